@@ -1,6 +1,7 @@
 #include <vk_buffers.h>
 #include "vk_rt_utils.h"
 #include "vk_utils.h"
+#include "vk_profiler.h"
 #include "vk_rt_funcs.h"
 
 namespace vk_rt_utils
@@ -370,11 +371,15 @@ namespace vk_rt_utils
     m_scratchBuf = vk_rt_utils::allocScratchBuffer(m_device, m_physDevice, m_scratchSize);
 
     std::vector<VkCommandBuffer> buildCmdBufs = vk_utils::createCommandBuffers(m_device, m_cmdPool, nBlas);
+    uint32_t zone = vk_utils::GpuProfiler::NO_ZONE;
     for(uint32_t idx = 0; idx < nBlas; idx++)
     {
       VkCommandBufferBeginInfo cmdBufInfo = {};
       cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO ;
       VK_CHECK_RESULT(vkBeginCommandBuffer(buildCmdBufs[idx], &cmdBufInfo));
+      // one zone for the whole submit, from the first command buffer to the last one
+      if(idx == 0)
+        zone = vk_utils::beginImmediateZone(m_profiler, buildCmdBufs[idx], "BuildBLAS", vk_utils::GpuZoneKind::EXECUTE);
       auto& blas   = m_blas[idx];
       buildInfos[idx].dstAccelerationStructure  = blas.handle;
       buildInfos[idx].scratchData.deviceAddress = m_scratchBuf.deviceAddress;
@@ -388,10 +393,13 @@ namespace vk_rt_utils
       barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
       vkCmdPipelineBarrier(buildCmdBufs[idx], VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
                            0, 1, &barrier, 0, nullptr, 0, nullptr);
+      if(idx + 1 == nBlas)
+        vk_utils::endImmediateZone(m_profiler, buildCmdBufs[idx], zone);
       vkEndCommandBuffer(buildCmdBufs[idx]);
     }
 
     vk_utils::executeCommandBufferNow(buildCmdBufs, m_queue, m_device);
+    vk_utils::resolveImmediateZones(m_profiler);
     buildCmdBufs.clear();
 
     if (m_scratchBuf.memory != VK_NULL_HANDLE)
@@ -454,9 +462,12 @@ namespace vk_rt_utils
     VkCommandBufferBeginInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+    const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, commandBuffer, "BuildTLAS", vk_utils::GpuZoneKind::EXECUTE);
     vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, accelerationBuildStructureRangeInfos.data());
+    vk_utils::endImmediateZone(m_profiler, commandBuffer, zone);
     vkEndCommandBuffer(commandBuffer);
     vk_utils::executeCommandBufferNow(commandBuffer, m_queue, m_device);
+    vk_utils::resolveImmediateZones(m_profiler);
 
     if (m_scratchBuf.memory != VK_NULL_HANDLE)
     {
@@ -494,11 +505,14 @@ namespace vk_rt_utils
     VkCommandBufferBeginInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+    const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, commandBuffer, "UpdateBLAS", vk_utils::GpuZoneKind::EXECUTE);
 
     vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, &pBuildOffset);
 
+    vk_utils::endImmediateZone(m_profiler, commandBuffer, zone);
     vkEndCommandBuffer(commandBuffer);
     vk_utils::executeCommandBufferNow(commandBuffer, m_queue, m_device);
+    vk_utils::resolveImmediateZones(m_profiler);
 
     if (m_scratchBuf.memory != VK_NULL_HANDLE)
     {
@@ -945,10 +959,13 @@ namespace vk_rt_utils
       VkCommandBufferBeginInfo cmdBufInfo = {};
       cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO ;
       VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+      const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, commandBuffer, "BuildTLAS", vk_utils::GpuZoneKind::EXECUTE);
       vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, accelerationBuildStructureRangeInfos.data());
+      vk_utils::endImmediateZone(m_profiler, commandBuffer, zone);
       vkEndCommandBuffer(commandBuffer);
     }
     vk_utils::executeCommandBufferNow(commandBuffer, m_queue, m_device);
+    vk_utils::resolveImmediateZones(m_profiler);
   }
 
   void AccelStructureBuilderV2::Destroy()
@@ -1031,20 +1048,55 @@ namespace vk_rt_utils
     return m_pipelineLayout;
   }
 
+  VkPipelineLayout RTPipelineMaker::MakeLayout(vk_utils::PipelineLayoutCache &a_cache, std::vector<VkDescriptorSetLayout> *a_pSetLayouts)
+  {
+    m_pipelineLayout = a_cache.GetPipelineLayout(reflection, a_pSetLayouts);
+    return m_pipelineLayout;
+  }
+
   void RTPipelineMaker::LoadShaders(VkDevice a_device, const std::vector<std::pair<VkShaderStageFlagBits, std::string>> &shader_paths)
   {
+    // the maker may be reused for another pipeline: drop stages of the previous one, modules which MakePipeline
+    // did not release yet are released here
+    for (size_t i = 0; i < shaderModules.size(); ++i)
+    {
+      if(shaderModules[i] == VK_NULL_HANDLE)
+        continue;
+      if(shaderModuleCache != nullptr)
+        shaderModuleCache->Release(shaderStages[i]);
+      else
+        vkDestroyShaderModule(a_device, shaderModules[i], VK_NULL_HANDLE);
+    }
+    shaderModules.clear();
+    shaderStages.clear();
+    shaderGroups.clear();
+    m_stagesNum = 0;
+    reflection  = {};
+
     for(auto& [stage, path] : shader_paths)
     {
       VkPipelineShaderStageCreateInfo shaderStage = {};
-      shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-      shaderStage.stage = stage;
+      if(shaderModuleCache != nullptr)
+      {
+        const std::vector<uint32_t>* pCode = nullptr;
+        if(!shaderModuleCache->Acquire(path, stage, shaderStage, &pCode))
+          RUN_TIME_ERROR(("[RTPipelineMaker::LoadShaders]: can't load shader " + path).c_str());
+        vk_utils::reflectSPIRV(*pCode, stage, reflection);
+        shaderModules.push_back(shaderStage.module);
+      }
+      else
+      {
+        shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStage.stage = stage;
 
-      auto shaderCode = vk_utils::readSPVFile(path.c_str());
-      shaderModules.push_back(vk_utils::createShaderModule(a_device, shaderCode));
-      shaderStage.module = shaderModules.back();
+        auto shaderCode = vk_utils::readSPVFile(path.c_str());
+        vk_utils::reflectSPIRV(shaderCode, stage, reflection);
+        shaderModules.push_back(vk_utils::createShaderModule(a_device, shaderCode));
+        shaderStage.module = shaderModules.back();
 
-      shaderStage.pName = "main";
-      assert(shaderStage.module != VK_NULL_HANDLE);
+        shaderStage.pName = "main";
+        assert(shaderStage.module != VK_NULL_HANDLE);
+      }
       shaderStages.push_back(shaderStage);
       m_stagesNum += 1;
 
@@ -1083,11 +1135,23 @@ namespace vk_rt_utils
     createInfo.maxPipelineRayRecursionDepth = a_maxDepth;
     createInfo.layout = m_pipelineLayout;
     createInfo.flags = a_flags;
-    VK_CHECK_RESULT(vkCreateRayTracingPipelinesKHR(a_device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &createInfo, nullptr, &m_pipeline));
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    if(pipelineCacheStore != nullptr)
+    {
+      cache            = pipelineCacheStore->Get();
+      createInfo.pNext = pipelineCacheStore->ChainFeedback(createInfo.pNext);
+    }
+
+    VK_CHECK_RESULT(vkCreateRayTracingPipelinesKHR(a_device, VK_NULL_HANDLE, cache, 1, &createInfo, nullptr, &m_pipeline));
+
+    if(pipelineCacheStore != nullptr)
+      pipelineCacheStore->CollectFeedback();
 
   for (size_t i = 0; i < m_stagesNum; ++i)
   {
-    if(shaderModules[i] != VK_NULL_HANDLE)
+    if(shaderModuleCache != nullptr)
+      shaderModuleCache->Release(shaderStages[i]);
+    else if(shaderModules[i] != VK_NULL_HANDLE)
       vkDestroyShaderModule(a_device, shaderModules[i], VK_NULL_HANDLE);
     shaderModules[i] = VK_NULL_HANDLE;
   }
@@ -3,11 +3,19 @@
 
 #include "vk_include.h"
 #include "vk_resource_manager.h"
+#include "vk_shader_reflection.h"
+#include "vk_pipeline_cache.h"
+#include "vk_shader_module_cache.h"
 #include "geom/vk_mesh.h"
 #include <array>
 #include <vector>
 #include <string>
 
+namespace vk_utils
+{
+  class GpuProfiler;
+}
+
 namespace vk_rt_utils
 {
   struct RTScratchBuffer
@@ -107,6 +115,9 @@ namespace vk_rt_utils
     uint64_t GetBLASDeviceAddress(uint32_t idx) const { assert(idx < m_blas.size()); return m_blas[idx].deviceAddress; };
     size_t   GetBLASCount() const { return m_blasInputs.size(); }
 
+    // build time of BuildTLAS goes to a_profiler->GetExecTime().msExecuteOnGPU, a_profiler must be created for a_queueIdx
+    void SetProfiler(vk_utils::GpuProfiler* a_profiler) { m_profiler = a_profiler; }
+
     void Destroy();
 
   private:
@@ -142,6 +153,8 @@ namespace vk_rt_utils
     vk_rt_utils::AccelStructure m_tlas{};
 
     std::vector<BLASBuildInput> m_blasInputs;
+
+    vk_utils::GpuProfiler* m_profiler = nullptr;
   };
 
   class AccelStructureBuilder
@@ -166,6 +179,9 @@ namespace vk_rt_utils
     VkAccelerationStructureKHR GetBLAS(uint32_t idx) const { assert(idx < m_blas.size()); return m_blas[idx].handle; };
     uint64_t GetBLASDeviceAddress(uint32_t idx) const { assert(idx < m_blas.size()); return m_blas[idx].deviceAddress; };
 
+    // build time goes to a_profiler->GetExecTime().msExecuteOnGPU, a_profiler must be created for a_queueIdx
+    void SetProfiler(vk_utils::GpuProfiler* a_profiler) { m_profiler = a_profiler; }
+
     void Destroy();
 
   private:
@@ -187,6 +203,8 @@ namespace vk_rt_utils
     RTScratchBuffer m_scratchBuf = {};
     VkDeviceSize m_scratchSize   = 0;
     VkDeviceSize m_totalBLASSize = 0;
+
+    vk_utils::GpuProfiler* m_profiler = nullptr;
   };
 
   struct RTPipelineMaker
@@ -194,10 +212,15 @@ namespace vk_rt_utils
     std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups{};
     std::vector<VkShaderModule> shaderModules{};
     std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+    vk_utils::ShaderReflection reflection{}; // merged interface of all stages, filled by LoadShaders
+    vk_utils::PipelineCacheStore* pipelineCacheStore = nullptr;
+    vk_utils::ShaderModuleCache*  shaderModuleCache  = nullptr; // modules are shared instead of created per pipeline
 
     void             LoadShaders(VkDevice a_device, const std::vector<std::pair<VkShaderStageFlagBits, std::string>> &shader_paths);
     VkPipelineLayout MakeLayout(VkDevice a_device, VkDescriptorSetLayout a_dslayout);
     VkPipelineLayout MakeLayout(VkDevice a_device, std::vector<VkDescriptorSetLayout> a_dslayouts);
+    // layout derived from shader reflection, shared with other pipelines through a_cache (which owns it)
+    VkPipelineLayout MakeLayout(vk_utils::PipelineLayoutCache &a_cache, std::vector<VkDescriptorSetLayout> *a_pSetLayouts = nullptr);
     VkPipeline       MakePipeline(VkDevice a_device, VkPipelineCreateFlags a_flags = 0, uint32_t a_maxDepth = 2);
 
     private:
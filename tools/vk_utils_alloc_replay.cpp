@@ -0,0 +1,78 @@
+// Replays allocation traces recorded with MemoryAlloc_Trace against the library allocators and prints time per op,
+// peak memory, number of vkAllocateMemory calls and fragmentation for each of them.
+//
+// usage: vk_utils_alloc_replay <trace file> [simple|special|vma|all] [device id]
+//
+// Device id is the physical device index as in globalContextInit; pick a software device (e.g. lavapipe)
+// to compare allocators without GPU driver noise.
+//
+#include "vk_context.h"
+#include "vk_utils.h"
+#include "vk_alloc.h"
+#include "vk_alloc_trace.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static std::shared_ptr<vk_utils::IMemoryAlloc> createAllocator(const std::string &a_name, const vk_utils::VulkanContext &a_ctx)
+{
+  if(a_name == "simple")
+    return vk_utils::CreateMemoryAlloc_Simple(a_ctx.device, a_ctx.physicalDevice);
+  if(a_name == "special")
+    return vk_utils::CreateMemoryAlloc_Special(a_ctx.device, a_ctx.physicalDevice);
+  if(a_name == "vma")
+    return vk_utils::CreateMemoryAlloc_VMA(a_ctx.instance, a_ctx.device, a_ctx.physicalDevice);
+  return nullptr;
+}
+
+int main(int argc, const char** argv)
+{
+  if(argc < 2)
+  {
+    std::cout << "usage: vk_utils_alloc_replay <trace file> [simple|special|vma|all] [device id]" << std::endl;
+    return 1;
+  }
+
+  const std::string tracePath = argv[1];
+  const std::string allocName = (argc > 2) ? argv[2] : "all";
+  const unsigned    deviceId  = (argc > 3) ? unsigned(std::strtoul(argv[3], nullptr, 10)) : 0;
+
+  std::vector<std::string> allocators;
+  if(allocName == "all")
+    allocators = {"simple", "special", "vma"};
+  else
+    allocators = {allocName};
+
+  auto ctx = vk_utils::globalContextInit(std::vector<const char*>(), false, deviceId);
+
+  int result = 0;
+  for(const auto &name : allocators)
+  {
+    // fresh allocator per run, so that every one starts with no memory allocated
+    //
+    auto pAlloc = createAllocator(name, ctx);
+    if(pAlloc == nullptr)
+    {
+      std::cout << "unknown allocator " << name << std::endl;
+      result = 1;
+      continue;
+    }
+
+    vk_utils::AllocReplayStats stats;
+    if(!vk_utils::replayAllocTrace(tracePath, pAlloc, stats))
+    {
+      std::cout << "can't read trace " << tracePath << std::endl;
+      result = 1;
+      break;
+    }
+
+    std::cout << name << ":" << std::endl;
+    vk_utils::printAllocReplayStats(stats);
+  }
+
+  vk_utils::globalContextDestroy();
+  return result;
+}
@@ -0,0 +1,115 @@
+// Measures DescriptorMaker::BindEnd latency for cache hits and misses (set allocation, update and LRU eviction)
+// and prints time per call for each case.
+//
+// usage: vk_utils_descriptor_bench [iterations] [device id]
+//
+// Misses are measured both without BeginFrame (evicted sets go back to the pool) and with it (evicted sets are reused
+// after setRecycleDelay frames). Nothing is submitted, so a software device (e.g. lavapipe) is fine as well.
+//
+#include "vk_context.h"
+#include "vk_utils.h"
+#include "vk_buffers.h"
+#include "vk_descriptor_sets.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static constexpr uint32_t     BINDINGS_PER_SET = 4;
+static constexpr uint32_t     CACHE_CAPACITY   = 4096;
+static constexpr VkDeviceSize RANGE            = 256; // max. of minStorageBufferOffsetAlignment, valid everywhere
+
+// each key binds BINDINGS_PER_SET consecutive sub-ranges starting at a_key, so keys differ in every binding
+//
+static void bindKey(vk_utils::DescriptorMaker &a_maker, VkBuffer a_buffer, uint32_t a_key)
+{
+  a_maker.BindBegin(VK_SHADER_STAGE_COMPUTE_BIT);
+  for(uint32_t loc = 0; loc < BINDINGS_PER_SET; ++loc)
+    a_maker.BindBuffer(loc, a_buffer, VkDeviceSize(a_key + loc) * RANGE, RANGE);
+}
+
+// a_framePeriod > 0 calls BeginFrame every a_framePeriod BindEnd calls (not timed)
+//
+static float measureBindEnd(vk_utils::DescriptorMaker &a_maker, VkBuffer a_buffer, uint32_t a_keyCount, uint32_t a_iterations,
+                            uint32_t a_framePeriod)
+{
+  using clock = std::chrono::high_resolution_clock;
+  VkDescriptorSet       set    = VK_NULL_HANDLE;
+  VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+
+  // warm up: fills the cache and creates the layout and its update template
+  //
+  for(uint32_t key = 0; key < a_keyCount; ++key)
+  {
+    bindKey(a_maker, a_buffer, key);
+    a_maker.BindEnd(&set, &layout);
+  }
+
+  double ns = 0.0;
+  uint32_t frame = 0;
+  for(uint32_t i = 0; i < a_iterations; ++i)
+  {
+    if(a_framePeriod > 0 && i % a_framePeriod == 0)
+      a_maker.BeginFrame(frame++);
+
+    bindKey(a_maker, a_buffer, i % a_keyCount);
+    auto start = clock::now();
+    a_maker.BindEnd(&set, &layout);
+    ns += double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+  }
+  return float(ns / double(a_iterations));
+}
+
+int main(int argc, const char** argv)
+{
+  const uint32_t iterations = (argc > 1) ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 100000;
+  const unsigned deviceId   = (argc > 2) ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 0;
+  if(iterations == 0)
+  {
+    std::cout << "usage: vk_utils_descriptor_bench [iterations] [device id]" << std::endl;
+    return 1;
+  }
+
+  auto ctx = vk_utils::globalContextInit(std::vector<const char*>(), false, deviceId);
+
+  // misses cycle through 4x more keys than the cache holds, so every BindEnd evicts the least recently used set
+  //
+  const uint32_t hitKeys  = 64;
+  const uint32_t missKeys = 4 * CACHE_CAPACITY;
+
+  VkBuffer buffer = vk_utils::createBuffer(ctx.device, VkDeviceSize(missKeys + BINDINGS_PER_SET) * RANGE,
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  VkDeviceMemory memory = vk_utils::allocateAndBindWithPadding(ctx.device, ctx.physicalDevice, {buffer});
+
+  const vk_utils::DescriptorTypesVec poolSizes = {{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1024 * BINDINGS_PER_SET}};
+
+  struct Case
+  {
+    const char* name;
+    uint32_t    keyCount;
+    uint32_t    framePeriod;
+  };
+  const Case cases[] = {
+    {"hit",                      hitKeys,  0},
+    {"miss",                     missKeys, 0},
+    {"miss, BeginFrame per 256", missKeys, 256},
+  };
+
+  for(const auto &c : cases)
+  {
+    // fresh maker per case, so that pools and cache of one case don't affect the next one
+    //
+    vk_utils::DescriptorMaker maker(ctx.device, poolSizes, 1024);
+    maker.SetCacheCapacity(CACHE_CAPACITY);
+
+    const float nsPerCall = measureBindEnd(maker, buffer, c.keyCount, iterations, c.framePeriod);
+    std::cout << "BindEnd " << c.name << ": " << nsPerCall << " ns/call" << std::endl;
+  }
+
+  vkDestroyBuffer(ctx.device, buffer, nullptr);
+  vkFreeMemory(ctx.device, memory, nullptr);
+  vk_utils::globalContextDestroy();
+  return 0;
+}
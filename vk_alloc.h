@@ -45,6 +45,9 @@ namespace vk_utils
 
     virtual VkPhysicalDevice GetPhysicalDevice() const = 0;
 
+    // number of vkAllocateMemory calls made so far, UINT32_MAX if the allocator can't count them
+    virtual uint32_t GetDeviceMemoryAllocCount() const { return UINT32_MAX; }
+
     virtual ~IMemoryAlloc() = default;
   };
 
@@ -2,6 +2,7 @@
 #include "vk_utils.h"
 #include "vk_buffers.h"
 #include "vk_images.h"
+#include "vk_trace.h"
 #include <unordered_map>
 
 namespace vk_utils
@@ -35,6 +36,7 @@ namespace vk_utils
 
   uint32_t MemoryAlloc_Simple::Allocate(const MemAllocInfo& a_allocInfo)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Simple::Allocate", "alloc");
     VkMemoryAllocateInfo memAllocInfo {};
     memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     memAllocInfo.allocationSize = a_allocInfo.memReq.size;
@@ -66,6 +68,7 @@ namespace vk_utils
     VkDeviceMemory memory = VK_NULL_HANDLE;
     VkResult result = vkAllocateMemory(m_device, &memAllocInfo, nullptr, &memory);
     VK_CHECK_RESULT(result);
+    m_deviceAllocCount++;
 
     MemoryBlock block {};
     block.memory = memory;
@@ -81,6 +84,7 @@ namespace vk_utils
 
   uint32_t MemoryAlloc_Simple::Allocate(const MemAllocInfo& a_allocInfoBuffers, const std::vector<VkBuffer> &a_buffers)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Simple::Allocate", "alloc");
     MemAllocInfo allocInfo = a_allocInfoBuffers;
     std::vector<VkMemoryRequirements> bufMemReqs(a_buffers.size());
     for(size_t i = 0; i < a_buffers.size(); ++i)
@@ -139,6 +143,7 @@ namespace vk_utils
 
   uint32_t MemoryAlloc_Simple::Allocate(const MemAllocInfo& a_allocInfoImages, const std::vector<VkImage> &a_images)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Simple::Allocate", "alloc");
     MemAllocInfo allocInfo = a_allocInfoImages;
     std::vector<VkMemoryRequirements> imgMemReqs(a_images.size());
     for(size_t i = 0; i < a_images.size(); ++i)
@@ -198,6 +203,7 @@ namespace vk_utils
 
   void MemoryAlloc_Simple::Free(uint32_t a_memBlockId)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Simple::Free", "alloc");
     if(!m_allocations.count(a_memBlockId)|| m_allocations[a_memBlockId].memory == VK_NULL_HANDLE)
       return;
 
@@ -223,6 +229,7 @@ namespace vk_utils
 
   void* MemoryAlloc_Simple::Map(uint32_t a_memBlockId, VkDeviceSize a_offset, VkDeviceSize a_size)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Simple::Map", "map");
     if(!m_allocations.count(a_memBlockId))
       return nullptr;
 
@@ -235,6 +242,7 @@ namespace vk_utils
 
   void MemoryAlloc_Simple::Unmap(uint32_t a_memBlockId)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Simple::Unmap", "map");
     if(!m_allocations.count(a_memBlockId))
       return;
 
@@ -261,6 +269,7 @@ namespace vk_utils
 
   uint32_t MemoryAlloc_Special::Allocate(const MemAllocInfo& a_allocInfo)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Special::Allocate", "alloc");
     (void)a_allocInfo;
     VK_UTILS_LOG_WARNING("[MemoryAlloc_Special::Allocate] general allocation not supported");
     return UINT32_MAX;
@@ -298,6 +307,7 @@ namespace vk_utils
     VkDeviceMemory memory = VK_NULL_HANDLE;
     VkResult result = vkAllocateMemory(m_device, &memAllocInfo, nullptr, &memory);
     VK_CHECK_RESULT(result);
+    m_deviceAllocCount++;
 
     MemoryBlock block {};
     block.memory = memory;
@@ -392,11 +402,13 @@ uint32_t MemoryAlloc_Special::AllocateHidden(const MemAllocInfo& a_allocInfoBuff
 
   uint32_t MemoryAlloc_Special::Allocate(const MemAllocInfo& a_allocInfoBuffers, const std::vector<VkBuffer> &a_buffers)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Special::Allocate", "alloc");
     return AllocateHidden(a_allocInfoBuffers, a_buffers);
   }
 
   uint32_t MemoryAlloc_Special::Allocate(const MemAllocInfo& a_allocInfoImages, const std::vector<VkImage> &a_images)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Special::Allocate", "alloc");
     MemAllocInfo allocInfo = a_allocInfoImages;
     std::vector<VkMemoryRequirements> imgMemReqs(a_images.size());
     for(size_t i = 0; i < a_images.size(); ++i)
@@ -467,6 +479,7 @@ uint32_t MemoryAlloc_Special::AllocateHidden(const MemAllocInfo& a_allocInfoBuff
 
   void MemoryAlloc_Special::Free(uint32_t a_memBlockId)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Special::Free", "alloc");
     assert(a_memBlockId == BUF_ALLOC_ID || a_memBlockId == IMG_ALLOC_ID);
 
     switch(a_memBlockId)
@@ -517,6 +530,7 @@ uint32_t MemoryAlloc_Special::AllocateHidden(const MemAllocInfo& a_allocInfoBuff
 
   void* MemoryAlloc_Special::Map(uint32_t a_memBlockId, VkDeviceSize a_offset, VkDeviceSize a_size)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Special::Map", "map");
     assert(a_memBlockId == BUF_ALLOC_ID || a_memBlockId == IMG_ALLOC_ID);
 
     void* ptr = nullptr;
@@ -537,6 +551,7 @@ uint32_t MemoryAlloc_Special::AllocateHidden(const MemAllocInfo& a_allocInfoBuff
 
   void MemoryAlloc_Special::Unmap(uint32_t a_memBlockId)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_Special::Unmap", "map");
     assert(a_memBlockId == BUF_ALLOC_ID || a_memBlockId == IMG_ALLOC_ID);
 
     switch(a_memBlockId)
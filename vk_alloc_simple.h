@@ -25,6 +25,7 @@ namespace vk_utils
     void Unmap(uint32_t a_memBlockId) override;
     VkDevice GetDevice() const override { return m_device; }
     VkPhysicalDevice GetPhysicalDevice() const override { return m_physicalDevice; }
+    uint32_t GetDeviceMemoryAllocCount() const override { return m_deviceAllocCount; }
 
   private:
 
@@ -33,6 +34,7 @@ namespace vk_utils
     VkPhysicalDeviceMemoryProperties m_physicalMemoryProps = {};
 
     uint32_t nextAllocIdx = 0;
+    uint32_t m_deviceAllocCount = 0;
     std::unordered_map<uint32_t, MemoryBlock> m_allocations;
   };
 
@@ -53,6 +55,7 @@ namespace vk_utils
     void Unmap(uint32_t a_memBlockId) override;
     VkDevice GetDevice() const override { return m_device; }
     VkPhysicalDevice GetPhysicalDevice() const override { return m_physicalDevice; }
+    uint32_t GetDeviceMemoryAllocCount() const override { return m_deviceAllocCount; }
 
   private:
     static constexpr uint8_t BUF_ALLOC_ID = 0;
@@ -67,6 +70,7 @@ namespace vk_utils
 
     MemoryBlock m_bufAlloc = {};
     MemoryBlock m_imgAlloc = {};
+    uint32_t    m_deviceAllocCount = 0;
   };
 }
 
@@ -0,0 +1,478 @@
+#include "vk_alloc_trace.h"
+#include "vk_utils.h"
+#include "vk_buffers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+
+namespace vk_utils
+{
+  // trace format: "VKAT", uint32 version, then records of uint8 op + uint32 id + op specific payload
+  //
+  static constexpr char     TRACE_MAGIC[4] = {'V', 'K', 'A', 'T'};
+  static constexpr uint32_t TRACE_VERSION  = 1;
+
+  enum class TraceOp : uint8_t
+  {
+    ALLOCATE = 0,
+    FREE     = 1,
+    FREE_ALL = 2,
+    MAP      = 3,
+    UNMAP    = 4
+  };
+
+  enum TraceResourceKind : uint8_t
+  {
+    TRACE_RES_NONE    = 0,
+    TRACE_RES_BUFFERS = 1,
+    TRACE_RES_IMAGES  = 2
+  };
+
+  template<typename T>
+  static void writePod(FILE* a_file, const T &a_val) { fwrite(&a_val, sizeof(T), 1, a_file); }
+
+  template<typename T>
+  static bool readPod(FILE* a_file, T &a_val) { return fread(&a_val, sizeof(T), 1, a_file) == 1; }
+
+  static void writeMemReq(FILE* a_file, const VkMemoryRequirements &a_req)
+  {
+    writePod(a_file, uint64_t(a_req.size));
+    writePod(a_file, uint64_t(a_req.alignment));
+    writePod(a_file, uint32_t(a_req.memoryTypeBits));
+  }
+
+  static bool readMemReq(FILE* a_file, VkMemoryRequirements &a_req)
+  {
+    uint64_t size, alignment;
+    uint32_t typeBits;
+    if(!readPod(a_file, size) || !readPod(a_file, alignment) || !readPod(a_file, typeBits))
+      return false;
+    a_req = {VkDeviceSize(size), VkDeviceSize(alignment), typeBits};
+    return true;
+  }
+
+  std::shared_ptr<IMemoryAlloc> CreateMemoryAlloc_Trace(std::shared_ptr<IMemoryAlloc> a_pAlloc, const std::string &a_tracePath)
+  {
+    return std::make_shared<MemoryAlloc_Trace>(a_pAlloc, a_tracePath);
+  }
+
+  MemoryAlloc_Trace::MemoryAlloc_Trace(std::shared_ptr<IMemoryAlloc> a_pAlloc, const std::string &a_tracePath) : m_pAlloc(a_pAlloc)
+  {
+    m_file = fopen(a_tracePath.c_str(), "wb");
+    if(m_file == nullptr)
+    {
+      VK_UTILS_LOG_WARNING("[MemoryAlloc_Trace::MemoryAlloc_Trace] can't open trace file " + a_tracePath + ", tracing disabled");
+      return;
+    }
+    fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), m_file);
+    writePod(m_file, TRACE_VERSION);
+  }
+
+  MemoryAlloc_Trace::~MemoryAlloc_Trace()
+  {
+    if(m_file != nullptr)
+      fclose(m_file);
+  }
+
+  void MemoryAlloc_Trace::WriteAlloc(uint32_t a_id, const MemAllocInfo& a_allocInfo)
+  {
+    if(m_file == nullptr)
+      return;
+
+    writePod(m_file, TraceOp::ALLOCATE);
+    writePod(m_file, a_id);
+    writeMemReq(m_file, a_allocInfo.memReq);
+    writePod(m_file, uint32_t(a_allocInfo.memUsage));
+    writePod(m_file, uint32_t(a_allocInfo.allocateFlags));
+    uint8_t dedicated = (a_allocInfo.dedicated_buffer != VK_NULL_HANDLE ? 1 : 0) | (a_allocInfo.dedicated_image != VK_NULL_HANDLE ? 2 : 0);
+    writePod(m_file, dedicated);
+  }
+
+  uint32_t MemoryAlloc_Trace::Allocate(const MemAllocInfo& a_allocInfo)
+  {
+    uint32_t id = m_pAlloc->Allocate(a_allocInfo);
+    WriteAlloc(id, a_allocInfo);
+    if(m_file != nullptr)
+    {
+      writePod(m_file, uint8_t(TRACE_RES_NONE));
+      writePod(m_file, uint32_t(0));
+    }
+    return id;
+  }
+
+  uint32_t MemoryAlloc_Trace::Allocate(const MemAllocInfo& a_allocInfoBuffers, const std::vector<VkBuffer> &a_buffers)
+  {
+    uint32_t id = m_pAlloc->Allocate(a_allocInfoBuffers, a_buffers);
+    WriteAlloc(id, a_allocInfoBuffers);
+    if(m_file != nullptr)
+    {
+      writePod(m_file, uint8_t(TRACE_RES_BUFFERS));
+      writePod(m_file, uint32_t(a_buffers.size()));
+      for(auto buf : a_buffers)
+      {
+        VkMemoryRequirements req = {};
+        if(buf != VK_NULL_HANDLE)
+          vkGetBufferMemoryRequirements(GetDevice(), buf, &req);
+        writeMemReq(m_file, req);
+      }
+    }
+    return id;
+  }
+
+  uint32_t MemoryAlloc_Trace::Allocate(const MemAllocInfo& a_allocInfoImages, const std::vector<VkImage> &a_images)
+  {
+    uint32_t id = m_pAlloc->Allocate(a_allocInfoImages, a_images);
+    WriteAlloc(id, a_allocInfoImages);
+    if(m_file != nullptr)
+    {
+      writePod(m_file, uint8_t(TRACE_RES_IMAGES));
+      writePod(m_file, uint32_t(a_images.size()));
+      for(auto img : a_images)
+      {
+        VkMemoryRequirements req = {};
+        if(img != VK_NULL_HANDLE)
+          vkGetImageMemoryRequirements(GetDevice(), img, &req);
+        writeMemReq(m_file, req);
+      }
+    }
+    return id;
+  }
+
+  void MemoryAlloc_Trace::Free(uint32_t a_memBlockId)
+  {
+    if(m_file != nullptr)
+    {
+      writePod(m_file, TraceOp::FREE);
+      writePod(m_file, a_memBlockId);
+    }
+    m_pAlloc->Free(a_memBlockId);
+  }
+
+  void MemoryAlloc_Trace::FreeAllMemory()
+  {
+    if(m_file != nullptr)
+    {
+      writePod(m_file, TraceOp::FREE_ALL);
+      writePod(m_file, uint32_t(0));
+    }
+    m_pAlloc->FreeAllMemory();
+  }
+
+  void* MemoryAlloc_Trace::Map(uint32_t a_memBlockId, VkDeviceSize a_offset, VkDeviceSize a_size)
+  {
+    if(m_file != nullptr)
+    {
+      writePod(m_file, TraceOp::MAP);
+      writePod(m_file, a_memBlockId);
+      writePod(m_file, uint64_t(a_offset));
+      writePod(m_file, uint64_t(a_size));
+    }
+    return m_pAlloc->Map(a_memBlockId, a_offset, a_size);
+  }
+
+  void MemoryAlloc_Trace::Unmap(uint32_t a_memBlockId)
+  {
+    if(m_file != nullptr)
+    {
+      writePod(m_file, TraceOp::UNMAP);
+      writePod(m_file, a_memBlockId);
+    }
+    m_pAlloc->Unmap(a_memBlockId);
+  }
+
+  ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  // buffers or images standing in for the recorded resources of a batched allocation
+  //
+  struct ReplayResources
+  {
+    std::vector<VkBuffer> buffers;
+    std::vector<VkImage>  images;
+  };
+
+  static VkBuffer createPlaceholderBuffer(VkDevice a_device, VkDeviceSize a_size)
+  {
+    VkBufferCreateInfo createInfo {};
+    createInfo.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    createInfo.size        = a_size;
+    createInfo.usage       = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    if(vkCreateBuffer(a_device, &createInfo, nullptr, &buffer) != VK_SUCCESS)
+      return VK_NULL_HANDLE;
+    return buffer;
+  }
+
+  // RGBA8 texture with about a_size bytes of texels, rows of 4096 texels are spread over 4096x4096 layers;
+  // both limits are the minimum guaranteed ones
+  //
+  static VkImage createPlaceholderImage(VkDevice a_device, VkDeviceSize a_size)
+  {
+    constexpr VkDeviceSize MAX_DIM = 4096;
+    const VkDeviceSize texels = std::max<VkDeviceSize>((a_size + 3) / 4, 1);
+    const VkDeviceSize width  = std::min(texels, MAX_DIM);
+    const VkDeviceSize rows   = (texels + width - 1) / width;
+
+    VkImageCreateInfo createInfo {};
+    createInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    createInfo.imageType     = VK_IMAGE_TYPE_2D;
+    createInfo.format        = VK_FORMAT_R8G8B8A8_UNORM;
+    createInfo.extent        = { uint32_t(width), uint32_t(std::min(rows, MAX_DIM)), 1 };
+    createInfo.mipLevels     = 1;
+    createInfo.arrayLayers   = uint32_t((rows + MAX_DIM - 1) / MAX_DIM);
+    createInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+    createInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+    createInfo.usage         = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    createInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+    createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkImage image = VK_NULL_HANDLE;
+    if(vkCreateImage(a_device, &createInfo, nullptr, &image) != VK_SUCCESS)
+      return VK_NULL_HANDLE;
+    return image;
+  }
+
+  static void destroyPlaceholders(VkDevice a_device, const ReplayResources &a_res)
+  {
+    for(auto buf : a_res.buffers)
+    {
+      if(buf != VK_NULL_HANDLE)
+        vkDestroyBuffer(a_device, buf, nullptr);
+    }
+    for(auto img : a_res.images)
+    {
+      if(img != VK_NULL_HANDLE)
+        vkDestroyImage(a_device, img, nullptr);
+    }
+  }
+
+  static float computeFragmentation(IMemoryAlloc* a_pAlloc, const std::unordered_map<uint32_t, uint32_t> &a_live)
+  {
+    std::map<VkDeviceMemory, VkDeviceSize> spans;
+    VkDeviceSize liveBytes = 0;
+    for(auto& [traceId, id] : a_live)
+    {
+      auto block = a_pAlloc->GetMemoryBlock(id);
+      spans[block.memory] = std::max(spans[block.memory], block.offset + block.size);
+      liveBytes += block.size;
+    }
+
+    VkDeviceSize spanBytes = 0;
+    for(auto& [mem, span] : spans)
+      spanBytes += span;
+
+    return spanBytes > 0 ? 1.0f - float(double(liveBytes) / double(spanBytes)) : 0.0f;
+  }
+
+  bool replayAllocTrace(const std::string &a_tracePath, std::shared_ptr<IMemoryAlloc> a_pAlloc, AllocReplayStats &a_stats)
+  {
+    FILE* file = fopen(a_tracePath.c_str(), "rb");
+    if(file == nullptr)
+    {
+      VK_UTILS_LOG_ERROR("[replayAllocTrace] can't open trace file " + a_tracePath);
+      return false;
+    }
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    if(fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+       !readPod(file, version) || version != TRACE_VERSION)
+    {
+      VK_UTILS_LOG_ERROR("[replayAllocTrace] invalid trace file or unsupported version: " + a_tracePath);
+      fclose(file);
+      return false;
+    }
+
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(a_pAlloc->GetPhysicalDevice(), &memProps);
+    const uint32_t allTypeBits = memProps.memoryTypeCount >= 32 ? UINT32_MAX : (1u << memProps.memoryTypeCount) - 1u;
+
+    using clock = std::chrono::high_resolution_clock;
+    auto msSince = [](clock::time_point a_start) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - a_start).count() / 1000000.f;
+    };
+
+    a_stats = AllocReplayStats{};
+    std::unordered_map<uint32_t, uint32_t>        idMap;        // trace id -> replay id
+    std::unordered_map<uint32_t, VkDeviceSize>    liveSizes;    // trace id -> requested size
+    std::unordered_map<uint32_t, ReplayResources> placeholders; // trace id -> resources bound to the allocation
+    std::unordered_set<VkDeviceMemory>            memObjects;
+    VkDeviceSize liveBytes = 0;
+
+    const VkDevice device          = a_pAlloc->GetDevice();
+    const uint32_t deviceAllocsOld = a_pAlloc->GetDeviceMemoryAllocCount();
+
+    bool ok = true;
+    TraceOp op;
+    uint32_t traceId;
+    while(readPod(file, op) && readPod(file, traceId))
+    {
+      switch(op)
+      {
+      case TraceOp::ALLOCATE:
+      {
+        MemAllocInfo info = {};
+        uint32_t memUsage, allocFlags, resCount;
+        uint8_t dedicated, resKind;
+        ok = readMemReq(file, info.memReq) && readPod(file, memUsage) && readPod(file, allocFlags) &&
+             readPod(file, dedicated) && readPod(file, resKind) && readPod(file, resCount);
+        std::vector<VkMemoryRequirements> resReqs(ok ? resCount : 0);
+        for(auto& req : resReqs)
+          ok = ok && readMemReq(file, req);
+        if(!ok)
+          break;
+
+        info.memUsage      = memUsage;
+        info.allocateFlags = allocFlags;
+        info.memReq.memoryTypeBits = allTypeBits; // used only without resources, batches take requirements of placeholders
+
+        VkDeviceSize requested = info.memReq.size;
+        ReplayResources res;
+        if(!resReqs.empty())
+          requested = calculateMemOffsets(resReqs).back();
+        for(const auto& req : resReqs)
+        {
+          if(resKind == TRACE_RES_BUFFERS)
+            res.buffers.push_back(req.size > 0 ? createPlaceholderBuffer(device, req.size) : VK_NULL_HANDLE);
+          else if(resKind == TRACE_RES_IMAGES)
+            res.images.push_back(req.size > 0 ? createPlaceholderImage(device, req.size) : VK_NULL_HANDLE);
+        }
+        if((dedicated & 1) != 0 && res.buffers.size() == 1)
+          info.dedicated_buffer = res.buffers[0];
+        if((dedicated & 2) != 0 && res.images.size() == 1)
+          info.dedicated_image = res.images[0];
+
+        auto start = clock::now();
+        uint32_t id = UINT32_MAX;
+        if(resKind == TRACE_RES_BUFFERS)
+          id = a_pAlloc->Allocate(info, res.buffers);
+        else if(resKind == TRACE_RES_IMAGES)
+          id = a_pAlloc->Allocate(info, res.images);
+        else
+          id = a_pAlloc->Allocate(info);
+        a_stats.msAllocate += msSince(start);
+        a_stats.numAllocs++;
+
+        if(id == UINT32_MAX)
+        {
+          VK_UTILS_LOG_WARNING("[replayAllocTrace] allocation failed during replay");
+          destroyPlaceholders(device, res);
+          break;
+        }
+        idMap[traceId]        = id;
+        liveSizes[traceId]    = requested;
+        placeholders[traceId] = std::move(res);
+        liveBytes            += requested;
+        memObjects.insert(a_pAlloc->GetMemoryBlock(id).memory);
+
+        if(liveBytes > a_stats.peakLiveBytes)
+        {
+          a_stats.peakLiveBytes       = liveBytes;
+          a_stats.fragmentationAtPeak = computeFragmentation(a_pAlloc.get(), idMap);
+        }
+        break;
+      }
+      case TraceOp::FREE:
+      {
+        auto it = idMap.find(traceId);
+        if(it == idMap.end())
+          break;
+        auto start = clock::now();
+        a_pAlloc->Free(it->second);
+        a_stats.msFree += msSince(start);
+        a_stats.numFrees++;
+
+        liveBytes -= liveSizes[traceId];
+        liveSizes.erase(traceId);
+        idMap.erase(it);
+        destroyPlaceholders(device, placeholders[traceId]);
+        placeholders.erase(traceId);
+        break;
+      }
+      case TraceOp::FREE_ALL:
+      {
+        auto start = clock::now();
+        a_pAlloc->FreeAllMemory();
+        a_stats.msFree += msSince(start);
+        a_stats.numFrees++;
+
+        idMap.clear();
+        liveSizes.clear();
+        liveBytes = 0;
+        for(const auto& [id, res] : placeholders)
+          destroyPlaceholders(device, res);
+        placeholders.clear();
+        break;
+      }
+      case TraceOp::MAP:
+      {
+        uint64_t offset, size;
+        ok = readPod(file, offset) && readPod(file, size);
+        auto it = idMap.find(traceId);
+        if(!ok || it == idMap.end())
+          break;
+        auto start = clock::now();
+        a_pAlloc->Map(it->second, offset, size);
+        a_stats.msMap += msSince(start);
+        a_stats.numMaps++;
+        break;
+      }
+      case TraceOp::UNMAP:
+      {
+        auto it = idMap.find(traceId);
+        if(it == idMap.end())
+          break;
+        auto start = clock::now();
+        a_pAlloc->Unmap(it->second);
+        a_stats.msUnmap += msSince(start);
+        a_stats.numUnmaps++;
+        break;
+      }
+      default:
+        ok = false;
+        break;
+      }
+
+      if(!ok)
+      {
+        VK_UTILS_LOG_ERROR("[replayAllocTrace] trace file is truncated or corrupted: " + a_tracePath);
+        break;
+      }
+    }
+
+    const uint32_t deviceAllocsNew = a_pAlloc->GetDeviceMemoryAllocCount();
+    if(deviceAllocsNew != UINT32_MAX && deviceAllocsOld != UINT32_MAX)
+      a_stats.numDeviceMemoryAllocs = deviceAllocsNew - deviceAllocsOld;
+    else
+      a_stats.numDeviceMemoryAllocs = static_cast<uint32_t>(memObjects.size());
+
+    a_pAlloc->FreeAllMemory();
+    for(const auto& [id, res] : placeholders)
+      destroyPlaceholders(device, res);
+    fclose(file);
+    return ok;
+  }
+
+  void printAllocReplayStats(const AllocReplayStats &a_stats)
+  {
+    std::stringstream ss;
+    ss << "[replayAllocTrace] allocs: " << a_stats.numAllocs
+       << " (" << (a_stats.numAllocs ? a_stats.msAllocate * 1000.0f / float(a_stats.numAllocs) : 0.0f) << " us/op)"
+       << ", frees: " << a_stats.numFrees
+       << " (" << (a_stats.numFrees ? a_stats.msFree * 1000.0f / float(a_stats.numFrees) : 0.0f) << " us/op)"
+       << ", maps: " << a_stats.numMaps
+       << " (" << (a_stats.numMaps ? a_stats.msMap * 1000.0f / float(a_stats.numMaps) : 0.0f) << " us/op)"
+       << ", unmaps: " << a_stats.numUnmaps
+       << " (" << (a_stats.numUnmaps ? a_stats.msUnmap * 1000.0f / float(a_stats.numUnmaps) : 0.0f) << " us/op)"
+       << ", peak: " << a_stats.peakLiveBytes / (1024 * 1024) << " MB"
+       << ", vkAllocateMemory calls: " << a_stats.numDeviceMemoryAllocs
+       << ", fragmentation at peak: " << a_stats.fragmentationAtPeak * 100.0f << "%";
+    VK_UTILS_LOG_INFO(ss.str());
+  }
+}
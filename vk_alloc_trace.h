@@ -0,0 +1,76 @@
+#ifndef VKUTILS_VK_ALLOC_TRACE_H
+#define VKUTILS_VK_ALLOC_TRACE_H
+
+#include "vk_alloc.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace vk_utils
+{
+  // Decorator which forwards everything to wrapped allocator and records Allocate/Free/Map/Unmap calls
+  // to a compact binary log, which can be replayed later with replayAllocTrace against any IMemoryAlloc.
+  //
+  // Batched allocations (with buffers or images) are stored with per-resource memory requirements,
+  // dedicated resource handles are stored as flags only.
+  //
+  struct MemoryAlloc_Trace : IMemoryAlloc
+  {
+    MemoryAlloc_Trace(std::shared_ptr<IMemoryAlloc> a_pAlloc, const std::string &a_tracePath);
+    ~MemoryAlloc_Trace() override;
+
+    uint32_t Allocate(const MemAllocInfo& a_allocInfo) override;
+    uint32_t Allocate(const MemAllocInfo& a_allocInfoBuffers, const std::vector<VkBuffer> &a_buffers) override;
+    uint32_t Allocate(const MemAllocInfo& a_allocInfoImages, const std::vector<VkImage> &a_images) override;
+
+    void Free(uint32_t a_memBlockId) override;
+    void FreeAllMemory() override;
+
+    MemoryBlock GetMemoryBlock(uint32_t a_memBlockId) const override { return m_pAlloc->GetMemoryBlock(a_memBlockId); }
+
+    void* Map(uint32_t a_memBlockId, VkDeviceSize a_offset, VkDeviceSize a_size) override;
+    void Unmap(uint32_t a_memBlockId) override;
+
+    VkDevice GetDevice() const override { return m_pAlloc->GetDevice(); }
+    VkPhysicalDevice GetPhysicalDevice() const override { return m_pAlloc->GetPhysicalDevice(); }
+    uint32_t GetDeviceMemoryAllocCount() const override { return m_pAlloc->GetDeviceMemoryAllocCount(); }
+
+    std::shared_ptr<IMemoryAlloc> GetWrapped() const { return m_pAlloc; }
+
+  private:
+    void WriteAlloc(uint32_t a_id, const MemAllocInfo& a_allocInfo);
+
+    std::shared_ptr<IMemoryAlloc> m_pAlloc;
+    FILE* m_file = nullptr;
+  };
+
+  std::shared_ptr<IMemoryAlloc> CreateMemoryAlloc_Trace(std::shared_ptr<IMemoryAlloc> a_pAlloc, const std::string &a_tracePath);
+
+  struct AllocReplayStats
+  {
+    uint32_t numAllocs   = 0;
+    uint32_t numFrees    = 0;
+    uint32_t numMaps     = 0;
+    uint32_t numUnmaps   = 0;
+    float    msAllocate  = 0.0f; // total time spent in each kind of op
+    float    msFree      = 0.0f;
+    float    msMap       = 0.0f;
+    float    msUnmap     = 0.0f;
+
+    VkDeviceSize peakLiveBytes  = 0; // sum of requested sizes at peak
+    uint32_t     numDeviceMemoryAllocs = 0; // vkAllocateMemory calls, distinct VkDeviceMemory handles if the allocator can't count them
+
+    // 1 - live bytes / used span of memory objects, measured at peak
+    float fragmentationAtPeak = 0.0f;
+  };
+
+  // replays trace recorded by MemoryAlloc_Trace against a_pAlloc. Batched allocations are replayed with placeholder
+  // buffers or images of the recorded sizes, so memory types and alignment come from a_pAlloc's device; allocations
+  // without resources are replayed as they are (MemoryAlloc_Special doesn't support them). Returns false if trace can't be read
+  //
+  bool replayAllocTrace(const std::string &a_tracePath, std::shared_ptr<IMemoryAlloc> a_pAlloc, AllocReplayStats &a_stats);
+
+  void printAllocReplayStats(const AllocReplayStats &a_stats);
+}
+
+#endif// VKUTILS_VK_ALLOC_TRACE_H
@@ -8,6 +8,8 @@
 #include "vk_utils.h"
 #include "vk_images.h"
 #include "vk_buffers.h"
+#include "vk_trace.h"
+#include "vk_sparse_texture.h"
 
 namespace vk_utils
 {
@@ -63,7 +65,7 @@ namespace vk_utils
   }
 
   VmaAllocator initVMA(VkInstance a_instance, VkDevice a_device, VkPhysicalDevice a_physicalDevice,
-                       VkFlags a_flags, uint32_t a_vkAPIVersion)
+                       VkFlags a_flags, uint32_t a_vkAPIVersion, const VmaDeviceMemoryCallbacks* a_pMemoryCallbacks)
   {
     VmaVulkanFunctions functions = {};
     functions.vkAllocateMemory                    = vkAllocateMemory;
@@ -107,6 +109,7 @@ namespace vk_utils
     allocatorInfo.device           = a_device;
     allocatorInfo.flags            = a_flags;  // VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
     allocatorInfo.pVulkanFunctions = &functions;
+    allocatorInfo.pDeviceMemoryCallbacks = a_pMemoryCallbacks;
 
     VmaAllocator allocator;
     vmaCreateAllocator(&allocatorInfo, &allocator);
@@ -120,13 +123,24 @@ namespace vk_utils
 
   }
 
+  static void VKAPI_PTR countDeviceMemoryAlloc(VmaAllocator, uint32_t, VkDeviceMemory, VkDeviceSize, void* a_pUserData)
+  {
+    static_cast<std::atomic<uint32_t>*>(a_pUserData)->fetch_add(1, std::memory_order_relaxed);
+  }
+
   MemoryAlloc_VMA::MemoryAlloc_VMA(VkInstance a_instance, VkDevice a_device, VkPhysicalDevice a_physicalDevice,
                                    VkFlags a_flags, uint32_t a_vkAPIVersion) :
                                    m_device(a_device), m_physicalDevice(a_physicalDevice)
   {
     // vma created internally and will be destroyed internally
     m_destroyVma = true;
-    m_vma = initVMA(a_instance, a_device, a_physicalDevice, a_flags, a_vkAPIVersion);
+
+    // VMA copies the callbacks, pUserData must outlive the allocator
+    VmaDeviceMemoryCallbacks callbacks = {};
+    callbacks.pfnAllocate = countDeviceMemoryAlloc;
+    callbacks.pUserData = &m_deviceAllocCount;
+    m_countAllocs = true;
+    m_vma = initVMA(a_instance, a_device, a_physicalDevice, a_flags, a_vkAPIVersion, &callbacks);
   }
 
   VmaAllocator MemoryAlloc_VMA::GetVMA()
@@ -152,6 +166,7 @@ namespace vk_utils
 
   uint32_t MemoryAlloc_VMA::Allocate(const MemAllocInfo& a_allocInfo)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_VMA::Allocate", "alloc");
     VmaAllocationCreateInfo vmaAllocCreateInfo = {};
     vmaAllocCreateInfo.usage = getVMAMemoryUsage(a_allocInfo.memUsage);
     if(a_allocInfo.dedicated_image || a_allocInfo.dedicated_buffer)
@@ -175,6 +190,7 @@ namespace vk_utils
 
   uint32_t MemoryAlloc_VMA::Allocate(const MemAllocInfo& a_allocInfoBuffers, const std::vector<VkBuffer> &a_buffers)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_VMA::Allocate", "alloc");
     MemAllocInfo allocInfo = a_allocInfoBuffers;
     std::vector<VkMemoryRequirements> bufMemReqs(a_buffers.size());
     for(size_t i = 0; i < a_buffers.size(); ++i)
@@ -216,6 +232,7 @@ namespace vk_utils
 
   uint32_t MemoryAlloc_VMA::Allocate(const MemAllocInfo& a_allocInfoImages, const std::vector<VkImage> &a_images)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_VMA::Allocate", "alloc");
     MemAllocInfo allocInfo = a_allocInfoImages;
     std::vector<VkMemoryRequirements> imgMemReqs(a_images.size());
     for(size_t i = 0; i < a_images.size(); ++i)
@@ -292,6 +309,7 @@ namespace vk_utils
 
   void MemoryAlloc_VMA::Free(uint32_t a_memBlockId)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_VMA::Free", "alloc");
     if(!m_allocations.count(a_memBlockId))
       return;
 
@@ -325,6 +343,7 @@ namespace vk_utils
 
   void* MemoryAlloc_VMA::Map(uint32_t a_memBlockId, VkDeviceSize a_offset, VkDeviceSize a_size)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_VMA::Map", "map");
     if(!m_allocations.count(a_memBlockId))
       return nullptr;
 
@@ -340,6 +359,7 @@ namespace vk_utils
 
   void MemoryAlloc_VMA::Unmap(uint32_t a_memBlockId)
   {
+    VK_UTILS_TRACE_SCOPE("MemoryAlloc_VMA::Unmap", "map");
     if(!m_allocations.count(a_memBlockId))
       return;
 
@@ -365,9 +385,11 @@ namespace vk_utils
   {
     for(auto& [buf, _] : m_bufAllocs)
     {
+      NotifyDestroyed(handleToU64(buf));
       vmaDestroyBuffer(m_vma, buf, m_bufAllocs[buf]);
     }
     m_bufAllocs.clear();
+    m_bufAddresses.clear();
 
     for(auto& [img, _] : m_imgAllocs)
     {
@@ -375,6 +397,9 @@ namespace vk_utils
     }
     m_imgAllocs.clear();
 
+    // sparse textures hold the allocator too, they must be destroyed before the resource manager
+    m_pSparseAlloc = nullptr;
+
     m_samplerPool.deinit();
   }
 
@@ -397,6 +422,8 @@ namespace vk_utils
       &allocation, nullptr);
 
     m_bufAllocs[buffer] = allocation;
+    if(auto addr = vk_utils::getBufferDeviceAddress(m_device, buffer, a_usage))
+      m_bufAddresses[buffer] = addr;
 
     return buffer;
   }
@@ -447,12 +474,20 @@ namespace vk_utils
         &allocation, nullptr);
 
       m_bufAllocs[buffers[i]] = allocation;
+      if(auto addr = vk_utils::getBufferDeviceAddress(m_device, buffers[i], a_usages[i]))
+        m_bufAddresses[buffers[i]] = addr;
     }
 
     return buffers;
   }
 
 
+  VkDeviceAddress ResourceManager_VMA::GetDeviceAddress(VkBuffer a_buf) const
+  {
+    auto it = m_bufAddresses.find(a_buf);
+    return it != m_bufAddresses.end() ? it->second : 0;
+  }
+
   void* ResourceManager_VMA::MapBufferToHostMemory(VkBuffer a_buf, VkDeviceSize a_offset, VkDeviceSize a_size)
   {
     void* pRes = nullptr;
@@ -590,6 +625,22 @@ namespace vk_utils
     return m_samplerPool.acquireSampler(a_samplerCreateInfo);
   }
 
+  std::shared_ptr<SparseTexture> ResourceManager_VMA::CreateSparseTexture(const VkImageCreateInfo& a_createInfo, VkQueue a_sparseQueue,
+                                                                          uint32_t a_sparseQueueFamily, uint32_t a_maxResidentTiles)
+  {
+    if(m_pCopy == nullptr)
+    {
+      VK_UTILS_LOG_WARNING("[ResourceManager_VMA::CreateSparseTexture] copy engine is required for page table uploads");
+      return nullptr;
+    }
+
+    if(m_pSparseAlloc == nullptr)
+      m_pSparseAlloc = std::make_shared<MemoryAlloc_VMA>(m_device, m_physicalDevice, m_vma);
+
+    return std::make_shared<SparseTexture>(m_device, m_physicalDevice, a_sparseQueue, a_sparseQueueFamily, m_pSparseAlloc, m_pCopy,
+                                           a_createInfo, a_maxResidentTiles);
+  }
+
   void ResourceManager_VMA::DestroyBuffer(VkBuffer &a_buffer)
   {
     if(a_buffer == VK_NULL_HANDLE)
@@ -601,8 +652,10 @@ namespace vk_utils
       return;
     }
 
+    NotifyDestroyed(handleToU64(a_buffer));
     vmaDestroyBuffer(m_vma, a_buffer, m_bufAllocs[a_buffer]);
     m_bufAllocs.erase(a_buffer);
+    m_bufAddresses.erase(a_buffer);
     a_buffer = VK_NULL_HANDLE;
   }
 
@@ -627,6 +680,7 @@ namespace vk_utils
 
     if(a_texture.descriptor.imageView != VK_NULL_HANDLE)
     {
+      NotifyDestroyed(handleToU64(a_texture.descriptor.imageView));
       vkDestroyImageView(m_device, a_texture.descriptor.imageView, nullptr);
       a_texture.descriptor.imageView = VK_NULL_HANDLE;
     }
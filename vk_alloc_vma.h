@@ -4,13 +4,14 @@
 #include "vk_alloc.h"
 #include "external/vk_mem_alloc.h"
 #include "vk_resource_manager.h"
+#include <atomic>
 #include <vector>
 #include <unordered_map>
 
 namespace vk_utils
 {
   VmaAllocator initVMA(VkInstance a_instance, VkDevice a_device, VkPhysicalDevice a_physicalDevice,
-    VkFlags a_flags = 0, uint32_t a_vkAPIVersion = VK_API_VERSION_1_1);
+    VkFlags a_flags = 0, uint32_t a_vkAPIVersion = VK_API_VERSION_1_1, const VmaDeviceMemoryCallbacks* a_pMemoryCallbacks = nullptr);
 
   struct MemoryAlloc_VMA : IMemoryAlloc
   {
@@ -43,6 +44,9 @@ namespace vk_utils
 
     VkPhysicalDevice GetPhysicalDevice() const override { return m_physicalDevice; }
 
+    // counted only if VMA was created internally
+    uint32_t GetDeviceMemoryAllocCount() const override { return m_countAllocs ? m_deviceAllocCount.load() : UINT32_MAX; }
+
     // not part of IMemoryAlloc interface
     //
     VkBuffer AllocateBuffer(const VkBufferCreateInfo &a_bufCreateInfo, VkMemoryPropertyFlags a_memProps);
@@ -58,6 +62,8 @@ namespace vk_utils
     VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
 
     VmaAllocator m_vma = VK_NULL_HANDLE;
+    std::atomic<uint32_t> m_deviceAllocCount {0};
+    bool                  m_countAllocs = false;
 
     uint32_t nextAllocIdx = 0;
     std::unordered_map<uint32_t, VmaAllocation> m_allocations;
@@ -96,6 +102,9 @@ namespace vk_utils
     void* MapBufferToHostMemory(VkBuffer a_buf, VkDeviceSize a_offset, VkDeviceSize a_size) override;
     void UnmapBuffer(VkBuffer a_buf) override;
 
+    // requires allocator created with VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT
+    VkDeviceAddress GetDeviceAddress(VkBuffer a_buf) const override;
+
     VkImage CreateImage(const VkImageCreateInfo &a_createInfo) override;
 
     VkImage CreateImage(uint32_t a_width, uint32_t a_height, VkFormat a_format, VkImageUsageFlags a_usage,
@@ -120,6 +129,10 @@ namespace vk_utils
 
     VkSampler CreateSampler(const VkSamplerCreateInfo &a_samplerCreateInfo) override;
 
+    // tile pool and page table are allocated from the same VmaAllocator
+    std::shared_ptr<SparseTexture> CreateSparseTexture(const VkImageCreateInfo &a_createInfo, VkQueue a_sparseQueue,
+                                                       uint32_t a_sparseQueueFamily, uint32_t a_maxResidentTiles) override;
+
     // create accel struct ?
     // map, unmap
 
@@ -137,10 +150,12 @@ namespace vk_utils
 
     VmaAllocator m_vma = VK_NULL_HANDLE;
     std::shared_ptr<ICopyEngine> m_pCopy;
+    std::shared_ptr<IMemoryAlloc> m_pSparseAlloc; // IMemoryAlloc view of m_vma for sparse textures, created on demand
     vk_utils::SamplerPool m_samplerPool;
 
     std::unordered_map<VkBuffer, VmaAllocation> m_bufAllocs;
     std::unordered_map<VkImage, VmaAllocation> m_imgAllocs;
+    std::unordered_map<VkBuffer, VkDeviceAddress> m_bufAddresses;
   };
 }
 
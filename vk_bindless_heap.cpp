@@ -0,0 +1,163 @@
+#include "vk_bindless_heap.h"
+#include "vk_utils.h"
+
+#include <array>
+#include <cassert>
+
+namespace vk_utils
+{
+  uint32_t BindlessHeap::IndexAllocator::Acquire()
+  {
+    if(!freeList.empty())
+    {
+      uint32_t idx = freeList.back();
+      freeList.pop_back();
+      return idx;
+    }
+    if(next < capacity)
+      return next++;
+
+    return INVALID_INDEX;
+  }
+
+  void BindlessHeap::IndexAllocator::Release(uint32_t a_index)
+  {
+    assert(a_index < next);
+    freeList.push_back(a_index);
+  }
+
+  BindlessHeap::BindlessHeap(VkDevice a_device, uint32_t a_maxSampledImages, uint32_t a_maxStorageBuffers,
+                             uint32_t a_maxSamplers, VkShaderStageFlags a_stages, bool a_updateUnusedWhilePending) :
+                             m_device(a_device)
+  {
+    assert(m_device != VK_NULL_HANDLE);
+    m_images.capacity   = a_maxSampledImages;
+    m_buffers.capacity  = a_maxStorageBuffers;
+    m_samplers.capacity = a_maxSamplers;
+
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    bindings[0] = {BINDING_SAMPLED_IMAGES,  VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,  a_maxSampledImages,  a_stages, nullptr};
+    bindings[1] = {BINDING_STORAGE_BUFFERS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, a_maxStorageBuffers, a_stages, nullptr};
+    bindings[2] = {BINDING_SAMPLERS,        VK_DESCRIPTOR_TYPE_SAMPLER,        a_maxSamplers,       a_stages, nullptr};
+
+    VkDescriptorBindingFlags bindlessFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    if(a_updateUnusedWhilePending)
+      bindlessFlags |= VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    std::array<VkDescriptorBindingFlags, 3> bindingFlags = {bindlessFlags, bindlessFlags, bindlessFlags};
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+    bindingFlagsInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount  = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext        = &bindingFlagsInfo;
+    layoutInfo.flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings    = bindings.data();
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_layout));
+
+    std::array<VkDescriptorPoolSize, 3> poolSizes = {{
+      {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,  a_maxSampledImages},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, a_maxStorageBuffers},
+      {VK_DESCRIPTOR_TYPE_SAMPLER,        a_maxSamplers}
+    }};
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets       = 1;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes    = poolSizes.data();
+    VK_CHECK_RESULT(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_pool));
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool     = m_pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts        = &m_layout;
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &allocInfo, &m_set));
+  }
+
+  BindlessHeap::~BindlessHeap()
+  {
+    assert(m_device != VK_NULL_HANDLE);
+    vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_layout, nullptr);
+  }
+
+  void BindlessHeap::Write(uint32_t a_binding, uint32_t a_index, const VkDescriptorImageInfo* a_pImage,
+                           const VkDescriptorBufferInfo* a_pBuffer)
+  {
+    VkWriteDescriptorSet write = {};
+    write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet          = m_set;
+    write.dstBinding      = a_binding;
+    write.dstArrayElement = a_index;
+    write.descriptorCount = 1;
+    switch(a_binding)
+    {
+    case BINDING_SAMPLED_IMAGES:  write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;  break;
+    case BINDING_STORAGE_BUFFERS: write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; break;
+    default:                      write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;        break;
+    }
+    write.pImageInfo  = a_pImage;
+    write.pBufferInfo = a_pBuffer;
+
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+  }
+
+  uint32_t BindlessHeap::RegisterImage(VkImageView a_view, VkImageLayout a_layout)
+  {
+    uint32_t idx = m_images.Acquire();
+    if(idx == INVALID_INDEX)
+    {
+      VK_UTILS_LOG_ERROR("[BindlessHeap::RegisterImage] sampled image array is full");
+      return INVALID_INDEX;
+    }
+
+    VkDescriptorImageInfo info = {VK_NULL_HANDLE, a_view, a_layout};
+    Write(BINDING_SAMPLED_IMAGES, idx, &info, nullptr);
+    return idx;
+  }
+
+  uint32_t BindlessHeap::RegisterBuffer(VkBuffer a_buffer, VkDeviceSize a_offset, VkDeviceSize a_range)
+  {
+    uint32_t idx = m_buffers.Acquire();
+    if(idx == INVALID_INDEX)
+    {
+      VK_UTILS_LOG_ERROR("[BindlessHeap::RegisterBuffer] storage buffer array is full");
+      return INVALID_INDEX;
+    }
+
+    VkDescriptorBufferInfo info = {a_buffer, a_offset, a_range};
+    Write(BINDING_STORAGE_BUFFERS, idx, nullptr, &info);
+    return idx;
+  }
+
+  uint32_t BindlessHeap::RegisterSampler(VkSampler a_sampler)
+  {
+    uint32_t idx = m_samplers.Acquire();
+    if(idx == INVALID_INDEX)
+    {
+      VK_UTILS_LOG_ERROR("[BindlessHeap::RegisterSampler] sampler array is full");
+      return INVALID_INDEX;
+    }
+
+    VkDescriptorImageInfo info = {a_sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED};
+    Write(BINDING_SAMPLERS, idx, &info, nullptr);
+    return idx;
+  }
+
+  // descriptors of released slots are left as is, PARTIALLY_BOUND allows them to be stale while not accessed
+  //
+  void BindlessHeap::UnregisterImage(uint32_t a_index)   { m_images.Release(a_index); }
+  void BindlessHeap::UnregisterBuffer(uint32_t a_index)  { m_buffers.Release(a_index); }
+  void BindlessHeap::UnregisterSampler(uint32_t a_index) { m_samplers.Release(a_index); }
+
+  void BindlessHeap::Bind(VkCommandBuffer a_cmdBuff, VkPipelineBindPoint a_bindPoint, VkPipelineLayout a_layout, uint32_t a_setIndex) const
+  {
+    vkCmdBindDescriptorSets(a_cmdBuff, a_bindPoint, a_layout, a_setIndex, 1, &m_set, 0, nullptr);
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef VK_UTILS_BINDLESS_HEAP_H
+#define VK_UTILS_BINDLESS_HEAP_H
+
+#include "vk_include.h"
+
+#include <vector>
+
+namespace vk_utils
+{
+  // Global descriptor heap for bindless rendering (requires descriptor indexing: runtimeDescriptorArray,
+  // descriptorBindingPartiallyBound, *UpdateAfterBind and descriptorBindingUpdateUnusedWhilePending features).
+  //
+  // Single descriptor set with three large UPDATE_AFTER_BIND | PARTIALLY_BOUND arrays:
+  //   binding 0 (BINDING_SAMPLED_IMAGES)  - sampled images,  layout(binding = 0) uniform texture2D  textures[];
+  //   binding 1 (BINDING_STORAGE_BUFFERS) - storage buffers, layout(binding = 1) buffer Data { ... } buffers[];
+  //   binding 2 (BINDING_SAMPLERS)        - samplers,        layout(binding = 2) uniform sampler    samplers[];
+  //
+  // Register* returns stable index of resource in corresponding array, indices of unregistered resources
+  // are reused. Unregister only after GPU finished using the resource. Register/Unregister while frames using the set
+  // are in flight is valid because of UPDATE_UNUSED_WHILE_PENDING; without descriptorBindingUpdateUnusedWhilePending
+  // pass a_updateUnusedWhilePending = false and change the heap only when no submitted command buffer uses it.
+  // Set is bound once per command buffer with Bind(), shaders address resources by these indices.
+  //
+  class BindlessHeap
+  {
+  public:
+    static constexpr uint32_t BINDING_SAMPLED_IMAGES  = 0;
+    static constexpr uint32_t BINDING_STORAGE_BUFFERS = 1;
+    static constexpr uint32_t BINDING_SAMPLERS        = 2;
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    BindlessHeap(VkDevice a_device, uint32_t a_maxSampledImages = 16384, uint32_t a_maxStorageBuffers = 16384,
+                 uint32_t a_maxSamplers = 256, VkShaderStageFlags a_stages = VK_SHADER_STAGE_ALL,
+                 bool a_updateUnusedWhilePending = true);
+    ~BindlessHeap();
+
+    BindlessHeap(BindlessHeap const&) = delete;
+    BindlessHeap& operator=(BindlessHeap const&) = delete;
+
+    uint32_t RegisterImage(VkImageView a_view, VkImageLayout a_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t RegisterBuffer(VkBuffer a_buffer, VkDeviceSize a_offset = 0, VkDeviceSize a_range = VK_WHOLE_SIZE);
+    uint32_t RegisterSampler(VkSampler a_sampler);
+
+    void UnregisterImage(uint32_t a_index);
+    void UnregisterBuffer(uint32_t a_index);
+    void UnregisterSampler(uint32_t a_index);
+
+    void Bind(VkCommandBuffer a_cmdBuff, VkPipelineBindPoint a_bindPoint, VkPipelineLayout a_layout, uint32_t a_setIndex = 0) const;
+
+    VkDescriptorSetLayout GetLayout() const { return m_layout; }
+    VkDescriptorSet GetSet() const { return m_set; }
+
+  private:
+    struct IndexAllocator
+    {
+      uint32_t capacity = 0;
+      uint32_t next     = 0;
+      std::vector<uint32_t> freeList;
+
+      uint32_t Acquire();
+      void Release(uint32_t a_index);
+    };
+
+    void Write(uint32_t a_binding, uint32_t a_index, const VkDescriptorImageInfo* a_pImage, const VkDescriptorBufferInfo* a_pBuffer);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+    VkDescriptorSet m_set = VK_NULL_HANDLE;
+
+    IndexAllocator m_images;
+    IndexAllocator m_buffers;
+    IndexAllocator m_samplers;
+  };
+}
+
+#endif //VK_UTILS_BINDLESS_HEAP_H
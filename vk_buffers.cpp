@@ -130,6 +130,24 @@ namespace vk_utils
     return res;
   }
 
+  VkDeviceAddress getBufferDeviceAddress(VkDevice a_dev, VkBuffer a_buf, VkBufferUsageFlags a_usage)
+  {
+#if defined(VK_VERSION_1_2)
+    if(a_buf == VK_NULL_HANDLE || !(a_usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT))
+      return 0;
+
+    VkBufferDeviceAddressInfo addressInfo = {};
+    addressInfo.sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    addressInfo.buffer = a_buf;
+    return vkGetBufferDeviceAddress(a_dev, &addressInfo);
+#else
+    (void)a_dev;
+    (void)a_buf;
+    (void)a_usage;
+    return 0;
+#endif
+  }
+
   std::vector<VkDeviceSize> calculateMemOffsets(const std::vector<VkMemoryRequirements> &a_memReqs, size_t a_buffImageGranularity)
   {
     assert(!a_memReqs.empty());
@@ -27,6 +27,9 @@ namespace vk_utils
                                             VkMemoryAllocateFlags flags = {});
 
   std::vector<size_t> assignMemOffsetsWithPadding(const std::vector<VkMemoryRequirements> &a_memInfos);
+  // returns 0 if buffer was created without SHADER_DEVICE_ADDRESS usage or Vulkan 1.2 is not available
+  VkDeviceAddress getBufferDeviceAddress(VkDevice a_dev, VkBuffer a_buf, VkBufferUsageFlags a_usage);
+
   std::vector<VkDeviceSize> calculateMemOffsets(const std::vector<VkMemoryRequirements> &a_memReqs, size_t a_buffImageGranularity = 0);
 }
 
@@ -2,6 +2,7 @@
 #include "vk_utils.h"
 #include "vk_buffers.h"
 #include "vk_images.h"
+#include "vk_ext_funcs.h"
 
 #include <cstring>
 #include <cassert>
@@ -153,9 +154,13 @@ vk_utils::VulkanContext vk_utils::globalContextInit(const std::vector<const char
 
   const bool supportBindless = (supportedExtensions.find("VK_EXT_descriptor_indexing") != supportedExtensions.end());
 
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingQuestion = {};
+  indexingQuestion.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  indexingQuestion.pNext = nullptr;
+
   VkPhysicalDeviceShaderFloat16Int8Features featuresQuestion = {};
   featuresQuestion.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES;
-  featuresQuestion.pNext = nullptr;
+  featuresQuestion.pNext = supportBindless ? &indexingQuestion : nullptr;
 
   VkPhysicalDeviceVariablePointersFeatures varPointersQuestion = {};
   varPointersQuestion.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VARIABLE_POINTERS_FEATURES;
@@ -202,6 +207,12 @@ vk_utils::VulkanContext vk_utils::globalContextInit(const std::vector<const char
   indexingFeatures.pNext = &varPointers;
   indexingFeatures.shaderSampledImageArrayNonUniformIndexing = supportBindless ? VK_TRUE : VK_FALSE;
   indexingFeatures.runtimeDescriptorArray                    = supportBindless ? VK_TRUE : VK_FALSE;
+  // required by BindlessHeap (vk_bindless_heap.h)
+  indexingFeatures.descriptorBindingPartiallyBound               = indexingQuestion.descriptorBindingPartiallyBound;
+  indexingFeatures.descriptorBindingSampledImageUpdateAfterBind  = indexingQuestion.descriptorBindingSampledImageUpdateAfterBind;
+  indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = indexingQuestion.descriptorBindingStorageBufferUpdateAfterBind;
+  indexingFeatures.shaderStorageBufferArrayNonUniformIndexing    = indexingQuestion.shaderStorageBufferArrayNonUniformIndexing;
+  indexingFeatures.descriptorBindingUpdateUnusedWhilePending     = indexingQuestion.descriptorBindingUpdateUnusedWhilePending;
 
   // query features for shaderInt8
   //
@@ -237,6 +248,8 @@ vk_utils::VulkanContext vk_utils::globalContextInit(const std::vector<const char
     deviceExtensions.push_back("VK_KHR_variable_pointers");
   if(supportedExtensions.find("VK_EXT_descriptor_indexing") != supportedExtensions.end())
     deviceExtensions.push_back("VK_EXT_descriptor_indexing");
+  if(supportedExtensions.find("VK_EXT_calibrated_timestamps") != supportedExtensions.end()) // for TraceRecorder::Calibrate
+    deviceExtensions.push_back("VK_EXT_calibrated_timestamps");
   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   
@@ -255,6 +268,7 @@ vk_utils::VulkanContext vk_utils::globalContextInit(const std::vector<const char
   g_ctx.device = vk_utils::createLogicalDevice(g_ctx.physicalDevice, validationLayers, deviceExtensions, enabledDeviceFeatures,
                                                fIDs, VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT, pExtendedDeviceFeatures);
   volkLoadDevice(g_ctx.device);                                            
+  vk_utils::loadExtensionFunctions(g_ctx.device, g_ctx.instance);
   g_ctx.commandPool = vk_utils::createCommandPool(g_ctx.device, fIDs.compute, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
   
 
@@ -2,6 +2,7 @@
 #include "vk_utils.h"
 #include "vk_buffers.h"
 #include "vk_images.h"
+#include "vk_profiler.h"
 
 #include <cstring>
 #include <cassert>
@@ -71,6 +72,45 @@ vk_utils::SimpleCopyHelper::~SimpleCopyHelper()
   vkDestroyCommandPool(dev, cmdPool, nullptr);
 }
 
+bool vk_utils::SimpleCopyHelper::WaitSemaphore(VkSemaphore a_semaphore, VkPipelineStageFlags a_dstStageMask)
+{
+  m_waitSemaphores.push_back(a_semaphore);
+  m_waitStages.push_back(a_dstStageMask);
+  return true;
+}
+
+void vk_utils::SimpleCopyHelper::Submit(VkFence a_fence)
+{
+  VkSubmitInfo submitInfo       = {};
+  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.waitSemaphoreCount = static_cast<uint32_t>(m_waitSemaphores.size());
+  submitInfo.pWaitSemaphores    = m_waitSemaphores.data();
+  submitInfo.pWaitDstStageMask  = m_waitStages.data();
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &cmdBuff;
+  VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, a_fence));
+
+  m_waitSemaphores.clear();
+  m_waitStages.clear();
+}
+
+void vk_utils::SimpleCopyHelper::ExecuteNow()
+{
+  if(m_waitSemaphores.empty())
+  {
+    vk_utils::executeCommandBufferNow(cmdBuff, queue, dev);
+    return;
+  }
+
+  VkFence fence = VK_NULL_HANDLE;
+  VkFenceCreateInfo fenceCreateInfo = {};
+  fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VK_CHECK_RESULT(vkCreateFence(dev, &fenceCreateInfo, nullptr, &fence));
+  Submit(fence);
+  VK_CHECK_RESULT(vkWaitForFences(dev, 1, &fence, VK_TRUE, vk_utils::DEFAULT_TIMEOUT));
+  vkDestroyFence(dev, fence, nullptr);
+}
+
 
 void vk_utils::SimpleCopyHelper::UpdateBuffer(VkBuffer a_dst, size_t a_dstOffset, const void* a_src, size_t a_size)
 {
@@ -84,9 +124,12 @@ void vk_utils::SimpleCopyHelper::UpdateBuffer(VkBuffer a_dst, size_t a_dstOffset
 
     vkResetCommandBuffer(cmdBuff, 0);
     vkBeginCommandBuffer(cmdBuff, &beginInfo);
+    const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, cmdBuff, "UpdateBuffer", vk_utils::GpuZoneKind::COPY_TO_GPU);
     vkCmdUpdateBuffer   (cmdBuff, a_dst, a_dstOffset, a_size, a_src);
+    vk_utils::endImmediateZone(m_profiler, cmdBuff, zone);
     vkEndCommandBuffer  (cmdBuff);
-    vk_utils::executeCommandBufferNow(cmdBuff, queue, dev);
+    ExecuteNow();
+    vk_utils::resolveImmediateZones(m_profiler);
     return;
   }
 
@@ -119,6 +162,7 @@ void vk_utils::SimpleCopyHelper::UpdateBuffer(VkBuffer a_dst, size_t a_dstOffset
 
     vkResetCommandBuffer(cmdBuff, 0);
     vkBeginCommandBuffer(cmdBuff, &beginInfo);
+    const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, cmdBuff, "UpdateBuffer", vk_utils::GpuZoneKind::COPY_TO_GPU);
      
     VkBufferCopy region0 = {};
     region0.srcOffset    = 0;
@@ -127,8 +171,10 @@ void vk_utils::SimpleCopyHelper::UpdateBuffer(VkBuffer a_dst, size_t a_dstOffset
 
     vkCmdCopyBuffer(cmdBuff, stagingBuff, a_dst, 1, &region0);
 
+    vk_utils::endImmediateZone(m_profiler, cmdBuff, zone);
     vkEndCommandBuffer(cmdBuff);
-    vk_utils::executeCommandBufferNow(cmdBuff, queue, dev);
+    ExecuteNow();
+    vk_utils::resolveImmediateZones(m_profiler);
   }
 }
 
@@ -146,14 +192,17 @@ void vk_utils::SimpleCopyHelper::ReadBuffer(VkBuffer a_src, size_t a_srcOffset,
   
     vkResetCommandBuffer(cmdBuff, 0);
     vkBeginCommandBuffer(cmdBuff, &beginInfo);
+    const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, cmdBuff, "ReadBuffer", vk_utils::GpuZoneKind::COPY_FROM_GPU);
     VkBufferCopy region0 = {};
     region0.srcOffset    = a_srcOffset + currPos;
     region0.dstOffset    = 0;
     region0.size         = currCopySize;
     vkCmdCopyBuffer(cmdBuff, a_src, stagingBuff, 1, &region0);  
+    vk_utils::endImmediateZone(m_profiler, cmdBuff, zone);
     vkEndCommandBuffer(cmdBuff);
 
-    vk_utils::executeCommandBufferNow(cmdBuff, queue, dev);
+    ExecuteNow();
+    vk_utils::resolveImmediateZones(m_profiler);
     
     auto currMapSize = currCopySize;
     if(currMapSize % m_nonCoherentAtomSize != 0)
@@ -192,6 +241,7 @@ void vk_utils::SimpleCopyHelper::ReadImage(VkImage a_image, void* a_dst, int a_w
     size_t numLinesToCopy = std::min(n_lines - currLine, linesPerStage);
     vkResetCommandBuffer(cmdBuff, 0);
     vkBeginCommandBuffer(cmdBuff, &beginInfo);
+    const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, cmdBuff, "ReadImage", vk_utils::GpuZoneKind::COPY_FROM_GPU);
     if(currLine == 0)
     {
       VkImageSubresourceRange range = {};
@@ -221,9 +271,11 @@ void vk_utils::SimpleCopyHelper::ReadImage(VkImage a_image, void* a_dst, int a_w
 
     vkCmdCopyImageToBuffer(cmdBuff, a_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuff, 1, &copyRegion);
 
+    vk_utils::endImmediateZone(m_profiler, cmdBuff, zone);
     vkEndCommandBuffer(cmdBuff);
 
-    vk_utils::executeCommandBufferNow(cmdBuff, queue, dev);
+    ExecuteNow();
+    vk_utils::resolveImmediateZones(m_profiler);
 
     void* mappedMemory = nullptr;
     vkMapMemory(dev, stagingBuffMemory, 0, numLinesToCopy * lineSize, 0, &mappedMemory);
@@ -241,6 +293,7 @@ void vk_utils::SimpleCopyHelper::ReadImage(VkImage a_image, void* a_dst, int a_w
 
   vkResetCommandBuffer(cmdBuff, 0);
   vkBeginCommandBuffer(cmdBuff, &beginInfo);
+  const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, cmdBuff, "ReadImage layout", vk_utils::GpuZoneKind::LAYOUT_CHANGE);
   VkImageSubresourceRange range = {};
   range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   range.baseMipLevel = 0;
@@ -249,8 +302,10 @@ void vk_utils::SimpleCopyHelper::ReadImage(VkImage a_image, void* a_dst, int a_w
   range.layerCount = 1;
   vk_utils::setImageLayout(cmdBuff, a_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, a_finalLayout, range, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
+  vk_utils::endImmediateZone(m_profiler, cmdBuff, zone);
   vkEndCommandBuffer(cmdBuff);
-  vk_utils::executeCommandBufferNow(cmdBuff, queue, dev);
+  ExecuteNow();
+  vk_utils::resolveImmediateZones(m_profiler);
 }
 
 void vk_utils::SimpleCopyHelper::UpdateImage(VkImage a_image, const void* a_src, int a_width, int a_height, int a_bpp, VkImageLayout a_finalLayout)
@@ -266,6 +321,7 @@ void vk_utils::SimpleCopyHelper::UpdateImage(VkImage a_image, const void* a_src,
     size_t numLinesToCopy = std::min(n_lines - currLine, linesPerStage);
     vkResetCommandBuffer(cmdBuff, 0);
     vkBeginCommandBuffer(cmdBuff, &beginInfo);
+    const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, cmdBuff, "UpdateImage", vk_utils::GpuZoneKind::COPY_TO_GPU);
     if(currLine == 0)
     {
       VkImageSubresourceRange range = {};
@@ -315,13 +371,16 @@ void vk_utils::SimpleCopyHelper::UpdateImage(VkImage a_image, const void* a_src,
 
     vkCmdCopyBufferToImage(cmdBuff, stagingBuff, a_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
 
+    vk_utils::endImmediateZone(m_profiler, cmdBuff, zone);
     vkEndCommandBuffer(cmdBuff);
 
-    vk_utils::executeCommandBufferNow(cmdBuff, queue, dev);
+    ExecuteNow();
+    vk_utils::resolveImmediateZones(m_profiler);
   }
 
   vkResetCommandBuffer(cmdBuff, 0);
   vkBeginCommandBuffer(cmdBuff, &beginInfo);
+  const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, cmdBuff, "UpdateImage layout", vk_utils::GpuZoneKind::LAYOUT_CHANGE);
   VkImageSubresourceRange range = {};
   range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   range.baseMipLevel = 0;
@@ -331,8 +390,10 @@ void vk_utils::SimpleCopyHelper::UpdateImage(VkImage a_image, const void* a_src,
   vk_utils::setImageLayout(cmdBuff, a_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, a_finalLayout, range,
     VK_PIPELINE_STAGE_TRANSFER_BIT);
 
+  vk_utils::endImmediateZone(m_profiler, cmdBuff, zone);
   vkEndCommandBuffer(cmdBuff);
-  vk_utils::executeCommandBufferNow(cmdBuff, queue, dev);
+  ExecuteNow();
+  vk_utils::resolveImmediateZones(m_profiler);
 
 }
 
@@ -448,11 +509,7 @@ void vk_utils::PingPongCopyHelper::SubmitCopy(VkBuffer a_dst, size_t a_dstOffset
   vkCmdCopyBuffer(cmdBuff, readyBuff, a_dst, 1, &region0);
   vkEndCommandBuffer(cmdBuff);
   
-  VkSubmitInfo submitInfo       = {};
-  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;        
-  submitInfo.pCommandBuffers    = &cmdBuff; 
-  VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+  Submit(fence);
 }
 
 void vk_utils::PingPongCopyHelper::UpdateBuffer(VkBuffer a_dst, size_t a_dstOffset, const void* a_src, size_t a_size)
@@ -474,11 +531,7 @@ void vk_utils::PingPongCopyHelper::UpdateBuffer(VkBuffer a_dst, size_t a_dstOffs
     vkEndCommandBuffer  (cmdBuff);
     
     vkResetFences(dev, 1, &fence);
-    VkSubmitInfo submitInfo       = {};
-    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;        
-    submitInfo.pCommandBuffers    = &cmdBuff; 
-    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+    Submit(fence);
     VK_CHECK_RESULT(vkWaitForFences(dev, 1, &fence, VK_TRUE, vk_utils::DEFAULT_TIMEOUT));
 
     return;
@@ -710,7 +763,7 @@ void vk_utils::ComputeCopyHelper::ReadBuffer(VkBuffer a_src, size_t a_srcOffset,
 
   vkResetCommandBuffer(cmdBuff, 0);
   vkBeginCommandBuffer(cmdBuff, &beginInfo);
-
+  const uint32_t zone = vk_utils::beginImmediateZone(m_profiler, cmdBuff, "ReadBuffer", vk_utils::GpuZoneKind::COPY_FROM_GPU);
 
   vkCmdBindPipeline      (cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, copyPipeline);
   vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, copyPipelineLayout, 0, 1, &copyDescriptorSet, 0, NULL);
@@ -750,9 +803,11 @@ void vk_utils::ComputeCopyHelper::ReadBuffer(VkBuffer a_src, size_t a_srcOffset,
 
   vkCmdCopyBuffer(cmdBuff, auxBuff, stagingBuff, 1, &region0);
 
+  vk_utils::endImmediateZone(m_profiler, cmdBuff, zone);
   vkEndCommandBuffer(cmdBuff);
 
-  vk_utils::executeCommandBufferNow(cmdBuff, queue, dev);
+  ExecuteNow();
+  vk_utils::resolveImmediateZones(m_profiler);
 
   // second, copy data from staging buff to a_dst
   //
@@ -9,6 +9,8 @@
 
 namespace vk_utils
 {
+  class GpuProfiler;
+
   // Application should implement this interface or use provided helpers 
   //
   struct ICopyEngine
@@ -45,6 +47,18 @@ namespace vk_utils
 
     virtual VkQueue         TransferQueue() const { return VK_NULL_HANDLE; }
     virtual VkCommandBuffer CmdBuffer()     const { return VK_NULL_HANDLE; }
+
+    // the next submit of the engine waits for a_semaphore on GPU (e.g. vkQueueBindSparse which made the destination
+    // resident); returns false if the engine can't do it, the caller has to wait on the host then
+    virtual bool WaitSemaphore(VkSemaphore a_semaphore, VkPipelineStageFlags a_dstStageMask)
+    {
+      (void)a_semaphore;
+      (void)a_dstStageMask;
+      return false;
+    }
+
+    // GPU time of copies goes to a_profiler->GetExecTime(); a_profiler must be created for the transfer queue family
+    virtual void SetProfiler(GpuProfiler* a_profiler) { (void)a_profiler; }
   protected:
     ICopyEngine(const ICopyEngine& rhs) { (void)rhs; }
     ICopyEngine& operator=(const ICopyEngine& rhs) { (void)rhs; return *this; }    
@@ -69,8 +83,16 @@ namespace vk_utils
     VkQueue         TransferQueue() const override { return queue; }
     VkCommandBuffer CmdBuffer()     const override { return cmdBuff; }
 
+    void SetProfiler(GpuProfiler* a_profiler) override { m_profiler = a_profiler; }
+
+    bool WaitSemaphore(VkSemaphore a_semaphore, VkPipelineStageFlags a_dstStageMask) override;
+
   protected:
     static constexpr uint32_t SMALL_BUFF = 65536;
+
+    // submit cmdBuff with semaphores from WaitSemaphore, which are consumed by it
+    void Submit(VkFence a_fence);
+    void ExecuteNow(); // Submit and wait
     VkQueue         queue = VK_NULL_HANDLE;
     VkCommandPool   cmdPool = VK_NULL_HANDLE;
     VkCommandBuffer cmdBuff = VK_NULL_HANDLE;
@@ -83,6 +105,10 @@ namespace vk_utils
     VkDevice         dev     = VK_NULL_HANDLE;
 
     VkDeviceSize     m_nonCoherentAtomSize = 0;
+    GpuProfiler*     m_profiler = nullptr;
+
+    std::vector<VkSemaphore>          m_waitSemaphores;
+    std::vector<VkPipelineStageFlags> m_waitStages;
 
     SimpleCopyHelper(const SimpleCopyHelper& rhs) = delete;
     SimpleCopyHelper& operator=(const SimpleCopyHelper& rhs) { (void)rhs; return *this; }
@@ -78,11 +78,7 @@ namespace vk_utils
       vkEndCommandBuffer  (cmdBuff);
       
       vkResetFences(dev, 1, &fence);
-      VkSubmitInfo submitInfo       = {};
-      submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-      submitInfo.commandBufferCount = 1;        
-      submitInfo.pCommandBuffers    = &cmdBuff; 
-      VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+      Submit(fence);
       VK_CHECK_RESULT(vkWaitForFences(dev, 1, &fence, VK_TRUE, vk_utils::DEFAULT_TIMEOUT));
 
       return;
@@ -0,0 +1,349 @@
+#include "vk_descriptor_buffer.h"
+#include "vk_descriptor_sets.h"
+#include "vk_ext_funcs.h"
+#include "vk_buffers.h"
+#include "vk_utils.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vk_utils
+{
+#if defined(VK_EXT_descriptor_buffer)
+
+  bool DescriptorBufferMaker::IsSupported(VkPhysicalDevice a_physicalDevice)
+  {
+    VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures = {};
+    descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &descriptorBufferFeatures;
+    vkGetPhysicalDeviceFeatures2(a_physicalDevice, &features2);
+
+    return descriptorBufferFeatures.descriptorBuffer == VK_TRUE;
+  }
+
+  DescriptorBufferMaker::DescriptorBufferMaker(VkDevice a_device, VkPhysicalDevice a_physicalDevice, VkDeviceSize a_ringSize,
+                                               uint32_t a_framesInFlight) : m_device(a_device), m_ringSize(a_ringSize)
+  {
+    assert(m_device != VK_NULL_HANDLE);
+    m_frameUsed.resize(std::max(a_framesInFlight, 1u), 0);
+
+    m_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 props2 = {};
+    props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props2.pNext = &m_props;
+    vkGetPhysicalDeviceProperties2(a_physicalDevice, &props2);
+
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
+                                     VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    VkMemoryRequirements memReq = {};
+    m_buffer = createBuffer(m_device, m_ringSize, usage, &memReq);
+
+    // prefer host visible device local memory (BAR/ReBAR), GPU reads descriptors from it every draw
+    const VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t memType = findMemoryType(memReq.memoryTypeBits, hostFlags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, a_physicalDevice);
+    if(memType == UINT32_MAX)
+      memType = findMemoryType(memReq.memoryTypeBits, hostFlags, a_physicalDevice);
+
+    VkMemoryAllocateFlagsInfo flagsInfo = {};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+    flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.pNext           = &flagsInfo;
+    allocateInfo.allocationSize  = memReq.size;
+    allocateInfo.memoryTypeIndex = memType;
+    VK_CHECK_RESULT(vkAllocateMemory(m_device, &allocateInfo, nullptr, &m_memory));
+    VK_CHECK_RESULT(vkBindBufferMemory(m_device, m_buffer, m_memory, 0));
+    VK_CHECK_RESULT(vkMapMemory(m_device, m_memory, 0, VK_WHOLE_SIZE, 0, (void**)&m_mapped));
+
+    m_address = getBufferDeviceAddress(m_device, m_buffer, usage);
+  }
+
+  DescriptorBufferMaker::~DescriptorBufferMaker()
+  {
+    assert(m_device != VK_NULL_HANDLE);
+
+    for (auto& [key, info] : m_layouts)
+      vkDestroyDescriptorSetLayout(m_device, info.layout, nullptr);
+
+    if(m_memory != VK_NULL_HANDLE)
+    {
+      vkUnmapMemory(m_device, m_memory);
+      vkFreeMemory(m_device, m_memory, nullptr);
+    }
+    vkDestroyBuffer(m_device, m_buffer, nullptr);
+  }
+
+  size_t DescriptorBufferMaker::DescriptorSize(VkDescriptorType a_type) const
+  {
+    switch (a_type)
+    {
+    case VK_DESCRIPTOR_TYPE_SAMPLER:                    return m_props.samplerDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:     return m_props.combinedImageSamplerDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:              return m_props.sampledImageDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:              return m_props.storageImageDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:           return m_props.inputAttachmentDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:       return m_props.uniformTexelBufferDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:       return m_props.storageTexelBufferDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:             return m_props.uniformBufferDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:             return m_props.storageBufferDescriptorSize;
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR: return m_props.accelerationStructureDescriptorSize;
+    default:
+      return 0;
+    }
+  }
+
+  void DescriptorBufferMaker::BeginFrame(uint32_t a_frameIndex)
+  {
+    m_currentFrame = a_frameIndex % uint32_t(m_frameUsed.size());
+    m_inFlight -= m_frameUsed[m_currentFrame];
+    m_frameUsed[m_currentFrame] = 0;
+  }
+
+  VkDeviceSize DescriptorBufferMaker::AllocateRange(VkDeviceSize a_size)
+  {
+    // ranges of frames in flight form a contiguous arc of the ring ending at m_ringHead
+    VkDeviceSize offset = getPaddedSize(m_ringHead, m_props.descriptorBufferOffsetAlignment);
+    VkDeviceSize waste  = offset - m_ringHead;
+    if(offset + a_size > m_ringSize)
+    {
+      waste  = m_ringSize - m_ringHead;
+      offset = 0;
+    }
+
+    if(m_inFlight + waste + a_size > m_ringSize)
+      return INVALID_OFFSET;
+
+    m_ringHead = offset + a_size;
+    m_inFlight += waste + a_size;
+    m_frameUsed[m_currentFrame] += waste + a_size;
+    return offset;
+  }
+
+  const DescriptorBufferMaker::LayoutInfo& DescriptorBufferMaker::GetOrCreateLayout(const DescriptorTypesMap &a_descrTypes)
+  {
+    LayoutKey layout_key = { m_currentStageFlags, a_descrTypes };
+    auto found = m_layouts.find(layout_key);
+    if(found != m_layouts.end())
+      return found->second;
+
+    LayoutInfo info;
+    info.layout = createDescriptorSetLayout(m_device, a_descrTypes, m_currentStageFlags,
+                                            VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+    vkGetDescriptorSetLayoutSizeEXT(m_device, info.layout, &info.size);
+    for (const auto& [location, descriptor] : a_descrTypes)
+    {
+      VkDeviceSize offset = 0;
+      vkGetDescriptorSetLayoutBindingOffsetEXT(m_device, info.layout, location, &offset);
+      info.bindingOffsets[location] = offset;
+    }
+
+    return m_layouts[layout_key] = std::move(info);
+  }
+
+  void DescriptorBufferMaker::WriteDescriptor(const Binding &a_binding, uint32_t a_element, uint8_t* a_dst) const
+  {
+    VkDescriptorGetInfoEXT getInfo = {};
+    getInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+    getInfo.type  = a_binding.type;
+
+    VkDescriptorAddressInfoEXT addressInfo = {};
+    addressInfo.sType   = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+    addressInfo.address = a_binding.address;
+    addressInfo.range   = a_binding.range;
+    addressInfo.format  = a_binding.format;
+
+    switch (a_binding.type)
+    {
+    case VK_DESCRIPTOR_TYPE_SAMPLER:                    getInfo.data.pSampler              = &a_binding.images[a_element].sampler; break;
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:     getInfo.data.pCombinedImageSampler = &a_binding.images[a_element]; break;
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:              getInfo.data.pSampledImage         = &a_binding.images[a_element]; break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:              getInfo.data.pStorageImage         = &a_binding.images[a_element]; break;
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:           getInfo.data.pInputAttachmentImage = &a_binding.images[a_element]; break;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:       getInfo.data.pUniformTexelBuffer   = &addressInfo; break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:       getInfo.data.pStorageTexelBuffer   = &addressInfo; break;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:             getInfo.data.pUniformBuffer        = &addressInfo; break;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:             getInfo.data.pStorageBuffer        = &addressInfo; break;
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR: getInfo.data.accelerationStructure = a_binding.address; break;
+    default:
+      return;
+    }
+
+    vkGetDescriptorEXT(m_device, &getInfo, DescriptorSize(a_binding.type), a_dst);
+  }
+
+  bool DescriptorBufferMaker::BindEnd(VkDeviceSize *a_pOffset, VkDescriptorSetLayout *a_pLayout)
+  {
+    DescriptorTypesMap descrTypes;
+    for (const auto& [location, binding] : m_bindings)
+    {
+      const uint32_t count = binding.images.empty() ? 1u : uint32_t(binding.images.size());
+      descrTypes[location] = { binding.type, count };
+    }
+
+    const LayoutInfo& layoutInfo = GetOrCreateLayout(descrTypes);
+    if(a_pLayout != nullptr)
+      *a_pLayout = layoutInfo.layout;
+
+    const VkDeviceSize setOffset = AllocateRange(layoutInfo.size);
+    if(setOffset == INVALID_OFFSET)
+    {
+      VK_UTILS_LOG_ERROR("[DescriptorBufferMaker::BindEnd] descriptor ring is full, increase its size or call BeginFrame");
+      return false;
+    }
+
+    uint8_t* setData = m_mapped + setOffset;
+    for (const auto& [location, binding] : m_bindings)
+    {
+      const size_t descriptorSize = DescriptorSize(binding.type);
+      uint8_t* dst = setData + layoutInfo.bindingOffsets.at(location);
+      const uint32_t count = descrTypes[location].second;
+      for(uint32_t i = 0; i < count; ++i)
+        WriteDescriptor(binding, i, dst + i * descriptorSize);
+    }
+
+    if(a_pOffset != nullptr)
+      *a_pOffset = setOffset;
+    return true;
+  }
+
+  void DescriptorBufferMaker::BindDescriptorBuffer(VkCommandBuffer a_cmdBuff) const
+  {
+    VkDescriptorBufferBindingInfoEXT bindingInfo = {};
+    bindingInfo.sType   = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+    bindingInfo.address = m_address;
+    bindingInfo.usage   = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+    vkCmdBindDescriptorBuffersEXT(a_cmdBuff, 1, &bindingInfo);
+  }
+
+  void DescriptorBufferMaker::SetOffset(VkCommandBuffer a_cmdBuff, VkPipelineBindPoint a_bindPoint, VkPipelineLayout a_pipelineLayout,
+                                        uint32_t a_setIndex, VkDeviceSize a_offset) const
+  {
+    const uint32_t bufferIndex = 0;
+    vkCmdSetDescriptorBufferOffsetsEXT(a_cmdBuff, a_bindPoint, a_pipelineLayout, a_setIndex, 1, &bufferIndex, &a_offset);
+  }
+
+  void DescriptorBufferMaker::BindAccelStruct(uint32_t a_loc, VkAccelerationStructureKHR a_accStruct)
+  {
+    VkAccelerationStructureDeviceAddressInfoKHR addressInfo = {};
+    addressInfo.sType                 = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+    addressInfo.accelerationStructure = a_accStruct;
+
+    Binding b{};
+    b.type    = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    b.address = vkGetAccelerationStructureDeviceAddressKHR(m_device, &addressInfo);
+
+    if (m_bindings.count(a_loc))
+      VK_UTILS_LOG_WARNING("[DescriptorBufferMaker::BindAccelStruct] binding to the same location!");
+
+    m_bindings[a_loc] = b;
+  }
+
+#else
+
+  bool DescriptorBufferMaker::IsSupported(VkPhysicalDevice) { return false; }
+
+  DescriptorBufferMaker::DescriptorBufferMaker(VkDevice a_device, VkPhysicalDevice, VkDeviceSize a_ringSize, uint32_t) :
+    m_device(a_device), m_ringSize(a_ringSize)
+  {
+    VK_UTILS_LOG_ERROR("[DescriptorBufferMaker::DescriptorBufferMaker] built without VK_EXT_descriptor_buffer, use DescriptorMaker");
+  }
+
+  DescriptorBufferMaker::~DescriptorBufferMaker() = default;
+  size_t DescriptorBufferMaker::DescriptorSize(VkDescriptorType) const { return 0; }
+  void DescriptorBufferMaker::BeginFrame(uint32_t) {}
+  bool DescriptorBufferMaker::BindEnd(VkDeviceSize*, VkDescriptorSetLayout*) { return false; }
+  void DescriptorBufferMaker::BindDescriptorBuffer(VkCommandBuffer) const {}
+  void DescriptorBufferMaker::SetOffset(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, uint32_t, VkDeviceSize) const {}
+  void DescriptorBufferMaker::BindAccelStruct(uint32_t, VkAccelerationStructureKHR) {}
+
+#endif
+
+  void DescriptorBufferMaker::BindBegin(VkShaderStageFlags a_shaderStage)
+  {
+    m_currentStageFlags = a_shaderStage;
+    m_bindings.clear();
+  }
+
+  void DescriptorBufferMaker::BindBuffer(uint32_t a_loc, VkBuffer a_buffer, VkDeviceSize a_offset, VkDeviceSize a_range,
+                                         VkDescriptorType a_bindType)
+  {
+    if(a_bindType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || a_bindType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+    {
+      VK_UTILS_LOG_WARNING("[DescriptorBufferMaker::BindBuffer] dynamic buffers are not supported with descriptor buffers, binding ignored");
+      return;
+    }
+    if(a_range == VK_WHOLE_SIZE)
+    {
+      VK_UTILS_LOG_WARNING("[DescriptorBufferMaker::BindBuffer] VK_WHOLE_SIZE is not allowed, binding ignored");
+      return;
+    }
+
+    Binding b{};
+    b.type    = a_bindType;
+    b.address = getBufferDeviceAddress(m_device, a_buffer, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) + a_offset;
+    b.range   = a_range;
+
+    if (m_bindings.count(a_loc))
+      VK_UTILS_LOG_WARNING("[DescriptorBufferMaker::BindBuffer] binding to the same location!");
+
+    m_bindings[a_loc] = b;
+  }
+
+  void DescriptorBufferMaker::BindTexelBuffer(uint32_t a_loc, VkBuffer a_buffer, VkDeviceSize a_offset, VkDeviceSize a_range,
+                                              VkFormat a_format, VkDescriptorType a_bindType)
+  {
+    if(a_range == VK_WHOLE_SIZE)
+    {
+      VK_UTILS_LOG_WARNING("[DescriptorBufferMaker::BindTexelBuffer] VK_WHOLE_SIZE is not allowed, binding ignored");
+      return;
+    }
+
+    Binding b{};
+    b.type    = a_bindType;
+    b.address = getBufferDeviceAddress(m_device, a_buffer, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) + a_offset;
+    b.range   = a_range;
+    b.format  = a_format;
+
+    if (m_bindings.count(a_loc))
+      VK_UTILS_LOG_WARNING("[DescriptorBufferMaker::BindTexelBuffer] binding to the same location!");
+
+    m_bindings[a_loc] = b;
+  }
+
+  void DescriptorBufferMaker::BindImage(uint32_t a_loc, VkImageView a_imageView, VkSampler a_sampler, VkDescriptorType a_bindType,
+                                        VkImageLayout a_imageLayout)
+  {
+    Binding b{};
+    b.type = a_bindType;
+    b.images.push_back({a_sampler, a_imageView, a_imageLayout});
+
+    if (m_bindings.count(a_loc))
+      VK_UTILS_LOG_WARNING("[DescriptorBufferMaker::BindImage] binding to the same location!");
+
+    m_bindings[a_loc] = b;
+  }
+
+  void DescriptorBufferMaker::BindImageArray(uint32_t a_loc, const std::vector<VkDescriptorImageInfo> &a_imageDesc,
+                                             VkDescriptorType a_bindType)
+  {
+    if(a_imageDesc.empty())
+    {
+      VK_UTILS_LOG_WARNING("[DescriptorBufferMaker::BindImageArray] binding ignored - empty VkDescriptorImageInfo array");
+      return;
+    }
+
+    Binding b{};
+    b.type   = a_bindType;
+    b.images = a_imageDesc;
+
+    if (m_bindings.count(a_loc))
+      VK_UTILS_LOG_WARNING("[DescriptorBufferMaker::BindImageArray] binding to the same location!");
+
+    m_bindings[a_loc] = b;
+  }
+}
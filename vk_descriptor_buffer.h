@@ -0,0 +1,106 @@
+#ifndef VK_UTILS_DESCRIPTOR_BUFFER_H
+#define VK_UTILS_DESCRIPTOR_BUFFER_H
+
+#include "vk_include.h"
+
+#include "vk_descriptor_helpers.h"
+
+#include <vector>
+#include <unordered_map>
+
+namespace vk_utils
+{
+  // Alternative to DescriptorMaker based on VK_EXT_descriptor_buffer: descriptors are written with vkGetDescriptorEXT
+  // directly to a persistently mapped host visible buffer, no pools and sets are involved.
+  // Use DescriptorMaker when IsSupported() returns false.
+  //
+  // Usage is the same as with DescriptorMaker: BindBegin, Bind*, BindEnd, which returns layout (to create pipeline layout with,
+  // layouts are cached) and offset of the "set" in descriptor buffer. Set ranges are sub-allocated from a ring,
+  // which is split between frames in flight: BeginFrame(i) releases everything written during previous use of frame i,
+  // so call it after fence of that frame is signaled.
+  //
+  // Record BindDescriptorBuffer once per command buffer, then SetOffset for each set. Pipelines using these layouts must be
+  // created with VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT (pipelineFlags of Graphics/ComputePipelineMaker).
+  // Bound buffers must have SHADER_DEVICE_ADDRESS usage, ranges must be explicit (no VK_WHOLE_SIZE),
+  // dynamic buffers are not supported by the extension.
+  //
+  class DescriptorBufferMaker
+  {
+  public:
+    static bool IsSupported(VkPhysicalDevice a_physicalDevice);
+
+    DescriptorBufferMaker(VkDevice a_device, VkPhysicalDevice a_physicalDevice, VkDeviceSize a_ringSize = 4 * 1024 * 1024,
+                          uint32_t a_framesInFlight = 2);
+    ~DescriptorBufferMaker();
+
+    DescriptorBufferMaker(DescriptorBufferMaker const&) = delete;
+    DescriptorBufferMaker& operator=(DescriptorBufferMaker const&) = delete;
+
+    void BeginFrame(uint32_t a_frameIndex);
+
+    void BindBegin(VkShaderStageFlags a_shaderStage);
+    void BindBuffer(uint32_t a_loc, VkBuffer a_buffer, VkDeviceSize a_offset, VkDeviceSize a_range,
+                    VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    void BindTexelBuffer(uint32_t a_loc, VkBuffer a_buffer, VkDeviceSize a_offset, VkDeviceSize a_range, VkFormat a_format,
+                         VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+    void BindAccelStruct(uint32_t a_loc, VkAccelerationStructureKHR a_accStruct);
+    void BindImage(uint32_t a_loc, VkImageView a_imageView, VkSampler a_sampler = VK_NULL_HANDLE,
+                   VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                   VkImageLayout a_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    void BindImageArray(uint32_t a_loc, const std::vector<VkDescriptorImageInfo> &a_imageDesc,
+                        VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    // returns false if ring is full
+    bool BindEnd(VkDeviceSize *a_pOffset, VkDescriptorSetLayout *a_pLayout = nullptr);
+
+    void BindDescriptorBuffer(VkCommandBuffer a_cmdBuff) const;
+    void SetOffset(VkCommandBuffer a_cmdBuff, VkPipelineBindPoint a_bindPoint, VkPipelineLayout a_pipelineLayout,
+                   uint32_t a_setIndex, VkDeviceSize a_offset) const;
+
+    VkBuffer GetBuffer() const { return m_buffer; }
+
+  private:
+    struct Binding
+    {
+      VkDescriptorType type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+      std::vector<VkDescriptorImageInfo> images;
+      VkDeviceAddress address = 0;
+      VkDeviceSize    range   = 0;
+      VkFormat        format  = VK_FORMAT_UNDEFINED;
+    };
+
+    struct LayoutInfo
+    {
+      VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+      VkDeviceSize size = 0;
+      std::unordered_map<uint32_t, VkDeviceSize> bindingOffsets;
+    };
+
+    size_t DescriptorSize(VkDescriptorType a_type) const;
+    const LayoutInfo& GetOrCreateLayout(const DescriptorTypesMap &a_descrTypes);
+    VkDeviceSize AllocateRange(VkDeviceSize a_size);
+    void WriteDescriptor(const Binding &a_binding, uint32_t a_element, uint8_t* a_dst) const;
+
+    static constexpr VkDeviceSize INVALID_OFFSET = VkDeviceSize(-1);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+#if defined(VK_EXT_descriptor_buffer)
+    VkPhysicalDeviceDescriptorBufferPropertiesEXT m_props{};
+#endif
+    VkBuffer        m_buffer  = VK_NULL_HANDLE;
+    VkDeviceMemory  m_memory  = VK_NULL_HANDLE;
+    VkDeviceAddress m_address = 0;
+    uint8_t*        m_mapped  = nullptr;
+
+    VkDeviceSize m_ringSize = 0;
+    VkDeviceSize m_ringHead = 0;
+    VkDeviceSize m_inFlight = 0;            // bytes used by all frames in flight (including wasted tail on wrap)
+    std::vector<VkDeviceSize> m_frameUsed;  // bytes used by each frame
+    uint32_t m_currentFrame = 0;
+
+    VkShaderStageFlags m_currentStageFlags = 0u;
+    std::unordered_map<uint32_t, Binding> m_bindings;
+    std::unordered_map<LayoutKey, LayoutInfo, LayoutHash> m_layouts;
+  };
+}
+
+#endif// VK_UTILS_DESCRIPTOR_BUFFER_H
@@ -30,6 +30,8 @@ namespace vk_utils
   {
     VkBufferView buffView = VK_NULL_HANDLE;
     VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize bufferOffset = 0;
+    VkDeviceSize bufferRange  = VK_WHOLE_SIZE;
     std::vector<VkDescriptorImageInfo> imageDescriptor;
     VkAccelerationStructureKHR accelStruct = VK_NULL_HANDLE;
 
@@ -37,8 +39,8 @@ namespace vk_utils
 
     bool operator==(const DescriptorHandles &rhs) const
     {
-      return std::tie(type, buffer, buffView, accelStruct, imageDescriptor) ==
-             std::tie(rhs.type, rhs.buffer, rhs.buffView, rhs.accelStruct, rhs.imageDescriptor);
+      return std::tie(type, buffer, bufferOffset, bufferRange, buffView, accelStruct, imageDescriptor) ==
+             std::tie(rhs.type, rhs.buffer, rhs.bufferOffset, rhs.bufferRange, rhs.buffView, rhs.accelStruct, rhs.imageDescriptor);
     }
   };
 
@@ -95,14 +97,11 @@ namespace vk_utils
           hash_combine(currHash, desc.sampler);
           hash_combine(currHash, desc.imageLayout);
         }
-//        for (const auto &samp : handle.imageSampler)
-//          hash_combine(currHash, samp);
-//        for (const auto &view : handle.imageSampler)
-//          hash_combine(currHash, view);
-//        hash_combine(currHash, handle.imageLayout);
         hash_combine(currHash, handle.accelStruct);
         hash_combine(currHash, handle.buffView);
         hash_combine(currHash, handle.buffer);
+        hash_combine(currHash, handle.bufferOffset);
+        hash_combine(currHash, handle.bufferRange);
       }
 
       return currHash;
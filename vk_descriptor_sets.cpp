@@ -1,10 +1,15 @@
 #include "vk_descriptor_sets.h"
+#include "vk_resource_manager.h"
 #include "vk_utils.h"
+#include "vk_ext_funcs.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace vk_utils
 {
   VkDescriptorSetLayout createDescriptorSetLayout(VkDevice a_device, const DescriptorTypesMap &a_descrTypes,
-                                                  VkShaderStageFlags a_stage)
+                                                  VkShaderStageFlags a_stage, VkDescriptorSetLayoutCreateFlags a_flags)
   {
     VkDescriptorSetLayout layout;
 
@@ -25,6 +30,7 @@ namespace vk_utils
     descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     descriptorSetLayoutCreateInfo.bindingCount = (uint32_t)bindings.size();
     descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+    descriptorSetLayoutCreateInfo.flags = a_flags;
     VK_CHECK_RESULT(vkCreateDescriptorSetLayout(a_device, &descriptorSetLayoutCreateInfo, nullptr, &layout));
 
     return layout;
@@ -93,16 +99,304 @@ namespace vk_utils
   ////////////////////////////////////////////////////////////////////////////////////////
   ////////////////////////////////////////////////////////////////////////////////////////
 
-  DescriptorMaker::DescriptorMaker(VkDevice a_device, const DescriptorTypesVec &a_maxDescrTypes, uint32_t a_maxSets) : m_device(a_device)
+  DescriptorPoolAllocator::DescriptorPoolAllocator(VkDevice a_device, const DescriptorTypesVec &a_poolSizes, uint32_t a_setsPerPool,
+                                                   uint32_t a_framesInFlight) : m_device(a_device), m_poolSizes(a_poolSizes),
+                                                   m_setsPerPool(a_setsPerPool)
   {
     assert(m_device != VK_NULL_HANDLE);
-    m_pool = createDescriptorPool(m_device, a_maxDescrTypes, a_maxSets);
+    m_persistent.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    m_persistent.pools.push_back(createDescriptorPool(m_device, m_poolSizes, m_setsPerPool, m_persistent.flags));
+    m_frames.resize(a_framesInFlight);
+  }
+
+  DescriptorPoolAllocator::~DescriptorPoolAllocator()
+  {
+    for (auto pool : m_persistent.pools)
+      vkDestroyDescriptorPool(m_device, pool, nullptr);
+
+    for (auto& frame : m_frames)
+    {
+      for (auto pool : frame.pools)
+        vkDestroyDescriptorPool(m_device, pool, nullptr);
+    }
+  }
+
+  VkDescriptorSet DescriptorPoolAllocator::AllocateFromChain(PoolChain &a_chain, VkDescriptorSetLayout a_layout)
+  {
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &a_layout;
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    while(true)
+    {
+      bool freshPool = false;
+      if(a_chain.current == a_chain.pools.size())
+      {
+        a_chain.pools.push_back(createDescriptorPool(m_device, m_poolSizes, m_setsPerPool, a_chain.flags));
+        freshPool = true;
+      }
+
+      descriptorSetAllocateInfo.descriptorPool = a_chain.pools[a_chain.current];
+      VkResult res = vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, &set);
+      if(res == VK_SUCCESS)
+        return set;
+
+      if(res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL)
+      {
+        VK_CHECK_RESULT(res);
+        return VK_NULL_HANDLE;
+      }
+
+      // set doesn't fit even into an empty pool, chaining more pools won't help
+      if(freshPool)
+      {
+        VK_UTILS_LOG_ERROR("[DescriptorPoolAllocator::AllocateFromChain] set layout exceeds size of a single pool");
+        return VK_NULL_HANDLE;
+      }
+      a_chain.current++;
+    }
+  }
+
+  VkDescriptorSet DescriptorPoolAllocator::Allocate(VkDescriptorSetLayout a_layout)
+  {
+    VkDescriptorSet set = AllocateFromChain(m_persistent, a_layout);
+    if(set != VK_NULL_HANDLE)
+      m_persistentOwners[set] = m_persistent.pools[m_persistent.current];
+    return set;
+  }
+
+  void DescriptorPoolAllocator::Free(VkDescriptorSet a_set)
+  {
+    auto owner = m_persistentOwners.find(a_set);
+    if(owner == m_persistentOwners.end())
+    {
+      VK_UTILS_LOG_WARNING("[DescriptorPoolAllocator::Free] set was not allocated with Allocate()");
+      return;
+    }
+    VK_CHECK_RESULT(vkFreeDescriptorSets(m_device, owner->second, 1, &a_set));
+    m_persistentOwners.erase(owner);
+
+    // next allocation tries the chain from the start, so freed space is used before a new pool is created
+    m_persistent.current = 0;
+  }
+
+  VkDescriptorSet DescriptorPoolAllocator::AllocateTransient(VkDescriptorSetLayout a_layout)
+  {
+    if(m_frames.empty())
+    {
+      VK_UTILS_LOG_ERROR("[DescriptorPoolAllocator::AllocateTransient] allocator was created with a_framesInFlight = 0");
+      return VK_NULL_HANDLE;
+    }
+    return AllocateFromChain(m_frames[m_currentFrame], a_layout);
+  }
+
+  void DescriptorPoolAllocator::BeginFrame(uint32_t a_frameIndex)
+  {
+    if(m_frames.empty())
+      return;
+
+    m_currentFrame = a_frameIndex % uint32_t(m_frames.size());
+    auto& frame = m_frames[m_currentFrame];
+    for (auto pool : frame.pools)
+      VK_CHECK_RESULT(vkResetDescriptorPool(m_device, pool, 0));
+    frame.current = 0;
+  }
+
+  uint32_t DescriptorPoolAllocator::GetPoolCount() const
+  {
+    size_t count = m_persistent.pools.size();
+    for (const auto& frame : m_frames)
+      count += frame.pools.size();
+    return uint32_t(count);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////////////
+
+  DescriptorSetCache::DescriptorSetCache(uint32_t a_capacity)
+  {
+    a_capacity = std::max(a_capacity, 1u);
+    m_entries.resize(a_capacity);
+
+    uint32_t tableSize = 1;
+    while(tableSize < 2 * a_capacity)
+      tableSize <<= 1;
+    m_slots.resize(tableSize, INVALID);
+    m_mask = tableSize - 1;
+
+    m_freeEntries.reserve(a_capacity);
+    for(uint32_t i = a_capacity; i > 0; --i)
+      m_freeEntries.push_back(i - 1);
+  }
+
+  static inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+  // murmur3-like mixing of whole 64-bit words
+  uint64_t DescriptorSetCache::Hash(const uint64_t* a_key, size_t a_keySize)
+  {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ (uint64_t(a_keySize) * 0xff51afd7ed558ccdull);
+    for(size_t i = 0; i < a_keySize; ++i)
+    {
+      uint64_t k = a_key[i] * 0x87c37b91114253d5ull;
+      k  = rotl64(k, 31) * 0x4cf5ad432745937full;
+      h ^= k;
+      h  = rotl64(h, 27) * 5 + 0x52dce729;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  void DescriptorSetCache::Unlink(uint32_t a_entry)
+  {
+    Entry& e = m_entries[a_entry];
+    if(e.prev != INVALID) m_entries[e.prev].next = e.next; else m_head = e.next;
+    if(e.next != INVALID) m_entries[e.next].prev = e.prev; else m_tail = e.prev;
+    e.prev = e.next = INVALID;
+  }
+
+  void DescriptorSetCache::PushFront(uint32_t a_entry)
+  {
+    Entry& e = m_entries[a_entry];
+    e.prev = INVALID;
+    e.next = m_head;
+    if(m_head != INVALID)
+      m_entries[m_head].prev = a_entry;
+    m_head = a_entry;
+    if(m_tail == INVALID)
+      m_tail = a_entry;
+  }
+
+  VkDescriptorSet DescriptorSetCache::Find(const std::vector<uint64_t> &a_key, uint64_t a_hash)
+  {
+    for(uint32_t slot = uint32_t(a_hash) & m_mask; m_slots[slot] != INVALID; slot = (slot + 1) & m_mask)
+    {
+      const uint32_t idx = m_slots[slot];
+      const Entry& e = m_entries[idx];
+      if(e.hash == a_hash && e.key == a_key)
+      {
+        if(m_head != idx)
+        {
+          Unlink(idx);
+          PushFront(idx);
+        }
+        return e.set;
+      }
+    }
+    return VK_NULL_HANDLE;
+  }
+
+  void DescriptorSetCache::Insert(const std::vector<uint64_t> &a_key, uint64_t a_hash, const std::vector<uint64_t> &a_handles,
+                                  VkDescriptorSet a_set, VkDescriptorSetLayout a_layout,
+                                  std::pair<VkDescriptorSet, VkDescriptorSetLayout>* a_pEvicted)
+  {
+    if(m_freeEntries.empty())
+    {
+      const Entry& lru = m_entries[m_tail];
+      if(a_pEvicted != nullptr)
+        *a_pEvicted = {lru.set, lru.layout};
+      Remove(m_tail);
+    }
+
+    const uint32_t idx = m_freeEntries.back();
+    m_freeEntries.pop_back();
+
+    Entry& e = m_entries[idx];
+    e.hash    = a_hash;
+    e.key     = a_key;
+    e.handles = a_handles;
+    e.set     = a_set;
+    e.layout  = a_layout;
+
+    uint32_t slot = uint32_t(a_hash) & m_mask;
+    while(m_slots[slot] != INVALID)
+      slot = (slot + 1) & m_mask;
+    m_slots[slot] = idx;
+    e.slot = slot;
+
+    PushFront(idx);
+    m_size++;
+  }
+
+  void DescriptorSetCache::Remove(uint32_t a_entry)
+  {
+    Unlink(a_entry);
+
+    // backward shift deletion, keeps probe sequences intact without tombstones
+    uint32_t hole = m_entries[a_entry].slot;
+    m_slots[hole] = INVALID;
+    for(uint32_t slot = (hole + 1) & m_mask; m_slots[slot] != INVALID; slot = (slot + 1) & m_mask)
+    {
+      const uint32_t idx   = m_slots[slot];
+      const uint32_t ideal = uint32_t(m_entries[idx].hash) & m_mask;
+      const bool stays = (hole <= slot) ? (hole < ideal && ideal <= slot) : (hole < ideal || ideal <= slot);
+      if(!stays)
+      {
+        m_slots[hole] = idx;
+        m_entries[idx].slot = hole;
+        m_slots[slot] = INVALID;
+        hole = slot;
+      }
+    }
+
+    Entry& e = m_entries[a_entry];
+    e.set    = VK_NULL_HANDLE;
+    e.layout = VK_NULL_HANDLE;
+    e.slot   = INVALID;
+    e.key.clear();
+    e.handles.clear();
+    m_freeEntries.push_back(a_entry);
+    m_size--;
+  }
+
+  void DescriptorSetCache::Invalidate(uint64_t a_handle, std::vector<std::pair<VkDescriptorSet, VkDescriptorSetLayout>> &a_freed)
+  {
+    for(uint32_t i = 0; i < uint32_t(m_entries.size()); ++i)
+    {
+      const Entry& e = m_entries[i];
+      if(e.set == VK_NULL_HANDLE || std::find(e.handles.begin(), e.handles.end(), a_handle) == e.handles.end())
+        continue;
+
+      a_freed.emplace_back(e.set, e.layout);
+      Remove(i);
+    }
+  }
+
+  void DescriptorSetCache::Clear(std::vector<std::pair<VkDescriptorSet, VkDescriptorSetLayout>> &a_freed)
+  {
+    for(uint32_t i = 0; i < uint32_t(m_entries.size()); ++i)
+    {
+      if(m_entries[i].set != VK_NULL_HANDLE)
+      {
+        a_freed.emplace_back(m_entries[i].set, m_entries[i].layout);
+        Remove(i);
+      }
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////////////
+
+  DescriptorMaker::DescriptorMaker(VkDevice a_device, const DescriptorTypesVec &a_maxDescrTypes, uint32_t a_maxSets,
+                                   uint32_t a_framesInFlight) : m_device(a_device),
+    m_pools(a_device, a_maxDescrTypes, a_maxSets, a_framesInFlight), m_maxDescrTypes(a_maxDescrTypes), m_maxSets(a_maxSets)
+  {
+    assert(m_device != VK_NULL_HANDLE);
+    if(a_framesInFlight > 0)
+      setRecycleDelay = a_framesInFlight;
   }
 
   DescriptorMaker::~DescriptorMaker()
   {
     assert(m_device != VK_NULL_HANDLE);
 
+    if(m_pTrackedManager != nullptr)
+      m_pTrackedManager->RemoveDestroyCallback(m_destroyCallbackId);
+
     for (auto& l : m_layoutDict)
     {
       if(l.second != VK_NULL_HANDLE)
@@ -111,7 +405,21 @@ namespace vk_utils
       }
     }
 
-    vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+    for (auto& l : m_pushLayoutDict)
+    {
+      if(l.second != VK_NULL_HANDLE)
+      {
+        vkDestroyDescriptorSetLayout(m_device, l.second, nullptr);
+      }
+    }
+
+#if defined(VK_VERSION_1_1)
+    for (auto& [layout, lt] : m_layoutTemplates)
+      vkDestroyDescriptorUpdateTemplate(m_device, lt.templ, nullptr);
+#endif
+
+    for (auto pool : m_ringPools)
+      vkDestroyDescriptorPool(m_device, pool, nullptr);
   }
 
   void DescriptorMaker::BindBegin(VkShaderStageFlags a_shaderStage)
@@ -133,6 +441,25 @@ namespace vk_utils
     m_bindings[a_loc] = h;
   }
 
+  void DescriptorMaker::BindBuffer(uint32_t a_loc, VkBuffer a_buffer, VkDeviceSize a_offset, VkDeviceSize a_range,
+                                   VkDescriptorType a_bindType)
+  {
+    DescriptorHandles h{};
+    h.buffer = a_buffer;
+    h.bufferOffset = a_offset;
+    h.bufferRange = a_range;
+    h.type = a_bindType;
+
+    if (m_bindings.count(a_loc))
+      VK_UTILS_LOG_WARNING("[DescriptorMaker::BindBuffer] binding to the same location!");
+
+    if ((a_bindType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || a_bindType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) &&
+        a_range == VK_WHOLE_SIZE)
+      VK_UTILS_LOG_WARNING("[DescriptorMaker::BindBuffer] dynamic buffer bound with VK_WHOLE_SIZE, any non-zero dynamic offset will exceed buffer size");
+
+    m_bindings[a_loc] = h;
+  }
+
   void DescriptorMaker::BindImage(uint32_t a_loc, VkImageView  a_imageView, VkSampler a_sampler, VkDescriptorType a_bindType,
                                   VkImageLayout a_imageLayout)
   {
@@ -213,15 +540,8 @@ namespace vk_utils
     m_bindings[a_loc] = h;
   }
 
-  void DescriptorMaker::BindEnd(VkDescriptorSet *a_pSet, VkDescriptorSetLayout *a_pLayout)
+  void DescriptorMaker::CollectDescriptorTypes(DescriptorTypesMap &a_descrTypes) const
   {
-    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-    VkDescriptorSet set = VK_NULL_HANDLE;
-    DescriptorTypesMap descrTypes;
-
-    size_t totalImageInfos = 0;
-    size_t totalBufferInfos = 0;
-    size_t totalAccStructsInfos = 0;
     for (const auto &[location, handle] : m_bindings)
     {
       uint32_t count = 1;
@@ -233,7 +553,6 @@ namespace vk_utils
       case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
       case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
         count = (uint32_t)handle.imageDescriptor.size();
-        totalImageInfos += handle.imageDescriptor.size();
         break;
       case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER: //TODO: test and fix
       case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER: //TODO: test and fix
@@ -241,10 +560,7 @@ namespace vk_utils
       case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
       case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
       case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
-        totalBufferInfos++;
-        break;
       case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
-        totalAccStructsInfos++;
         break;
       //case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV:
       //case VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT: //TODO
@@ -253,37 +569,36 @@ namespace vk_utils
         break;
       }
 
-      descrTypes[location] = { handle.type, count };
+      a_descrTypes[location] = { handle.type, count };
     }
+  }
+
+  void DescriptorMaker::BindEnd(VkDescriptorSet *a_pSet, VkDescriptorSetLayout *a_pLayout)
+  {
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    DescriptorTypesMap descrTypes;
+
+    CollectDescriptorTypes(descrTypes);
 
     if(hashingMode == HASHING_MODE::LAYOUTS_ONLY || hashingMode == HASHING_MODE::LAYOUTS_AND_SETS)
     {
-      // Check if we already had created such layout
-      LayoutKey layout_key = { m_currentStageFlags, descrTypes };
-      auto found_layout = m_layoutDict.find(layout_key);
-      if (found_layout != m_layoutDict.end())
-      {
-        layout = found_layout->second;
-      }
-      else
-      {
-        layout = createDescriptorSetLayout(m_device, descrTypes, m_currentStageFlags);
-        m_layoutDict[layout_key] = layout;
-      }
+      layout = GetOrCreateLayout(descrTypes);
     }
     else
     {
       layout = createDescriptorSetLayout(m_device, descrTypes, m_currentStageFlags);
     }
 
-    SetKey set_key = { layout, m_bindings };
+    uint64_t setHash = 0;
     if(hashingMode == HASHING_MODE::LAYOUTS_AND_SETS)
     {
       // Check if we already had created such set
-      auto found_set = m_setDict.find(set_key);
-      if (found_set != m_setDict.end())
+      FlattenSetKey(layout);
+      setHash = DescriptorSetCache::Hash(m_setKey.data(), m_setKey.size());
+      set = m_setCache.Find(m_setKey, setHash);
+      if (set != VK_NULL_HANDLE)
       {
-        set = found_set->second;
         *a_pSet = set;
         *a_pLayout = layout;
         return;
@@ -292,29 +607,341 @@ namespace vk_utils
 
     ///////////////////
 
-    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
-    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocateInfo.descriptorPool = m_pool;
-    descriptorSetAllocateInfo.descriptorSetCount = 1;
-    descriptorSetAllocateInfo.pSetLayouts = &layout;
+    set = (hashingMode == HASHING_MODE::LAYOUTS_AND_SETS) ? AllocateCached(layout) : m_pools.Allocate(layout);
 
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, &set));
+    if(!UpdateWithTemplate(set, layout))
+      UpdateWithWrites(set, descrTypes);
+
+    if(hashingMode == HASHING_MODE::LAYOUTS_AND_SETS)
+    {
+      std::pair<VkDescriptorSet, VkDescriptorSetLayout> evicted = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+      m_setCache.Insert(m_setKey, setHash, m_setHandles, set, layout, &evicted);
+      if(evicted.first != VK_NULL_HANDLE)
+        RetireSet(evicted.first, evicted.second);
+    }
+
+    *a_pSet = set;
+    *a_pLayout = layout;
+  }
+
+  void DescriptorMaker::FlattenSetKey(VkDescriptorSetLayout a_layout)
+  {
+    m_sortedLocations.clear();
+    for (const auto &[location, handle] : m_bindings)
+      m_sortedLocations.push_back(location);
+    std::sort(m_sortedLocations.begin(), m_sortedLocations.end());
+
+    m_setKey.clear();
+    m_setHandles.clear();
+    m_setKey.push_back(handleToU64(a_layout));
+    for (uint32_t location : m_sortedLocations)
+    {
+      const auto& handle = m_bindings.find(location)->second;
+      m_setKey.push_back((uint64_t(location) << 32) | uint64_t(uint32_t(handle.type)));
+      m_setKey.push_back(handleToU64(handle.buffer));
+      m_setKey.push_back(handle.bufferOffset);
+      m_setKey.push_back(handle.bufferRange);
+      m_setKey.push_back(handleToU64(handle.buffView));
+      m_setKey.push_back(handleToU64(handle.accelStruct));
+      m_setKey.push_back(handle.imageDescriptor.size());
+      for (const auto& desc : handle.imageDescriptor)
+      {
+        m_setKey.push_back(handleToU64(desc.sampler));
+        m_setKey.push_back(handleToU64(desc.imageView));
+        m_setKey.push_back(uint64_t(desc.imageLayout));
+        if(desc.imageView != VK_NULL_HANDLE) m_setHandles.push_back(handleToU64(desc.imageView));
+        if(desc.sampler   != VK_NULL_HANDLE) m_setHandles.push_back(handleToU64(desc.sampler));
+      }
+
+      if(handle.buffer   != VK_NULL_HANDLE) m_setHandles.push_back(handleToU64(handle.buffer));
+      if(handle.buffView != VK_NULL_HANDLE) m_setHandles.push_back(handleToU64(handle.buffView));
+    }
+  }
+
+  void DescriptorMaker::BeginFrame(uint32_t a_frameIndex)
+  {
+    m_pools.BeginFrame(a_frameIndex);
+    m_frameCounter++;
+    m_frameDriven = true;
+
+    // retired sets are ordered by retireFrame; those nobody took for another setRecycleDelay frames belong to layouts
+    // which are not used anymore, keeping them would only grow the pool chain
+    for(auto& [layout, retired] : m_retiredSets)
+    {
+      auto keep = retired.begin();
+      while(keep != retired.end() && keep->retireFrame + setRecycleDelay < m_frameCounter)
+      {
+        m_pools.Free(keep->set);
+        ++keep;
+      }
+      retired.erase(retired.begin(), keep);
+    }
+  }
+
+  void DescriptorMaker::RetireSet(VkDescriptorSet a_set, VkDescriptorSetLayout a_layout)
+  {
+    // without frames nothing tells when the set is not in flight anymore, it is assumed to be idle already
+    // and its pool space is reused by next allocations
+    if(!m_frameDriven)
+    {
+      m_pools.Free(a_set);
+      return;
+    }
+
+    // set may still be used by command buffers in flight, it is rewritten only after setRecycleDelay frames
+    m_retiredSets[a_layout].push_back({a_set, m_frameCounter + setRecycleDelay});
+  }
+
+  VkDescriptorSet DescriptorMaker::AllocateCached(VkDescriptorSetLayout a_layout)
+  {
+    auto found = m_retiredSets.find(a_layout);
+    if(found != m_retiredSets.end() && !found->second.empty() && found->second.front().retireFrame <= m_frameCounter)
+    {
+      VkDescriptorSet set = found->second.front().set;
+      found->second.erase(found->second.begin());
+      return set;
+    }
+    return m_pools.Allocate(a_layout);
+  }
+
+  void DescriptorMaker::SetCacheCapacity(uint32_t a_maxSets)
+  {
+    m_freedScratch.clear();
+    m_setCache.Clear(m_freedScratch);
+    for(const auto& [set, layout] : m_freedScratch)
+      RetireSet(set, layout);
+    m_freedScratch.clear();
+
+    m_setCache = DescriptorSetCache(a_maxSets);
+  }
+
+  void DescriptorMaker::InvalidateHandle(uint64_t a_handle)
+  {
+    m_freedScratch.clear();
+    m_setCache.Invalidate(a_handle, m_freedScratch);
+    for(const auto& [set, layout] : m_freedScratch)
+      RetireSet(set, layout);
+  }
+
+  void DescriptorMaker::TrackResourceManager(std::shared_ptr<IResourceManager> a_pResourceManager)
+  {
+    if(m_pTrackedManager != nullptr)
+      m_pTrackedManager->RemoveDestroyCallback(m_destroyCallbackId);
+
+    m_pTrackedManager = a_pResourceManager;
+    if(m_pTrackedManager != nullptr)
+      m_destroyCallbackId = m_pTrackedManager->AddDestroyCallback([this](uint64_t a_handle) { InvalidateHandle(a_handle); });
+  }
+
+  VkDescriptorSetLayout DescriptorMaker::GetOrCreateLayout(const DescriptorTypesMap &a_descrTypes)
+  {
+    // Check if we already had created such layout
+    LayoutKey layout_key = { m_currentStageFlags, a_descrTypes };
+    auto found_layout = m_layoutDict.find(layout_key);
+    if (found_layout != m_layoutDict.end())
+      return found_layout->second;
+
+    VkDescriptorSetLayout layout = createDescriptorSetLayout(m_device, a_descrTypes, m_currentStageFlags);
+    m_layoutDict[layout_key] = layout;
+    CreateUpdateTemplate(layout, a_descrTypes);
+    return layout;
+  }
+
+  void DescriptorMaker::BindEndTransient(VkDescriptorSet *a_pSet, VkDescriptorSetLayout *a_pLayout)
+  {
+    DescriptorTypesMap descrTypes;
+    CollectDescriptorTypes(descrTypes);
 
-    const size_t descriptorsInSet = descrTypes.size();
-    std::vector<VkWriteDescriptorSet> writeSets;
-    writeSets.reserve(descriptorsInSet);
-    std::vector<VkDescriptorBufferInfo> dBufferInfos(totalBufferInfos);
-    std::vector<VkDescriptorImageInfo> dImageInfos(totalImageInfos);
-    std::vector<VkWriteDescriptorSetAccelerationStructureKHR> dAccStructInfos(totalAccStructsInfos);
+    // layouts are always cached here, transient sets would otherwise leak them every frame
+    VkDescriptorSetLayout layout = GetOrCreateLayout(descrTypes);
+    VkDescriptorSet set = m_pools.AllocateTransient(layout);
+
+    if(!UpdateWithTemplate(set, layout))
+      UpdateWithWrites(set, descrTypes);
+
+    if(a_pSet != nullptr)
+      *a_pSet = set;
+    if(a_pLayout != nullptr)
+      *a_pLayout = layout;
+  }
+
+  static size_t templateEntrySize(VkDescriptorType a_type)
+  {
+    switch (a_type)
+    {
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      return sizeof(VkDescriptorImageInfo);
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+      return sizeof(VkBufferView);
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+      return sizeof(VkDescriptorBufferInfo);
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+      return sizeof(VkAccelerationStructureKHR);
+    default:
+      return 0;
+    }
+  }
+
+  void DescriptorMaker::CreateUpdateTemplate(VkDescriptorSetLayout a_layout, const DescriptorTypesMap &a_descrTypes)
+  {
+#if defined(VK_VERSION_1_1)
+    LayoutTemplate lt;
+    lt.locations.reserve(a_descrTypes.size());
+    for(const auto& [location, descriptor] : a_descrTypes)
+    {
+      if(descriptor.second == 0)
+        continue;
+      if(templateEntrySize(descriptor.first) == 0)
+        return; // unsupported descriptor type, use vkUpdateDescriptorSets for this layout
+      lt.locations.push_back(location);
+    }
+    std::sort(lt.locations.begin(), lt.locations.end());
+
+    std::vector<VkDescriptorUpdateTemplateEntry> entries(lt.locations.size());
+    for(size_t i = 0; i < lt.locations.size(); ++i)
+    {
+      const auto& descriptor = a_descrTypes.at(lt.locations[i]);
+      const size_t stride = templateEntrySize(descriptor.first);
+
+      entries[i].dstBinding      = lt.locations[i];
+      entries[i].dstArrayElement = 0;
+      entries[i].descriptorCount = descriptor.second;
+      entries[i].descriptorType  = descriptor.first;
+      entries[i].offset          = lt.dataSize;
+      entries[i].stride          = stride;
+
+      lt.offsets.push_back(lt.dataSize);
+      lt.dataSize += stride * descriptor.second;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo createInfo = {};
+    createInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    createInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+    createInfo.pDescriptorUpdateEntries   = entries.data();
+    createInfo.templateType               = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    createInfo.descriptorSetLayout        = a_layout;
+    VK_CHECK_RESULT(vkCreateDescriptorUpdateTemplate(m_device, &createInfo, nullptr, &lt.templ));
+
+    if(lt.dataSize > m_templateData.size())
+      m_templateData.resize(lt.dataSize);
+
+    m_layoutTemplates[a_layout] = std::move(lt);
+#else
+    (void)a_layout;
+    (void)a_descrTypes;
+#endif
+  }
+
+  bool DescriptorMaker::UpdateWithTemplate(VkDescriptorSet a_set, VkDescriptorSetLayout a_layout)
+  {
+#if defined(VK_VERSION_1_1)
+    auto found = m_layoutTemplates.find(a_layout);
+    if(found == m_layoutTemplates.end())
+      return false;
+
+    const auto& lt = found->second;
+    uint8_t* data = m_templateData.data();
+    for(size_t i = 0; i < lt.locations.size(); ++i)
+    {
+      const auto& handle = m_bindings[lt.locations[i]];
+      uint8_t* dst = data + lt.offsets[i];
+      switch (handle.type)
+      {
+      case VK_DESCRIPTOR_TYPE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        memcpy(dst, handle.imageDescriptor.data(), handle.imageDescriptor.size() * sizeof(VkDescriptorImageInfo));
+        break;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+        memcpy(dst, &handle.buffView, sizeof(VkBufferView));
+        break;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+      {
+        VkDescriptorBufferInfo info = {handle.buffer, handle.bufferOffset, handle.bufferRange};
+        memcpy(dst, &info, sizeof(VkDescriptorBufferInfo));
+        break;
+      }
+      case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+        memcpy(dst, &handle.accelStruct, sizeof(VkAccelerationStructureKHR));
+        break;
+      default:
+        break;
+      }
+    }
+
+    vkUpdateDescriptorSetWithTemplate(m_device, a_set, lt.templ, data);
+    return true;
+#else
+    (void)a_set;
+    (void)a_layout;
+    return false;
+#endif
+  }
+
+  void DescriptorMaker::BuildWrites(VkDescriptorSet a_set, const DescriptorTypesMap &a_descrTypes)
+  {
+    size_t totalImageInfos = 0;
+    size_t totalBufferInfos = 0;
+    size_t totalAccStructsInfos = 0;
+    for(auto& [location, descriptor] : a_descrTypes)
+    {
+      switch (descriptor.first)
+      {
+      case VK_DESCRIPTOR_TYPE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+        totalImageInfos += descriptor.second;
+        break;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        totalBufferInfos++;
+        break;
+      case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+        totalAccStructsInfos++;
+        break;
+      default:
+        break;
+      }
+    }
+
+    auto& writeSets       = m_writeSets;
+    auto& dBufferInfos    = m_writeBufferInfos;
+    auto& dImageInfos     = m_writeImageInfos;
+    auto& dAccStructInfos = m_writeAccStructInfos;
+    writeSets.clear();
+    writeSets.reserve(a_descrTypes.size());
+    dBufferInfos.resize(totalBufferInfos);
+    dImageInfos.resize(totalImageInfos);
+    dAccStructInfos.resize(totalAccStructsInfos);
 
     size_t imgInfoIdx = 0;
     size_t bufInfoIdx = 0;
     size_t accStructInfoIdx = 0;
-    for(auto& [location, descriptor] : descrTypes)
+    for(auto& [location, descriptor] : a_descrTypes)
     {
       VkWriteDescriptorSet writeDescriptorSet = {};
       writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      writeDescriptorSet.dstSet = set;
+      writeDescriptorSet.dstSet = a_set;
       writeDescriptorSet.dstBinding = location;
       writeDescriptorSet.descriptorCount = descriptor.second;
       writeDescriptorSet.descriptorType = descriptor.first;
@@ -339,7 +966,7 @@ namespace vk_utils
       case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
       case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
       case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
-        dBufferInfos[bufInfoIdx] = {m_bindings[location].buffer, 0, VK_WHOLE_SIZE}; //TODO: buffer range
+        dBufferInfos[bufInfoIdx] = {m_bindings[location].buffer, m_bindings[location].bufferOffset, m_bindings[location].bufferRange};
         writeDescriptorSet.pBufferInfo = &dBufferInfos[bufInfoIdx];
         bufInfoIdx++;
         break;
@@ -359,14 +986,103 @@ namespace vk_utils
 
       writeSets.push_back(writeDescriptorSet);
     }
+  }
 
-    vkUpdateDescriptorSets(m_device, (uint32_t)writeSets.size(), writeSets.data(), 0, nullptr);
-    if(hashingMode == HASHING_MODE::LAYOUTS_AND_SETS)
+  void DescriptorMaker::UpdateWithWrites(VkDescriptorSet a_set, const DescriptorTypesMap &a_descrTypes)
+  {
+    BuildWrites(a_set, a_descrTypes);
+    vkUpdateDescriptorSets(m_device, (uint32_t)m_writeSets.size(), m_writeSets.data(), 0, nullptr);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////////////
+
+  void DescriptorMaker::EnablePushDescriptors(bool a_extensionEnabled, uint32_t a_ringPools)
+  {
+    m_pushSupported = a_extensionEnabled;
+    if(m_pushSupported || !m_ringPools.empty())
+      return;
+
+    m_ringPools.resize(std::max(a_ringPools, 2u));
+    for(auto& pool : m_ringPools)
+      pool = createDescriptorPool(m_device, m_maxDescrTypes, m_maxSets);
+    m_ringCurrent = 0;
+  }
+
+  VkDescriptorSet DescriptorMaker::AllocateFromRing(VkDescriptorSetLayout a_layout)
+  {
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.descriptorPool = m_ringPools[m_ringCurrent];
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &a_layout;
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if(vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, &set) == VK_SUCCESS)
+      return set;
+
+    // current pool is exhausted, sets of the next one are expected to be no longer in use
+    m_ringCurrent = (m_ringCurrent + 1) % uint32_t(m_ringPools.size());
+    VK_CHECK_RESULT(vkResetDescriptorPool(m_device, m_ringPools[m_ringCurrent], 0));
+
+    descriptorSetAllocateInfo.descriptorPool = m_ringPools[m_ringCurrent];
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, &set));
+    return set;
+  }
+
+  VkDescriptorSetLayout DescriptorMaker::BindEndPush(VkCommandBuffer a_cmdBuff, VkPipelineBindPoint a_bindPoint,
+                                                     VkPipelineLayout a_pipelineLayout, uint32_t a_setIndex)
+  {
+    if(!m_pushSupported && m_ringPools.empty())
+      EnablePushDescriptors(false);
+
+    DescriptorTypesMap descrTypes;
+    CollectDescriptorTypes(descrTypes);
+
+    for (const auto& [location, descriptor] : descrTypes)
     {
-        m_setDict[set_key] = set;
+      if(descriptor.first == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || descriptor.first == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+      {
+        VK_UTILS_LOG_ERROR("[DescriptorMaker::BindEndPush] dynamic buffers are not allowed with push descriptors, use BindBuffer with offset instead");
+        return VK_NULL_HANDLE;
+      }
     }
 
-    *a_pSet = set;
-    *a_pLayout = layout;
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    LayoutKey layout_key = { m_currentStageFlags, descrTypes };
+    auto found_layout = m_pushLayoutDict.find(layout_key);
+    if (found_layout != m_pushLayoutDict.end())
+    {
+      layout = found_layout->second;
+    }
+    else if(m_pushSupported)
+    {
+      layout = createDescriptorSetLayout(m_device, descrTypes, m_currentStageFlags, VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
+      m_pushLayoutDict[layout_key] = layout;
+    }
+    else
+    {
+      layout = createDescriptorSetLayout(m_device, descrTypes, m_currentStageFlags);
+      m_pushLayoutDict[layout_key] = layout;
+      CreateUpdateTemplate(layout, descrTypes);
+    }
+
+    if(a_cmdBuff == VK_NULL_HANDLE)
+      return layout;
+
+    if(m_pushSupported)
+    {
+      BuildWrites(VK_NULL_HANDLE, descrTypes);
+      vkCmdPushDescriptorSetKHR(a_cmdBuff, a_bindPoint, a_pipelineLayout, a_setIndex,
+                                (uint32_t)m_writeSets.size(), m_writeSets.data());
+    }
+    else
+    {
+      VkDescriptorSet set = AllocateFromRing(layout);
+      if(!UpdateWithTemplate(set, layout))
+        UpdateWithWrites(set, descrTypes);
+      vkCmdBindDescriptorSets(a_cmdBuff, a_bindPoint, a_pipelineLayout, a_setIndex, 1, &set, 0, nullptr);
+    }
+
+    return layout;
   }
 }// namespace vk_utils
@@ -9,29 +9,176 @@
 #include <vector>
 #include <cassert>
 #include <unordered_map>
+#include <memory>
 
 namespace vk_utils
 {
 
-  VkDescriptorSetLayout createDescriptorSetLayout(VkDevice a_device, const DescriptorTypesMap &a_descrTypes, VkShaderStageFlags a_stage = VK_SHADER_STAGE_COMPUTE_BIT);
+  VkDescriptorSetLayout createDescriptorSetLayout(VkDevice a_device, const DescriptorTypesMap &a_descrTypes, VkShaderStageFlags a_stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                                                  VkDescriptorSetLayoutCreateFlags a_flags = 0);
   VkDescriptorPool createDescriptorPool(VkDevice a_device, const DescriptorTypesVec &a_descrTypes, unsigned a_maxSets, VkDescriptorPoolCreateFlags a_flags = 0);
   VkDescriptorSet createDescriptorSet(VkDevice a_device, VkDescriptorSetLayout a_pDSLayout, VkDescriptorPool a_pDSPool, const std::vector<VkDescriptorBufferInfo> &bufInfos);
 
+  // Bounded cache of descriptor sets, keyed by flattened array of 64-bit words (layout + bindings).
+  // Open addressing with linear probing over a power of two table, LRU eviction when a_capacity sets are stored.
+  // Each entry also keeps handles it references, so that sets can be invalidated when a handle is destroyed.
+  // Evicted and invalidated sets are returned to caller to be recycled.
+  //
+  class DescriptorSetCache
+  {
+  public:
+    explicit DescriptorSetCache(uint32_t a_capacity = 4096);
+
+    static uint64_t Hash(const uint64_t* a_key, size_t a_keySize);
+
+    VkDescriptorSet Find(const std::vector<uint64_t> &a_key, uint64_t a_hash);
+
+    // if cache is full least recently used entry is evicted and written to a_pEvicted
+    void Insert(const std::vector<uint64_t> &a_key, uint64_t a_hash, const std::vector<uint64_t> &a_handles,
+                VkDescriptorSet a_set, VkDescriptorSetLayout a_layout, std::pair<VkDescriptorSet, VkDescriptorSetLayout>* a_pEvicted);
+
+    // removes all sets referencing a_handle, appends them to a_freed; O(capacity)
+    void Invalidate(uint64_t a_handle, std::vector<std::pair<VkDescriptorSet, VkDescriptorSetLayout>> &a_freed);
+
+    void Clear(std::vector<std::pair<VkDescriptorSet, VkDescriptorSetLayout>> &a_freed);
+    uint32_t Size() const { return m_size; }
+    uint32_t Capacity() const { return uint32_t(m_entries.size()); }
+
+  private:
+    static constexpr uint32_t INVALID = UINT32_MAX;
+
+    struct Entry
+    {
+      uint64_t hash = 0;
+      std::vector<uint64_t> key;
+      std::vector<uint64_t> handles;
+      VkDescriptorSet set = VK_NULL_HANDLE;
+      VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+      uint32_t slot = INVALID;
+      uint32_t prev = INVALID; // LRU list, head is most recently used
+      uint32_t next = INVALID;
+    };
+
+    void Remove(uint32_t a_entry);
+    void Unlink(uint32_t a_entry);
+    void PushFront(uint32_t a_entry);
+
+    std::vector<Entry> m_entries;
+    std::vector<uint32_t> m_slots; // entry index or INVALID
+    std::vector<uint32_t> m_freeEntries;
+    uint32_t m_mask = 0;
+    uint32_t m_size = 0;
+    uint32_t m_head = INVALID;
+    uint32_t m_tail = INVALID;
+  };
+
+  struct IResourceManager;
+
+  // Descriptor pool allocator which never runs out: when pool returns VK_ERROR_OUT_OF_POOL_MEMORY/VK_ERROR_FRAGMENTED_POOL,
+  // new pool of the same size is chained and allocation is retried.
+  //
+  // Allocate() gives persistent sets, they live until Free() or until allocator is destroyed; their pools are created with
+  // VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, space of freed sets is reused before new pools are chained.
+  // AllocateTransient() gives sets from pools of current frame (a_framesInFlight > 0), which are reset all at once
+  // with vkResetDescriptorPool in BeginFrame() - call it only after fence of that frame has been waited on.
+  //
+  class DescriptorPoolAllocator
+  {
+  public:
+    DescriptorPoolAllocator(VkDevice a_device, const DescriptorTypesVec &a_poolSizes, uint32_t a_setsPerPool, uint32_t a_framesInFlight = 0);
+    ~DescriptorPoolAllocator();
+
+    DescriptorPoolAllocator(DescriptorPoolAllocator const&) = delete;
+    DescriptorPoolAllocator& operator=(DescriptorPoolAllocator const&) = delete;
+
+    VkDescriptorSet Allocate(VkDescriptorSetLayout a_layout);
+    VkDescriptorSet AllocateTransient(VkDescriptorSetLayout a_layout);
+    // returns a set from Allocate() to its pool, GPU must not use it anymore
+    void Free(VkDescriptorSet a_set);
+
+    void BeginFrame(uint32_t a_frameIndex);
+
+    VkDescriptorPool GetPool() const { return m_persistent.pools.front(); }
+    uint32_t GetPoolCount() const;
+
+  private:
+    struct PoolChain
+    {
+      std::vector<VkDescriptorPool> pools;
+      uint32_t current = 0;
+      VkDescriptorPoolCreateFlags flags = 0;
+    };
+
+    VkDescriptorSet AllocateFromChain(PoolChain &a_chain, VkDescriptorSetLayout a_layout);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    DescriptorTypesVec m_poolSizes;
+    uint32_t m_setsPerPool = 0;
+
+    PoolChain m_persistent;
+    std::unordered_map<VkDescriptorSet, VkDescriptorPool> m_persistentOwners; // to free sets to their pool
+    std::vector<PoolChain> m_frames;
+    uint32_t m_currentFrame = 0;
+  };
+
   class DescriptorMaker
   {
   public:
-    DescriptorMaker(VkDevice a_device, const DescriptorTypesVec &a_maxDescrTypes, uint32_t a_maxSets);
+    // a_maxDescrTypes and a_maxSets define size of a single pool, more pools are chained when it is exhausted;
+    // a_framesInFlight > 0 enables BindEndTransient
+    DescriptorMaker(VkDevice a_device, const DescriptorTypesVec &a_maxDescrTypes, uint32_t a_maxSets, uint32_t a_framesInFlight = 0);
     ~DescriptorMaker();
 
     void BindBegin(VkShaderStageFlags a_shaderStage);
     void BindBuffer(uint32_t a_loc, VkBuffer a_buffer, VkBufferView a_buffView = VK_NULL_HANDLE, VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    // binds [a_offset, a_offset + a_range) sub-range of a_buffer;
+    // for *_BUFFER_DYNAMIC types a_offset is the base offset and a_range is the size visible to shader (per object),
+    // offsets of each dynamic binding are passed to vkCmdBindDescriptorSets in binding order. Since dynamic offsets
+    // are not part of the set, one set serves all objects suballocated from the same buffer
+    void BindBuffer(uint32_t a_loc, VkBuffer a_buffer, VkDeviceSize a_offset, VkDeviceSize a_range,
+                    VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
     void BindAccelStruct(uint32_t a_loc, VkAccelerationStructureKHR a_accStruct, VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR);
     void BindImage(uint32_t a_loc, VkImageView a_imageView, VkSampler a_sampler = VK_NULL_HANDLE, VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VkImageLayout a_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     void BindImageArray(uint32_t a_loc, const std::vector<VkImageView> &a_imageView, const std::vector<VkSampler> &a_sampler, VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VkImageLayout a_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     void BindImageArray(uint32_t a_loc, const std::vector<VkDescriptorImageInfo> &a_imageDesc, VkDescriptorType a_bindType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
     void BindEnd(VkDescriptorSet *a_pSet = nullptr, VkDescriptorSetLayout *a_pLayout = nullptr);
 
-    VkDescriptorPool GetPool() const { return m_pool; }
+    // set is allocated from pools of current frame and is not cached, it is valid until BeginFrame() with the same frame index
+    void BindEndTransient(VkDescriptorSet *a_pSet, VkDescriptorSetLayout *a_pLayout = nullptr);
+    // resets transient pools of a_frameIndex, call after fence of that frame is signaled. With a_framesInFlight == 0
+    // it is optional: calling it once per frame makes evicted sets reusable by frame count (see setRecycleDelay),
+    // without it they are freed to their pool right away, which is valid only if each submit is waited before next BindEnd
+    void BeginFrame(uint32_t a_frameIndex);
+
+    // Push-descriptor path for bindings which change on every dispatch (VK_KHR_push_descriptor).
+    // Layouts are created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR and cached separately from BindEnd ones,
+    // BindEndPush records vkCmdPushDescriptorSetKHR to a_cmdBuff, no sets are allocated and no set hashing is done.
+    // Without the extension sets are allocated from a ring of a_ringPools pools (each sized as the main one) and bound with
+    // vkCmdBindDescriptorSets; next pool in the ring is reset when current one is exhausted, so the ring must be long enough
+    // for sets in flight.
+    //
+    void EnablePushDescriptors(bool a_extensionEnabled, uint32_t a_ringPools = 3);
+
+    // with a_cmdBuff == VK_NULL_HANDLE nothing is recorded, only layout is returned (to create pipeline layout with);
+    // returns VK_NULL_HANDLE without recording anything if dynamic buffers are bound
+    VkDescriptorSetLayout BindEndPush(VkCommandBuffer a_cmdBuff, VkPipelineBindPoint a_bindPoint, VkPipelineLayout a_pipelineLayout,
+                                      uint32_t a_setIndex = 0);
+
+    VkDescriptorPool GetPool() const { return m_pools.GetPool(); }
+
+    // LAYOUTS_AND_SETS mode keeps at most a_maxSets sets in cache (least recently used are evicted), clears the cache
+    void SetCacheCapacity(uint32_t a_maxSets);
+
+    // drops cached sets which reference a_handle (raw VkBuffer/VkImageView/VkBufferView/VkSampler value, see handleToU64)
+    void InvalidateHandle(uint64_t a_handle);
+    // calls InvalidateHandle for each buffer and image view a_pResourceManager destroys
+    void TrackResourceManager(std::shared_ptr<IResourceManager> a_pResourceManager);
+
+    // once BeginFrame() is called, evicted and invalidated sets are reused for the same layout after this many BeginFrame()
+    // calls (a_framesInFlight, or DEFAULT_RECYCLE_DELAY without frames in flight; 0 - right away, when every submit is waited
+    // before next BindEnd). Sets which are not reused during another setRecycleDelay frames are freed to their pool.
+    static constexpr uint32_t DEFAULT_RECYCLE_DELAY = 3;
+    uint32_t setRecycleDelay = DEFAULT_RECYCLE_DELAY;
 
     enum class HASHING_MODE {
       NONE,
@@ -42,14 +189,66 @@ namespace vk_utils
 
   private:
     VkDevice m_device = VK_NULL_HANDLE;
-    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+    DescriptorPoolAllocator m_pools;
+    DescriptorTypesVec m_maxDescrTypes;
+    uint32_t m_maxSets = 0;
 
     VkShaderStageFlags m_currentStageFlags = 0u;
     std::unordered_map<uint32_t, DescriptorHandles> m_bindings;// shader location to vk handle(s)
 
     std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutHash> m_layoutDict;
-    std::unordered_map<SetKey, VkDescriptorSet, SetHash> m_setDict;
+    DescriptorSetCache m_setCache;
+    std::vector<uint64_t> m_setKey;     // scratch, flattened key of current bindings
+    std::vector<uint64_t> m_setHandles; // scratch, handles referenced by current bindings
+    std::vector<uint32_t> m_sortedLocations;
+
+    // sets removed from cache, reusable for the same layout once m_frameCounter >= retireFrame
+    struct RetiredSet
+    {
+      VkDescriptorSet set;
+      uint64_t retireFrame;
+    };
+    std::unordered_map<VkDescriptorSetLayout, std::vector<RetiredSet>> m_retiredSets;
+    std::vector<std::pair<VkDescriptorSet, VkDescriptorSetLayout>> m_freedScratch;
+    uint64_t m_frameCounter = 0;
+    bool     m_frameDriven  = false; // BeginFrame was called, sets are recycled by frame count
+
+    std::shared_ptr<IResourceManager> m_pTrackedManager;
+    uint32_t m_destroyCallbackId = UINT32_MAX;
+
+    // update template created once per cached layout, data is packed to m_templateData in 'locations' order
+    struct LayoutTemplate
+    {
+      VkDescriptorUpdateTemplate templ = VK_NULL_HANDLE;
+      std::vector<uint32_t> locations;
+      std::vector<size_t>   offsets;
+      size_t dataSize = 0;
+    };
+    std::unordered_map<VkDescriptorSetLayout, LayoutTemplate> m_layoutTemplates;
+    std::vector<uint8_t> m_templateData;
+
+    // scratch arrays for VkWriteDescriptorSet path, reused between calls
+    std::vector<VkWriteDescriptorSet> m_writeSets;
+    std::vector<VkDescriptorBufferInfo> m_writeBufferInfos;
+    std::vector<VkDescriptorImageInfo> m_writeImageInfos;
+    std::vector<VkWriteDescriptorSetAccelerationStructureKHR> m_writeAccStructInfos;
+
+    // push descriptors
+    bool m_pushSupported = false;
+    std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutHash> m_pushLayoutDict;
+    std::vector<VkDescriptorPool> m_ringPools;
+    uint32_t m_ringCurrent = 0;
 
+    void CollectDescriptorTypes(DescriptorTypesMap &a_descrTypes) const;
+    VkDescriptorSetLayout GetOrCreateLayout(const DescriptorTypesMap &a_descrTypes);
+    void CreateUpdateTemplate(VkDescriptorSetLayout a_layout, const DescriptorTypesMap &a_descrTypes);
+    bool UpdateWithTemplate(VkDescriptorSet a_set, VkDescriptorSetLayout a_layout);
+    void BuildWrites(VkDescriptorSet a_set, const DescriptorTypesMap &a_descrTypes);
+    void UpdateWithWrites(VkDescriptorSet a_set, const DescriptorTypesMap &a_descrTypes);
+    VkDescriptorSet AllocateFromRing(VkDescriptorSetLayout a_layout);
+    void FlattenSetKey(VkDescriptorSetLayout a_layout);
+    void RetireSet(VkDescriptorSet a_set, VkDescriptorSetLayout a_layout);
+    VkDescriptorSet AllocateCached(VkDescriptorSetLayout a_layout);
   };
 }// namespace vk_utils
 
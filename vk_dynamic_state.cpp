@@ -0,0 +1,347 @@
+#include "vk_dynamic_state.h"
+#include "vk_pipeline.h"
+#include "vk_utils.h"
+#include "vk_ext_funcs.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace vk_utils
+{
+  static uint64_t floatBits(float a_value)
+  {
+    uint32_t bits = 0;
+    memcpy(&bits, &a_value, sizeof(bits));
+    return bits;
+  }
+
+  ExtendedDynamicStateSupport ExtendedDynamicStateSupport::Query(VkPhysicalDevice a_physicalDevice)
+  {
+    ExtendedDynamicStateSupport support;
+
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+#if defined(VK_EXT_extended_dynamic_state)
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT state1Features = {};
+    state1Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    state1Features.pNext = features2.pNext;
+    features2.pNext      = &state1Features;
+#endif
+#if defined(VK_EXT_extended_dynamic_state2)
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT state2Features = {};
+    state2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+    state2Features.pNext = features2.pNext;
+    features2.pNext      = &state2Features;
+#endif
+#if defined(VK_EXT_extended_dynamic_state3)
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT state3Features = {};
+    state3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+    state3Features.pNext = features2.pNext;
+    features2.pNext      = &state3Features;
+#endif
+
+    vkGetPhysicalDeviceFeatures2(a_physicalDevice, &features2);
+
+#if defined(VK_EXT_extended_dynamic_state)
+    support.extendedDynamicState  = state1Features.extendedDynamicState == VK_TRUE;
+#endif
+#if defined(VK_EXT_extended_dynamic_state2)
+    support.extendedDynamicState2 = state2Features.extendedDynamicState2 == VK_TRUE;
+#endif
+#if defined(VK_EXT_extended_dynamic_state3)
+    support.polygonMode           = state3Features.extendedDynamicState3PolygonMode == VK_TRUE;
+    support.colorBlendEnable      = state3Features.extendedDynamicState3ColorBlendEnable == VK_TRUE;
+    support.colorBlendEquation    = state3Features.extendedDynamicState3ColorBlendEquation == VK_TRUE;
+    support.colorWriteMask        = state3Features.extendedDynamicState3ColorWriteMask == VK_TRUE;
+#endif
+
+    return support;
+  }
+
+  std::vector<VkDynamicState> ExtendedDynamicStateSupport::DynamicStates() const
+  {
+    std::vector<VkDynamicState> states = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+#if defined(VK_EXT_extended_dynamic_state)
+    if(extendedDynamicState)
+    {
+      states.insert(states.end(), { VK_DYNAMIC_STATE_CULL_MODE_EXT, VK_DYNAMIC_STATE_FRONT_FACE_EXT, VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+                                    VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+                                    VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT, VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT });
+    }
+#endif
+#if defined(VK_EXT_extended_dynamic_state2)
+    if(extendedDynamicState2)
+    {
+      states.insert(states.end(), { VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT, VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT,
+                                    VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT });
+    }
+#endif
+#if defined(VK_EXT_extended_dynamic_state3)
+    if(polygonMode)
+      states.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+    if(colorBlendEnable)
+      states.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+    if(colorBlendEquation)
+      states.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT);
+    if(colorWriteMask)
+      states.push_back(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT);
+#endif
+
+    return states;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+
+  DynamicStateSetter::DynamicStateSetter(const ExtendedDynamicStateSupport &a_support) : m_dynamicStates(a_support.DynamicStates())
+  {
+  }
+
+  void DynamicStateSetter::Reset(VkCommandBuffer a_cmdBuff)
+  {
+    m_cmdBuff = a_cmdBuff;
+    m_values.clear();
+  }
+
+  bool DynamicStateSetter::IsDynamic(VkDynamicState a_state) const
+  {
+    return std::find(m_dynamicStates.begin(), m_dynamicStates.end(), a_state) != m_dynamicStates.end();
+  }
+
+  bool DynamicStateSetter::Store(VkDynamicState a_state, uint32_t a_index, uint64_t a_value)
+  {
+    assert(m_cmdBuff != VK_NULL_HANDLE);
+    const uint64_t key = (uint64_t(a_state) << 32) | a_index;
+    auto found = m_values.find(key);
+    if(found != m_values.end() && found->second == a_value)
+      return false;
+    m_values[key] = a_value;
+    return true;
+  }
+
+  bool DynamicStateSetter::Count(bool a_changed)
+  {
+    if(a_changed)
+      m_setCount++;
+    else
+      m_skippedCount++;
+    return a_changed;
+  }
+
+  bool DynamicStateSetter::SetViewport(const VkViewport &a_viewport)
+  {
+    bool changed = false;
+    const float components[6] = { a_viewport.x, a_viewport.y, a_viewport.width, a_viewport.height, a_viewport.minDepth, a_viewport.maxDepth };
+    for(uint32_t i = 0; i < 6; ++i)
+      changed = Store(VK_DYNAMIC_STATE_VIEWPORT, i, floatBits(components[i])) || changed;
+    if(Count(changed))
+      vkCmdSetViewport(m_cmdBuff, 0, 1, &a_viewport);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetScissor(const VkRect2D &a_scissor)
+  {
+    bool changed = Store(VK_DYNAMIC_STATE_SCISSOR, 0, (uint64_t(uint32_t(a_scissor.offset.x)) << 32) | uint32_t(a_scissor.offset.y));
+    changed = Store(VK_DYNAMIC_STATE_SCISSOR, 1, (uint64_t(a_scissor.extent.width) << 32) | a_scissor.extent.height) || changed;
+    if(Count(changed))
+      vkCmdSetScissor(m_cmdBuff, 0, 1, &a_scissor);
+    return true;
+  }
+
+#if defined(VK_EXT_extended_dynamic_state)
+
+  bool DynamicStateSetter::SetCullMode(VkCullModeFlags a_cullMode)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_CULL_MODE_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_CULL_MODE_EXT, 0, a_cullMode)))
+      vkCmdSetCullModeEXT(m_cmdBuff, a_cullMode);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetFrontFace(VkFrontFace a_frontFace)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_FRONT_FACE_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_FRONT_FACE_EXT, 0, a_frontFace)))
+      vkCmdSetFrontFaceEXT(m_cmdBuff, a_frontFace);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetPrimitiveTopology(VkPrimitiveTopology a_topology)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT, 0, a_topology)))
+      vkCmdSetPrimitiveTopologyEXT(m_cmdBuff, a_topology);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetDepthTestEnable(bool a_enable)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT, 0, a_enable)))
+      vkCmdSetDepthTestEnableEXT(m_cmdBuff, a_enable ? VK_TRUE : VK_FALSE);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetDepthWriteEnable(bool a_enable)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, 0, a_enable)))
+      vkCmdSetDepthWriteEnableEXT(m_cmdBuff, a_enable ? VK_TRUE : VK_FALSE);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetDepthCompareOp(VkCompareOp a_op)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT, 0, a_op)))
+      vkCmdSetDepthCompareOpEXT(m_cmdBuff, a_op);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetStencilTestEnable(bool a_enable)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT, 0, a_enable)))
+      vkCmdSetStencilTestEnableEXT(m_cmdBuff, a_enable ? VK_TRUE : VK_FALSE);
+    return true;
+  }
+
+#else
+
+  bool DynamicStateSetter::SetCullMode(VkCullModeFlags)            { return false; }
+  bool DynamicStateSetter::SetFrontFace(VkFrontFace)               { return false; }
+  bool DynamicStateSetter::SetPrimitiveTopology(VkPrimitiveTopology) { return false; }
+  bool DynamicStateSetter::SetDepthTestEnable(bool)                { return false; }
+  bool DynamicStateSetter::SetDepthWriteEnable(bool)               { return false; }
+  bool DynamicStateSetter::SetDepthCompareOp(VkCompareOp)          { return false; }
+  bool DynamicStateSetter::SetStencilTestEnable(bool)              { return false; }
+
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state2)
+
+  bool DynamicStateSetter::SetDepthBiasEnable(bool a_enable)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT, 0, a_enable)))
+      vkCmdSetDepthBiasEnableEXT(m_cmdBuff, a_enable ? VK_TRUE : VK_FALSE);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetRasterizerDiscardEnable(bool a_enable)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT, 0, a_enable)))
+      vkCmdSetRasterizerDiscardEnableEXT(m_cmdBuff, a_enable ? VK_TRUE : VK_FALSE);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetPrimitiveRestartEnable(bool a_enable)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT, 0, a_enable)))
+      vkCmdSetPrimitiveRestartEnableEXT(m_cmdBuff, a_enable ? VK_TRUE : VK_FALSE);
+    return true;
+  }
+
+#else
+
+  bool DynamicStateSetter::SetDepthBiasEnable(bool)         { return false; }
+  bool DynamicStateSetter::SetRasterizerDiscardEnable(bool) { return false; }
+  bool DynamicStateSetter::SetPrimitiveRestartEnable(bool)  { return false; }
+
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state3)
+
+  bool DynamicStateSetter::SetPolygonMode(VkPolygonMode a_mode)
+  {
+    if(!IsDynamic(VK_DYNAMIC_STATE_POLYGON_MODE_EXT))
+      return false;
+    if(Count(Store(VK_DYNAMIC_STATE_POLYGON_MODE_EXT, 0, a_mode)))
+      vkCmdSetPolygonModeEXT(m_cmdBuff, a_mode);
+    return true;
+  }
+
+  bool DynamicStateSetter::SetColorBlend(uint32_t a_attachment, const VkPipelineColorBlendAttachmentState &a_state)
+  {
+    const bool enableDynamic   = IsDynamic(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+    const bool equationDynamic = IsDynamic(VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT);
+    const bool maskDynamic     = IsDynamic(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT);
+
+    if(enableDynamic && Count(Store(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT, a_attachment, a_state.blendEnable)))
+      vkCmdSetColorBlendEnableEXT(m_cmdBuff, a_attachment, 1, &a_state.blendEnable);
+
+    if(equationDynamic)
+    {
+      VkColorBlendEquationEXT equation = {};
+      equation.srcColorBlendFactor = a_state.srcColorBlendFactor;
+      equation.dstColorBlendFactor = a_state.dstColorBlendFactor;
+      equation.colorBlendOp        = a_state.colorBlendOp;
+      equation.srcAlphaBlendFactor = a_state.srcAlphaBlendFactor;
+      equation.dstAlphaBlendFactor = a_state.dstAlphaBlendFactor;
+      equation.alphaBlendOp        = a_state.alphaBlendOp;
+
+      // factors fit in 16 bits, ops don't (advanced blend ops), so store them separately
+      //
+      const uint64_t factors = (uint64_t(equation.srcColorBlendFactor) << 48) | (uint64_t(equation.dstColorBlendFactor) << 32) |
+                               (uint64_t(equation.srcAlphaBlendFactor) << 16) |  uint64_t(equation.dstAlphaBlendFactor);
+      const uint64_t ops     = (uint64_t(equation.colorBlendOp) << 32) | uint64_t(equation.alphaBlendOp);
+      bool changed = Store(VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT, a_attachment * 2 + 0, factors);
+      changed      = Store(VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT, a_attachment * 2 + 1, ops) || changed;
+      if(Count(changed))
+        vkCmdSetColorBlendEquationEXT(m_cmdBuff, a_attachment, 1, &equation);
+    }
+
+    if(maskDynamic && Count(Store(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT, a_attachment, a_state.colorWriteMask)))
+      vkCmdSetColorWriteMaskEXT(m_cmdBuff, a_attachment, 1, &a_state.colorWriteMask);
+
+    return enableDynamic && equationDynamic && maskDynamic;
+  }
+
+#else
+
+  bool DynamicStateSetter::SetPolygonMode(VkPolygonMode) { return false; }
+  bool DynamicStateSetter::SetColorBlend(uint32_t, const VkPipelineColorBlendAttachmentState&) { return false; }
+
+#endif
+
+  void DynamicStateSetter::Apply(const GraphicsPipelineMaker &a_maker)
+  {
+    const auto &rs = a_maker.rasterizer;
+    const auto &ds = a_maker.depthStencilTest;
+
+    SetViewport(a_maker.viewport);
+    SetScissor(a_maker.scissor);
+
+    SetCullMode(rs.cullMode);
+    SetFrontFace(rs.frontFace);
+    SetPrimitiveTopology(a_maker.inputAssembly.topology);
+    SetDepthTestEnable(ds.depthTestEnable == VK_TRUE);
+    SetDepthWriteEnable(ds.depthWriteEnable == VK_TRUE);
+    SetDepthCompareOp(ds.depthCompareOp);
+    SetStencilTestEnable(ds.stencilTestEnable == VK_TRUE);
+
+    SetDepthBiasEnable(rs.depthBiasEnable == VK_TRUE);
+    SetRasterizerDiscardEnable(rs.rasterizerDiscardEnable == VK_TRUE);
+    SetPrimitiveRestartEnable(a_maker.inputAssembly.primitiveRestartEnable == VK_TRUE);
+
+    SetPolygonMode(rs.polygonMode);
+    for(size_t i = 0; i < a_maker.colorBlendAttachments.size(); ++i)
+      SetColorBlend(uint32_t(i), a_maker.colorBlendAttachments[i]);
+  }
+}
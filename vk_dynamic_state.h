@@ -0,0 +1,84 @@
+#ifndef VK_UTILS_DYNAMIC_STATE_H
+#define VK_UTILS_DYNAMIC_STATE_H
+
+#include "vk_include.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace vk_utils
+{
+  struct GraphicsPipelineMaker;
+
+  // Fixed function states that the device can set on command buffer with VK_EXT_extended_dynamic_state, 2 and 3.
+  // Corresponding extensions and features must be enabled on the device for every flag which is true.
+  //
+  struct ExtendedDynamicStateSupport
+  {
+    bool extendedDynamicState     = false; // cull mode, front face, topology (within one topology class), depth and stencil test
+    bool extendedDynamicState2    = false; // depth bias enable, rasterizer discard, primitive restart
+    bool polygonMode              = false; // extendedDynamicState3PolygonMode
+    bool colorBlendEnable         = false; // extendedDynamicState3ColorBlendEnable
+    bool colorBlendEquation       = false; // extendedDynamicState3ColorBlendEquation
+    bool colorWriteMask           = false; // extendedDynamicState3ColorWriteMask
+
+    static ExtendedDynamicStateSupport Query(VkPhysicalDevice a_physicalDevice);
+
+    // states to create pipelines with, viewport and scissor are always included
+    std::vector<VkDynamicState> DynamicStates() const;
+  };
+
+  // Sets dynamic states on a command buffer and skips calls which don't change the previously set value.
+  // Use with pipelines made by GraphicsPipelineMaker after EnableExtendedDynamicState, so one pipeline per shader set
+  // covers all combinations of these states.
+  //
+  // Set* return false if the state is not dynamic on this device, i.e. it is baked into the pipeline and a different
+  // pipeline is needed to change it. Call Reset for every new command buffer and after binding a pipeline created
+  // without these dynamic states (such pipelines invalidate dynamic values).
+  //
+  class DynamicStateSetter
+  {
+  public:
+    explicit DynamicStateSetter(const ExtendedDynamicStateSupport &a_support);
+
+    void Reset(VkCommandBuffer a_cmdBuff);
+    bool IsDynamic(VkDynamicState a_state) const;
+
+    bool SetViewport(const VkViewport &a_viewport);
+    bool SetScissor(const VkRect2D &a_scissor);
+
+    bool SetCullMode(VkCullModeFlags a_cullMode);
+    bool SetFrontFace(VkFrontFace a_frontFace);
+    bool SetPrimitiveTopology(VkPrimitiveTopology a_topology);
+    bool SetDepthTestEnable(bool a_enable);
+    bool SetDepthWriteEnable(bool a_enable);
+    bool SetDepthCompareOp(VkCompareOp a_op);
+    bool SetStencilTestEnable(bool a_enable);
+
+    bool SetDepthBiasEnable(bool a_enable);
+    bool SetRasterizerDiscardEnable(bool a_enable);
+    bool SetPrimitiveRestartEnable(bool a_enable);
+
+    bool SetPolygonMode(VkPolygonMode a_mode);
+    // blend enable, equation and write mask of one color attachment
+    bool SetColorBlend(uint32_t a_attachment, const VkPipelineColorBlendAttachmentState &a_state);
+
+    // all dynamic states from fixed function state of a_maker, call after MakePipeline (it stores input assembly)
+    void Apply(const GraphicsPipelineMaker &a_maker);
+
+    uint32_t SetCount()     const { return m_setCount; }
+    uint32_t SkippedCount() const { return m_skippedCount; }
+
+  private:
+    bool Store(VkDynamicState a_state, uint32_t a_index, uint64_t a_value);
+    bool Count(bool a_changed);
+
+    VkCommandBuffer                        m_cmdBuff = VK_NULL_HANDLE;
+    std::vector<VkDynamicState>            m_dynamicStates;
+    std::unordered_map<uint64_t, uint64_t> m_values; // (state, index) -> last set value
+    uint32_t                               m_setCount     = 0;
+    uint32_t                               m_skippedCount = 0;
+  };
+}
+
+#endif// VK_UTILS_DYNAMIC_STATE_H
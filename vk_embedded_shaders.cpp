@@ -0,0 +1,62 @@
+#include "vk_embedded_shaders.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace vk_utils
+{
+  // function local statics, registration may run during static initialization of other translation units
+  //
+  struct EmbeddedShaderRegistry
+  {
+    std::mutex mutex;
+    std::unordered_map<std::string, EmbeddedShader> shaders;
+    std::unordered_map<std::string, std::string>    overrides;
+  };
+
+  static EmbeddedShaderRegistry& registry()
+  {
+    static EmbeddedShaderRegistry instance;
+    return instance;
+  }
+
+  bool registerEmbeddedShader(const char* a_id, const uint32_t* a_code, size_t a_wordCount)
+  {
+    EmbeddedShader shader;
+    shader.id        = a_id;
+    shader.code      = a_code;
+    shader.wordCount = a_wordCount;
+
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.shaders.emplace(a_id, shader).second;
+  }
+
+  void setEmbeddedShaderOverride(const std::string &a_id, const std::string &a_path)
+  {
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if(a_path.empty())
+      reg.overrides.erase(a_id);
+    else
+      reg.overrides[a_id] = a_path;
+  }
+
+  const EmbeddedShader* findEmbeddedShader(const std::string &a_id)
+  {
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if(reg.overrides.find(a_id) != reg.overrides.end())
+      return nullptr;
+    auto found = reg.shaders.find(a_id);
+    return found != reg.shaders.end() ? &found->second : nullptr;
+  }
+
+  std::string resolveShaderPath(const std::string &a_idOrPath)
+  {
+    auto &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto found = reg.overrides.find(a_idOrPath);
+    return found != reg.overrides.end() ? found->second : a_idOrPath;
+  }
+}
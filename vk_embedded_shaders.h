@@ -0,0 +1,41 @@
+#ifndef VK_UTILS_EMBEDDED_SHADERS_H
+#define VK_UTILS_EMBEDDED_SHADERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace vk_utils
+{
+  // SPIR-V compiled into the executable, e.g. with
+  //   glslangValidator -V --vn quad_vert_spv -o quad_vert.spv.h quad_vert.vert
+  // which produces 'const uint32_t quad_vert_spv[] = {...};'. See README for the CMake build step.
+  //
+  struct EmbeddedShader
+  {
+    const char*     id        = nullptr;
+    const uint32_t* code      = nullptr;
+    size_t          wordCount = 0;
+  };
+
+  // a_id is what helpers get instead of a file path (readSPVFile, pipeline makers, FSQuad, ComputeCopyHelper, ...),
+  // a_code must have static storage duration. Returns false if a_id was already registered.
+  bool registerEmbeddedShader(const char* a_id, const uint32_t* a_code, size_t a_wordCount);
+
+  // file at a_path is loaded instead of embedded code of a_id (to iterate on shaders without rebuilding),
+  // empty a_path removes the override
+  void setEmbeddedShaderOverride(const std::string &a_id, const std::string &a_path);
+
+  // nullptr if a_id is not registered or is overridden by a file
+  const EmbeddedShader* findEmbeddedShader(const std::string &a_id);
+
+  // override path of a_idOrPath if it is set, a_idOrPath itself otherwise
+  std::string resolveShaderPath(const std::string &a_idOrPath);
+}
+
+// registers array generated by glslangValidator --vn during static initialization;
+// place it in a translation unit which is linked into the executable (not in an otherwise unreferenced static library object)
+#define VK_UTILS_EMBED_SHADER(a_id, a_array) \
+  static const bool a_array##_registered = vk_utils::registerEmbeddedShader(a_id, a_array, sizeof(a_array) / sizeof(a_array[0]))
+
+#endif// VK_UTILS_EMBEDDED_SHADERS_H
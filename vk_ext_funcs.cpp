@@ -0,0 +1,168 @@
+#include "vk_ext_funcs.h"
+
+namespace vk_utils
+{
+#if defined(VK_KHR_push_descriptor)
+  PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR = nullptr;
+#endif
+
+#if defined(VK_KHR_dynamic_rendering)
+  PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR = nullptr;
+  PFN_vkCmdEndRenderingKHR   vkCmdEndRenderingKHR   = nullptr;
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state)
+  PFN_vkCmdSetCullModeEXT              vkCmdSetCullModeEXT              = nullptr;
+  PFN_vkCmdSetFrontFaceEXT             vkCmdSetFrontFaceEXT             = nullptr;
+  PFN_vkCmdSetPrimitiveTopologyEXT     vkCmdSetPrimitiveTopologyEXT     = nullptr;
+  PFN_vkCmdSetDepthTestEnableEXT       vkCmdSetDepthTestEnableEXT       = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT      vkCmdSetDepthWriteEnableEXT      = nullptr;
+  PFN_vkCmdSetDepthCompareOpEXT        vkCmdSetDepthCompareOpEXT        = nullptr;
+  PFN_vkCmdSetStencilTestEnableEXT     vkCmdSetStencilTestEnableEXT     = nullptr;
+  PFN_vkCmdSetViewportWithCountEXT     vkCmdSetViewportWithCountEXT     = nullptr;
+  PFN_vkCmdSetScissorWithCountEXT      vkCmdSetScissorWithCountEXT      = nullptr;
+  PFN_vkCmdSetDepthBoundsTestEnableEXT vkCmdSetDepthBoundsTestEnableEXT = nullptr;
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state2)
+  PFN_vkCmdSetRasterizerDiscardEnableEXT vkCmdSetRasterizerDiscardEnableEXT = nullptr;
+  PFN_vkCmdSetDepthBiasEnableEXT         vkCmdSetDepthBiasEnableEXT         = nullptr;
+  PFN_vkCmdSetPrimitiveRestartEnableEXT  vkCmdSetPrimitiveRestartEnableEXT  = nullptr;
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state3)
+  PFN_vkCmdSetPolygonModeEXT           vkCmdSetPolygonModeEXT           = nullptr;
+  PFN_vkCmdSetColorBlendEnableEXT      vkCmdSetColorBlendEnableEXT      = nullptr;
+  PFN_vkCmdSetColorBlendEquationEXT    vkCmdSetColorBlendEquationEXT    = nullptr;
+  PFN_vkCmdSetColorWriteMaskEXT        vkCmdSetColorWriteMaskEXT        = nullptr;
+  PFN_vkCmdSetRasterizationSamplesEXT  vkCmdSetRasterizationSamplesEXT  = nullptr;
+  PFN_vkCmdSetSampleMaskEXT            vkCmdSetSampleMaskEXT            = nullptr;
+  PFN_vkCmdSetAlphaToCoverageEnableEXT vkCmdSetAlphaToCoverageEnableEXT = nullptr;
+  PFN_vkCmdSetAlphaToOneEnableEXT      vkCmdSetAlphaToOneEnableEXT      = nullptr;
+  PFN_vkCmdSetLogicOpEnableEXT         vkCmdSetLogicOpEnableEXT         = nullptr;
+  PFN_vkCmdSetDepthClampEnableEXT      vkCmdSetDepthClampEnableEXT      = nullptr;
+#endif
+
+#if defined(VK_EXT_vertex_input_dynamic_state)
+  PFN_vkCmdSetVertexInputEXT vkCmdSetVertexInputEXT = nullptr;
+#endif
+
+#if defined(VK_EXT_shader_object)
+  PFN_vkCreateShadersEXT       vkCreateShadersEXT       = nullptr;
+  PFN_vkDestroyShaderEXT       vkDestroyShaderEXT       = nullptr;
+  PFN_vkGetShaderBinaryDataEXT vkGetShaderBinaryDataEXT = nullptr;
+  PFN_vkCmdBindShadersEXT      vkCmdBindShadersEXT      = nullptr;
+#endif
+
+#if defined(VK_EXT_descriptor_buffer)
+  PFN_vkGetDescriptorSetLayoutSizeEXT          vkGetDescriptorSetLayoutSizeEXT          = nullptr;
+  PFN_vkGetDescriptorSetLayoutBindingOffsetEXT vkGetDescriptorSetLayoutBindingOffsetEXT = nullptr;
+  PFN_vkGetDescriptorEXT                       vkGetDescriptorEXT                       = nullptr;
+  PFN_vkCmdBindDescriptorBuffersEXT            vkCmdBindDescriptorBuffersEXT            = nullptr;
+  PFN_vkCmdSetDescriptorBufferOffsetsEXT       vkCmdSetDescriptorBufferOffsetsEXT       = nullptr;
+#endif
+
+#if defined(VK_KHR_acceleration_structure)
+  PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR = nullptr;
+#endif
+
+#if defined(VK_EXT_calibrated_timestamps)
+  PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT vkGetPhysicalDeviceCalibrateableTimeDomainsEXT = nullptr;
+  PFN_vkGetCalibratedTimestampsEXT                   vkGetCalibratedTimestampsEXT                   = nullptr;
+#endif
+
+  template<typename T>
+  static void loadDeviceFunction(VkDevice a_device, const char* a_name, T &a_func)
+  {
+    a_func = reinterpret_cast<T>(vkGetDeviceProcAddr(a_device, a_name));
+  }
+
+  // a_coreName is tried if the extension function is not available (extension promoted to core)
+  template<typename T>
+  static void loadDeviceFunction(VkDevice a_device, const char* a_name, const char* a_coreName, T &a_func)
+  {
+    loadDeviceFunction(a_device, a_name, a_func);
+    if(a_func == nullptr)
+      loadDeviceFunction(a_device, a_coreName, a_func);
+  }
+
+  template<typename T>
+  static void loadInstanceFunction(VkInstance a_instance, const char* a_name, T &a_func)
+  {
+    if(a_instance != VK_NULL_HANDLE)
+      a_func = reinterpret_cast<T>(vkGetInstanceProcAddr(a_instance, a_name));
+  }
+
+  void loadExtensionFunctions(VkDevice a_device, VkInstance a_instance)
+  {
+#if defined(VK_KHR_push_descriptor)
+    loadDeviceFunction(a_device, "vkCmdPushDescriptorSetKHR", vkCmdPushDescriptorSetKHR);
+#endif
+
+#if defined(VK_KHR_dynamic_rendering)
+    loadDeviceFunction(a_device, "vkCmdBeginRenderingKHR", "vkCmdBeginRendering", vkCmdBeginRenderingKHR);
+    loadDeviceFunction(a_device, "vkCmdEndRenderingKHR",   "vkCmdEndRendering",   vkCmdEndRenderingKHR);
+#endif
+
+    // extended dynamic state 1 and 2 are core in Vulkan 1.3, the core names are taken if extensions are not enabled
+#if defined(VK_EXT_extended_dynamic_state)
+    loadDeviceFunction(a_device, "vkCmdSetCullModeEXT",              "vkCmdSetCullMode",              vkCmdSetCullModeEXT);
+    loadDeviceFunction(a_device, "vkCmdSetFrontFaceEXT",             "vkCmdSetFrontFace",             vkCmdSetFrontFaceEXT);
+    loadDeviceFunction(a_device, "vkCmdSetPrimitiveTopologyEXT",     "vkCmdSetPrimitiveTopology",     vkCmdSetPrimitiveTopologyEXT);
+    loadDeviceFunction(a_device, "vkCmdSetDepthTestEnableEXT",       "vkCmdSetDepthTestEnable",       vkCmdSetDepthTestEnableEXT);
+    loadDeviceFunction(a_device, "vkCmdSetDepthWriteEnableEXT",      "vkCmdSetDepthWriteEnable",      vkCmdSetDepthWriteEnableEXT);
+    loadDeviceFunction(a_device, "vkCmdSetDepthCompareOpEXT",        "vkCmdSetDepthCompareOp",        vkCmdSetDepthCompareOpEXT);
+    loadDeviceFunction(a_device, "vkCmdSetStencilTestEnableEXT",     "vkCmdSetStencilTestEnable",     vkCmdSetStencilTestEnableEXT);
+    loadDeviceFunction(a_device, "vkCmdSetViewportWithCountEXT",     "vkCmdSetViewportWithCount",     vkCmdSetViewportWithCountEXT);
+    loadDeviceFunction(a_device, "vkCmdSetScissorWithCountEXT",      "vkCmdSetScissorWithCount",      vkCmdSetScissorWithCountEXT);
+    loadDeviceFunction(a_device, "vkCmdSetDepthBoundsTestEnableEXT", "vkCmdSetDepthBoundsTestEnable", vkCmdSetDepthBoundsTestEnableEXT);
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state2)
+    loadDeviceFunction(a_device, "vkCmdSetRasterizerDiscardEnableEXT", "vkCmdSetRasterizerDiscardEnable", vkCmdSetRasterizerDiscardEnableEXT);
+    loadDeviceFunction(a_device, "vkCmdSetDepthBiasEnableEXT",         "vkCmdSetDepthBiasEnable",         vkCmdSetDepthBiasEnableEXT);
+    loadDeviceFunction(a_device, "vkCmdSetPrimitiveRestartEnableEXT",  "vkCmdSetPrimitiveRestartEnable",  vkCmdSetPrimitiveRestartEnableEXT);
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state3)
+    loadDeviceFunction(a_device, "vkCmdSetPolygonModeEXT",           vkCmdSetPolygonModeEXT);
+    loadDeviceFunction(a_device, "vkCmdSetColorBlendEnableEXT",      vkCmdSetColorBlendEnableEXT);
+    loadDeviceFunction(a_device, "vkCmdSetColorBlendEquationEXT",    vkCmdSetColorBlendEquationEXT);
+    loadDeviceFunction(a_device, "vkCmdSetColorWriteMaskEXT",        vkCmdSetColorWriteMaskEXT);
+    loadDeviceFunction(a_device, "vkCmdSetRasterizationSamplesEXT",  vkCmdSetRasterizationSamplesEXT);
+    loadDeviceFunction(a_device, "vkCmdSetSampleMaskEXT",            vkCmdSetSampleMaskEXT);
+    loadDeviceFunction(a_device, "vkCmdSetAlphaToCoverageEnableEXT", vkCmdSetAlphaToCoverageEnableEXT);
+    loadDeviceFunction(a_device, "vkCmdSetAlphaToOneEnableEXT",      vkCmdSetAlphaToOneEnableEXT);
+    loadDeviceFunction(a_device, "vkCmdSetLogicOpEnableEXT",         vkCmdSetLogicOpEnableEXT);
+    loadDeviceFunction(a_device, "vkCmdSetDepthClampEnableEXT",      vkCmdSetDepthClampEnableEXT);
+#endif
+
+#if defined(VK_EXT_vertex_input_dynamic_state)
+    loadDeviceFunction(a_device, "vkCmdSetVertexInputEXT", vkCmdSetVertexInputEXT);
+#endif
+
+#if defined(VK_EXT_shader_object)
+    loadDeviceFunction(a_device, "vkCreateShadersEXT",       vkCreateShadersEXT);
+    loadDeviceFunction(a_device, "vkDestroyShaderEXT",       vkDestroyShaderEXT);
+    loadDeviceFunction(a_device, "vkGetShaderBinaryDataEXT", vkGetShaderBinaryDataEXT);
+    loadDeviceFunction(a_device, "vkCmdBindShadersEXT",      vkCmdBindShadersEXT);
+#endif
+
+#if defined(VK_EXT_descriptor_buffer)
+    loadDeviceFunction(a_device, "vkGetDescriptorSetLayoutSizeEXT",          vkGetDescriptorSetLayoutSizeEXT);
+    loadDeviceFunction(a_device, "vkGetDescriptorSetLayoutBindingOffsetEXT", vkGetDescriptorSetLayoutBindingOffsetEXT);
+    loadDeviceFunction(a_device, "vkGetDescriptorEXT",                       vkGetDescriptorEXT);
+    loadDeviceFunction(a_device, "vkCmdBindDescriptorBuffersEXT",            vkCmdBindDescriptorBuffersEXT);
+    loadDeviceFunction(a_device, "vkCmdSetDescriptorBufferOffsetsEXT",       vkCmdSetDescriptorBufferOffsetsEXT);
+#endif
+
+#if defined(VK_KHR_acceleration_structure)
+    loadDeviceFunction(a_device, "vkGetAccelerationStructureDeviceAddressKHR", vkGetAccelerationStructureDeviceAddressKHR);
+#endif
+
+#if defined(VK_EXT_calibrated_timestamps)
+    loadInstanceFunction(a_instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT", vkGetPhysicalDeviceCalibrateableTimeDomainsEXT);
+    loadDeviceFunction(a_device,     "vkGetCalibratedTimestampsEXT",                   vkGetCalibratedTimestampsEXT);
+#endif
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef VK_UTILS_EXT_FUNCS_H
+#define VK_UTILS_EXT_FUNCS_H
+
+#include "vk_include.h"
+
+namespace vk_utils
+{
+  // Entry points of device extensions used by the library, the Vulkan loader doesn't export them.
+  // They live in vk_utils namespace under the names of Vulkan functions, so library code calls them as usual and they
+  // don't clash with prototypes or volk globals. globalContextInit loads them, call loadExtensionFunctions yourself
+  // for devices created elsewhere; functions of extensions which are not enabled stay null.
+  //
+#if defined(VK_KHR_push_descriptor)
+  extern PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR;
+#endif
+
+#if defined(VK_KHR_dynamic_rendering)
+  extern PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR; // core vkCmdBeginRendering if only the Vulkan 1.3 feature is enabled
+  extern PFN_vkCmdEndRenderingKHR   vkCmdEndRenderingKHR;
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state)
+  extern PFN_vkCmdSetCullModeEXT              vkCmdSetCullModeEXT;
+  extern PFN_vkCmdSetFrontFaceEXT             vkCmdSetFrontFaceEXT;
+  extern PFN_vkCmdSetPrimitiveTopologyEXT     vkCmdSetPrimitiveTopologyEXT;
+  extern PFN_vkCmdSetDepthTestEnableEXT       vkCmdSetDepthTestEnableEXT;
+  extern PFN_vkCmdSetDepthWriteEnableEXT      vkCmdSetDepthWriteEnableEXT;
+  extern PFN_vkCmdSetDepthCompareOpEXT        vkCmdSetDepthCompareOpEXT;
+  extern PFN_vkCmdSetStencilTestEnableEXT     vkCmdSetStencilTestEnableEXT;
+  extern PFN_vkCmdSetViewportWithCountEXT     vkCmdSetViewportWithCountEXT;
+  extern PFN_vkCmdSetScissorWithCountEXT      vkCmdSetScissorWithCountEXT;
+  extern PFN_vkCmdSetDepthBoundsTestEnableEXT vkCmdSetDepthBoundsTestEnableEXT;
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state2)
+  extern PFN_vkCmdSetRasterizerDiscardEnableEXT vkCmdSetRasterizerDiscardEnableEXT;
+  extern PFN_vkCmdSetDepthBiasEnableEXT         vkCmdSetDepthBiasEnableEXT;
+  extern PFN_vkCmdSetPrimitiveRestartEnableEXT  vkCmdSetPrimitiveRestartEnableEXT;
+#endif
+
+#if defined(VK_EXT_extended_dynamic_state3)
+  extern PFN_vkCmdSetPolygonModeEXT           vkCmdSetPolygonModeEXT;
+  extern PFN_vkCmdSetColorBlendEnableEXT      vkCmdSetColorBlendEnableEXT;
+  extern PFN_vkCmdSetColorBlendEquationEXT    vkCmdSetColorBlendEquationEXT;
+  extern PFN_vkCmdSetColorWriteMaskEXT        vkCmdSetColorWriteMaskEXT;
+  extern PFN_vkCmdSetRasterizationSamplesEXT  vkCmdSetRasterizationSamplesEXT;
+  extern PFN_vkCmdSetSampleMaskEXT            vkCmdSetSampleMaskEXT;
+  extern PFN_vkCmdSetAlphaToCoverageEnableEXT vkCmdSetAlphaToCoverageEnableEXT;
+  extern PFN_vkCmdSetAlphaToOneEnableEXT      vkCmdSetAlphaToOneEnableEXT;
+  extern PFN_vkCmdSetLogicOpEnableEXT         vkCmdSetLogicOpEnableEXT;
+  extern PFN_vkCmdSetDepthClampEnableEXT      vkCmdSetDepthClampEnableEXT;
+#endif
+
+#if defined(VK_EXT_vertex_input_dynamic_state)
+  extern PFN_vkCmdSetVertexInputEXT vkCmdSetVertexInputEXT;
+#endif
+
+#if defined(VK_EXT_shader_object)
+  extern PFN_vkCreateShadersEXT       vkCreateShadersEXT;
+  extern PFN_vkDestroyShaderEXT       vkDestroyShaderEXT;
+  extern PFN_vkGetShaderBinaryDataEXT vkGetShaderBinaryDataEXT;
+  extern PFN_vkCmdBindShadersEXT      vkCmdBindShadersEXT;
+#endif
+
+#if defined(VK_EXT_descriptor_buffer)
+  extern PFN_vkGetDescriptorSetLayoutSizeEXT          vkGetDescriptorSetLayoutSizeEXT;
+  extern PFN_vkGetDescriptorSetLayoutBindingOffsetEXT vkGetDescriptorSetLayoutBindingOffsetEXT;
+  extern PFN_vkGetDescriptorEXT                       vkGetDescriptorEXT;
+  extern PFN_vkCmdBindDescriptorBuffersEXT            vkCmdBindDescriptorBuffersEXT;
+  extern PFN_vkCmdSetDescriptorBufferOffsetsEXT       vkCmdSetDescriptorBufferOffsetsEXT;
+#endif
+
+#if defined(VK_KHR_acceleration_structure)
+  extern PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR;
+#endif
+
+#if defined(VK_EXT_calibrated_timestamps)
+  extern PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT vkGetPhysicalDeviceCalibrateableTimeDomainsEXT; // instance level
+  extern PFN_vkGetCalibratedTimestampsEXT                   vkGetCalibratedTimestampsEXT;
+#endif
+
+  // instance level functions are loaded only with a_instance
+  void loadExtensionFunctions(VkDevice a_device, VkInstance a_instance = VK_NULL_HANDLE);
+}
+
+#endif// VK_UTILS_EXT_FUNCS_H
@@ -1,5 +1,6 @@
 #include <cassert>
 #include <array>
+#include <algorithm>
 #include "vk_fbuf_attachment.h"
 #include "vk_utils.h"
 #include "vk_images.h"
@@ -23,12 +24,39 @@ namespace vk_utils
       vkDestroyFramebuffer(m_device, fbuf, nullptr);
     }
 
+    for (auto &mem : m_ownedMemory)
+    {
+      vkFreeMemory(m_device, mem, nullptr);
+    }
   }
 
   uint32_t RenderTarget::CreateAttachment(const AttachmentInfo &a_info)
   {
     FbufAttachment attachment;
-    attachment.format = a_info.format;
+    attachment.format    = a_info.format;
+    attachment.firstPass = a_info.firstPass;
+    attachment.lastPass  = a_info.lastPass;
+    attachment.transient = a_info.transient;
+
+    assert(a_info.firstPass <= a_info.lastPass);
+
+    VkImageUsageFlags usage = a_info.usage;
+    if (a_info.transient)
+    {
+      const VkImageUsageFlags allowedTransient = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                                 VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+      if (usage & ~allowedTransient)
+      {
+        VK_UTILS_LOG_WARNING("[RenderTarget::CreateAttachment] transient attachment can't have usage other than "
+                             "color, depth/stencil or input attachment, creating it as non-transient");
+        attachment.transient = false;
+      }
+      else
+      {
+        usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      }
+    }
 
     VkImageAspectFlags aspectMask = 0;
 
@@ -62,7 +90,7 @@ namespace vk_utils
     imageInfo.format = a_info.format;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = a_info.usage;
+    imageInfo.usage = usage;
     imageInfo.samples = a_info.imageSampleCount;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -79,14 +107,23 @@ namespace vk_utils
     attachment.description = {};
     attachment.description.samples = a_info.imageSampleCount;
     attachment.description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachment.description.storeOp = (a_info.usage & VK_IMAGE_USAGE_SAMPLED_BIT) ? VK_ATTACHMENT_STORE_OP_STORE
-                                                                                 : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.description.storeOp = (!attachment.transient && (a_info.usage & VK_IMAGE_USAGE_SAMPLED_BIT)) ?
+                                     VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachment.description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachment.description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachment.description.format = a_info.format;
     attachment.description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     attachment.description.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
+    // SHADER_READ_ONLY_OPTIMAL needs sampled or input attachment usage, transient attachments are never read after the pass
+    //
+    if (attachment.transient || !(usage & (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT)))
+    {
+      attachment.description.finalLayout = vk_utils::isDepthOrStencil(a_info.format) ?
+                                           VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL :
+                                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
     if (!vk_utils::isDepthFormat(a_info.format) && !vk_utils::isStencilFormat(a_info.format))
     {
       m_numColorAttachments++;
@@ -99,22 +136,178 @@ namespace vk_utils
 
   void RenderTarget::CreateViewAndBindMemory(VkDeviceMemory a_mem, const std::vector <VkDeviceSize> &a_offsets)
   {
-    assert(a_offsets.size() <= m_attachments.size());
+    assert(a_offsets.size() >= m_attachments.size());
+    for (size_t i = 0; i < m_attachments.size(); ++i)
+    {
+      BindAndCreateView(i, a_mem, a_offsets[i]);
+    }
+    MarkAliasedAttachments();
+  }
+
+  void RenderTarget::BindAndCreateView(size_t a_idx, VkDeviceMemory a_mem, VkDeviceSize a_offset)
+  {
+    auto &attachment = m_attachments[a_idx];
+    VK_CHECK_RESULT(vkBindImageMemory(m_device, attachment.image, a_mem, a_offset));
+    attachment.mem = a_mem;
+    attachment.mem_offset = a_offset;
+
+    VkImageViewCreateInfo imageView{};
+    imageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageView.viewType = (attachment.layerCount == 1) ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    imageView.format = attachment.description.format;
+    imageView.subresourceRange = attachment.subresourceRange;
+
+    imageView.image = attachment.image;
+    VK_CHECK_RESULT(vkCreateImageView(m_device, &imageView, nullptr, &attachment.view));
+  }
+
+  uint32_t RenderTarget::GetSubpassCount() const
+  {
+    uint32_t count = 1;
+    for (const auto &attachment : m_attachments)
+    {
+      const uint32_t last = (attachment.lastPass != UINT32_MAX) ? attachment.lastPass : attachment.firstPass;
+      count = std::max(count, last + 1);
+    }
+    return count;
+  }
+
+  void RenderTarget::AttachmentLifetime(uint32_t a_idx, uint32_t &a_first, uint32_t &a_last) const
+  {
+    // subpasses which reference the attachment in CreateRenderPass; a stored attachment is read after the render pass,
+    // so it can't give its memory to attachments of later subpasses
+    //
+    const auto &attachment = m_attachments[a_idx];
+    const uint32_t lastSubpass = GetSubpassCount() - 1;
+    a_first = std::min(attachment.firstPass, lastSubpass);
+    a_last  = std::min(attachment.lastPass, lastSubpass);
+    if (attachment.description.storeOp == VK_ATTACHMENT_STORE_OP_STORE)
+      a_last = lastSubpass;
+  }
+
+  void RenderTarget::MarkAliasedAttachments()
+  {
+    for (auto &attachment : m_attachments)
+      attachment.description.flags &= ~VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT;
+
     for (size_t i = 0; i < m_attachments.size(); ++i)
     {
-      VK_CHECK_RESULT(vkBindImageMemory(m_device, m_attachments[i].image, a_mem, a_offsets[i]));
-      m_attachments[i].mem = a_mem;
-      m_attachments[i].mem_offset = a_offsets[i];
-
-      VkImageViewCreateInfo imageView{};
-      imageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-      imageView.viewType = (m_attachments[i].layerCount == 1) ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-      imageView.format = m_attachments[i].description.format;
-      imageView.subresourceRange = m_attachments[i].subresourceRange;
-
-      imageView.image = m_attachments[i].image;
-      VK_CHECK_RESULT(vkCreateImageView(m_device, &imageView, nullptr, &m_attachments[i].view));
+      auto &a = m_attachments[i];
+      for (size_t j = i + 1; j < m_attachments.size(); ++j)
+      {
+        auto &b = m_attachments[j];
+        if (a.mem != b.mem || a.mem_offset + a.mem_req.size <= b.mem_offset || b.mem_offset + b.mem_req.size <= a.mem_offset)
+          continue;
+        a.description.flags |= VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT;
+        b.description.flags |= VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT;
+      }
+    }
+  }
+
+  VkDeviceSize RenderTarget::CalculateAliasedOffsets(const std::vector<uint32_t> &a_ids, VkDeviceSize a_bufferImageGranularity,
+                                                     std::vector <VkDeviceSize> &a_offsets) const
+  {
+    // greedy first-fit: place largest attachments first, each one goes to the lowest offset
+    // which doesn't intersect any already placed attachment with overlapping subpass lifetime
+    //
+    std::vector<uint32_t> firstSubpass(m_attachments.size()), lastSubpass(m_attachments.size());
+    for (auto id : a_ids)
+      AttachmentLifetime(id, firstSubpass[id], lastSubpass[id]);
+
+    std::vector<uint32_t> order = a_ids;
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+      return m_attachments[a].mem_req.size > m_attachments[b].mem_req.size;
+    });
+
+    std::vector<uint32_t> placed;
+    placed.reserve(order.size());
+    VkDeviceSize total = 0;
+    for (auto id : order)
+    {
+      const auto &cur = m_attachments[id];
+      std::vector<uint32_t> live;
+      for (auto other : placed)
+      {
+        if (!(lastSubpass[other] < firstSubpass[id] || lastSubpass[id] < firstSubpass[other]))
+          live.push_back(other);
+      }
+      std::sort(live.begin(), live.end(), [&a_offsets](uint32_t a, uint32_t b) { return a_offsets[a] < a_offsets[b]; });
+
+      const VkDeviceSize alignment = std::max<VkDeviceSize>(cur.mem_req.alignment, a_bufferImageGranularity);
+      VkDeviceSize offset = 0;
+      for (auto other : live)
+      {
+        if (offset + cur.mem_req.size <= a_offsets[other])
+          break;
+        offset = std::max<VkDeviceSize>(offset, getPaddedSize(a_offsets[other] + m_attachments[other].mem_req.size, alignment));
+      }
+
+      a_offsets[id] = offset;
+      placed.push_back(id);
+      total = std::max<VkDeviceSize>(total, offset + cur.mem_req.size);
+    }
+
+    return total;
+  }
+
+  std::vector <VkDeviceSize> RenderTarget::CalculateAliasedOffsets(VkDeviceSize a_bufferImageGranularity) const
+  {
+    std::vector<uint32_t> ids(m_attachments.size());
+    for (uint32_t i = 0; i < ids.size(); ++i)
+      ids[i] = i;
+
+    std::vector <VkDeviceSize> offsets(m_attachments.size() + 1, 0);
+    offsets.back() = CalculateAliasedOffsets(ids, a_bufferImageGranularity, offsets);
+
+    return offsets;
+  }
+
+  VkResult RenderTarget::AllocateAndBindAliased(VkPhysicalDevice a_physDevice)
+  {
+    // transient and persistent attachments may end up in different memory types, so they get separate blocks
+    //
+    std::array<std::vector<uint32_t>, 2> groups;
+    for (uint32_t i = 0; i < m_attachments.size(); ++i)
+      groups[m_attachments[i].transient ? 1 : 0].push_back(i);
+
+    std::vector <VkDeviceSize> offsets(m_attachments.size(), 0);
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+      if (groups[g].empty())
+        continue;
+
+      uint32_t typeBits = UINT32_MAX;
+      for (auto id : groups[g])
+        typeBits &= m_attachments[id].mem_req.memoryTypeBits;
+
+      uint32_t memTypeIdx = UINT32_MAX;
+      if (g == 1)
+        memTypeIdx = findMemoryType(typeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, a_physDevice);
+      if (memTypeIdx == UINT32_MAX)
+        memTypeIdx = findMemoryType(typeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, a_physDevice);
+      if (memTypeIdx == UINT32_MAX)
+      {
+        VK_UTILS_LOG_ERROR("[RenderTarget::AllocateAndBindAliased] no suitable memory type for attachments");
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+      }
+
+      VkMemoryAllocateInfo allocateInfo = {};
+      allocateInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocateInfo.allocationSize  = CalculateAliasedOffsets(groups[g], 0, offsets);
+      allocateInfo.memoryTypeIndex = memTypeIdx;
+
+      VkDeviceMemory mem = VK_NULL_HANDLE;
+      VkResult res = vkAllocateMemory(m_device, &allocateInfo, nullptr, &mem);
+      if (res != VK_SUCCESS)
+        return res;
+      m_ownedMemory.push_back(mem);
+
+      for (auto id : groups[g])
+        BindAndCreateView(id, mem, offsets[id]);
     }
+    MarkAliasedAttachments();
+
+    return VK_SUCCESS;
   }
 
   VkResult RenderTarget::CreateDefaultSampler()
@@ -135,48 +328,68 @@ namespace vk_utils
     return vkCreateSampler(m_device, &samplerInfo, nullptr, &m_sampler);
   }
 
-  VkResult RenderTarget::CreateDefaultRenderPass()
+  VkRenderPass RenderTarget::CreateRenderPass(const VkAttachmentDescription *a_swapchainOut) const
   {
     std::vector <VkAttachmentDescription> attachmentDescriptions;
     for (auto &attachment : m_attachments)
     {
       attachmentDescriptions.push_back(attachment.description);
     };
+    if (a_swapchainOut != nullptr)
+    {
+      attachmentDescriptions.push_back(*a_swapchainOut);
+    }
 
-    std::vector <VkAttachmentReference> colorReferences;
-    VkAttachmentReference depthReference = {};
+    // one subpass per pass of attachment lifetimes, so attachments which alias each other are never used together;
+    // color attachments keep their location in every subpass and are VK_ATTACHMENT_UNUSED outside of their lifetime
+    //
+    const uint32_t subpassCount = GetSubpassCount();
+    std::vector <std::vector<VkAttachmentReference>> colorReferences(subpassCount);
+    std::vector <VkAttachmentReference> depthReferences(subpassCount, {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED});
+    std::vector <VkSubpassDescription> subpasses(subpassCount);
 
     bool hasDepth = false;
-    bool hasColor = false;
+    bool hasColor = (a_swapchainOut != nullptr);
     for (uint32_t i = 0; i < m_attachments.size(); ++i)
     {
+      uint32_t first = 0, last = 0;
+      AttachmentLifetime(i, first, last);
       if (vk_utils::isDepthOrStencil(m_attachments[i].format))
       {
         assert(!hasDepth);
-        depthReference.attachment = i;
-        depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        for (uint32_t s = first; s <= last; ++s)
+          depthReferences[s] = {i, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
         hasDepth = true;
       }
       else
       {
-        colorReferences.push_back({i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+        for (uint32_t s = 0; s < subpassCount; ++s)
+          colorReferences[s].push_back({(first <= s && s <= last) ? i : VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
         hasColor = true;
       }
     }
 
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    if (hasColor)
+    for (uint32_t s = 0; s < subpassCount; ++s)
     {
-      subpass.pColorAttachments = colorReferences.data();
-      subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
-    }
-    if (hasDepth)
-    {
-      subpass.pDepthStencilAttachment = &depthReference;
+      if (a_swapchainOut != nullptr)
+      {
+        colorReferences[s].push_back({static_cast<uint32_t>(m_attachments.size()), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+      }
+
+      VkSubpassDescription &subpass = subpasses[s];
+      subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+      if (hasColor)
+      {
+        subpass.pColorAttachments = colorReferences[s].data();
+        subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences[s].size());
+      }
+      if (depthReferences[s].attachment != VK_ATTACHMENT_UNUSED)
+      {
+        subpass.pDepthStencilAttachment = &depthReferences[s];
+      }
     }
 
-    std::array<VkSubpassDependency, 2> dependencies{};
+    std::vector<VkSubpassDependency> dependencies(subpassCount + 1);
 
     dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
     dependencies[0].dstSubpass = 0;
@@ -188,25 +401,52 @@ namespace vk_utils
     dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
-    dependencies[1].srcSubpass = 0;
-    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    // attachments starting in the next subpass may reuse memory written in this one
+    //
+    for (uint32_t s = 0; s + 1 < subpassCount; ++s)
+    {
+      VkSubpassDependency &dependency = dependencies[s + 1];
+      dependency.srcSubpass = s;
+      dependency.dstSubpass = s + 1;
+      dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+      dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+      dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    }
+
+    dependencies[subpassCount].srcSubpass = subpassCount - 1;
+    dependencies[subpassCount].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[subpassCount].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[subpassCount].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[subpassCount].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[subpassCount].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    dependencies[subpassCount].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.pAttachments = attachmentDescriptions.data();
     renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.subpassCount = subpassCount;
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
     renderPassInfo.pDependencies = dependencies.data();
-    VK_CHECK_RESULT(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass));
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &renderPass));
+    return renderPass;
+  }
+
+  VkResult RenderTarget::CreateDefaultRenderPass()
+  {
+    m_renderPass = CreateRenderPass(nullptr);
 
     std::vector <VkImageView> attachmentViews;
     for (auto attachment : m_attachments)
@@ -259,105 +499,150 @@ namespace vk_utils
     return renderPassInfo;
   }
 
-  std::vector <VkMemoryRequirements> RenderTarget::GetMemoryRequirements() const
+  std::vector <VkFormat> RenderTarget::GetColorFormats() const
   {
-    std::vector <VkMemoryRequirements> result;
-    for (size_t i = 0; i < m_attachments.size(); ++i)
+    std::vector <VkFormat> formats;
+    for (const auto &attachment : m_attachments)
     {
-      result.push_back(m_attachments[i].mem_req);
+      if (!vk_utils::isDepthFormat(attachment.format) && !vk_utils::isStencilFormat(attachment.format))
+        formats.push_back(attachment.format);
     }
-
-    return result;
+    return formats;
   }
 
-  VkResult RenderTarget::CreateRenderPassWithSwapchainOut(VkFormat a_swapChainFormat,
-                                                          const std::vector <VkImageView> &a_swapChainImageViews)
+  VkFormat RenderTarget::GetDepthFormat() const
   {
-    std::vector <VkAttachmentDescription> attachmentDescriptions;
-    for (auto &attachment : m_attachments)
+    for (const auto &attachment : m_attachments)
     {
-      attachmentDescriptions.push_back(attachment.description);
-    };
+      if (vk_utils::isDepthFormat(attachment.format))
+        return attachment.format;
+    }
+    return VK_FORMAT_UNDEFINED;
+  }
 
-    VkAttachmentDescription colorAttachment = {};
-    colorAttachment.format = a_swapChainFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  VkFormat RenderTarget::GetStencilFormat() const
+  {
+    for (const auto &attachment : m_attachments)
+    {
+      if (vk_utils::isStencilFormat(attachment.format))
+        return attachment.format;
+    }
+    return VK_FORMAT_UNDEFINED;
+  }
 
-    attachmentDescriptions.push_back(colorAttachment);
+#if defined(VK_KHR_dynamic_rendering)
+  void RenderTarget::BeginRendering(VkCommandBuffer a_cmdBuff, const std::vector <VkClearValue> &a_clearValues,
+                                    VkOffset2D a_renderOffset, uint32_t a_viewMask, uint32_t a_pass) const
+  {
+    if (a_clearValues.size() != m_attachments.size())
+    {
+      VK_UTILS_LOG_WARNING("[RenderTarget::BeginRendering] clear values size doesn't match attachment count");
+    }
 
-    std::vector <VkAttachmentReference> colorReferences;
-    VkAttachmentReference depthReference = {};
+    std::vector <VkRenderingAttachmentInfoKHR> colorAttachments;
+    VkRenderingAttachmentInfoKHR depthAttachment{};
+    VkRenderingAttachmentInfoKHR stencilAttachment{};
+    bool hasDepth   = false;
+    bool hasStencil = false;
+    uint32_t layerCount = UINT32_MAX;
+    bool aliased = false;
 
-    bool hasDepth = false;
-    bool hasColor = false;
-    for (uint32_t i = 0; i < m_attachments.size(); ++i)
+    for (size_t i = 0; i < m_attachments.size(); ++i)
     {
-      if (vk_utils::isDepthOrStencil(m_attachments[i].format))
+      const auto &attachment = m_attachments[i];
+      VkClearValue clearValue = (i < a_clearValues.size()) ? a_clearValues[i] : VkClearValue{};
+
+      uint32_t first = 0, last = 0;
+      AttachmentLifetime(uint32_t(i), first, last);
+      const bool alive = (a_pass == UINT32_MAX) || (first <= a_pass && a_pass <= last);
+      aliased = aliased || (attachment.description.flags & VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT) != 0;
+
+      bool depth   = vk_utils::isDepthFormat(attachment.format);
+      bool stencil = vk_utils::isStencilFormat(attachment.format);
+      if (!alive)
       {
-        assert(!hasDepth);
-        depthReference.attachment = i;
-        depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        if (!depth && !stencil)
+          colorAttachments.push_back(vk_utils::renderingAttachment(VK_NULL_HANDLE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                                   VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                                                   VK_ATTACHMENT_STORE_OP_DONT_CARE, clearValue));
+        continue;
+      }
+      layerCount = std::min(layerCount, attachment.layerCount);
+
+      // the description's ops apply only at the ends of the lifetime, contents are kept between passes in between
+      //
+      const bool keepIn  = (a_pass != UINT32_MAX) && a_pass > first;
+      const bool keepOut = (a_pass != UINT32_MAX) && a_pass < last;
+      const VkAttachmentLoadOp  loadOp         = keepIn  ? VK_ATTACHMENT_LOAD_OP_LOAD   : attachment.description.loadOp;
+      const VkAttachmentStoreOp storeOp        = keepOut ? VK_ATTACHMENT_STORE_OP_STORE : attachment.description.storeOp;
+      const VkAttachmentLoadOp  stencilLoadOp  = keepIn  ? VK_ATTACHMENT_LOAD_OP_LOAD   : attachment.description.stencilLoadOp;
+      const VkAttachmentStoreOp stencilStoreOp = keepOut ? VK_ATTACHMENT_STORE_OP_STORE : attachment.description.stencilStoreOp;
+
+      if (!depth && !stencil)
+      {
+        colorAttachments.push_back(vk_utils::renderingAttachment(attachment.view, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                                 loadOp, storeOp, clearValue));
+        continue;
+      }
+      if (depth)
+      {
+        depthAttachment = vk_utils::renderingAttachment(attachment.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                                        loadOp, storeOp, clearValue);
         hasDepth = true;
       }
-      else
+      if (stencil)
       {
-        colorReferences.push_back({i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
-        hasColor = true;
+        stencilAttachment = vk_utils::renderingAttachment(attachment.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                                          stencilLoadOp, stencilStoreOp, clearValue);
+        hasStencil = true;
       }
     }
 
-    colorReferences.push_back({static_cast<uint32_t>(m_attachments.size()), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
-
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    if (hasColor)
-    {
-      subpass.pColorAttachments = colorReferences.data();
-      subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
-    }
-    if (hasDepth)
+    if (a_pass == UINT32_MAX && aliased)
     {
-      subpass.pDepthStencilAttachment = &depthReference;
+      VK_UTILS_LOG_WARNING("[RenderTarget::BeginRendering] attachments share memory, rendering all of them at once corrupts them");
     }
 
-    std::array<VkSubpassDependency, 2> dependencies{};
+    VkRect2D renderArea{};
+    renderArea.offset = a_renderOffset;
+    renderArea.extent = m_resolution;
 
-    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
-    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    vk_utils::beginRendering(a_cmdBuff, renderArea, colorAttachments.data(), (uint32_t)colorAttachments.size(),
+                             hasDepth ? &depthAttachment : nullptr, hasStencil ? &stencilAttachment : nullptr,
+                             (a_viewMask != 0 || layerCount == UINT32_MAX) ? 1 : layerCount, a_viewMask);
+  }
 
-    dependencies[1].srcSubpass = 0;
-    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+  void RenderTarget::EndRendering(VkCommandBuffer a_cmdBuff) const
+  {
+    vk_utils::endRendering(a_cmdBuff);
+  }
+#endif
 
-    VkRenderPassCreateInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.pAttachments = attachmentDescriptions.data();
-    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 2;
-    renderPassInfo.pDependencies = dependencies.data();
-    VK_CHECK_RESULT(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass));
+  std::vector <VkMemoryRequirements> RenderTarget::GetMemoryRequirements() const
+  {
+    std::vector <VkMemoryRequirements> result;
+    for (size_t i = 0; i < m_attachments.size(); ++i)
+    {
+      result.push_back(m_attachments[i].mem_req);
+    }
+
+    return result;
+  }
+
+  VkResult RenderTarget::CreateRenderPassWithSwapchainOut(VkFormat a_swapChainFormat,
+                                                          const std::vector <VkImageView> &a_swapChainImageViews)
+  {
+    VkAttachmentDescription colorAttachment = {};
+    colorAttachment.format = a_swapChainFormat;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+    m_renderPass = CreateRenderPass(&colorAttachment);
 
     uint32_t maxLayers = 0;
     for (auto attachment : m_attachments)
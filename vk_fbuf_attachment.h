@@ -20,6 +20,10 @@ namespace vk_utils
     VkMemoryRequirements mem_req{};
     VkDeviceMemory mem = VK_NULL_HANDLE;
     VkDeviceSize mem_offset = 0;
+
+    uint32_t firstPass = 0;
+    uint32_t lastPass  = UINT32_MAX;
+    bool transient     = false;
   };
 
   struct AttachmentInfo
@@ -28,6 +32,16 @@ namespace vk_utils
     VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT;
     VkSampleCountFlagBits imageSampleCount = VK_SAMPLE_COUNT_1_BIT;
     VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    // lifetime in subpasses (inclusive): render passes made by RenderTarget have one subpass per pass index and reference
+    // the attachment only within its lifetime; stored attachments (sampled later) stay alive up to the last subpass.
+    // Attachments with non-overlapping lifetimes may share memory (see RenderTarget::CalculateAliasedOffsets)
+    uint32_t firstPass = 0;
+    uint32_t lastPass  = UINT32_MAX;
+
+    // attachment is never stored or sampled, i.e. lives only inside the render pass;
+    // created with TRANSIENT_ATTACHMENT usage and placed in LAZILY_ALLOCATED memory if available
+    bool transient = false;
   };
 
   struct RenderTarget
@@ -50,16 +64,53 @@ namespace vk_utils
     uint32_t CreateAttachment(const AttachmentInfo &a_info);
     void CreateViewAndBindMemory(VkDeviceMemory a_mem, const std::vector <VkDeviceSize> &a_offsets);
     VkResult CreateDefaultSampler();
+    // render passes have GetSubpassCount() subpasses, one per pass of attachment lifetimes: the caller records
+    // vkCmdNextSubpass between passes, i.e. GetSubpassCount() - 1 times before vkCmdEndRenderPass
     VkResult CreateDefaultRenderPass();
     VkResult CreateRenderPassWithSwapchainOut(VkFormat a_swapChainFormat, const std::vector <VkImageView> &a_swapChainImageViews);
 
     VkRenderPassBeginInfo GetRenderPassBeginInfo(uint32_t a_fbufIdx, std::vector <VkClearValue> &a_clearValues,
                                                  VkOffset2D a_renderOffset = {0, 0}) const;
 
+    // dynamic rendering (VK_KHR_dynamic_rendering) needs neither render pass nor framebuffers; attachments must be
+    // in COLOR_ATTACHMENT_OPTIMAL or DEPTH_STENCIL_ATTACHMENT_OPTIMAL layouts, transitions are done by the caller
+    //
+    std::vector <VkFormat> GetColorFormats() const;
+    VkFormat GetDepthFormat() const;   // VK_FORMAT_UNDEFINED if there is no depth attachment
+    VkFormat GetStencilFormat() const; // VK_FORMAT_UNDEFINED if there is no stencil attachment
+#if defined(VK_KHR_dynamic_rendering)
+    // a_pass binds only attachments alive in this pass (others are null views, so color locations stay the same);
+    // attachments are loaded if a_pass is after their first pass and stored if it is before their last one,
+    // description ops are used only at the ends of the lifetime. UINT32_MAX binds all of them with description ops,
+    // which is wrong if some of them share memory
+    void BeginRendering(VkCommandBuffer a_cmdBuff, const std::vector <VkClearValue> &a_clearValues,
+                        VkOffset2D a_renderOffset = {0, 0}, uint32_t a_viewMask = 0, uint32_t a_pass = UINT32_MAX) const;
+    void EndRendering(VkCommandBuffer a_cmdBuff) const;
+#endif
+
     std::vector <VkMemoryRequirements> GetMemoryRequirements() const;
 
+    // offsets for CreateViewAndBindMemory where attachments with non-overlapping lifetimes alias each other,
+    // last element is the total memory size (same convention as calculateMemOffsets)
+    std::vector <VkDeviceSize> CalculateAliasedOffsets(VkDeviceSize a_bufferImageGranularity = 0) const;
+
+    // allocates memory owned by render target (separate blocks for persistent and transient attachments),
+    // binds attachments at aliased offsets and creates views
+    VkResult AllocateAndBindAliased(VkPhysicalDevice a_physDevice);
+
+    // number of subpasses in render passes created by this render target, 1 if no attachment has a bounded lifetime
+    uint32_t GetSubpassCount() const;
+
   private:
     uint32_t m_numColorAttachments = 0;
+    std::vector <VkDeviceMemory> m_ownedMemory;
+
+    VkDeviceSize CalculateAliasedOffsets(const std::vector<uint32_t> &a_ids, VkDeviceSize a_bufferImageGranularity,
+                                         std::vector <VkDeviceSize> &a_offsets) const;
+    void BindAndCreateView(size_t a_idx, VkDeviceMemory a_mem, VkDeviceSize a_offset);
+    void AttachmentLifetime(uint32_t a_idx, uint32_t &a_first, uint32_t &a_last) const;
+    void MarkAliasedAttachments();
+    VkRenderPass CreateRenderPass(const VkAttachmentDescription *a_swapchainOut) const;
   };
 }
 #endif //VK_UTILS_FBUF_ATTACHMENT_H
@@ -0,0 +1,393 @@
+#include "vk_kernel_variants.h"
+#include "vk_pipeline_cache.h"
+#include "vk_utils.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace vk_utils
+{
+  ComputeKernelVariants::ComputeKernelVariants(VkDevice a_device, VkPhysicalDevice a_physicalDevice, const std::string &a_shaderPath,
+                                               VkPipelineLayout a_layout, const char* a_mainName) :
+                                               m_device(a_device), m_layout(a_layout), m_mainName(a_mainName),
+                                               m_physicalDevice(a_physicalDevice)
+  {
+    m_subgroupProps       = {};
+    m_subgroupProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 props2 = {};
+    props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props2.pNext = &m_subgroupProps;
+    vkGetPhysicalDeviceProperties2(a_physicalDevice, &props2);
+    m_props = props2.properties;
+    if(m_subgroupProps.subgroupSize == 0)
+      m_subgroupProps.subgroupSize = 1;
+
+    auto code      = vk_utils::readSPVFile(a_shaderPath.c_str());
+    m_shaderModule = vk_utils::createShaderModule(a_device, code);
+
+    // identifies kernel in tuned results file
+    m_codeHash = hashFNV1a(code.data(), code.size() * sizeof(uint32_t));
+  }
+
+  ComputeKernelVariants::~ComputeKernelVariants()
+  {
+    for(auto &[values, pipeline] : m_pipelines)
+      vkDestroyPipeline(m_device, pipeline, nullptr);
+    if(m_shaderModule != VK_NULL_HANDLE)
+      vkDestroyShaderModule(m_device, m_shaderModule, nullptr);
+  }
+
+  uint32_t ComputeKernelVariants::ClampValue(const KernelConstant &a_constant, uint32_t a_value) const
+  {
+    const uint32_t subgroupSize = m_subgroupProps.subgroupSize;
+    switch(a_constant.kind)
+    {
+      case KernelConstantKind::SUBGROUP_SIZE:
+        return subgroupSize;
+
+      case KernelConstantKind::WORKGROUP_SIZE:
+      {
+        if(a_value == 0)
+          a_value = std::max(subgroupSize, 64u);
+        a_value = std::min(a_value, std::min(m_props.limits.maxComputeWorkGroupSize[0], m_props.limits.maxComputeWorkGroupInvocations));
+        if(a_value >= subgroupSize)
+          a_value -= a_value % subgroupSize;
+        return std::max(a_value, 1u);
+      }
+
+      default:
+        return a_value;
+    }
+  }
+
+  void ComputeKernelVariants::Declare(const std::string &a_name, uint32_t a_constantId, uint32_t a_default,
+                                      KernelConstantKind a_kind, std::vector<uint32_t> a_candidates)
+  {
+    if(!m_pipelines.empty())
+    {
+      VK_UTILS_LOG_ERROR("[ComputeKernelVariants::Declare] constant " + a_name + " declared after pipelines were created, ignored");
+      return;
+    }
+
+    KernelConstant constant;
+    constant.name       = a_name;
+    constant.constantId = a_constantId;
+    constant.kind       = a_kind;
+    constant.value      = ClampValue(constant, a_default);
+
+    if(a_kind == KernelConstantKind::WORKGROUP_SIZE && a_candidates.empty())
+    {
+      for(uint32_t subgroups = 1; subgroups <= 8; subgroups *= 2)
+        a_candidates.push_back(m_subgroupProps.subgroupSize * subgroups);
+    }
+    for(uint32_t candidate : a_candidates)
+    {
+      const uint32_t value = ClampValue(constant, candidate);
+      if(std::find(constant.candidates.begin(), constant.candidates.end(), value) == constant.candidates.end())
+        constant.candidates.push_back(value);
+    }
+
+    const int existing = FindConstant(a_name);
+    if(existing >= 0)
+    {
+      m_constants[existing] = constant;
+      m_selected[existing]  = constant.value;
+      return;
+    }
+    m_constants.push_back(constant);
+    m_selected.push_back(constant.value);
+  }
+
+  int ComputeKernelVariants::FindConstant(const std::string &a_name) const
+  {
+    for(size_t i = 0; i < m_constants.size(); ++i)
+    {
+      if(m_constants[i].name == a_name)
+        return int(i);
+    }
+    return -1;
+  }
+
+  void ComputeKernelVariants::Set(const std::string &a_name, uint32_t a_value)
+  {
+    const int index = FindConstant(a_name);
+    if(index < 0)
+    {
+      VK_UTILS_LOG_WARNING("[ComputeKernelVariants::Set] unknown constant " + a_name);
+      return;
+    }
+    m_selected[index] = ClampValue(m_constants[index], a_value);
+  }
+
+  uint32_t ComputeKernelVariants::Get(const std::string &a_name) const
+  {
+    const int index = FindConstant(a_name);
+    return index >= 0 ? m_selected[index] : UINT32_MAX;
+  }
+
+  VkPipeline ComputeKernelVariants::GetPipeline(const std::vector<uint32_t> &a_values)
+  {
+    if(a_values.size() != m_constants.size())
+    {
+      VK_UTILS_LOG_ERROR("[ComputeKernelVariants::GetPipeline] wrong number of constant values");
+      return VK_NULL_HANDLE;
+    }
+
+    auto found = m_pipelines.find(a_values);
+    if(found != m_pipelines.end())
+      return found->second;
+
+    std::vector<VkSpecializationMapEntry> entries(m_constants.size());
+    for(size_t i = 0; i < m_constants.size(); ++i)
+    {
+      entries[i].constantID = m_constants[i].constantId;
+      entries[i].offset     = uint32_t(i * sizeof(uint32_t));
+      entries[i].size       = sizeof(uint32_t);
+    }
+
+    VkSpecializationInfo specInfo = {};
+    specInfo.mapEntryCount = uint32_t(entries.size());
+    specInfo.pMapEntries   = entries.data();
+    specInfo.dataSize      = a_values.size() * sizeof(uint32_t);
+    specInfo.pData         = a_values.data();
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType                     = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage               = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module              = m_shaderModule;
+    pipelineInfo.stage.pName               = m_mainName.c_str();
+    pipelineInfo.stage.pSpecializationInfo = entries.empty() ? nullptr : &specInfo;
+    pipelineInfo.layout                    = m_layout;
+    pipelineInfo.basePipelineHandle        = VK_NULL_HANDLE;
+
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    if(pipelineCacheStore != nullptr)
+    {
+      cache              = pipelineCacheStore->Get();
+      pipelineInfo.pNext = pipelineCacheStore->ChainFeedback(pipelineInfo.pNext);
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateComputePipelines(m_device, cache, 1, &pipelineInfo, nullptr, &pipeline));
+
+    if(pipelineCacheStore != nullptr)
+      pipelineCacheStore->CollectFeedback();
+
+    m_pipelines[a_values] = pipeline;
+    return pipeline;
+  }
+
+  bool ComputeKernelVariants::Autotune(VkQueue a_queue, uint32_t a_queueFamilyIndex, VkCommandPool a_cmdPool, RecordFunc a_record,
+                                       const std::string &a_directory, uint32_t a_repeats)
+  {
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &familyCount, families.data());
+    if(a_queueFamilyIndex >= familyCount || families[a_queueFamilyIndex].timestampValidBits == 0)
+    {
+      VK_UTILS_LOG_WARNING("[ComputeKernelVariants::Autotune] queue family doesn't support timestamps, keeping defaults");
+      return false;
+    }
+    const uint32_t validBits     = families[a_queueFamilyIndex].timestampValidBits;
+    const uint64_t timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1ull);
+
+    // all combinations of candidates
+    //
+    constexpr size_t MAX_VARIANTS = 256;
+    std::vector<std::vector<uint32_t>> tuples = { {} };
+    for(const auto &constant : m_constants)
+    {
+      const std::vector<uint32_t> values = constant.candidates.empty() ? std::vector<uint32_t>{ constant.value } : constant.candidates;
+      std::vector<std::vector<uint32_t>> next;
+      next.reserve(tuples.size() * values.size());
+      for(const auto &tuple : tuples)
+      {
+        for(uint32_t value : values)
+        {
+          next.push_back(tuple);
+          next.back().push_back(value);
+        }
+      }
+      tuples = std::move(next);
+    }
+    if(tuples.size() > MAX_VARIANTS)
+    {
+      VK_UTILS_LOG_WARNING("[ComputeKernelVariants::Autotune] too many combinations, only first " + std::to_string(MAX_VARIANTS) + " are timed");
+      tuples.resize(MAX_VARIANTS);
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &queryPool));
+
+    float bestTime = std::numeric_limits<float>::max();
+    size_t bestIndex = 0;
+    std::vector<bool> createdHere(tuples.size(), false); // losing variants created only for timing are destroyed below
+    for(size_t t = 0; t < tuples.size(); ++t)
+    {
+      createdHere[t] = m_pipelines.find(tuples[t]) == m_pipelines.end();
+      VkPipeline pipeline = GetPipeline(tuples[t]);
+      float minTime = std::numeric_limits<float>::max();
+      for(uint32_t r = 0; r < std::max(a_repeats, 1u); ++r)
+      {
+        // fresh command buffer each time, a_cmdPool may lack VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+        VkCommandBuffer cmdBuff = vk_utils::createCommandBuffer(m_device, a_cmdPool);
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuff, &beginInfo));
+        vkCmdResetQueryPool(cmdBuff, queryPool, 0, 2);
+        vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+        a_record(cmdBuff, pipeline, tuples[t]);
+        vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+        VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuff));
+
+        vk_utils::executeCommandBufferNow(cmdBuff, a_queue, m_device);
+        vkFreeCommandBuffers(m_device, a_cmdPool, 1, &cmdBuff);
+
+        uint64_t timestamps[2] = {};
+        VK_CHECK_RESULT(vkGetQueryPoolResults(m_device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        const uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+        minTime = std::min(minTime, float(double(ticks) * double(m_props.limits.timestampPeriod) * 1e-6));
+      }
+
+      if(minTime < bestTime)
+      {
+        bestTime  = minTime;
+        bestIndex = t;
+      }
+    }
+
+    vkDestroyQueryPool(m_device, queryPool, nullptr);
+
+    // every timing submit was waited, so candidates are not in use anymore; pipelines which existed before may be held by caller
+    //
+    for(size_t t = 0; t < tuples.size(); ++t)
+    {
+      if(t == bestIndex || !createdHere[t])
+        continue;
+      auto found = m_pipelines.find(tuples[t]);
+      vkDestroyPipeline(m_device, found->second, nullptr);
+      m_pipelines.erase(found);
+    }
+
+    m_selected = tuples[bestIndex];
+
+    std::stringstream ss;
+    ss << "[ComputeKernelVariants::Autotune] best of " << tuples.size() << " variants (" << std::fixed << std::setprecision(3)
+       << bestTime << " ms):";
+    for(size_t i = 0; i < m_constants.size(); ++i)
+      ss << " " << m_constants[i].name << "=" << m_selected[i];
+    VK_UTILS_LOG_INFO(ss.str());
+
+    if(!a_directory.empty())
+      SaveTuned(a_directory);
+    return true;
+  }
+
+  std::string ComputeKernelVariants::TunedFilePath(const std::string &a_directory) const
+  {
+    std::stringstream name;
+    name << std::hex << std::setfill('0') << "kernel_variants_" << std::setw(4) << m_props.vendorID << "_"
+         << std::setw(4) << m_props.deviceID << "_" << std::setw(8) << m_props.driverVersion << ".txt";
+    return (std::filesystem::path(a_directory) / name.str()).string();
+  }
+
+  std::string ComputeKernelVariants::TunedKey() const
+  {
+    std::stringstream key;
+    key << std::hex << std::setfill('0') << std::setw(16) << m_codeHash << "_" << m_mainName;
+    for(const auto &constant : m_constants)
+      key << "_" << constant.constantId;
+    return key.str();
+  }
+
+  bool ComputeKernelVariants::LoadTuned(const std::string &a_directory)
+  {
+    std::ifstream file(TunedFilePath(a_directory));
+    if(!file.is_open())
+      return false;
+
+    const std::string key = TunedKey();
+    std::string line;
+    while(std::getline(file, line))
+    {
+      std::istringstream in(line);
+      std::string lineKey;
+      if(!(in >> lineKey) || lineKey != key)
+        continue;
+
+      std::vector<uint32_t> values;
+      uint32_t value = 0;
+      while(in >> value)
+        values.push_back(value);
+      if(values.size() != m_constants.size())
+        return false;
+
+      for(size_t i = 0; i < values.size(); ++i)
+        m_selected[i] = ClampValue(m_constants[i], values[i]);
+      return true;
+    }
+    return false;
+  }
+
+  bool ComputeKernelVariants::SaveTuned(const std::string &a_directory) const
+  {
+    const std::string path = TunedFilePath(a_directory);
+    const std::string key  = TunedKey();
+
+    // keep results of other kernels
+    std::vector<std::string> lines;
+    {
+      std::ifstream file(path);
+      std::string line;
+      while(std::getline(file, line))
+      {
+        if(!line.empty() && line.compare(0, key.size() + 1, key + " ") != 0)
+          lines.push_back(line);
+      }
+    }
+
+    std::stringstream newLine;
+    newLine << key;
+    for(uint32_t value : m_selected)
+      newLine << " " << value;
+    lines.push_back(newLine.str());
+
+    std::error_code ec;
+    std::filesystem::create_directories(a_directory, ec);
+
+    const std::string tmpPath = path + ".tmp";
+    {
+      std::ofstream file(tmpPath, std::ios::trunc);
+      for(const auto &line : lines)
+        file << line << "\n";
+      if(!file.good())
+      {
+        VK_UTILS_LOG_WARNING("[ComputeKernelVariants::SaveTuned] failed to write " + tmpPath);
+        return false;
+      }
+    }
+
+    std::filesystem::rename(tmpPath, path, ec);
+    if(ec)
+    {
+      VK_UTILS_LOG_WARNING("[ComputeKernelVariants::SaveTuned] failed to replace " + path + ": " + ec.message());
+      std::filesystem::remove(tmpPath, ec);
+      return false;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef VK_UTILS_KERNEL_VARIANTS_H
+#define VK_UTILS_KERNEL_VARIANTS_H
+
+#include "vk_include.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace vk_utils
+{
+  class PipelineCacheStore;
+
+  enum class KernelConstantKind
+  {
+    VALUE,          // user value (unroll factor, feature toggle as 0/1, ...)
+    WORKGROUP_SIZE, // local_size_x_id; clamped to device limits and rounded to a multiple of subgroup size
+    SUBGROUP_SIZE,  // always equals VkPhysicalDeviceSubgroupProperties::subgroupSize
+  };
+
+  struct KernelConstant
+  {
+    std::string           name;
+    uint32_t              constantId = 0;
+    uint32_t              value      = 0;
+    KernelConstantKind    kind       = KernelConstantKind::VALUE;
+    std::vector<uint32_t> candidates; // values tried by Autotune, empty means only 'value'
+  };
+
+  // Compute kernel with 32-bit specialization constants, one pipeline is created and cached per distinct tuple of values.
+  // Declare constants once, then GetPipeline() returns the pipeline for selected values (defaults, Set() or tuned ones)
+  // and Get(name) gives the value to use on the host side, e.g. workgroup size for vkCmdDispatch.
+  //
+  // Autotune() times every combination of candidates with timestamp queries, selects the fastest one and, if a_directory
+  // is not empty, stores it in a per device file (vendor id, device id, driver version), LoadTuned() reads it back on next
+  // runs. Stored results are keyed by shader code and declared constants, so changed kernels are tuned again.
+  // Pipelines which Autotune() created for the other combinations are destroyed.
+  //
+  class ComputeKernelVariants
+  {
+  public:
+    ComputeKernelVariants(VkDevice a_device, VkPhysicalDevice a_physicalDevice, const std::string &a_shaderPath,
+                          VkPipelineLayout a_layout, const char* a_mainName = "main");
+    ~ComputeKernelVariants();
+
+    ComputeKernelVariants(ComputeKernelVariants const&) = delete;
+    ComputeKernelVariants& operator=(ComputeKernelVariants const&) = delete;
+
+    // must be called before first GetPipeline; a_default == 0 for WORKGROUP_SIZE picks max(subgroup size, 64).
+    // WORKGROUP_SIZE constants without candidates are tuned over 1, 2, 4 and 8 subgroups.
+    void Declare(const std::string &a_name, uint32_t a_constantId, uint32_t a_default,
+                 KernelConstantKind a_kind = KernelConstantKind::VALUE, std::vector<uint32_t> a_candidates = {});
+
+    void     Set(const std::string &a_name, uint32_t a_value);
+    uint32_t Get(const std::string &a_name) const;      // UINT32_MAX if not declared
+    const std::vector<uint32_t>& Selected() const { return m_selected; } // in declaration order
+    const std::vector<KernelConstant>& Constants() const { return m_constants; }
+
+    VkPipeline GetPipeline() { return GetPipeline(m_selected); }
+    VkPipeline GetPipeline(const std::vector<uint32_t> &a_values);
+    size_t     VariantCount() const { return m_pipelines.size(); }
+
+    // a_record binds descriptor sets etc. and dispatches the kernel with the given pipeline and values
+    using RecordFunc = std::function<void(VkCommandBuffer a_cmdBuff, VkPipeline a_pipeline, const std::vector<uint32_t> &a_values)>;
+
+    bool Autotune(VkQueue a_queue, uint32_t a_queueFamilyIndex, VkCommandPool a_cmdPool, RecordFunc a_record,
+                  const std::string &a_directory = "", uint32_t a_repeats = 3);
+    bool LoadTuned(const std::string &a_directory);
+
+    PipelineCacheStore* pipelineCacheStore = nullptr;
+
+  private:
+    int         FindConstant(const std::string &a_name) const;
+    uint32_t    ClampValue(const KernelConstant &a_constant, uint32_t a_value) const;
+    std::string TunedFilePath(const std::string &a_directory) const;
+    std::string TunedKey() const;
+    bool        SaveTuned(const std::string &a_directory) const;
+
+    VkDevice         m_device       = VK_NULL_HANDLE;
+    VkPipelineLayout m_layout       = VK_NULL_HANDLE;
+    VkShaderModule   m_shaderModule = VK_NULL_HANDLE;
+    std::string      m_mainName;
+    uint64_t         m_codeHash     = 0;
+
+    VkPhysicalDeviceProperties         m_props {};
+    VkPhysicalDeviceSubgroupProperties m_subgroupProps {};
+    VkPhysicalDevice                   m_physicalDevice = VK_NULL_HANDLE;
+
+    std::vector<KernelConstant>                   m_constants;
+    std::vector<uint32_t>                         m_selected;
+    std::map<std::vector<uint32_t>, VkPipeline>   m_pipelines;
+  };
+}
+
+#endif// VK_UTILS_KERNEL_VARIANTS_H
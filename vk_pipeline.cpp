@@ -1,6 +1,13 @@
 #include "vk_pipeline.h"
+#include "vk_pipeline_cache.h"
+#include "vk_shader_module_cache.h"
+#include "vk_pipeline_library.h"
+#include "vk_dynamic_state.h"
+#include "vk_trace.h"
 #include "vk_utils.h"
 
+#include <algorithm>
+
 VkPipelineInputAssemblyStateCreateInfo vk_utils::IA_TList()
 {
   VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
@@ -54,13 +61,29 @@ void vk_utils::destroyPipelineIfExists(VkDevice a_device, VkPipeline &a_pipeline
 void vk_utils::GraphicsPipelineMaker::LoadShaders(VkDevice a_device, const std::unordered_map<VkShaderStageFlagBits, std::string> &shader_paths)
 {
   uint32_t top = 0u;
+  reflection = {};
   for(auto& [stage, path] : shader_paths)
   {
     VkPipelineShaderStageCreateInfo stage_info = {};
+    if(shaderModuleCache != nullptr)
+    {
+      const std::vector<uint32_t>* pCode = nullptr;
+      if(!shaderModuleCache->Acquire(path, stage, stage_info, &pCode))
+        RUN_TIME_ERROR(("[GraphicsPipelineMaker::LoadShaders]: can't load shader " + path).c_str());
+      vk_utils::reflectSPIRV(*pCode, stage, reflection);
+      shaderCodeHashes[top] = vk_utils::hashFNV1a(pCode->data(), pCode->size() * sizeof(uint32_t));
+      shaderModules[top]    = stage_info.module;
+      shaderStageInfos[top] = stage_info;
+      top++;
+      continue;
+    }
+
     stage_info.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     stage_info.stage  = stage;
 
     auto shaderCode             = vk_utils::readSPVFile(path.c_str());
+    vk_utils::reflectSPIRV(shaderCode, stage, reflection);
+    shaderCodeHashes[top]       = vk_utils::hashFNV1a(shaderCode.data(), shaderCode.size() * sizeof(uint32_t));
     VkShaderModule shaderModule = vk_utils::createShaderModule(a_device, shaderCode);
     shaderModules[top]          = shaderModule;
 
@@ -109,6 +132,12 @@ VkPipelineLayout vk_utils::GraphicsPipelineMaker::MakeLayout(VkDevice a_device,
   return m_pipelineLayout;
 }
 
+VkPipelineLayout vk_utils::GraphicsPipelineMaker::MakeLayout(PipelineLayoutCache &a_cache, std::vector<VkDescriptorSetLayout> *a_pSetLayouts)
+{
+  m_pipelineLayout = a_cache.GetPipelineLayout(reflection, a_pSetLayouts);
+  return m_pipelineLayout;
+}
+
 void vk_utils::GraphicsPipelineMaker::SetDefaultState(uint32_t a_width, uint32_t a_height, uint32_t rt_count)
 {
   VkExtent2D a_screenExtent{ a_width, a_height };
@@ -176,8 +205,73 @@ VkPipeline vk_utils::GraphicsPipelineMaker::MakePipeline(VkDevice a_device, VkPi
                                                          VkPipelineInputAssemblyStateCreateInfo a_inputAssembly,
                                                          uint32_t subpass)
 {
+  VK_UTILS_TRACE_SCOPE("GraphicsPipelineMaker::MakePipeline", "pipeline");
   inputAssembly = a_inputAssembly;
 
+  for(auto state : m_extendedDynamicStates)
+  {
+    if(std::find(a_dynamicStates.begin(), a_dynamicStates.end(), state) == a_dynamicStates.end())
+      a_dynamicStates.push_back(state);
+  }
+
+  m_pipeline = VK_NULL_HANDLE;
+  if(pipelineLibrary != nullptr && pipelineLibrary->IsEnabled())
+  {
+    m_pipeline = pipelineLibrary->Link(*this, m_stagesNum, m_pipelineLayout, a_vertexLayout, a_renderPass, a_dynamicStates, subpass);
+    if(m_pipeline == VK_NULL_HANDLE)
+      VK_UTILS_LOG_WARNING("[GraphicsPipelineMaker::MakePipeline] pipeline library link failed, creating monolithic pipeline");
+  }
+
+  if(m_pipeline == VK_NULL_HANDLE)
+    MakeMonolithic(a_device, a_vertexLayout, a_renderPass, a_dynamicStates, subpass);
+
+  for (size_t i = 0; i < m_stagesNum; ++i)
+  {
+    if(shaderModuleCache != nullptr)
+      shaderModuleCache->Release(shaderStageInfos[i]);
+    else if(shaderModules[i] != VK_NULL_HANDLE)
+      vkDestroyShaderModule(a_device, shaderModules[i], VK_NULL_HANDLE);
+    shaderModules[i] = VK_NULL_HANDLE;
+  }
+
+  return m_pipeline;
+}
+
+void vk_utils::GraphicsPipelineMaker::EnableExtendedDynamicState(const ExtendedDynamicStateSupport &a_support)
+{
+  m_extendedDynamicStates = a_support.DynamicStates();
+}
+
+void vk_utils::GraphicsPipelineMaker::SetRenderingFormats(const std::vector<VkFormat> &a_colorFormats, VkFormat a_depthFormat,
+                                                          VkFormat a_stencilFormat, uint32_t a_viewMask)
+{
+  renderingColorFormats  = a_colorFormats;
+  renderingDepthFormat   = a_depthFormat;
+  renderingStencilFormat = a_stencilFormat;
+  renderingViewMask      = a_viewMask;
+
+  if(colorBlendAttachments.size() != renderingColorFormats.size())
+    VK_UTILS_LOG_WARNING("[GraphicsPipelineMaker::SetRenderingFormats] color attachment count differs from color blend state");
+}
+
+#if defined(VK_KHR_dynamic_rendering)
+VkPipelineRenderingCreateInfoKHR vk_utils::GraphicsPipelineMaker::RenderingCreateInfo() const
+{
+  VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+  renderingInfo.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+  renderingInfo.viewMask                = renderingViewMask;
+  renderingInfo.colorAttachmentCount    = (uint32_t)renderingColorFormats.size();
+  renderingInfo.pColorAttachmentFormats = renderingColorFormats.data();
+  renderingInfo.depthAttachmentFormat   = renderingDepthFormat;
+  renderingInfo.stencilAttachmentFormat = renderingStencilFormat;
+  return renderingInfo;
+}
+#endif
+
+void vk_utils::GraphicsPipelineMaker::MakeMonolithic(VkDevice a_device, const VkPipelineVertexInputStateCreateInfo &a_vertexLayout,
+                                                     VkRenderPass a_renderPass, const std::vector<VkDynamicState> &a_dynamicStates,
+                                                     uint32_t subpass)
+{
   VkPipelineDynamicStateCreateInfo dynamicState = {};
   dynamicState.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
   dynamicState.dynamicStateCount = (uint32_t)a_dynamicStates.size();
@@ -185,7 +279,7 @@ VkPipeline vk_utils::GraphicsPipelineMaker::MakePipeline(VkDevice a_device, VkPi
 
   pipelineInfo = {};
   pipelineInfo.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.flags               = 0;
+  pipelineInfo.flags               = pipelineFlags;
   pipelineInfo.stageCount          = m_stagesNum;
   pipelineInfo.pStages             = shaderStageInfos;
   pipelineInfo.pVertexInputState   = &a_vertexLayout;
@@ -201,16 +295,23 @@ VkPipeline vk_utils::GraphicsPipelineMaker::MakePipeline(VkDevice a_device, VkPi
   pipelineInfo.basePipelineHandle  = VK_NULL_HANDLE;
   pipelineInfo.pDepthStencilState  = &depthStencilTest;
 
-  VK_CHECK_RESULT(vkCreateGraphicsPipelines(a_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
+#if defined(VK_KHR_dynamic_rendering)
+  VkPipelineRenderingCreateInfoKHR renderingInfo = RenderingCreateInfo();
+  if(a_renderPass == VK_NULL_HANDLE)
+    pipelineInfo.pNext = &renderingInfo;
+#endif
 
-  for (size_t i = 0; i < m_stagesNum; ++i)
+  VkPipelineCache cache = VK_NULL_HANDLE;
+  if(pipelineCacheStore != nullptr)
   {
-    if(shaderModules[i] != VK_NULL_HANDLE)
-      vkDestroyShaderModule(a_device, shaderModules[i], VK_NULL_HANDLE);
-    shaderModules[i] = VK_NULL_HANDLE;
+    cache              = pipelineCacheStore->Get();
+    pipelineInfo.pNext = pipelineCacheStore->ChainFeedback(pipelineInfo.pNext);
   }
 
-  return m_pipeline;
+  VK_CHECK_RESULT(vkCreateGraphicsPipelines(a_device, cache, 1, &pipelineInfo, nullptr, &m_pipeline));
+
+  if(pipelineCacheStore != nullptr)
+    pipelineCacheStore->CollectFeedback();
 }
 
 
@@ -222,18 +323,49 @@ VkPipeline vk_utils::GraphicsPipelineMaker::MakePipeline(VkDevice a_device, VkPi
 void vk_utils::ComputePipelineMaker::LoadShader(VkDevice a_device, const std::string& a_shaderPath,
                                                 const VkSpecializationInfo *a_specInfo, const char* a_mainName)
 {
-  (void)a_specInfo;
   m_mainName = a_mainName;
 
+  m_specEntries.clear();
+  m_specData.clear();
+  m_specInfo = {};
+  if(a_specInfo != nullptr)
+  {
+    m_specEntries.assign(a_specInfo->pMapEntries, a_specInfo->pMapEntries + a_specInfo->mapEntryCount);
+    const uint8_t* specData = reinterpret_cast<const uint8_t*>(a_specInfo->pData);
+    m_specData.assign(specData, specData + a_specInfo->dataSize);
+
+    m_specInfo.mapEntryCount = uint32_t(m_specEntries.size());
+    m_specInfo.pMapEntries   = m_specEntries.data();
+    m_specInfo.dataSize      = m_specData.size();
+    m_specInfo.pData         = m_specData.data();
+  }
+
   shaderStageInfo = {};
+  if(shaderModuleCache != nullptr)
+  {
+    const std::vector<uint32_t>* pCode = nullptr;
+    if(!shaderModuleCache->Acquire(a_shaderPath, VK_SHADER_STAGE_COMPUTE_BIT, shaderStageInfo, &pCode))
+      RUN_TIME_ERROR(("[ComputePipelineMaker::LoadShader]: can't load shader " + a_shaderPath).c_str());
+    reflection = {};
+    vk_utils::reflectSPIRV(*pCode, VK_SHADER_STAGE_COMPUTE_BIT, reflection);
+    shaderModule          = shaderStageInfo.module;
+    shaderStageInfo.pName = m_mainName.c_str();
+    shaderStageInfo.pSpecializationInfo = (a_specInfo != nullptr) ? &m_specInfo : nullptr;
+    return;
+  }
+
   shaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStageInfo.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
 
   auto shaderCode = vk_utils::readSPVFile(a_shaderPath.c_str());
   shaderModule    = vk_utils::createShaderModule(a_device, shaderCode);
 
+  reflection = {};
+  vk_utils::reflectSPIRV(shaderCode, VK_SHADER_STAGE_COMPUTE_BIT, reflection);
+
   shaderStageInfo.module = shaderModule;
   shaderStageInfo.pName  = m_mainName.c_str();
+  shaderStageInfo.pSpecializationInfo = (a_specInfo != nullptr) ? &m_specInfo : nullptr;
 }
 
 VkPipelineLayout vk_utils::ComputePipelineMaker::MakeLayout(VkDevice a_device, std::vector<VkDescriptorSetLayout> a_dslayouts,
@@ -270,18 +402,38 @@ VkPipelineLayout vk_utils::ComputePipelineMaker::MakeLayout(VkDevice a_device, s
   return m_pipelineLayout;
 }
 
+VkPipelineLayout vk_utils::ComputePipelineMaker::MakeLayout(PipelineLayoutCache &a_cache, std::vector<VkDescriptorSetLayout> *a_pSetLayouts)
+{
+  m_pipelineLayout = a_cache.GetPipelineLayout(reflection, a_pSetLayouts);
+  return m_pipelineLayout;
+}
+
 VkPipeline vk_utils::ComputePipelineMaker::MakePipeline(VkDevice a_device)
 {
+  VK_UTILS_TRACE_SCOPE("ComputePipelineMaker::MakePipeline", "pipeline");
   pipelineInfo                    = {};
   pipelineInfo.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-  pipelineInfo.flags              = 0;
+  pipelineInfo.flags              = pipelineFlags;
   pipelineInfo.stage              = shaderStageInfo;
   pipelineInfo.layout             = m_pipelineLayout;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-  VK_CHECK_RESULT(vkCreateComputePipelines(a_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
+  VkPipelineCache cache = VK_NULL_HANDLE;
+  if(pipelineCacheStore != nullptr)
+  {
+    cache              = pipelineCacheStore->Get();
+    pipelineInfo.pNext = pipelineCacheStore->ChainFeedback(pipelineInfo.pNext);
+  }
+
+  VK_CHECK_RESULT(vkCreateComputePipelines(a_device, cache, 1, &pipelineInfo, nullptr, &m_pipeline));
+
+  if(pipelineCacheStore != nullptr)
+    pipelineCacheStore->CollectFeedback();
 
-  if (shaderModule != VK_NULL_HANDLE)
+  if(shaderModuleCache != nullptr)
+    shaderModuleCache->Release(shaderStageInfo);
+  else if (shaderModule != VK_NULL_HANDLE)
     vkDestroyShaderModule(a_device, shaderModule, VK_NULL_HANDLE);
+  shaderModule = VK_NULL_HANDLE;
 
   return m_pipeline;
 }
@@ -3,6 +3,7 @@
 
 
 #include "vk_include.h"
+#include "vk_shader_reflection.h"
 
 #include <unordered_map>
 #include <vector>
@@ -15,11 +16,17 @@ namespace vk_utils
   VkPipelineInputAssemblyStateCreateInfo IA_LList();
   VkPipelineInputAssemblyStateCreateInfo IA_LSList();
 
+  class PipelineCacheStore;
+  class ShaderModuleCache;
+  class GraphicsPipelineLibrary;
+  struct ExtendedDynamicStateSupport;
+
   struct GraphicsPipelineMaker
   {
     static constexpr uint32_t MAX_STAGES = 5;
     VkShaderModule                  shaderModules[MAX_STAGES] = { VK_NULL_HANDLE };
     VkPipelineShaderStageCreateInfo shaderStageInfos[MAX_STAGES] = { };
+    uint64_t                        shaderCodeHashes[MAX_STAGES] = { 0 }; // identify stages when modules are gone
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly {};
     VkViewport                             viewport {};
@@ -33,6 +40,20 @@ namespace vk_utils
     VkPipelineLayoutCreateInfo             pipelineLayoutInfo {};
     VkPipelineDepthStencilStateCreateInfo  depthStencilTest {};
     VkGraphicsPipelineCreateInfo           pipelineInfo {};
+    ShaderReflection                       reflection {}; // merged interface of all stages, filled by LoadShaders
+    PipelineCacheStore*                    pipelineCacheStore = nullptr;
+    ShaderModuleCache*                     shaderModuleCache  = nullptr; // modules are shared instead of created per pipeline
+    GraphicsPipelineLibrary*               pipelineLibrary    = nullptr; // link pipelines from cached parts if supported
+
+    // dynamic rendering (VK_KHR_dynamic_rendering): attachment formats, used when MakePipeline gets VK_NULL_HANDLE render pass
+    //
+    std::vector<VkFormat>                  renderingColorFormats {};
+    VkFormat                               renderingDepthFormat   = VK_FORMAT_UNDEFINED;
+    VkFormat                               renderingStencilFormat = VK_FORMAT_UNDEFINED;
+    uint32_t                               renderingViewMask      = 0;
+
+    // added to pipelineInfo.flags (also of library parts), e.g. VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT for DescriptorBufferMaker layouts
+    VkPipelineCreateFlags                  pipelineFlags          = 0;
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -41,14 +62,32 @@ namespace vk_utils
     void             LoadShaders(VkDevice a_device, const std::unordered_map<VkShaderStageFlagBits, std::string> &shader_paths);
     void             SetDefaultState(uint32_t a_width, uint32_t a_height, uint32_t rt_count = 1);
     VkPipelineLayout MakeLayout(VkDevice a_device, std::vector<VkDescriptorSetLayout> a_dslayouts, uint32_t a_pcRangeSize);
+    // layout derived from shader reflection, shared with other pipelines through a_cache (which owns it)
+    VkPipelineLayout MakeLayout(PipelineLayoutCache &a_cache, std::vector<VkDescriptorSetLayout> *a_pSetLayouts = nullptr);
     VkPipeline       MakePipeline(VkDevice a_device, VkPipelineVertexInputStateCreateInfo a_vertexLayout, VkRenderPass a_renderPass,
                                   std::vector<VkDynamicState> a_dynamicStates = {},
                                   VkPipelineInputAssemblyStateCreateInfo a_inputAssembly = IA_TList(),
                                   uint32_t subpass = 0);
+
+    // pipeline for vkCmdBeginRendering: pass VK_NULL_HANDLE as render pass to MakePipeline after this call
+    void             SetRenderingFormats(const std::vector<VkFormat> &a_colorFormats, VkFormat a_depthFormat = VK_FORMAT_UNDEFINED,
+                                         VkFormat a_stencilFormat = VK_FORMAT_UNDEFINED, uint32_t a_viewMask = 0);
+#if defined(VK_KHR_dynamic_rendering)
+    // points to renderingColorFormats
+    VkPipelineRenderingCreateInfoKHR RenderingCreateInfo() const;
+#endif
+
+    // make states from a_support dynamic in all next pipelines (in addition to MakePipeline a_dynamicStates),
+    // their values are set on command buffer, e.g. with DynamicStateSetter
+    void             EnableExtendedDynamicState(const ExtendedDynamicStateSupport &a_support);
   private:
+    void             MakeMonolithic(VkDevice a_device, const VkPipelineVertexInputStateCreateInfo &a_vertexLayout, VkRenderPass a_renderPass,
+                                    const std::vector<VkDynamicState> &a_dynamicStates, uint32_t subpass);
+
     uint32_t         m_stagesNum = 0;
     VkPipeline       m_pipeline  = VK_NULL_HANDLE;
     VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    std::vector<VkDynamicState> m_extendedDynamicStates;
   };
 
   struct ComputePipelineMaker
@@ -58,15 +97,31 @@ namespace vk_utils
     VkPushConstantRange             pcRange {};
     VkPipelineLayoutCreateInfo      pipelineLayoutInfo {};
     VkComputePipelineCreateInfo     pipelineInfo {};
+    ShaderReflection                reflection {}; // filled by LoadShader
+    PipelineCacheStore*             pipelineCacheStore = nullptr;
+    ShaderModuleCache*              shaderModuleCache  = nullptr; // modules are shared instead of created per pipeline
+    VkPipelineCreateFlags           pipelineFlags      = 0;       // e.g. VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+
+    // shaderStageInfo points to the members below (entry point name, specialization info), a copy would point to the original
+    ComputePipelineMaker() = default;
+    ComputePipelineMaker(ComputePipelineMaker const&) = delete;
+    ComputePipelineMaker& operator=(ComputePipelineMaker const&) = delete;
 
     void             LoadShader(VkDevice a_device, const std::string& a_shaderPath, const VkSpecializationInfo *a_specInfo = nullptr,
                                 const char* a_mainName = "main");
     VkPipelineLayout MakeLayout(VkDevice a_device, std::vector<VkDescriptorSetLayout> a_dslayouts, uint32_t a_pcRangeSize);
+    // layout derived from shader reflection, shared with other pipelines through a_cache (which owns it)
+    VkPipelineLayout MakeLayout(PipelineLayoutCache &a_cache, std::vector<VkDescriptorSetLayout> *a_pSetLayouts = nullptr);
     VkPipeline       MakePipeline(VkDevice a_device);
   private:
     VkPipeline       m_pipeline  = VK_NULL_HANDLE;
     VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
     std::string      m_mainName;
+
+    // copy of LoadShader specialization info, shaderStageInfo points here
+    std::vector<VkSpecializationMapEntry> m_specEntries;
+    std::vector<uint8_t>                  m_specData;
+    VkSpecializationInfo                  m_specInfo {};
   };
 
   void destroyPipelineIfExists(VkDevice a_device, VkPipeline &a_pipeline, VkPipelineLayout &a_layout);
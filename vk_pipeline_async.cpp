@@ -0,0 +1,202 @@
+#include "vk_pipeline_async.h"
+#include "vk_utils.h"
+
+#include <algorithm>
+
+namespace vk_utils
+{
+  AsyncPipelineProvider::AsyncPipelineProvider(VkDevice a_device, VkPipelineCache a_cache, uint32_t a_threadCount) :
+                                               m_device(a_device), m_cache(a_cache)
+  {
+    if(a_threadCount == 0)
+      a_threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    m_workers.reserve(a_threadCount);
+    for(uint32_t i = 0; i < a_threadCount; ++i)
+      m_workers.emplace_back(&AsyncPipelineProvider::WorkerLoop, this);
+  }
+
+  AsyncPipelineProvider::~AsyncPipelineProvider()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+      m_queue.clear();
+    }
+    m_jobReady.notify_all();
+    for(auto &worker : m_workers)
+      worker.join();
+
+    for(auto &request : m_requests)
+    {
+      if(request.second.pipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(m_device, request.second.pipeline, nullptr);
+    }
+  }
+
+  uint32_t AsyncPipelineProvider::RequestCompute(ComputePipelineDesc a_desc, VkPipeline a_fallback, int a_priority)
+  {
+    Request request;
+    request.compute  = std::make_unique<ComputePipelineDesc>(std::move(a_desc));
+    request.fallback = a_fallback;
+    request.priority = a_priority;
+    return Enqueue(std::move(request));
+  }
+
+  uint32_t AsyncPipelineProvider::RequestGraphics(GraphicsPipelineDesc a_desc, VkPipeline a_fallback, int a_priority)
+  {
+    Request request;
+    request.graphics = std::make_unique<GraphicsPipelineDesc>(std::move(a_desc));
+    request.fallback = a_fallback;
+    request.priority = a_priority;
+    return Enqueue(std::move(request));
+  }
+
+  uint32_t AsyncPipelineProvider::Enqueue(Request &&a_request)
+  {
+    uint32_t handle = INVALID_HANDLE;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      handle = m_nextHandle++;
+      if(m_nextHandle == INVALID_HANDLE)
+        m_nextHandle = 1;
+      m_requests[handle] = std::move(a_request);
+      m_queue.push_back(handle);
+    }
+    m_jobReady.notify_one();
+    return handle;
+  }
+
+  VkPipeline AsyncPipelineProvider::Get(uint32_t a_handle) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_requests.find(a_handle);
+    if(found == m_requests.end() || found->second.cancelled)
+      return VK_NULL_HANDLE;
+
+    const Request &request = found->second;
+    return request.state == AsyncPipelineState::READY ? request.pipeline : request.fallback;
+  }
+
+  bool AsyncPipelineProvider::IsReady(uint32_t a_handle) const
+  {
+    return GetState(a_handle) == AsyncPipelineState::READY;
+  }
+
+  AsyncPipelineState AsyncPipelineProvider::GetState(uint32_t a_handle) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_requests.find(a_handle);
+    if(found == m_requests.end() || found->second.cancelled)
+      return AsyncPipelineState::UNKNOWN;
+    return found->second.state;
+  }
+
+  void AsyncPipelineProvider::SetPriority(uint32_t a_handle, int a_priority)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_requests.find(a_handle);
+    if(found != m_requests.end())
+      found->second.priority = a_priority;
+  }
+
+  void AsyncPipelineProvider::Cancel(uint32_t a_handle)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto found = m_requests.find(a_handle);
+    if(found == m_requests.end())
+      return;
+
+    Request &request = found->second;
+    switch(request.state)
+    {
+    case AsyncPipelineState::QUEUED:
+      m_queue.erase(std::find(m_queue.begin(), m_queue.end(), a_handle));
+      m_requests.erase(found);
+      lock.unlock();
+      m_idle.notify_all();
+      break;
+    case AsyncPipelineState::COMPILING:
+      request.cancelled = true; // worker destroys the result
+      break;
+    default:
+      if(request.pipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(m_device, request.pipeline, nullptr);
+      m_requests.erase(found);
+      break;
+    }
+  }
+
+  void AsyncPipelineProvider::WaitIdle()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_queue.empty() && m_compiling == 0; });
+  }
+
+  size_t AsyncPipelineProvider::GetPendingCount() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size() + m_compiling;
+  }
+
+  void AsyncPipelineProvider::WorkerLoop()
+  {
+    while(true)
+    {
+      uint32_t              handle   = INVALID_HANDLE;
+      ComputePipelineDesc*  compute  = nullptr;
+      GraphicsPipelineDesc* graphics = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobReady.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+        // unlike PipelineBatchBuilder queued requests are dropped on exit, nobody waits for them
+        if(m_stop)
+          return;
+
+        // the queue is short (pipelines not compiled yet), linear search keeps SetPriority and Cancel trivial
+        //
+        auto best = m_queue.begin();
+        for(auto it = m_queue.begin(); it != m_queue.end(); ++it)
+        {
+          if(m_requests[*it].priority > m_requests[*best].priority)
+            best = it;
+        }
+        handle = *best;
+        m_queue.erase(best);
+
+        Request &request = m_requests[handle];
+        request.state = AsyncPipelineState::COMPILING;
+        compute       = request.compute.get();
+        graphics      = request.graphics.get();
+        m_compiling++;
+      }
+
+      // descriptions are not touched by other threads while the request is COMPILING
+      //
+      VkPipeline pipeline = graphics != nullptr ? makeGraphicsPipeline(m_device, m_cache, *graphics)
+                                                : makeComputePipeline(m_device, m_cache, *compute);
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_requests.find(handle);
+        if(found->second.cancelled)
+        {
+          if(pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(m_device, pipeline, nullptr);
+          m_requests.erase(found);
+        }
+        else
+        {
+          Request &request = found->second;
+          request.pipeline = pipeline;
+          request.state    = pipeline != VK_NULL_HANDLE ? AsyncPipelineState::READY : AsyncPipelineState::FAILED;
+          request.compute.reset();
+          request.graphics.reset();
+          if(pipeline == VK_NULL_HANDLE)
+            VK_UTILS_LOG_WARNING("[AsyncPipelineProvider::WorkerLoop] pipeline creation failed, fallback stays in use");
+        }
+        m_compiling--;
+      }
+      m_idle.notify_all();
+    }
+  }
+}
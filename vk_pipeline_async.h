@@ -0,0 +1,98 @@
+#ifndef VK_UTILS_PIPELINE_ASYNC_H
+#define VK_UTILS_PIPELINE_ASYNC_H
+
+#include "vk_include.h"
+#include "vk_pipeline_batch.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vk_utils
+{
+  enum class AsyncPipelineState
+  {
+    QUEUED,
+    COMPILING,
+    READY,
+    FAILED,    // creation failed, Get keeps returning the fallback
+    UNKNOWN,   // invalid or cancelled handle
+  };
+
+  // Creates pipelines on background threads without stalling the frame: Request* returns a handle right away, Get(handle)
+  // returns the compiled pipeline once it is ready and the fallback pipeline given with the request until then
+  // (e.g. a generic material or an ubershader with the same layout). Call Get when recording every frame, so the real
+  // pipeline is picked up as soon as it is compiled.
+  //
+  // Queued requests are compiled in order of priority (higher first, in request order for equal priority), so pipelines
+  // which are visible now can be moved ahead with SetPriority. All workers share one VkPipelineCache, pass
+  // PipelineCacheStore::Get() to persist results.
+  //
+  // Compiled pipelines are owned by the provider until Cancel or destruction; fallback pipelines are owned by the caller.
+  // All methods are thread safe.
+  //
+  class AsyncPipelineProvider
+  {
+  public:
+    static constexpr uint32_t INVALID_HANDLE = 0;
+
+    // a_threadCount == 0 uses std::thread::hardware_concurrency() - 1, leaving one core for the render thread
+    AsyncPipelineProvider(VkDevice a_device, VkPipelineCache a_cache = VK_NULL_HANDLE, uint32_t a_threadCount = 0);
+    ~AsyncPipelineProvider();
+
+    AsyncPipelineProvider(AsyncPipelineProvider const&) = delete;
+    AsyncPipelineProvider& operator=(AsyncPipelineProvider const&) = delete;
+
+    uint32_t RequestCompute(ComputePipelineDesc a_desc, VkPipeline a_fallback = VK_NULL_HANDLE, int a_priority = 0);
+    uint32_t RequestGraphics(GraphicsPipelineDesc a_desc, VkPipeline a_fallback = VK_NULL_HANDLE, int a_priority = 0);
+
+    VkPipeline         Get(uint32_t a_handle) const;
+    bool               IsReady(uint32_t a_handle) const;
+    AsyncPipelineState GetState(uint32_t a_handle) const;
+
+    // affects only requests which are still queued
+    void SetPriority(uint32_t a_handle, int a_priority);
+
+    // drops a queued request, a request being compiled is destroyed when the worker finishes it;
+    // a ready pipeline is destroyed immediately, so the GPU must not use it anymore
+    void Cancel(uint32_t a_handle);
+
+    // blocks until all queued requests are compiled
+    void   WaitIdle();
+    size_t GetPendingCount() const;
+    size_t GetThreadCount() const { return m_workers.size(); }
+
+  private:
+    struct Request
+    {
+      std::unique_ptr<ComputePipelineDesc>  compute;
+      std::unique_ptr<GraphicsPipelineDesc> graphics;
+      VkPipeline         fallback  = VK_NULL_HANDLE;
+      VkPipeline         pipeline  = VK_NULL_HANDLE;
+      int                priority  = 0;
+      AsyncPipelineState state     = AsyncPipelineState::QUEUED;
+      bool               cancelled = false;
+    };
+
+    uint32_t Enqueue(Request &&a_request);
+    void     WorkerLoop();
+
+    VkDevice        m_device = VK_NULL_HANDLE;
+    VkPipelineCache m_cache  = VK_NULL_HANDLE;
+
+    std::vector<std::thread>              m_workers;
+    std::unordered_map<uint32_t, Request> m_requests;
+    std::vector<uint32_t>                 m_queue;     // handles of QUEUED requests in request order
+    mutable std::mutex                    m_mutex;
+    std::condition_variable               m_jobReady;
+    std::condition_variable               m_idle;
+    uint32_t                              m_nextHandle = 1;
+    uint32_t                              m_compiling  = 0;
+    bool                                  m_stop       = false;
+  };
+}
+
+#endif// VK_UTILS_PIPELINE_ASYNC_H
@@ -0,0 +1,304 @@
+#include "vk_pipeline_batch.h"
+#include "vk_utils.h"
+#include "vk_trace.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace vk_utils
+{
+  void PipelineStageDesc::SetSpecialization(const VkSpecializationInfo *a_specInfo)
+  {
+    specEntries.clear();
+    specData.clear();
+    if(a_specInfo == nullptr)
+      return;
+
+    specEntries.assign(a_specInfo->pMapEntries, a_specInfo->pMapEntries + a_specInfo->mapEntryCount);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(a_specInfo->pData);
+    specData.assign(data, data + a_specInfo->dataSize);
+  }
+
+  void GraphicsPipelineDesc::CopyStateFrom(const GraphicsPipelineMaker &a_maker)
+  {
+    inputAssembly         = a_maker.inputAssembly;
+    viewport              = a_maker.viewport;
+    scissor               = a_maker.scissor;
+    rasterizer            = a_maker.rasterizer;
+    multisampling         = a_maker.multisampling;
+    depthStencilTest      = a_maker.depthStencilTest;
+    colorBlendAttachments = a_maker.colorBlendAttachments;
+    colorBlending         = a_maker.colorBlending;
+
+    renderingColorFormats  = a_maker.renderingColorFormats;
+    renderingDepthFormat   = a_maker.renderingDepthFormat;
+    renderingStencilFormat = a_maker.renderingStencilFormat;
+    renderingViewMask      = a_maker.renderingViewMask;
+  }
+
+  void GraphicsPipelineDesc::SetVertexInput(const VkPipelineVertexInputStateCreateInfo &a_vertexLayout)
+  {
+    vertexBindings.assign(a_vertexLayout.pVertexBindingDescriptions,
+                          a_vertexLayout.pVertexBindingDescriptions + a_vertexLayout.vertexBindingDescriptionCount);
+    vertexAttributes.assign(a_vertexLayout.pVertexAttributeDescriptions,
+                            a_vertexLayout.pVertexAttributeDescriptions + a_vertexLayout.vertexAttributeDescriptionCount);
+  }
+
+  void GraphicsPipelineDesc::AddStage(VkShaderStageFlagBits a_stage, const std::string &a_shaderPath,
+                                      const VkSpecializationInfo *a_specInfo, const char* a_mainName)
+  {
+    PipelineStageDesc stage;
+    stage.stage    = a_stage;
+    stage.code     = vk_utils::readSPVFile(a_shaderPath.c_str());
+    stage.mainName = a_mainName;
+    stage.SetSpecialization(a_specInfo);
+    stages.push_back(std::move(stage));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  // worker side of a stage: module and specialization info pointing into PipelineStageDesc
+  //
+  struct CompiledStage
+  {
+    VkShaderModule                  module = VK_NULL_HANDLE;
+    VkSpecializationInfo            specInfo {};
+    VkPipelineShaderStageCreateInfo stageInfo {};
+  };
+
+  static bool createStage(VkDevice a_device, const PipelineStageDesc &a_desc, CompiledStage &a_out)
+  {
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = a_desc.code.size() * sizeof(uint32_t);
+    createInfo.pCode    = a_desc.code.data();
+    if(a_desc.code.empty() || vkCreateShaderModule(a_device, &createInfo, nullptr, &a_out.module) != VK_SUCCESS)
+    {
+      a_out.module = VK_NULL_HANDLE;
+      return false;
+    }
+
+    a_out.specInfo.mapEntryCount = uint32_t(a_desc.specEntries.size());
+    a_out.specInfo.pMapEntries   = a_desc.specEntries.data();
+    a_out.specInfo.dataSize      = a_desc.specData.size();
+    a_out.specInfo.pData         = a_desc.specData.data();
+
+    a_out.stageInfo        = {};
+    a_out.stageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    a_out.stageInfo.stage  = a_desc.stage;
+    a_out.stageInfo.module = a_out.module;
+    a_out.stageInfo.pName  = a_desc.mainName.c_str();
+    a_out.stageInfo.pSpecializationInfo = a_desc.specEntries.empty() ? nullptr : &a_out.specInfo;
+    return true;
+  }
+
+  PipelineBatchBuilder::PipelineBatchBuilder(VkDevice a_device, VkPipelineCache a_cache, uint32_t a_threadCount) :
+                                             m_device(a_device), m_cache(a_cache)
+  {
+    if(a_threadCount == 0)
+      a_threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    m_workers.reserve(a_threadCount);
+    for(uint32_t i = 0; i < a_threadCount; ++i)
+      m_workers.emplace_back(&PipelineBatchBuilder::WorkerLoop, this);
+  }
+
+  PipelineBatchBuilder::~PipelineBatchBuilder()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_jobReady.notify_all();
+    for(auto &worker : m_workers)
+      worker.join();
+  }
+
+  void PipelineBatchBuilder::WorkerLoop()
+  {
+    while(true)
+    {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobReady.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+        // queued jobs are finished before exit, so no future is left without a value
+        if(m_jobs.empty())
+          return;
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+      }
+
+      job();
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlight--;
+      }
+      m_allDone.notify_all();
+    }
+  }
+
+  std::shared_future<VkPipeline> PipelineBatchBuilder::Enqueue(std::function<VkPipeline()> a_job)
+  {
+    auto promise = std::make_shared<std::promise<VkPipeline>>();
+    std::shared_future<VkPipeline> future = promise->get_future().share();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs.emplace_back([promise, job = std::move(a_job)]() { promise->set_value(job()); });
+      m_inFlight++;
+    }
+    m_jobReady.notify_one();
+    return future;
+  }
+
+  void PipelineBatchBuilder::Wait()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_allDone.wait(lock, [this]() { return m_inFlight == 0; });
+  }
+
+  std::shared_future<VkPipeline> PipelineBatchBuilder::AddCompute(ComputePipelineDesc a_desc)
+  {
+    auto desc = std::make_shared<ComputePipelineDesc>(std::move(a_desc));
+    return Enqueue([this, desc]() { return makeComputePipeline(m_device, m_cache, *desc); });
+  }
+
+  std::shared_future<VkPipeline> PipelineBatchBuilder::AddCompute(const std::string &a_shaderPath, VkPipelineLayout a_layout,
+                                                                  const VkSpecializationInfo *a_specInfo, const char* a_mainName)
+  {
+    ComputePipelineDesc desc;
+    desc.stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+    desc.stage.code     = vk_utils::readSPVFile(a_shaderPath.c_str());
+    desc.stage.mainName = a_mainName;
+    desc.stage.SetSpecialization(a_specInfo);
+    desc.layout         = a_layout;
+    return AddCompute(std::move(desc));
+  }
+
+  std::shared_future<VkPipeline> PipelineBatchBuilder::AddGraphics(GraphicsPipelineDesc a_desc)
+  {
+    auto desc = std::make_shared<GraphicsPipelineDesc>(std::move(a_desc));
+    return Enqueue([this, desc]() { return makeGraphicsPipeline(m_device, m_cache, *desc); });
+  }
+
+  VkPipeline makeComputePipeline(VkDevice a_device, VkPipelineCache a_cache, const ComputePipelineDesc &a_desc)
+  {
+    VK_UTILS_TRACE_SCOPE("makeComputePipeline", "pipeline");
+    CompiledStage stage;
+    if(!createStage(a_device, a_desc.stage, stage))
+    {
+      VK_UTILS_LOG_ERROR("[makeComputePipeline] can't create shader module");
+      return VK_NULL_HANDLE;
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage              = stage.stageInfo;
+    pipelineInfo.layout             = a_desc.layout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    const VkResult res  = vkCreateComputePipelines(a_device, a_cache, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(a_device, stage.module, nullptr);
+
+    if(res != VK_SUCCESS)
+    {
+      VK_UTILS_LOG_ERROR("[makeComputePipeline] vkCreateComputePipelines failed: " + vk_utils::errorString(res));
+      return VK_NULL_HANDLE;
+    }
+    return pipeline;
+  }
+
+  VkPipeline makeGraphicsPipeline(VkDevice a_device, VkPipelineCache a_cache, const GraphicsPipelineDesc &a_desc)
+  {
+    VK_UTILS_TRACE_SCOPE("makeGraphicsPipeline", "pipeline");
+    std::vector<CompiledStage> stages(a_desc.stages.size());
+    std::vector<VkPipelineShaderStageCreateInfo> stageInfos(a_desc.stages.size());
+    bool stagesOk = true;
+    for(size_t i = 0; i < a_desc.stages.size() && stagesOk; ++i)
+    {
+      stagesOk      = createStage(a_device, a_desc.stages[i], stages[i]);
+      stageInfos[i] = stages[i].stageInfo;
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult   res      = VK_ERROR_INITIALIZATION_FAILED;
+    if(stagesOk)
+    {
+      VkPipelineVertexInputStateCreateInfo vertexInput = {};
+      vertexInput.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+      vertexInput.vertexBindingDescriptionCount   = uint32_t(a_desc.vertexBindings.size());
+      vertexInput.pVertexBindingDescriptions      = a_desc.vertexBindings.data();
+      vertexInput.vertexAttributeDescriptionCount = uint32_t(a_desc.vertexAttributes.size());
+      vertexInput.pVertexAttributeDescriptions    = a_desc.vertexAttributes.data();
+
+      VkPipelineViewportStateCreateInfo viewportState = {};
+      viewportState.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+      viewportState.viewportCount = 1;
+      viewportState.pViewports    = &a_desc.viewport;
+      viewportState.scissorCount  = 1;
+      viewportState.pScissors     = &a_desc.scissor;
+
+      VkPipelineColorBlendStateCreateInfo colorBlending = a_desc.colorBlending;
+      colorBlending.attachmentCount = uint32_t(a_desc.colorBlendAttachments.size());
+      colorBlending.pAttachments    = a_desc.colorBlendAttachments.data();
+
+      VkPipelineDynamicStateCreateInfo dynamicState = {};
+      dynamicState.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+      dynamicState.dynamicStateCount = uint32_t(a_desc.dynamicStates.size());
+      dynamicState.pDynamicStates    = a_desc.dynamicStates.data();
+
+      VkGraphicsPipelineCreateInfo pipelineInfo = {};
+      pipelineInfo.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+      pipelineInfo.stageCount          = uint32_t(stageInfos.size());
+      pipelineInfo.pStages             = stageInfos.data();
+      pipelineInfo.pVertexInputState   = &vertexInput;
+      pipelineInfo.pInputAssemblyState = &a_desc.inputAssembly;
+      pipelineInfo.pViewportState      = &viewportState;
+      pipelineInfo.pRasterizationState = &a_desc.rasterizer;
+      pipelineInfo.pMultisampleState   = &a_desc.multisampling;
+      pipelineInfo.pColorBlendState    = &colorBlending;
+      pipelineInfo.pDepthStencilState  = &a_desc.depthStencilTest;
+      pipelineInfo.pDynamicState       = &dynamicState;
+      pipelineInfo.layout              = a_desc.layout;
+      pipelineInfo.renderPass          = a_desc.renderPass;
+      pipelineInfo.subpass             = a_desc.subpass;
+      pipelineInfo.basePipelineHandle  = VK_NULL_HANDLE;
+
+#if defined(VK_KHR_dynamic_rendering)
+      VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+      renderingInfo.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+      renderingInfo.viewMask                = a_desc.renderingViewMask;
+      renderingInfo.colorAttachmentCount    = uint32_t(a_desc.renderingColorFormats.size());
+      renderingInfo.pColorAttachmentFormats = a_desc.renderingColorFormats.data();
+      renderingInfo.depthAttachmentFormat   = a_desc.renderingDepthFormat;
+      renderingInfo.stencilAttachmentFormat = a_desc.renderingStencilFormat;
+      if(a_desc.renderPass == VK_NULL_HANDLE)
+        pipelineInfo.pNext = &renderingInfo;
+#endif
+
+      res = vkCreateGraphicsPipelines(a_device, a_cache, 1, &pipelineInfo, nullptr, &pipeline);
+    }
+
+    for(auto &stage : stages)
+    {
+      if(stage.module != VK_NULL_HANDLE)
+        vkDestroyShaderModule(a_device, stage.module, nullptr);
+    }
+
+    if(!stagesOk)
+    {
+      VK_UTILS_LOG_ERROR("[makeGraphicsPipeline] can't create shader module");
+      return VK_NULL_HANDLE;
+    }
+    if(res != VK_SUCCESS)
+    {
+      VK_UTILS_LOG_ERROR("[makeGraphicsPipeline] vkCreateGraphicsPipelines failed: " + vk_utils::errorString(res));
+      return VK_NULL_HANDLE;
+    }
+    return pipeline;
+  }
+}
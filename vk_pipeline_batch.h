@@ -0,0 +1,120 @@
+#ifndef VK_UTILS_PIPELINE_BATCH_H
+#define VK_UTILS_PIPELINE_BATCH_H
+
+#include "vk_include.h"
+#include "vk_pipeline.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vk_utils
+{
+  // Self-contained shader stage description: owns SPIR-V code and specialization constants,
+  // shader module is created and destroyed by the worker thread that compiles the pipeline
+  //
+  struct PipelineStageDesc
+  {
+    VkShaderStageFlagBits                 stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    std::vector<uint32_t>                 code;
+    std::string                           mainName = "main";
+    std::vector<VkSpecializationMapEntry> specEntries;
+    std::vector<uint8_t>                  specData;
+
+    // copies a_specInfo (if not null) into specEntries/specData
+    void SetSpecialization(const VkSpecializationInfo *a_specInfo);
+  };
+
+  struct ComputePipelineDesc
+  {
+    PipelineStageDesc stage;
+    VkPipelineLayout  layout = VK_NULL_HANDLE;
+  };
+
+  // Fixed function state is stored by value, pointers between create info structures are restored when pipeline is compiled
+  //
+  struct GraphicsPipelineDesc
+  {
+    std::vector<PipelineStageDesc>                   stages;
+    std::vector<VkVertexInputBindingDescription>     vertexBindings;
+    std::vector<VkVertexInputAttributeDescription>   vertexAttributes;
+    VkPipelineInputAssemblyStateCreateInfo           inputAssembly = IA_TList();
+    VkViewport                                       viewport {};
+    VkRect2D                                         scissor {};
+    VkPipelineRasterizationStateCreateInfo           rasterizer {};
+    VkPipelineMultisampleStateCreateInfo             multisampling {};
+    VkPipelineDepthStencilStateCreateInfo            depthStencilTest {};
+    std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
+    VkPipelineColorBlendStateCreateInfo              colorBlending {};
+    std::vector<VkDynamicState>                      dynamicStates;
+    VkPipelineLayout                                 layout     = VK_NULL_HANDLE;
+    VkRenderPass                                     renderPass = VK_NULL_HANDLE;
+    uint32_t                                         subpass    = 0;
+
+    // dynamic rendering formats, used when renderPass is VK_NULL_HANDLE
+    std::vector<VkFormat>                            renderingColorFormats;
+    VkFormat                                         renderingDepthFormat   = VK_FORMAT_UNDEFINED;
+    VkFormat                                         renderingStencilFormat = VK_FORMAT_UNDEFINED;
+    uint32_t                                         renderingViewMask      = 0;
+
+    // takes fixed function state and rendering formats of a_maker (e.g. after SetDefaultState), shader stages are not copied
+    void CopyStateFrom(const GraphicsPipelineMaker &a_maker);
+    void SetVertexInput(const VkPipelineVertexInputStateCreateInfo &a_vertexLayout);
+    void AddStage(VkShaderStageFlagBits a_stage, const std::string &a_shaderPath, const VkSpecializationInfo *a_specInfo = nullptr,
+                  const char* a_mainName = "main");
+  };
+
+  // compile a pipeline on the calling thread (shader modules are created and destroyed here), VK_NULL_HANDLE on failure
+  //
+  VkPipeline makeComputePipeline(VkDevice a_device, VkPipelineCache a_cache, const ComputePipelineDesc &a_desc);
+  VkPipeline makeGraphicsPipeline(VkDevice a_device, VkPipelineCache a_cache, const GraphicsPipelineDesc &a_desc);
+
+  // Compiles many pipelines concurrently on a pool of worker threads.
+  // Each Add* call queues a pipeline and returns a future which is ready as soon as this pipeline is created,
+  // so dependent work doesn't have to wait for the whole batch. Compilation starts immediately; Wait() blocks until
+  // the queue is empty. All workers share one VkPipelineCache (internally synchronized by the driver), pass
+  // PipelineCacheStore::Get() to persist results; creation feedback is not collected for batched pipelines.
+  //
+  // Created pipelines are owned by the caller, VK_NULL_HANDLE is returned if creation failed.
+  //
+  class PipelineBatchBuilder
+  {
+  public:
+    // a_threadCount == 0 uses std::thread::hardware_concurrency()
+    PipelineBatchBuilder(VkDevice a_device, VkPipelineCache a_cache = VK_NULL_HANDLE, uint32_t a_threadCount = 0);
+    ~PipelineBatchBuilder();
+
+    PipelineBatchBuilder(PipelineBatchBuilder const&) = delete;
+    PipelineBatchBuilder& operator=(PipelineBatchBuilder const&) = delete;
+
+    std::shared_future<VkPipeline> AddCompute(ComputePipelineDesc a_desc);
+    std::shared_future<VkPipeline> AddCompute(const std::string &a_shaderPath, VkPipelineLayout a_layout,
+                                              const VkSpecializationInfo *a_specInfo = nullptr, const char* a_mainName = "main");
+    std::shared_future<VkPipeline> AddGraphics(GraphicsPipelineDesc a_desc);
+
+    void   Wait();
+    size_t GetThreadCount() const { return m_workers.size(); }
+
+  private:
+    void       WorkerLoop();
+    std::shared_future<VkPipeline> Enqueue(std::function<VkPipeline()> a_job);
+
+    VkDevice        m_device = VK_NULL_HANDLE;
+    VkPipelineCache m_cache  = VK_NULL_HANDLE;
+
+    std::vector<std::thread>               m_workers;
+    std::deque<std::function<void()>>      m_jobs;
+    std::mutex                             m_mutex;
+    std::condition_variable                m_jobReady;
+    std::condition_variable                m_allDone;
+    uint32_t                               m_inFlight = 0;
+    bool                                   m_stop     = false;
+  };
+}
+
+#endif// VK_UTILS_PIPELINE_BATCH_H
@@ -0,0 +1,178 @@
+#include "vk_pipeline_cache.h"
+#include "vk_utils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace vk_utils
+{
+  static std::vector<uint8_t> readBinaryFile(const std::string &a_path)
+  {
+    std::vector<uint8_t> data;
+    FILE* file = fopen(a_path.c_str(), "rb");
+    if(file == nullptr)
+      return data;
+
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if(size > 0)
+    {
+      data.resize(size_t(size));
+      if(fread(data.data(), 1, data.size(), file) != data.size())
+        data.clear();
+    }
+    fclose(file);
+    return data;
+  }
+
+  static bool validateCacheHeader(const std::vector<uint8_t> &a_data, const VkPhysicalDeviceProperties &a_props)
+  {
+    VkPipelineCacheHeaderVersionOne header = {};
+    if(a_data.size() < sizeof(header))
+      return false;
+    memcpy(&header, a_data.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == a_props.vendorID &&
+           header.deviceID == a_props.deviceID &&
+           memcmp(header.pipelineCacheUUID, a_props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+  }
+
+  PipelineCacheStore::PipelineCacheStore(VkDevice a_device, VkPhysicalDevice a_physicalDevice, const std::string &a_directory,
+                                         bool a_creationFeedback) : m_device(a_device), m_feedbackEnabled(a_creationFeedback)
+  {
+    VkPhysicalDeviceProperties props = {};
+    vkGetPhysicalDeviceProperties(a_physicalDevice, &props);
+
+    std::stringstream name;
+    name << std::hex << std::setfill('0') << "pipeline_cache_" << std::setw(4) << props.vendorID << "_"
+         << std::setw(4) << props.deviceID << "_" << std::setw(8) << props.driverVersion << "_";
+    for(uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+      name << std::setw(2) << uint32_t(props.pipelineCacheUUID[i]);
+    name << ".bin";
+    m_path = (std::filesystem::path(a_directory) / name.str()).string();
+
+    std::vector<uint8_t> data = readBinaryFile(m_path);
+    if(!data.empty() && !validateCacheHeader(data, props))
+    {
+      VK_UTILS_LOG_WARNING("[PipelineCacheStore::PipelineCacheStore] pipeline cache header mismatch, ignoring " + m_path);
+      data.clear();
+    }
+    m_loaded = !data.empty();
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData    = data.empty() ? nullptr : data.data();
+    if(vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_cache) != VK_SUCCESS && m_loaded)
+    {
+      // driver rejected the blob despite valid header, start with empty cache
+      m_loaded = false;
+      createInfo.initialDataSize = 0;
+      createInfo.pInitialData    = nullptr;
+      VK_CHECK_RESULT(vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_cache));
+    }
+
+#if !defined(VK_EXT_pipeline_creation_feedback)
+    m_feedbackEnabled = false;
+#endif
+  }
+
+  PipelineCacheStore::~PipelineCacheStore()
+  {
+    if(m_cache == VK_NULL_HANDLE)
+      return;
+    Save();
+    vkDestroyPipelineCache(m_device, m_cache, nullptr);
+  }
+
+  bool PipelineCacheStore::Save()
+  {
+    size_t size = 0;
+    VK_CHECK_RESULT(vkGetPipelineCacheData(m_device, m_cache, &size, nullptr));
+    std::vector<uint8_t> data(size);
+    VK_CHECK_RESULT(vkGetPipelineCacheData(m_device, m_cache, &size, data.data()));
+    data.resize(size);
+
+    std::error_code ec;
+    const std::filesystem::path path(m_path);
+    if(path.has_parent_path())
+      std::filesystem::create_directories(path.parent_path(), ec);
+
+    const std::string tmpPath = m_path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if(file == nullptr)
+    {
+      VK_UTILS_LOG_WARNING("[PipelineCacheStore::Save] can't open " + tmpPath);
+      return false;
+    }
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    const bool closed  = fclose(file) == 0;
+    if(!written || !closed)
+    {
+      VK_UTILS_LOG_WARNING("[PipelineCacheStore::Save] failed to write " + tmpPath);
+      std::filesystem::remove(tmpPath, ec);
+      return false;
+    }
+
+    std::filesystem::rename(tmpPath, path, ec);
+    if(ec)
+    {
+      VK_UTILS_LOG_WARNING("[PipelineCacheStore::Save] failed to replace " + m_path + ": " + ec.message());
+      std::filesystem::remove(tmpPath, ec);
+      return false;
+    }
+    return true;
+  }
+
+  const void* PipelineCacheStore::ChainFeedback(const void* a_pNext)
+  {
+#if defined(VK_EXT_pipeline_creation_feedback)
+    if(!m_feedbackEnabled)
+      return a_pNext;
+
+    m_feedback = {};
+    m_feedbackInfo = {};
+    m_feedbackInfo.sType              = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+    m_feedbackInfo.pNext              = a_pNext;
+    m_feedbackInfo.pPipelineCreationFeedback = &m_feedback;
+    m_feedbackChained = true;
+    return &m_feedbackInfo;
+#else
+    return a_pNext;
+#endif
+  }
+
+  void PipelineCacheStore::CollectFeedback()
+  {
+#if defined(VK_EXT_pipeline_creation_feedback)
+    if(!m_feedbackChained)
+      return;
+    m_feedbackChained = false;
+
+    if(!(m_feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+      return;
+
+    m_stats.pipelines++;
+    if(m_feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+      m_stats.cacheHits++;
+    m_stats.msCreateTotal += float(double(m_feedback.duration) * 1e-6);
+#endif
+  }
+
+  void PipelineCacheStore::PrintStats() const
+  {
+    std::stringstream ss;
+    ss << "[PipelineCacheStore] " << m_stats.cacheHits << "/" << m_stats.pipelines << " pipelines hit the cache";
+    if(m_stats.pipelines > 0)
+      ss << " (" << std::fixed << std::setprecision(1) << 100.0f * float(m_stats.cacheHits) / float(m_stats.pipelines) << "%)";
+    ss << ", creation time " << std::setprecision(2) << m_stats.msCreateTotal << " ms";
+    VK_UTILS_LOG_INFO(ss.str());
+  }
+}
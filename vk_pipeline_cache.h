@@ -0,0 +1,65 @@
+#ifndef VK_UTILS_PIPELINE_CACHE_H
+#define VK_UTILS_PIPELINE_CACHE_H
+
+#include "vk_include.h"
+
+#include <string>
+
+namespace vk_utils
+{
+  struct PipelineCacheStats
+  {
+    uint32_t pipelines     = 0; // pipelines created with feedback
+    uint32_t cacheHits     = 0; // VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT was reported
+    float    msCreateTotal = 0.0f;
+  };
+
+  // VkPipelineCache persisted to disk between runs.
+  // Blob is stored in a_directory in a file named after vendor id, device id, driver version and pipeline cache UUID,
+  // its header (VkPipelineCacheHeaderVersionOne) is validated before it is handed to the driver, mismatching or
+  // corrupted blobs are ignored. Save() writes to a temporary file and renames it, so cache file is never half written;
+  // destructor calls Save().
+  //
+  // Set pipelineCacheStore of Graphics/Compute/RT pipeline makers to use the cache. If a_creationFeedback is true
+  // (requires VK_EXT_pipeline_creation_feedback or Vulkan 1.3), makers also collect cache hit statistics.
+  //
+  class PipelineCacheStore
+  {
+  public:
+    PipelineCacheStore(VkDevice a_device, VkPhysicalDevice a_physicalDevice, const std::string &a_directory,
+                       bool a_creationFeedback = false);
+    ~PipelineCacheStore();
+
+    PipelineCacheStore(PipelineCacheStore const&) = delete;
+    PipelineCacheStore& operator=(PipelineCacheStore const&) = delete;
+
+    VkPipelineCache Get() const { return m_cache; }
+    const std::string& GetPath() const { return m_path; }
+    bool LoadedFromDisk() const { return m_loaded; }
+
+    bool Save();
+
+    // not thread safe: called by pipeline makers around vkCreate*Pipelines, ChainFeedback returns new pNext for create info
+    const void* ChainFeedback(const void* a_pNext);
+    void        CollectFeedback();
+
+    const PipelineCacheStats& GetStats() const { return m_stats; }
+    void PrintStats() const;
+
+  private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPipelineCache m_cache = VK_NULL_HANDLE;
+    std::string m_path;
+    bool m_loaded = false;
+
+    bool m_feedbackEnabled = false;
+    bool m_feedbackChained = false;
+#if defined(VK_EXT_pipeline_creation_feedback)
+    VkPipelineCreationFeedbackEXT           m_feedback{};
+    VkPipelineCreationFeedbackCreateInfoEXT m_feedbackInfo{};
+#endif
+    PipelineCacheStats m_stats;
+  };
+}
+
+#endif// VK_UTILS_PIPELINE_CACHE_H
@@ -0,0 +1,397 @@
+#include "vk_pipeline_library.h"
+#include "vk_pipeline.h"
+#include "vk_pipeline_cache.h"
+#include "vk_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <string>
+
+namespace vk_utils
+{
+  static void pushFloat(std::vector<uint64_t> &a_key, float a_value)
+  {
+    uint32_t bits = 0;
+    memcpy(&bits, &a_value, sizeof(bits));
+    a_key.push_back(bits);
+  }
+
+  static void pushStage(std::vector<uint64_t> &a_key, const VkPipelineShaderStageCreateInfo &a_stage, uint64_t a_codeHash)
+  {
+    a_key.push_back(uint64_t(a_stage.stage));
+    a_key.push_back(a_codeHash);
+    a_key.push_back(std::hash<std::string>()(a_stage.pName != nullptr ? a_stage.pName : ""));
+
+    // specialization constants change the compiled stage as much as the code does; data is packed into 64-bit words
+    //
+    const VkSpecializationInfo* spec = a_stage.pSpecializationInfo;
+    if(spec == nullptr)
+    {
+      a_key.push_back(0);
+      return;
+    }
+    a_key.push_back(uint64_t(spec->mapEntryCount) + 1);
+    for(uint32_t i = 0; i < spec->mapEntryCount; ++i)
+    {
+      const VkSpecializationMapEntry &entry = spec->pMapEntries[i];
+      a_key.push_back((uint64_t(entry.constantID) << 32u) | entry.offset);
+      a_key.push_back(uint64_t(entry.size));
+    }
+    a_key.push_back(uint64_t(spec->dataSize));
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(spec->pData);
+    for(size_t offset = 0; offset < spec->dataSize; offset += sizeof(uint64_t))
+    {
+      uint64_t word = 0;
+      memcpy(&word, data + offset, std::min(sizeof(uint64_t), spec->dataSize - offset));
+      a_key.push_back(word);
+    }
+  }
+
+  static void pushMultisample(std::vector<uint64_t> &a_key, const VkPipelineMultisampleStateCreateInfo &a_state)
+  {
+    a_key.push_back(uint64_t(a_state.rasterizationSamples));
+    a_key.push_back(uint64_t(a_state.sampleShadingEnable));
+    pushFloat(a_key, a_state.minSampleShading);
+    a_key.push_back(uint64_t(a_state.alphaToCoverageEnable));
+    a_key.push_back(uint64_t(a_state.alphaToOneEnable));
+  }
+
+  static void pushStencilOp(std::vector<uint64_t> &a_key, const VkStencilOpState &a_op)
+  {
+    a_key.push_back(uint64_t(a_op.failOp));
+    a_key.push_back(uint64_t(a_op.passOp));
+    a_key.push_back(uint64_t(a_op.depthFailOp));
+    a_key.push_back(uint64_t(a_op.compareOp));
+    a_key.push_back(uint64_t(a_op.compareMask));
+    a_key.push_back(uint64_t(a_op.writeMask));
+    a_key.push_back(uint64_t(a_op.reference));
+  }
+
+  // render pass (or dynamic rendering formats), subpass and dynamic states are part of every key
+  static void pushCommon(std::vector<uint64_t> &a_key, const GraphicsPipelineMaker &a_maker, VkRenderPass a_renderPass,
+                         uint32_t a_subpass, const std::vector<VkDynamicState> &a_dynamicStates)
+  {
+    a_key.push_back(handleToU64(a_renderPass));
+    if(a_renderPass == VK_NULL_HANDLE)
+    {
+      a_key.insert(a_key.end(), { uint64_t(a_maker.renderingViewMask), uint64_t(a_maker.renderingDepthFormat),
+                                  uint64_t(a_maker.renderingStencilFormat), uint64_t(a_maker.renderingColorFormats.size()) });
+      for(auto format : a_maker.renderingColorFormats)
+        a_key.push_back(uint64_t(format));
+    }
+    a_key.push_back(a_subpass);
+    a_key.push_back(uint64_t(a_maker.pipelineFlags));
+    for(auto state : a_dynamicStates)
+      a_key.push_back(uint64_t(state));
+  }
+
+  size_t GraphicsPipelineLibrary::KeyHash::operator()(const std::vector<uint64_t> &a_key) const
+  {
+    size_t seed = a_key.size();
+    for(uint64_t v : a_key)
+      seed ^= std::hash<uint64_t>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+  }
+
+#if defined(VK_EXT_graphics_pipeline_library)
+
+  bool GraphicsPipelineLibrary::IsSupported(VkPhysicalDevice a_physicalDevice)
+  {
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures = {};
+    libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &libraryFeatures;
+    vkGetPhysicalDeviceFeatures2(a_physicalDevice, &features2);
+
+    return libraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+  }
+
+  GraphicsPipelineLibrary::GraphicsPipelineLibrary(VkDevice a_device, bool a_extensionEnabled, bool a_backgroundOptimize,
+                                                   PipelineCacheStore* a_pCacheStore) :
+                                                   m_device(a_device), m_backgroundOptimize(a_backgroundOptimize)
+  {
+    m_enabled = a_extensionEnabled;
+    if(a_pCacheStore != nullptr)
+      m_cache = a_pCacheStore->Get();
+    if(!m_enabled)
+      VK_UTILS_LOG_INFO("[GraphicsPipelineLibrary::GraphicsPipelineLibrary] graphicsPipelineLibrary is not enabled, using monolithic pipelines");
+  }
+
+  VkPipeline GraphicsPipelineLibrary::GetPart(const std::vector<uint64_t> &a_key, VkGraphicsPipelineCreateInfo &a_createInfo,
+                                              uint32_t a_partFlags)
+  {
+    auto found = m_parts.find(a_key);
+    if(found != m_parts.end())
+      return found->second;
+
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo = {};
+    libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+    libraryInfo.flags = VkGraphicsPipelineLibraryFlagsEXT(a_partFlags);
+    libraryInfo.pNext = a_createInfo.pNext; // dynamic rendering formats
+
+    a_createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    a_createInfo.pNext = &libraryInfo;
+    a_createInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+    VkPipeline part = VK_NULL_HANDLE;
+    if(vkCreateGraphicsPipelines(m_device, m_cache, 1, &a_createInfo, nullptr, &part) != VK_SUCCESS)
+    {
+      VK_UTILS_LOG_ERROR("[GraphicsPipelineLibrary::GetPart] failed to create pipeline library part");
+      return VK_NULL_HANDLE;
+    }
+    m_parts[a_key] = part;
+    return part;
+  }
+
+  VkPipeline GraphicsPipelineLibrary::Link(const GraphicsPipelineMaker &a_maker, uint32_t a_stageCount, VkPipelineLayout a_layout,
+                                           const VkPipelineVertexInputStateCreateInfo &a_vertexLayout, VkRenderPass a_renderPass,
+                                           const std::vector<VkDynamicState> &a_dynamicStates, uint32_t a_subpass)
+  {
+    if(!m_enabled)
+      return VK_NULL_HANDLE;
+
+#if defined(VK_KHR_dynamic_rendering)
+    VkPipelineRenderingCreateInfoKHR renderingInfo = a_maker.RenderingCreateInfo();
+    const void* pRendering = (a_renderPass == VK_NULL_HANDLE) ? &renderingInfo : nullptr;
+#else
+    const void* pRendering = nullptr;
+#endif
+
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = uint32_t(a_dynamicStates.size());
+    dynamicState.pDynamicStates    = a_dynamicStates.data();
+
+    std::vector<VkPipelineShaderStageCreateInfo> preRasterStages;
+    std::vector<VkPipelineShaderStageCreateInfo> fragmentStages;
+    std::vector<uint64_t> preRasterKey = { 1 };
+    std::vector<uint64_t> fragmentKey  = { 2 };
+    for(uint32_t i = 0; i < a_stageCount; ++i)
+    {
+      const auto &stage = a_maker.shaderStageInfos[i];
+      if(stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+      {
+        fragmentStages.push_back(stage);
+        pushStage(fragmentKey, stage, a_maker.shaderCodeHashes[i]);
+      }
+      else
+      {
+        preRasterStages.push_back(stage);
+        pushStage(preRasterKey, stage, a_maker.shaderCodeHashes[i]);
+      }
+    }
+
+    // vertex input interface
+    //
+    std::vector<uint64_t> vertexKey = { 0, uint64_t(a_maker.inputAssembly.topology), uint64_t(a_maker.inputAssembly.primitiveRestartEnable) };
+    for(uint32_t i = 0; i < a_vertexLayout.vertexBindingDescriptionCount; ++i)
+    {
+      const auto &binding = a_vertexLayout.pVertexBindingDescriptions[i];
+      vertexKey.insert(vertexKey.end(), { binding.binding, binding.stride, uint64_t(binding.inputRate) });
+    }
+    for(uint32_t i = 0; i < a_vertexLayout.vertexAttributeDescriptionCount; ++i)
+    {
+      const auto &attr = a_vertexLayout.pVertexAttributeDescriptions[i];
+      vertexKey.insert(vertexKey.end(), { attr.location, attr.binding, uint64_t(attr.format), attr.offset });
+    }
+    // vertex input part doesn't depend on the render pass or attachment formats, so it is shared between them
+    vertexKey.push_back(uint64_t(a_maker.pipelineFlags));
+    for(auto state : a_dynamicStates)
+      vertexKey.push_back(uint64_t(state));
+
+    VkGraphicsPipelineCreateInfo vertexInfo = {};
+    vertexInfo.pVertexInputState   = &a_vertexLayout;
+    vertexInfo.pInputAssemblyState = &a_maker.inputAssembly;
+    vertexInfo.pDynamicState       = &dynamicState;
+    vertexInfo.flags               = a_maker.pipelineFlags;
+    VkPipeline vertexPart = GetPart(vertexKey, vertexInfo, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT);
+
+    // pre-rasterization shaders
+    //
+    const auto &vp = a_maker.viewport;
+    const auto &rs = a_maker.rasterizer;
+    for(float v : { vp.x, vp.y, vp.width, vp.height, vp.minDepth, vp.maxDepth })
+      pushFloat(preRasterKey, v);
+    preRasterKey.insert(preRasterKey.end(), { uint64_t(int64_t(a_maker.scissor.offset.x)), uint64_t(int64_t(a_maker.scissor.offset.y)),
+                                              a_maker.scissor.extent.width, a_maker.scissor.extent.height });
+    preRasterKey.insert(preRasterKey.end(), { uint64_t(rs.depthClampEnable), uint64_t(rs.rasterizerDiscardEnable), uint64_t(rs.polygonMode),
+                                              uint64_t(rs.cullMode), uint64_t(rs.frontFace), uint64_t(rs.depthBiasEnable) });
+    for(float v : { rs.depthBiasConstantFactor, rs.depthBiasClamp, rs.depthBiasSlopeFactor, rs.lineWidth })
+      pushFloat(preRasterKey, v);
+    preRasterKey.push_back(handleToU64(a_layout));
+    pushCommon(preRasterKey, a_maker, a_renderPass, a_subpass, a_dynamicStates);
+
+    VkPipelineViewportStateCreateInfo viewportState = a_maker.viewportState;
+    viewportState.pViewports = &a_maker.viewport;
+    viewportState.pScissors  = &a_maker.scissor;
+
+    VkGraphicsPipelineCreateInfo preRasterInfo = {};
+    preRasterInfo.stageCount          = uint32_t(preRasterStages.size());
+    preRasterInfo.pStages             = preRasterStages.data();
+    preRasterInfo.pViewportState      = &viewportState;
+    preRasterInfo.pRasterizationState = &a_maker.rasterizer;
+    preRasterInfo.pDynamicState       = &dynamicState;
+    preRasterInfo.flags               = a_maker.pipelineFlags;
+    preRasterInfo.layout              = a_layout;
+    preRasterInfo.pNext               = pRendering;
+    preRasterInfo.renderPass          = a_renderPass;
+    preRasterInfo.subpass             = a_subpass;
+    VkPipeline preRasterPart = GetPart(preRasterKey, preRasterInfo, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+
+    // fragment shader
+    //
+    const auto &ds = a_maker.depthStencilTest;
+    fragmentKey.insert(fragmentKey.end(), { uint64_t(ds.depthTestEnable), uint64_t(ds.depthWriteEnable), uint64_t(ds.depthCompareOp),
+                                            uint64_t(ds.depthBoundsTestEnable), uint64_t(ds.stencilTestEnable) });
+    pushStencilOp(fragmentKey, ds.front);
+    pushStencilOp(fragmentKey, ds.back);
+    pushFloat(fragmentKey, ds.minDepthBounds);
+    pushFloat(fragmentKey, ds.maxDepthBounds);
+    pushMultisample(fragmentKey, a_maker.multisampling);
+    fragmentKey.push_back(handleToU64(a_layout));
+    pushCommon(fragmentKey, a_maker, a_renderPass, a_subpass, a_dynamicStates);
+
+    VkGraphicsPipelineCreateInfo fragmentInfo = {};
+    fragmentInfo.stageCount         = uint32_t(fragmentStages.size());
+    fragmentInfo.pStages            = fragmentStages.data();
+    fragmentInfo.pDepthStencilState = &a_maker.depthStencilTest;
+    fragmentInfo.pMultisampleState  = &a_maker.multisampling;
+    fragmentInfo.pDynamicState      = &dynamicState;
+    fragmentInfo.flags              = a_maker.pipelineFlags;
+    fragmentInfo.layout             = a_layout;
+    fragmentInfo.pNext              = pRendering;
+    fragmentInfo.renderPass         = a_renderPass;
+    fragmentInfo.subpass            = a_subpass;
+    VkPipeline fragmentPart = GetPart(fragmentKey, fragmentInfo, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+
+    // fragment output interface
+    //
+    const auto &cb = a_maker.colorBlending;
+    std::vector<uint64_t> outputKey = { 3, uint64_t(cb.logicOpEnable), uint64_t(cb.logicOp) };
+    for(float v : cb.blendConstants)
+      pushFloat(outputKey, v);
+    for(const auto &att : a_maker.colorBlendAttachments)
+    {
+      outputKey.insert(outputKey.end(), { uint64_t(att.blendEnable), uint64_t(att.srcColorBlendFactor), uint64_t(att.dstColorBlendFactor),
+                                          uint64_t(att.colorBlendOp), uint64_t(att.srcAlphaBlendFactor), uint64_t(att.dstAlphaBlendFactor),
+                                          uint64_t(att.alphaBlendOp), uint64_t(att.colorWriteMask) });
+    }
+    pushMultisample(outputKey, a_maker.multisampling);
+    pushCommon(outputKey, a_maker, a_renderPass, a_subpass, a_dynamicStates);
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = a_maker.colorBlending;
+    colorBlending.attachmentCount = uint32_t(a_maker.colorBlendAttachments.size());
+    colorBlending.pAttachments    = a_maker.colorBlendAttachments.data();
+
+    VkGraphicsPipelineCreateInfo outputInfo = {};
+    outputInfo.pColorBlendState  = &colorBlending;
+    outputInfo.pMultisampleState = &a_maker.multisampling;
+    outputInfo.pDynamicState     = &dynamicState;
+    outputInfo.flags             = a_maker.pipelineFlags;
+    outputInfo.pNext             = pRendering;
+    outputInfo.renderPass        = a_renderPass;
+    outputInfo.subpass           = a_subpass;
+    VkPipeline outputPart = GetPart(outputKey, outputInfo, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT);
+
+    if(vertexPart == VK_NULL_HANDLE || preRasterPart == VK_NULL_HANDLE || fragmentPart == VK_NULL_HANDLE || outputPart == VK_NULL_HANDLE)
+      return VK_NULL_HANDLE;
+
+    // link: fast now, optimized in background
+    //
+    const std::vector<VkPipeline> libraries = { vertexPart, preRasterPart, fragmentPart, outputPart };
+    auto linkParts = [device = m_device, cache = m_cache, libraries, a_layout, makerFlags = a_maker.pipelineFlags](VkPipelineCreateFlags a_flags)
+    {
+      VkPipelineLibraryCreateInfoKHR linkInfo = {};
+      linkInfo.sType        = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+      linkInfo.libraryCount = uint32_t(libraries.size());
+      linkInfo.pLibraries   = libraries.data();
+
+      VkGraphicsPipelineCreateInfo linkedInfo = {};
+      linkedInfo.sType  = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+      linkedInfo.pNext  = &linkInfo;
+      linkedInfo.flags  = a_flags | makerFlags;
+      linkedInfo.layout = a_layout;
+
+      VkPipeline pipeline = VK_NULL_HANDLE;
+      if(vkCreateGraphicsPipelines(device, cache, 1, &linkedInfo, nullptr, &pipeline) != VK_SUCCESS)
+        return VkPipeline(VK_NULL_HANDLE);
+      return pipeline;
+    };
+
+    VkPipeline fastPipeline = linkParts(0);
+    if(fastPipeline == VK_NULL_HANDLE)
+    {
+      VK_UTILS_LOG_ERROR("[GraphicsPipelineLibrary::Link] failed to link pipeline");
+      return VK_NULL_HANDLE;
+    }
+
+    if(m_backgroundOptimize)
+    {
+      m_optimizing[handleToU64(fastPipeline)] = std::async(std::launch::async, linkParts,
+                                                           VkPipelineCreateFlags(VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT));
+    }
+    return fastPipeline;
+  }
+
+#else
+
+  bool GraphicsPipelineLibrary::IsSupported(VkPhysicalDevice) { return false; }
+
+  GraphicsPipelineLibrary::GraphicsPipelineLibrary(VkDevice a_device, bool, bool a_backgroundOptimize, PipelineCacheStore*) :
+    m_device(a_device), m_backgroundOptimize(a_backgroundOptimize)
+  {
+    VK_UTILS_LOG_INFO("[GraphicsPipelineLibrary::GraphicsPipelineLibrary] built without VK_EXT_graphics_pipeline_library, using monolithic pipelines");
+  }
+
+  VkPipeline GraphicsPipelineLibrary::GetPart(const std::vector<uint64_t>&, VkGraphicsPipelineCreateInfo&, uint32_t) { return VK_NULL_HANDLE; }
+
+  VkPipeline GraphicsPipelineLibrary::Link(const GraphicsPipelineMaker&, uint32_t, VkPipelineLayout, const VkPipelineVertexInputStateCreateInfo&,
+                                           VkRenderPass, const std::vector<VkDynamicState>&, uint32_t)
+  {
+    return VK_NULL_HANDLE;
+  }
+
+#endif
+
+  GraphicsPipelineLibrary::~GraphicsPipelineLibrary()
+  {
+    WaitOptimized();
+    for(auto &[fast, future] : m_optimizing)
+    {
+      VkPipeline optimized = future.get();
+      if(optimized != VK_NULL_HANDLE)
+        vkDestroyPipeline(m_device, optimized, nullptr);
+    }
+    for(auto &[key, part] : m_parts)
+      vkDestroyPipeline(m_device, part, nullptr);
+  }
+
+  VkPipeline GraphicsPipelineLibrary::TakeOptimized(VkPipeline &a_pipeline)
+  {
+    auto found = m_optimizing.find(handleToU64(a_pipeline));
+    if(found == m_optimizing.end() || found->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      return VK_NULL_HANDLE;
+
+    VkPipeline optimized = found->second.get();
+    m_optimizing.erase(found);
+    if(optimized == VK_NULL_HANDLE)
+    {
+      VK_UTILS_LOG_WARNING("[GraphicsPipelineLibrary::TakeOptimized] optimized link failed, keeping fast-linked pipeline");
+      return VK_NULL_HANDLE;
+    }
+
+    VkPipeline fastPipeline = a_pipeline;
+    a_pipeline = optimized;
+    return fastPipeline;
+  }
+
+  void GraphicsPipelineLibrary::WaitOptimized()
+  {
+    for(auto &[fast, future] : m_optimizing)
+      future.wait();
+  }
+}
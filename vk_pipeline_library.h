@@ -0,0 +1,72 @@
+#ifndef VK_UTILS_PIPELINE_LIBRARY_H
+#define VK_UTILS_PIPELINE_LIBRARY_H
+
+#include "vk_include.h"
+
+#include <future>
+#include <unordered_map>
+#include <vector>
+
+namespace vk_utils
+{
+  struct GraphicsPipelineMaker;
+  class PipelineCacheStore;
+
+  // Graphics pipelines assembled from VK_EXT_graphics_pipeline_library parts: vertex input interface, pre-rasterization
+  // shaders, fragment shader and fragment output interface are created and cached separately, so changing e.g. only the
+  // render pass or the fragment shader reuses all other parts. Parts are keyed by shader code hashes and fixed function state.
+  //
+  // Set pipelineLibrary of GraphicsPipelineMaker to use it: MakePipeline returns a fast-linked pipeline right away and
+  // an optimized (link time optimization) relink of the same parts starts in a background thread, TakeOptimized swaps
+  // them when it is ready. If IsEnabled() is false (device or headers lack the extension) MakePipeline creates
+  // monolithic pipelines as before. a_extensionEnabled tells whether VK_EXT_graphics_pipeline_library (and
+  // VK_KHR_pipeline_library) and its graphicsPipelineLibrary feature are enabled on a_device; use IsSupported() to decide that.
+  //
+  // Not thread safe; parts are owned by this object, linked pipelines are owned by the caller.
+  //
+  class GraphicsPipelineLibrary
+  {
+  public:
+    static bool IsSupported(VkPhysicalDevice a_physicalDevice);
+
+    GraphicsPipelineLibrary(VkDevice a_device, bool a_extensionEnabled, bool a_backgroundOptimize = true,
+                            PipelineCacheStore* a_pCacheStore = nullptr);
+    ~GraphicsPipelineLibrary();
+
+    GraphicsPipelineLibrary(GraphicsPipelineLibrary const&) = delete;
+    GraphicsPipelineLibrary& operator=(GraphicsPipelineLibrary const&) = delete;
+
+    bool IsEnabled() const { return m_enabled; }
+
+    // called by GraphicsPipelineMaker::MakePipeline, shader modules of a_maker must be valid; VK_NULL_HANDLE on failure
+    VkPipeline Link(const GraphicsPipelineMaker &a_maker, uint32_t a_stageCount, VkPipelineLayout a_layout,
+                    const VkPipelineVertexInputStateCreateInfo &a_vertexLayout, VkRenderPass a_renderPass,
+                    const std::vector<VkDynamicState> &a_dynamicStates, uint32_t a_subpass);
+
+    // if optimized version of a_pipeline is ready, a_pipeline is replaced with it and the fast-linked pipeline is returned
+    // (destroy it when GPU doesn't use it anymore); returns VK_NULL_HANDLE otherwise
+    VkPipeline TakeOptimized(VkPipeline &a_pipeline);
+    // blocks until all background relinks are finished
+    void       WaitOptimized();
+
+    size_t PartCount() const { return m_parts.size(); }
+
+  private:
+    struct KeyHash
+    {
+      size_t operator()(const std::vector<uint64_t> &a_key) const;
+    };
+
+    VkPipeline GetPart(const std::vector<uint64_t> &a_key, VkGraphicsPipelineCreateInfo &a_createInfo, uint32_t a_partFlags);
+
+    VkDevice        m_device  = VK_NULL_HANDLE;
+    VkPipelineCache m_cache   = VK_NULL_HANDLE;
+    bool            m_enabled = false;
+    bool            m_backgroundOptimize = true;
+
+    std::unordered_map<std::vector<uint64_t>, VkPipeline, KeyHash> m_parts;
+    std::unordered_map<uint64_t, std::future<VkPipeline>>         m_optimizing; // by fast-linked pipeline handle
+  };
+}
+
+#endif// VK_UTILS_PIPELINE_LIBRARY_H
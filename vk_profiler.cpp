@@ -0,0 +1,319 @@
+#include "vk_profiler.h"
+#include "vk_utils.h"
+#include "vk_trace.h"
+
+#include <algorithm>
+
+namespace vk_utils
+{
+  GpuProfiler::GpuProfiler(VkDevice a_device, VkPhysicalDevice a_physicalDevice, uint32_t a_queueFamilyIndex,
+                           uint32_t a_framesInFlight, uint32_t a_maxZonesPerFrame) : m_device(a_device), m_maxZones(a_maxZonesPerFrame)
+  {
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(a_physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(a_physicalDevice, &familyCount, families.data());
+    if(a_queueFamilyIndex >= familyCount || families[a_queueFamilyIndex].timestampValidBits == 0 || a_maxZonesPerFrame == 0)
+    {
+      VK_UTILS_LOG_WARNING("[GpuProfiler::GpuProfiler] queue family doesn't support timestamps, profiling is disabled");
+      return;
+    }
+
+    VkPhysicalDeviceProperties props = {};
+    vkGetPhysicalDeviceProperties(a_physicalDevice, &props);
+
+    const uint32_t validBits = families[a_queueFamilyIndex].timestampValidBits;
+    m_timestampMask   = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1ull);
+    m_timestampPeriod = double(props.limits.timestampPeriod);
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * m_maxZones;
+
+    m_slots.resize(std::max(a_framesInFlight, 1u));
+    for(auto &slot : m_slots)
+    {
+      VK_CHECK_RESULT(vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &slot.pool));
+      slot.zones.reserve(m_maxZones);
+    }
+
+    queryPoolInfo.queryCount = 2;
+    VK_CHECK_RESULT(vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &m_immediate.pool));
+    m_results.resize(2 * m_maxZones);
+  }
+
+  GpuProfiler::~GpuProfiler()
+  {
+    for(auto &slot : m_slots)
+      vkDestroyQueryPool(m_device, slot.pool, nullptr);
+    if(m_immediate.pool != VK_NULL_HANDLE)
+      vkDestroyQueryPool(m_device, m_immediate.pool, nullptr);
+  }
+
+  void GpuProfiler::BeginFrame(VkCommandBuffer a_cmdBuff)
+  {
+    if(!IsEnabled())
+      return;
+
+    if(!m_openZones.empty())
+      VK_UTILS_LOG_WARNING("[GpuProfiler::BeginFrame] previous frame has zones without EndZone");
+
+    m_frameIndex++;
+    FrameSlot &slot = m_slots[m_frameIndex % m_slots.size()];
+    if(!ResolveSlot(slot, false))
+    {
+      m_droppedFrames++;
+      slot.zones.clear();
+    }
+
+    vkCmdResetQueryPool(a_cmdBuff, slot.pool, 0, 2 * m_maxZones);
+    m_openZones.clear();
+    m_openExecTime = 0;
+    m_frameStarted = true;
+  }
+
+  void GpuProfiler::Resolve(bool a_wait)
+  {
+    for(auto &slot : m_slots)
+    {
+      const bool allEnded = std::all_of(slot.zones.begin(), slot.zones.end(), [](const ZoneRecord &zone) { return zone.ended; });
+      if(allEnded)
+        ResolveSlot(slot, a_wait);
+    }
+  }
+
+  uint32_t GpuProfiler::BeginZone(VkCommandBuffer a_cmdBuff, const char* a_name, GpuZoneKind a_kind)
+  {
+    if(!m_frameStarted)
+      return NO_ZONE;
+
+    FrameSlot &slot = m_slots[m_frameIndex % m_slots.size()];
+    if(slot.zones.size() >= m_maxZones)
+      return NO_ZONE;
+
+    ZoneRecord zone;
+    zone.statId   = StatId(m_openZones.empty() ? UINT32_MAX : slot.zones[m_openZones.back()].statId, a_name);
+    zone.query    = uint32_t(2 * slot.zones.size());
+    zone.kind     = a_kind;
+    zone.execTime = (a_kind != GpuZoneKind::NONE) && (m_openExecTime == 0);
+    if(a_kind != GpuZoneKind::NONE)
+      m_openExecTime++;
+
+    vkCmdWriteTimestamp(a_cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.pool, zone.query);
+
+    const uint32_t zoneId = uint32_t(slot.zones.size());
+    slot.zones.push_back(zone);
+    m_openZones.push_back(zoneId);
+    return zoneId;
+  }
+
+  void GpuProfiler::EndZone(VkCommandBuffer a_cmdBuff, uint32_t a_zone)
+  {
+    if(a_zone == NO_ZONE || !m_frameStarted)
+      return;
+
+    if(m_openZones.empty() || m_openZones.back() != a_zone)
+    {
+      VK_UTILS_LOG_WARNING("[GpuProfiler::EndZone] zones must be closed in reverse order of BeginZone");
+      return;
+    }
+    m_openZones.pop_back();
+
+    FrameSlot  &slot = m_slots[m_frameIndex % m_slots.size()];
+    ZoneRecord &zone = slot.zones[a_zone];
+    if(zone.kind != GpuZoneKind::NONE)
+      m_openExecTime--;
+    zone.ended = true;
+
+    vkCmdWriteTimestamp(a_cmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.pool, zone.query + 1);
+  }
+
+  uint32_t GpuProfiler::BeginImmediateZone(VkCommandBuffer a_cmdBuff, const char* a_name, GpuZoneKind a_kind)
+  {
+    if(!IsEnabled())
+      return NO_ZONE;
+
+    // previous immediate zone was not resolved after its wait (or never submitted)
+    //
+    if(!ResolveSlot(m_immediate, false))
+    {
+      m_droppedFrames++;
+      m_immediate.zones.clear();
+    }
+
+    ZoneRecord zone;
+    zone.statId   = StatId(UINT32_MAX, a_name);
+    zone.query    = 0;
+    zone.kind     = a_kind;
+    zone.execTime = (a_kind != GpuZoneKind::NONE);
+
+    vkCmdResetQueryPool(a_cmdBuff, m_immediate.pool, 0, 2);
+    vkCmdWriteTimestamp(a_cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_immediate.pool, zone.query);
+
+    m_immediate.zones.push_back(zone);
+    return 0;
+  }
+
+  void GpuProfiler::EndImmediateZone(VkCommandBuffer a_cmdBuff, uint32_t a_zone)
+  {
+    if(a_zone == NO_ZONE || m_immediate.zones.empty() || m_immediate.zones[0].ended)
+      return;
+
+    m_immediate.zones[0].ended = true;
+    vkCmdWriteTimestamp(a_cmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_immediate.pool, 1);
+  }
+
+  void GpuProfiler::ResolveImmediateZone()
+  {
+    if(!m_immediate.zones.empty() && m_immediate.zones[0].ended)
+      ResolveSlot(m_immediate, false);
+  }
+
+  const GpuZoneStats* GpuProfiler::FindZone(const std::string &a_name) const
+  {
+    for(const auto &stats : m_stats)
+    {
+      if(stats.name == a_name)
+        return &stats;
+    }
+    return nullptr;
+  }
+
+  void GpuProfiler::ResetStats()
+  {
+    for(auto &stats : m_stats)
+    {
+      const std::string name = stats.name;
+      const uint32_t parent  = stats.parent;
+      const uint32_t depth   = stats.depth;
+      stats        = GpuZoneStats();
+      stats.name   = name;
+      stats.parent = parent;
+      stats.depth  = depth;
+    }
+    m_execTime      = ExecTime();
+    m_droppedFrames = 0;
+  }
+
+  // returns false if results are not available yet, zones are kept then
+  //
+  bool GpuProfiler::ResolveSlot(FrameSlot &a_slot, bool a_wait)
+  {
+    if(a_slot.zones.empty())
+      return true;
+
+    for(const auto &zone : a_slot.zones)
+    {
+      if(!zone.ended)
+      {
+        VK_UTILS_LOG_WARNING("[GpuProfiler::ResolveSlot] zone '" + m_stats[zone.statId].name + "' has no EndZone, frame is skipped");
+        a_slot.zones.clear();
+        return true;
+      }
+    }
+
+    const uint32_t queryCount = uint32_t(2 * a_slot.zones.size());
+    const VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | (a_wait ? VK_QUERY_RESULT_WAIT_BIT : 0);
+    const VkResult res = vkGetQueryPoolResults(m_device, a_slot.pool, 0, queryCount, queryCount * sizeof(uint64_t), m_results.data(),
+                                               sizeof(uint64_t), flags);
+    if(res == VK_NOT_READY)
+      return false;
+    if(res != VK_SUCCESS)
+    {
+      VK_UTILS_LOG_WARNING("[GpuProfiler::ResolveSlot] vkGetQueryPoolResults failed: " + vk_utils::errorString(res));
+      a_slot.zones.clear();
+      return true;
+    }
+
+    TraceRecorder* recorder = getTraceRecorder();
+    for(const auto &zone : a_slot.zones)
+    {
+      const uint64_t ticks = (m_results[zone.query + 1] - m_results[zone.query]) & m_timestampMask;
+      const float    ms    = float(double(ticks) * m_timestampPeriod * 1e-6);
+
+      GpuZoneStats &stats = m_stats[zone.statId];
+      stats.msMin   = stats.count == 0 ? ms : std::min(stats.msMin, ms);
+      stats.msMax   = stats.count == 0 ? ms : std::max(stats.msMax, ms);
+      stats.msLast  = ms;
+      stats.msTotal += double(ms);
+      stats.count++;
+      stats.msAvg   = float(stats.msTotal / double(stats.count));
+
+      // invalid bits are undefined; the end is taken from the masked duration, so a wrapped counter keeps it after the begin
+      //
+      if(recorder != nullptr)
+      {
+        const uint64_t begin = m_results[zone.query] & m_timestampMask;
+        recorder->AddGpuEvent(this, stats.name, begin, begin + ticks, m_timestampPeriod);
+      }
+
+      if(!zone.execTime)
+        continue;
+
+      switch(zone.kind)
+      {
+      case GpuZoneKind::COPY_TO_GPU:   m_execTime.msCopyToGPU    += ms; break;
+      case GpuZoneKind::COPY_FROM_GPU: m_execTime.msCopyFromGPU  += ms; break;
+      case GpuZoneKind::EXECUTE:       m_execTime.msExecuteOnGPU += ms; break;
+      case GpuZoneKind::LAYOUT_CHANGE: m_execTime.msLayoutChange += ms; break;
+      default: break;
+      }
+    }
+
+    a_slot.zones.clear();
+    return true;
+  }
+
+  uint32_t GpuProfiler::StatId(uint32_t a_parent, const char* a_name)
+  {
+    const std::string key = std::to_string(a_parent) + ":" + a_name;
+    auto found = m_statIds.find(key);
+    if(found != m_statIds.end())
+      return found->second;
+
+    GpuZoneStats stats;
+    stats.name   = a_name;
+    stats.parent = a_parent;
+    stats.depth  = a_parent == UINT32_MAX ? 0 : m_stats[a_parent].depth + 1;
+    m_stats.push_back(stats);
+
+    const uint32_t statId = uint32_t(m_stats.size() - 1);
+    m_statIds[key] = statId;
+    return statId;
+  }
+
+  ////
+
+  ProfileZone::ProfileZone(GpuProfiler* a_profiler, VkCommandBuffer a_cmdBuff, const char* a_name, GpuZoneKind a_kind) :
+                           m_profiler(a_profiler), m_cmdBuff(a_cmdBuff)
+  {
+    if(m_profiler != nullptr)
+      m_zone = m_profiler->BeginZone(m_cmdBuff, a_name, a_kind);
+  }
+
+  ProfileZone::~ProfileZone()
+  {
+    if(m_profiler != nullptr)
+      m_profiler->EndZone(m_cmdBuff, m_zone);
+  }
+
+  uint32_t beginImmediateZone(GpuProfiler* a_profiler, VkCommandBuffer a_cmdBuff, const char* a_name, GpuZoneKind a_kind)
+  {
+    if(a_profiler == nullptr)
+      return GpuProfiler::NO_ZONE;
+    return a_profiler->BeginImmediateZone(a_cmdBuff, a_name, a_kind);
+  }
+
+  void endImmediateZone(GpuProfiler* a_profiler, VkCommandBuffer a_cmdBuff, uint32_t a_zone)
+  {
+    if(a_profiler != nullptr)
+      a_profiler->EndImmediateZone(a_cmdBuff, a_zone);
+  }
+
+  void resolveImmediateZones(GpuProfiler* a_profiler)
+  {
+    if(a_profiler != nullptr)
+      a_profiler->ResolveImmediateZone();
+  }
+}
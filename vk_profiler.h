@@ -0,0 +1,152 @@
+#ifndef VK_UTILS_PROFILER_H
+#define VK_UTILS_PROFILER_H
+
+#include "vk_include.h"
+#include "vk_context.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vk_utils
+{
+  // ExecTime field which a zone adds its time to
+  //
+  enum class GpuZoneKind
+  {
+    NONE,
+    COPY_TO_GPU,
+    COPY_FROM_GPU,
+    EXECUTE,
+    LAYOUT_CHANGE,
+  };
+
+  struct GpuZoneStats
+  {
+    std::string name;
+    uint32_t    parent  = UINT32_MAX; // index of the enclosing zone in GpuProfiler::GetStats(), UINT32_MAX for top level zones
+    uint32_t    depth   = 0;
+    uint32_t    count   = 0;
+    float       msLast  = 0.0f;
+    float       msMin   = 0.0f;
+    float       msAvg   = 0.0f;
+    float       msMax   = 0.0f;
+    double      msTotal = 0.0;
+  };
+
+  // GPU time of named, nested zones measured with timestamp queries.
+  //
+  // Frame loop: call BeginFrame(cmdBuff) at the start of every frame's first command buffer (outside of a render pass),
+  // then BeginZone/EndZone or ProfileZone around passes. Each of a_framesInFlight frames has its own query pool;
+  // BeginFrame reads results of the frame which used the pool before without waiting, so it must be finished by then
+  // (i.e. a_framesInFlight is not less than the number of frames the application keeps in flight). Unfinished frames are
+  // skipped and counted in DroppedFrames().
+  //
+  // Command buffers which are submitted and waited right away (copy helpers, AS builders, executeCommandBufferNow) use
+  // BeginImmediateZone / ResolveImmediateZone instead. They have their own query pool and don't touch frame slots,
+  // so the same profiler may be used by a frame loop and copy helpers at the same time.
+  //
+  // Zones with a kind also accumulate into GetExecTime(), unless they are nested into another zone with a kind.
+  // Not thread safe.
+  //
+  class GpuProfiler
+  {
+  public:
+    static constexpr uint32_t NO_ZONE = UINT32_MAX;
+
+    GpuProfiler(VkDevice a_device, VkPhysicalDevice a_physicalDevice, uint32_t a_queueFamilyIndex,
+                uint32_t a_framesInFlight = 2, uint32_t a_maxZonesPerFrame = 256);
+    ~GpuProfiler();
+
+    GpuProfiler(GpuProfiler const&) = delete;
+    GpuProfiler& operator=(GpuProfiler const&) = delete;
+
+    // false if the queue family has no timestamp support, all zones are ignored then
+    bool IsEnabled() const { return m_timestampMask != 0; }
+
+    void BeginFrame(VkCommandBuffer a_cmdBuff);
+    // reads results of all frames with finished zones; a_wait blocks until they are available,
+    // use it only if these command buffers are submitted
+    void Resolve(bool a_wait = false);
+
+    // returns NO_ZONE if disabled, BeginFrame was not called or the frame has a_maxZonesPerFrame zones already
+    uint32_t BeginZone(VkCommandBuffer a_cmdBuff, const char* a_name, GpuZoneKind a_kind = GpuZoneKind::NONE);
+    void     EndZone(VkCommandBuffer a_cmdBuff, uint32_t a_zone);
+
+    // top level zone outside of frames, one at a time; ResolveImmediateZone is called after the submit is waited
+    uint32_t BeginImmediateZone(VkCommandBuffer a_cmdBuff, const char* a_name, GpuZoneKind a_kind = GpuZoneKind::NONE);
+    void     EndImmediateZone(VkCommandBuffer a_cmdBuff, uint32_t a_zone);
+    void     ResolveImmediateZone();
+
+    const std::vector<GpuZoneStats>& GetStats() const { return m_stats; }
+    const GpuZoneStats* FindZone(const std::string &a_name) const; // first zone with this name
+    const ExecTime&     GetExecTime() const { return m_execTime; }
+    uint32_t            DroppedFrames() const { return m_droppedFrames; }
+    void                ResetStats();
+
+  private:
+    struct ZoneRecord
+    {
+      uint32_t    statId   = 0;
+      uint32_t    query    = 0;     // begin timestamp, end is query + 1
+      GpuZoneKind kind     = GpuZoneKind::NONE;
+      bool        execTime = false; // adds to m_execTime
+      bool        ended    = false;
+    };
+
+    struct FrameSlot
+    {
+      VkQueryPool             pool = VK_NULL_HANDLE;
+      std::vector<ZoneRecord> zones;
+    };
+
+    bool     ResolveSlot(FrameSlot &a_slot, bool a_wait);
+    uint32_t StatId(uint32_t a_parent, const char* a_name);
+
+    VkDevice m_device          = VK_NULL_HANDLE;
+    uint64_t m_timestampMask   = 0;
+    double   m_timestampPeriod = 1.0; // ns per tick
+    uint32_t m_maxZones        = 0;
+
+    std::vector<FrameSlot>  m_slots;
+    FrameSlot               m_immediate;     // 2 queries, zone of the last immediate submit
+    uint64_t                m_frameIndex    = 0;
+    bool                    m_frameStarted  = false;
+    std::vector<uint32_t>   m_openZones;     // stack of zone indices in the current slot
+    uint32_t                m_openExecTime  = 0;
+    uint32_t                m_droppedFrames = 0;
+    std::vector<uint64_t>   m_results;
+
+    std::vector<GpuZoneStats>                 m_stats;
+    std::unordered_map<std::string, uint32_t> m_statIds; // "parent:name" -> index in m_stats
+    ExecTime                                  m_execTime {};
+  };
+
+  // RAII zone, does nothing if a_profiler is null
+  //
+  class ProfileZone
+  {
+  public:
+    ProfileZone(GpuProfiler* a_profiler, VkCommandBuffer a_cmdBuff, const char* a_name, GpuZoneKind a_kind = GpuZoneKind::NONE);
+    ProfileZone(GpuProfiler &a_profiler, VkCommandBuffer a_cmdBuff, const char* a_name, GpuZoneKind a_kind = GpuZoneKind::NONE) :
+                ProfileZone(&a_profiler, a_cmdBuff, a_name, a_kind) {}
+    ~ProfileZone();
+
+    ProfileZone(ProfileZone const&) = delete;
+    ProfileZone& operator=(ProfileZone const&) = delete;
+
+  private:
+    GpuProfiler*    m_profiler = nullptr;
+    VkCommandBuffer m_cmdBuff  = VK_NULL_HANDLE;
+    uint32_t        m_zone     = GpuProfiler::NO_ZONE;
+  };
+
+  // one zone per command buffer which is submitted and waited right away (see GpuProfiler::BeginImmediateZone),
+  // resolveImmediateZones reads the result after the wait. All of them accept null a_profiler.
+  //
+  uint32_t beginImmediateZone(GpuProfiler* a_profiler, VkCommandBuffer a_cmdBuff, const char* a_name, GpuZoneKind a_kind);
+  void     endImmediateZone(GpuProfiler* a_profiler, VkCommandBuffer a_cmdBuff, uint32_t a_zone);
+  void     resolveImmediateZones(GpuProfiler* a_profiler);
+}
+
+#endif// VK_UTILS_PROFILER_H
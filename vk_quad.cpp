@@ -1,5 +1,6 @@
 #include "vk_quad.h"
 #include "vk_utils.h"
+#include "vk_shader_module_cache.h"
 
 #include <vector>
 
@@ -8,6 +9,97 @@
 #include <memory>
 
 
+// vertex and fragment stages of a quad, taken from a_cache if it is not null
+//
+static void loadQuadStages(VkDevice a_device, vk_utils::ShaderModuleCache* a_cache, const char* a_vspath, const char* a_fspath,
+                           VkPipelineShaderStageCreateInfo a_stages[2])
+{
+  if(a_cache != nullptr)
+  {
+    if(!a_cache->Acquire(a_vspath, VK_SHADER_STAGE_VERTEX_BIT, a_stages[0]) ||
+       !a_cache->Acquire(a_fspath, VK_SHADER_STAGE_FRAGMENT_BIT, a_stages[1]))
+      RUN_TIME_ERROR("[FSQuad::Create]: can not load shaders");
+    return;
+  }
+
+  auto vertShaderCode = vk_utils::readSPVFile(a_vspath);
+  auto fragShaderCode = vk_utils::readSPVFile(a_fspath);
+
+  if(vertShaderCode.size() == 0 || fragShaderCode.size() == 0)
+    RUN_TIME_ERROR("[FSQuad::Create]: can not load shaders");
+
+  a_stages[0] = {};
+  a_stages[0].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  a_stages[0].stage  = VK_SHADER_STAGE_VERTEX_BIT;
+  a_stages[0].module = vk_utils::createShaderModule(a_device, vertShaderCode);
+  a_stages[0].pName  = "main";
+
+  a_stages[1] = {};
+  a_stages[1].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  a_stages[1].stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
+  a_stages[1].module = vk_utils::createShaderModule(a_device, fragShaderCode);
+  a_stages[1].pName  = "main";
+}
+
+static void releaseQuadStages(VkDevice a_device, vk_utils::ShaderModuleCache* a_cache, VkPipelineShaderStageCreateInfo a_stages[2])
+{
+  for(int i = 0; i < 2; ++i)
+  {
+    if(a_cache != nullptr)
+      a_cache->Release(a_stages[i]);
+    else
+      vkDestroyShaderModule(a_device, a_stages[i].module, nullptr);
+  }
+}
+
+// begins either render pass with a_framebuffer or dynamic rendering to a_targetView, target is cleared to black
+//
+static void beginQuadRendering(VkCommandBuffer a_cmdBuff, const vk_utils::RenderTargetInfo2D &a_rtInfo, VkRenderPass a_renderPass,
+                               VkFramebuffer a_framebuffer, VkImageView a_targetView)
+{
+  VkClearValue clearValues[1] = {};
+  clearValues[0].color        = {0.0f, 0.0f, 0.0f, 1.0f};
+
+  VkRect2D renderArea = {};
+  renderArea.offset   = { 0, 0 };
+  renderArea.extent   = a_rtInfo.size;
+
+  if(a_rtInfo.dynamicRendering)
+  {
+#if defined(VK_KHR_dynamic_rendering)
+    VkRenderingAttachmentInfoKHR colorAttachment = vk_utils::renderingAttachment(a_targetView, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                                                 a_rtInfo.loadOp, VK_ATTACHMENT_STORE_OP_STORE, clearValues[0]);
+    vk_utils::beginRendering(a_cmdBuff, renderArea, &colorAttachment, 1);
+#else
+    (void)a_targetView;
+#endif
+    return;
+  }
+
+  VkRenderPassBeginInfo renderPassInfo = {};
+  renderPassInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass      = a_renderPass;
+  renderPassInfo.framebuffer     = a_framebuffer;
+  renderPassInfo.renderArea      = renderArea;
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues    = &clearValues[0];
+
+  vkCmdBeginRenderPass(a_cmdBuff, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+static void endQuadRendering(VkCommandBuffer a_cmdBuff, const vk_utils::RenderTargetInfo2D &a_rtInfo)
+{
+#if defined(VK_KHR_dynamic_rendering)
+  if(a_rtInfo.dynamicRendering)
+  {
+    vk_utils::endRendering(a_cmdBuff);
+    return;
+  }
+#endif
+  (void)a_rtInfo;
+  vkCmdEndRenderPass(a_cmdBuff);
+}
+
 vk_utils::FSQuad::~FSQuad()
 {
   if(m_pipeline != nullptr)
@@ -29,31 +121,10 @@ void vk_utils::FSQuad::Create(VkDevice a_device, const char* a_vspath, const cha
   m_device       = a_device;
   m_fbSize       = a_rtInfo.size;
   m_rtCreateInfo = a_rtInfo;
-  
-  auto vertShaderCode = vk_utils::readSPVFile(a_vspath);
-  auto fragShaderCode = vk_utils::readSPVFile(a_fspath);
-  
-  if(vertShaderCode.size() == 0 || fragShaderCode.size() == 0)
-    RUN_TIME_ERROR("[FSQuad::Create]: can not load shaders");
 
-  VkShaderModule vertShaderModule = vk_utils::createShaderModule(a_device, vertShaderCode);
-  VkShaderModule fragShaderModule = vk_utils::createShaderModule(a_device, fragShaderCode);
+  VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+  loadQuadStages(a_device, m_shaderModuleCache, a_vspath, a_fspath, shaderStages);
 
-  // create pipeline layout first
-  //
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-  vertShaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage  = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName  = "main";  
-  
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-  fragShaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName  = "main";  
-
-  VkPipelineShaderStageCreateInfo      shaderStages[]  = { vertShaderStageInfo, fragShaderStageInfo };  
   VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
   vertexInputInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
   vertexInputInfo.vertexBindingDescriptionCount   = 0;
@@ -148,7 +219,19 @@ void vk_utils::FSQuad::Create(VkDevice a_device, const char* a_vspath, const cha
 
   VK_CHECK_RESULT(vkCreatePipelineLayout(a_device, &pipelineLayoutInfo, nullptr, &m_layout));
 
-  m_renderPass = vk_utils::createRenderPass(m_device, a_rtInfo);
+  // with dynamic rendering the pipeline is created against the target format, no render pass is needed
+  //
+#if defined(VK_KHR_dynamic_rendering)
+  VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+  renderingInfo.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+  renderingInfo.colorAttachmentCount    = 1;
+  renderingInfo.pColorAttachmentFormats = &m_rtCreateInfo.format;
+#else
+  if(a_rtInfo.dynamicRendering)
+    RUN_TIME_ERROR("[FSQuad::Create]: VK_KHR_dynamic_rendering is not available");
+#endif
+  if(!a_rtInfo.dynamicRendering)
+    m_renderPass = vk_utils::createRenderPass(m_device, a_rtInfo);
   
   // finally create graphics pipeline
   //
@@ -166,15 +249,24 @@ void vk_utils::FSQuad::Create(VkDevice a_device, const char* a_vspath, const cha
   pipelineInfo.renderPass          = m_renderPass;
   pipelineInfo.subpass             = 0;
   pipelineInfo.basePipelineHandle  = VK_NULL_HANDLE;  
+#if defined(VK_KHR_dynamic_rendering)
+  if(a_rtInfo.dynamicRendering)
+    pipelineInfo.pNext             = &renderingInfo;
+#endif
   
   VK_CHECK_RESULT(vkCreateGraphicsPipelines(a_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
 
-  vkDestroyShaderModule(m_device, fragShaderModule, nullptr);
-  vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
+  releaseQuadStages(m_device, m_shaderModuleCache, shaderStages);
 }
 
 void vk_utils::FSQuad::SetRenderTarget(VkImageView a_imageView)
 {
+  if(m_rtCreateInfo.dynamicRendering)
+  {
+    m_targetView = a_imageView;
+    return;
+  }
+
   if(m_fbTarget != nullptr)
     vkDestroyFramebuffer(m_device, m_fbTarget, NULL);
 
@@ -198,19 +290,7 @@ void vk_utils::FSQuad::SetRenderTarget(VkImageView a_imageView)
 
 void vk_utils::FSQuad::DrawCmd(VkCommandBuffer a_cmdBuff, VkDescriptorSet a_inTexDescriptor, float a_offsAndScale[4], void* pcData, size_t pcSize)
 {
-  VkRenderPassBeginInfo renderPassInfo = {};
-  renderPassInfo.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  renderPassInfo.renderPass        = m_renderPass;
-  renderPassInfo.framebuffer       = m_fbTarget;
-  renderPassInfo.renderArea.offset = { 0, 0 };
-  renderPassInfo.renderArea.extent = m_fbSize;
-
-  VkClearValue clearValues[1]    = {};
-  clearValues[0].color           = {0.0f, 0.0f, 0.0f, 1.0f};
-  renderPassInfo.clearValueCount = 1;
-  renderPassInfo.pClearValues    = &clearValues[0];  
-
-  vkCmdBeginRenderPass(a_cmdBuff, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);  
+  beginQuadRendering(a_cmdBuff, m_rtCreateInfo, m_renderPass, m_fbTarget, m_targetView);
 
   vkCmdBindPipeline      (a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
   vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 0, 1, &a_inTexDescriptor, 0, NULL);
@@ -232,7 +312,7 @@ void vk_utils::FSQuad::DrawCmd(VkCommandBuffer a_cmdBuff, VkDescriptorSet a_inTe
 
   vkCmdDraw(a_cmdBuff, 4, 1, 0, 0);
 
-  vkCmdEndRenderPass(a_cmdBuff);
+  endQuadRendering(a_cmdBuff, m_rtCreateInfo);
 }
 
 namespace vk_utils
@@ -260,30 +340,9 @@ void QuadRenderer::Create(VkDevice a_device, const char* a_vspath, const char* a
   m_fbSize = a_rtInfo.size;
   m_rtCreateInfo = a_rtInfo;
 
-  auto vertShaderCode = vk_utils::readSPVFile(a_vspath);
-  auto fragShaderCode = vk_utils::readSPVFile(a_fspath);
-
-  if (vertShaderCode.size() == 0 || fragShaderCode.size() == 0)
-    RUN_TIME_ERROR("[FSQuad::Create]: can not load shaders");
+  VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+  loadQuadStages(a_device, m_shaderModuleCache, a_vspath, a_fspath, shaderStages);
 
-  VkShaderModule vertShaderModule = vk_utils::createShaderModule(a_device, vertShaderCode);
-  VkShaderModule fragShaderModule = vk_utils::createShaderModule(a_device, fragShaderCode);
-
-  // create pipeline layout first
-  //
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-  vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-  fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo      shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
   VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
   vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
   vertexInputInfo.vertexBindingDescriptionCount = 0;
@@ -386,7 +445,19 @@ void QuadRenderer::Create(VkDevice a_device, const char* a_vspath, const char* a
 
   VK_CHECK_RESULT(vkCreatePipelineLayout(a_device, &pipelineLayoutInfo, nullptr, &m_layout));
 
-  m_renderPass = vk_utils::createRenderPass(m_device, a_rtInfo);
+  // with dynamic rendering the pipeline is created against the target format, no render pass is needed
+  //
+#if defined(VK_KHR_dynamic_rendering)
+  VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachmentFormats = &m_rtCreateInfo.format;
+#else
+  if(a_rtInfo.dynamicRendering)
+    RUN_TIME_ERROR("[QuadRenderer::Create]: VK_KHR_dynamic_rendering is not available");
+#endif
+  if(!a_rtInfo.dynamicRendering)
+    m_renderPass = vk_utils::createRenderPass(m_device, a_rtInfo);
 
   // finally create graphics pipeline
   //
@@ -404,15 +475,24 @@ void QuadRenderer::Create(VkDevice a_device, const char* a_vspath, const char* a
   pipelineInfo.renderPass = m_renderPass;
   pipelineInfo.subpass = 0;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+#if defined(VK_KHR_dynamic_rendering)
+  if(a_rtInfo.dynamicRendering)
+    pipelineInfo.pNext = &renderingInfo;
+#endif
 
   VK_CHECK_RESULT(vkCreateGraphicsPipelines(a_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
 
-  vkDestroyShaderModule(m_device, fragShaderModule, nullptr);
-  vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
+  releaseQuadStages(m_device, m_shaderModuleCache, shaderStages);
 }
 
 void QuadRenderer::SetRenderTarget(VkImageView a_imageView)
 {
+  if (m_rtCreateInfo.dynamicRendering)
+  {
+    m_targetView = a_imageView;
+    return;
+  }
+
   if (m_fbTarget != nullptr)
     vkDestroyFramebuffer(m_device, m_fbTarget, NULL);
 
@@ -437,24 +517,13 @@ void QuadRenderer::SetRenderTarget(VkImageView a_imageView)
 void QuadRenderer::DrawCmd(VkCommandBuffer a_cmdBuff, VkDescriptorSet a_inTexDescriptor, float a_offsAndScale[4], void* pcData, size_t pcSize)
 {
   (void)a_offsAndScale;
-  VkRenderPassBeginInfo renderPassInfo = {};
-  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  renderPassInfo.renderPass = m_renderPass;
-  renderPassInfo.framebuffer = m_fbTarget;
-  renderPassInfo.renderArea.offset = { 0, 0 };
-  renderPassInfo.renderArea.extent = m_fbSize;
-
-  VkClearValue clearValues[1] = {};
-  clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-  renderPassInfo.clearValueCount = 1;
-  renderPassInfo.pClearValues = &clearValues[0];
    
   //VkRect2D scissor{};
   //scissor.offset = {0, 0};
   //scissor.extent = {1024, 1024};
   //vkCmdSetScissor(a_cmdBuff, 0, 1, &scissor); // this should be enabled for pipeline, can't require that ("when the graphics pipeline is created with VK_DYNAMIC_STATE_SCISSOR")
 
-  vkCmdBeginRenderPass(a_cmdBuff, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  beginQuadRendering(a_cmdBuff, m_rtCreateInfo, m_renderPass, m_fbTarget, m_targetView);
    
   vkCmdBindPipeline(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
   vkCmdBindDescriptorSets(a_cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 0, 1, &a_inTexDescriptor, 0, NULL);
@@ -466,7 +535,7 @@ void QuadRenderer::DrawCmd(VkCommandBuffer a_cmdBuff, VkDescriptorSet a_inTexDes
   
   vkCmdDraw(a_cmdBuff, 3, 1, 0, 0);
 
-  vkCmdEndRenderPass(a_cmdBuff);
+  endQuadRendering(a_cmdBuff, m_rtCreateInfo);
 }
 
 
@@ -5,6 +5,8 @@
 
 namespace vk_utils
 {
+  class ShaderModuleCache;
+
   /**
   \brief simple API for drawing textured quads (2D rectangles) on screen 
   */
@@ -16,8 +18,8 @@ namespace vk_utils
     /**
     \brief Create resources that are needed to draw textured quad
     \param a_device - input Vulkan logical device
-    \param a_vspath - input path to special quad vertex shader (compiled to SPIR-V)
-    \param a_fspath - input path to quad fragment shader       (compiled to SPIR-V)
+    \param a_vspath - input path to special quad vertex shader (compiled to SPIR-V) or embedded shader id (see vk_embedded_shaders.h)
+    \param a_fspath - input path to quad fragment shader       (compiled to SPIR-V) or embedded shader id
     \param a_rtInfo - input render target info; you shoud specify it due to Vulkan requires a lot of detailsto be specified. 
                       I. e. you should know a lot in advance about images that you are going to render in to. 
 
@@ -30,6 +32,8 @@ namespace vk_utils
 
       The future implementations is assume to have some cache of vulkan frame buffer objects for each input image view
       The current implementation make new framebuffer for each call of 'SetRenderTarget' (destroying the old one of cource).
+      With RenderTargetInfo2D::dynamicRendering no framebuffer is created, the view is just remembered; 
+      it should be in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL when 'DrawCmd' commands are executed.
     */
     virtual void SetRenderTarget(VkImageView a_imageView) = 0; 
 
@@ -41,6 +45,15 @@ namespace vk_utils
     \param a_offsAndScale    - input array of packed scale ([0],[1]) and offset ([2],[3]);
     */
     virtual void DrawCmd(VkCommandBuffer a_cmdBuff, VkDescriptorSet a_inTexDescriptor, float a_offsAndScale[4], void* pcData = nullptr, size_t pcSize = 128) = 0;
+
+    /**
+    \brief Share quad shader modules with other pipelines; should be called before 'Create'
+    \param a_cache - input shader module cache, must outlive 'Create' call
+    */
+    void SetShaderModuleCache(ShaderModuleCache* a_cache) { m_shaderModuleCache = a_cache; }
+
+  protected:
+    ShaderModuleCache* m_shaderModuleCache = nullptr;
   };
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,306 @@
+#include "vk_residency.h"
+#include "vk_utils.h"
+#include "vk_images.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+namespace vk_utils
+{
+  ResidencyManager::ResidencyManager(VkPhysicalDevice a_physicalDevice, std::shared_ptr<IResourceManager> a_pResMgr,
+                                     VkDeviceSize a_minHeadroom, uint32_t a_framesInFlight) :
+    m_physicalDevice(a_physicalDevice), m_pResMgr(a_pResMgr), m_minHeadroom(a_minHeadroom), m_framesInFlight(a_framesInFlight)
+  {
+    assert(m_pResMgr != nullptr);
+    m_pCopy = m_pResMgr->GetCopyEngine();
+    if(m_pCopy == nullptr)
+      VK_UTILS_LOG_WARNING("[ResidencyManager::ResidencyManager] resource manager has no copy engine, eviction is disabled");
+
+    uint32_t extCount = 0;
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extCount);
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extCount, extensions.data());
+    for(const auto& ext : extensions)
+    {
+      if(strcmp(ext.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+        m_budgetExt = true;
+    }
+
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProps);
+    for(uint32_t i = 0; i < memProps.memoryHeapCount; ++i)
+    {
+      if(memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        m_deviceLocalHeapSize = std::max(m_deviceLocalHeapSize, memProps.memoryHeaps[i].size);
+    }
+  }
+
+  void ResidencyManager::Cleanup()
+  {
+    for(auto& [id, res] : m_resources)
+    {
+      if(res.buffer != VK_NULL_HANDLE)
+        m_pResMgr->DestroyBuffer(res.buffer);
+      if(res.image != VK_NULL_HANDLE)
+        m_pResMgr->DestroyImage(res.image);
+      if(res.hostCopy != VK_NULL_HANDLE)
+      {
+        m_pResMgr->UnmapBuffer(res.hostCopy);
+        m_pResMgr->DestroyBuffer(res.hostCopy);
+      }
+    }
+    m_resources.clear();
+    m_stats.residentBytes = 0;
+  }
+
+  uint32_t ResidencyManager::CreateBuffer(VkDeviceSize a_size, VkBufferUsageFlags a_usage, VkMemoryAllocateFlags a_flags)
+  {
+    Resource res;
+    res.size       = a_size;
+    res.bufUsage   = a_usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    res.allocFlags = a_flags;
+    res.lastUseFrame = m_frame;
+    res.buffer     = m_pResMgr->CreateBuffer(res.size, res.bufUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, res.allocFlags);
+    if(res.buffer == VK_NULL_HANDLE)
+      return UINT32_MAX;
+
+    m_stats.residentBytes += res.size;
+    m_resources[m_nextId] = res;
+    return m_nextId++;
+  }
+
+  uint32_t ResidencyManager::CreateImage(const VkImageCreateInfo& a_createInfo, VkImageLayout a_layout)
+  {
+    Resource res;
+    res.isImage   = true;
+    res.imgInfo   = a_createInfo;
+    res.imgInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    res.imgLayout = a_layout;
+    res.lastUseFrame = m_frame;
+    res.pinned    = a_createInfo.imageType != VK_IMAGE_TYPE_2D || a_createInfo.mipLevels != 1 ||
+                    a_createInfo.arrayLayers != 1 || isDepthOrStencil(a_createInfo.format);
+    res.size      = VkDeviceSize(a_createInfo.extent.width) * a_createInfo.extent.height * bppFromVkFormat(a_createInfo.format);
+    res.image     = m_pResMgr->CreateImage(res.imgInfo);
+    if(res.image == VK_NULL_HANDLE)
+      return UINT32_MAX;
+
+    m_stats.residentBytes += res.size;
+    m_resources[m_nextId] = res;
+    return m_nextId++;
+  }
+
+  VkBuffer ResidencyManager::UseBuffer(uint32_t a_id)
+  {
+    auto it = m_resources.find(a_id);
+    if(it == m_resources.end() || it->second.isImage)
+    {
+      VK_UTILS_LOG_WARNING("[ResidencyManager::UseBuffer] unknown buffer id");
+      return VK_NULL_HANDLE;
+    }
+
+    it->second.lastUseFrame = m_frame;
+    if(!it->second.resident && !Restore(it->second))
+      return VK_NULL_HANDLE;
+
+    return it->second.buffer;
+  }
+
+  VkImage ResidencyManager::UseImage(uint32_t a_id)
+  {
+    auto it = m_resources.find(a_id);
+    if(it == m_resources.end() || !it->second.isImage)
+    {
+      VK_UTILS_LOG_WARNING("[ResidencyManager::UseImage] unknown image id");
+      return VK_NULL_HANDLE;
+    }
+
+    it->second.lastUseFrame = m_frame;
+    if(!it->second.resident && !Restore(it->second))
+      return VK_NULL_HANDLE;
+
+    return it->second.image;
+  }
+
+  void ResidencyManager::Destroy(uint32_t a_id)
+  {
+    auto it = m_resources.find(a_id);
+    if(it == m_resources.end())
+      return;
+
+    auto& res = it->second;
+    if(res.resident)
+      m_stats.residentBytes -= res.size;
+    if(res.buffer != VK_NULL_HANDLE)
+      m_pResMgr->DestroyBuffer(res.buffer);
+    if(res.image != VK_NULL_HANDLE)
+      m_pResMgr->DestroyImage(res.image);
+    if(res.hostCopy != VK_NULL_HANDLE)
+    {
+      m_pResMgr->UnmapBuffer(res.hostCopy);
+      m_pResMgr->DestroyBuffer(res.hostCopy);
+    }
+    m_resources.erase(it);
+  }
+
+  bool ResidencyManager::IsResident(uint32_t a_id) const
+  {
+    auto it = m_resources.find(a_id);
+    return it != m_resources.end() && it->second.resident;
+  }
+
+  void ResidencyManager::BeginFrame()
+  {
+    m_frame++;
+    if(QueryHeadroom() < m_minHeadroom)
+      EvictUntil(m_minHeadroom);
+  }
+
+  VkDeviceSize ResidencyManager::QueryHeadroom() const
+  {
+#if defined(VK_EXT_memory_budget)
+    if(m_budgetExt)
+    {
+      VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = {};
+      budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+      VkPhysicalDeviceMemoryProperties2 memProps2 = {};
+      memProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+      memProps2.pNext = &budgetProps;
+      vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memProps2);
+
+      VkDeviceSize headroom = 0;
+      bool found = false;
+      for(uint32_t i = 0; i < memProps2.memoryProperties.memoryHeapCount; ++i)
+      {
+        if(!(memProps2.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+          continue;
+        VkDeviceSize free = budgetProps.heapBudget[i] > budgetProps.heapUsage[i] ? budgetProps.heapBudget[i] - budgetProps.heapUsage[i] : 0;
+        headroom = found ? std::min(headroom, free) : free;
+        found = true;
+      }
+      if(found)
+        return headroom;
+    }
+#endif
+    // no budget extension: assume we can use 80% of the largest device local heap
+    //
+    const VkDeviceSize budget = m_deviceLocalHeapSize / 5 * 4;
+    return budget > m_stats.residentBytes ? budget - m_stats.residentBytes : 0;
+  }
+
+  VkDeviceSize ResidencyManager::EvictUntil(VkDeviceSize a_headroom)
+  {
+    if(m_pCopy == nullptr)
+      return 0;
+
+    std::vector<Resource*> candidates;
+    for(auto& [id, res] : m_resources)
+    {
+      // resources used in the last m_framesInFlight frames may still be accessed by GPU
+      if(res.resident && !res.pinned && res.lastUseFrame + m_framesInFlight <= m_frame)
+        candidates.push_back(&res);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Resource* a, const Resource* b) {
+      return a->lastUseFrame < b->lastUseFrame;
+    });
+
+    VkDeviceSize evicted  = 0;
+    VkDeviceSize headroom = QueryHeadroom();
+    for(auto* pRes : candidates)
+    {
+      if(headroom + evicted >= a_headroom)
+        break;
+      if(Evict(*pRes))
+        evicted += pRes->size;
+    }
+
+    if(headroom + evicted < a_headroom)
+      VK_UTILS_LOG_WARNING("[ResidencyManager::EvictUntil] not enough evictable resources to reach requested headroom");
+
+    return evicted;
+  }
+
+  bool ResidencyManager::Evict(Resource &a_res)
+  {
+    a_res.hostCopy = m_pResMgr->CreateBuffer(a_res.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0);
+    a_res.hostPtr  = m_pResMgr->MapBufferToHostMemory(a_res.hostCopy, 0, a_res.size);
+    if(a_res.hostPtr == nullptr)
+    {
+      VK_UTILS_LOG_WARNING("[ResidencyManager::Evict] failed to map host copy, resource stays resident");
+      m_pResMgr->DestroyBuffer(a_res.hostCopy);
+      a_res.hostCopy = VK_NULL_HANDLE;
+      return false;
+    }
+
+    if(a_res.isImage)
+    {
+      m_pCopy->ReadImage(a_res.image, a_res.hostPtr, int(a_res.imgInfo.extent.width), int(a_res.imgInfo.extent.height),
+                         bppFromVkFormat(a_res.imgInfo.format), a_res.imgLayout);
+      m_pResMgr->DestroyImage(a_res.image);
+      a_res.image = VK_NULL_HANDLE;
+    }
+    else
+    {
+      m_pCopy->ReadBuffer(a_res.buffer, 0, a_res.hostPtr, a_res.size);
+      m_pResMgr->DestroyBuffer(a_res.buffer);
+      a_res.buffer = VK_NULL_HANDLE;
+    }
+
+    a_res.resident = false;
+    m_stats.residentBytes -= a_res.size;
+    m_stats.evictedBytes  += a_res.size;
+    m_stats.evictions++;
+    return true;
+  }
+
+  bool ResidencyManager::Restore(Resource &a_res)
+  {
+    auto before = std::chrono::high_resolution_clock::now();
+
+    // making room reads evicted resources back through the copy engine, that is what stalls the caller
+    //
+    bool stalled = false;
+    if(QueryHeadroom() < a_res.size + m_minHeadroom)
+      stalled = EvictUntil(a_res.size + m_minHeadroom) != 0;
+
+    if(a_res.isImage)
+      a_res.image = m_pResMgr->CreateImage(a_res.imgInfo);
+    else
+      a_res.buffer = m_pResMgr->CreateBuffer(a_res.size, a_res.bufUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, a_res.allocFlags);
+
+    if(a_res.image == VK_NULL_HANDLE && a_res.buffer == VK_NULL_HANDLE)
+    {
+      VK_UTILS_LOG_WARNING("[ResidencyManager::Restore] failed to allocate device memory, resource stays evicted");
+      m_stats.restoreFails++;
+      return false;
+    }
+
+    if(a_res.isImage)
+      m_pCopy->UpdateImage(a_res.image, a_res.hostPtr, int(a_res.imgInfo.extent.width), int(a_res.imgInfo.extent.height),
+                           bppFromVkFormat(a_res.imgInfo.format), a_res.imgLayout);
+    else
+      m_pCopy->UpdateBuffer(a_res.buffer, 0, a_res.hostPtr, a_res.size);
+
+    m_pResMgr->UnmapBuffer(a_res.hostCopy);
+    m_pResMgr->DestroyBuffer(a_res.hostCopy);
+    a_res.hostCopy = VK_NULL_HANDLE;
+    a_res.hostPtr  = nullptr;
+    a_res.resident = true;
+
+    const float ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - before).count() / 1000.f;
+    m_stats.residentBytes += a_res.size;
+    m_stats.restoredBytes += a_res.size;
+    m_stats.restores++;
+    m_stats.msRestore += ms;
+    if(stalled)
+    {
+      m_stats.restoreStalls++;
+      m_stats.msRestoreStall += ms;
+    }
+    return true;
+  }
+}
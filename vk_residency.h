@@ -0,0 +1,112 @@
+#ifndef VK_UTILS_RESIDENCY_H
+#define VK_UTILS_RESIDENCY_H
+
+#include "vk_include.h"
+#include "vk_resource_manager.h"
+#include <memory>
+#include <unordered_map>
+
+namespace vk_utils
+{
+  struct ResidencyStats
+  {
+    uint64_t evictions      = 0;
+    uint64_t restores       = 0;
+    uint64_t evictedBytes   = 0;
+    uint64_t restoredBytes  = 0;
+    uint64_t restoreStalls  = 0;   // number of restores which had to evict other resources first and wait for their readback
+    float    msRestoreStall = 0.0f; // time spent in these restores
+    float    msRestore      = 0.0f; // time spent in all restores
+    uint64_t restoreFails   = 0;   // restores which couldn't allocate device memory, resource stays evicted
+    VkDeviceSize residentBytes = 0;
+  };
+
+  // Residency layer on top of IResourceManager.
+  // Resources are referred by id, actual Vulkan handles are obtained with UseBuffer/UseImage every frame,
+  // since evicted resource is recreated (with different handle) when it is restored.
+  //
+  // When device local memory headroom (VK_EXT_memory_budget if available, own accounting otherwise)
+  // drops below threshold, least recently used resources are copied to host visible buffers
+  // through resource manager's copy engine and their device memory is released.
+  //
+  // Images are evicted only if they are 2D with single mip level and layer (copy engine limitation),
+  // other images are always resident.
+  //
+  struct ResidencyManager
+  {
+    ResidencyManager(VkPhysicalDevice a_physicalDevice, std::shared_ptr<IResourceManager> a_pResMgr,
+                     VkDeviceSize a_minHeadroom = VkDeviceSize(256) * 1024 * 1024, uint32_t a_framesInFlight = 2);
+
+    ResidencyManager(ResidencyManager const&) = delete;
+    ResidencyManager& operator=(ResidencyManager const&) = delete;
+
+    ~ResidencyManager() { Cleanup(); }
+
+    void Cleanup();
+
+    uint32_t CreateBuffer(VkDeviceSize a_size, VkBufferUsageFlags a_usage, VkMemoryAllocateFlags a_flags = 0);
+    uint32_t CreateImage(const VkImageCreateInfo& a_createInfo, VkImageLayout a_layout);
+
+    // mark resource as used in current frame and return its handle, restores resource if it was evicted;
+    // returns VK_NULL_HANDLE if device memory for the restore can't be allocated (data is kept, try again later)
+    //
+    VkBuffer UseBuffer(uint32_t a_id);
+    VkImage  UseImage(uint32_t a_id);
+
+    void Destroy(uint32_t a_id);
+
+    // advance frame counter and evict resources if memory headroom is below threshold
+    //
+    void BeginFrame();
+
+    // evict least recently used resources until headroom is at least a_headroom, returns evicted bytes
+    //
+    VkDeviceSize EvictUntil(VkDeviceSize a_headroom);
+
+    VkDeviceSize QueryHeadroom() const;
+    bool IsResident(uint32_t a_id) const;
+
+    const ResidencyStats& GetStats() const { return m_stats; }
+    void ResetStats() { m_stats = ResidencyStats{ 0, 0, 0, 0, 0, 0.0f, 0.0f, 0, m_stats.residentBytes }; }
+
+  private:
+    struct Resource
+    {
+      bool isImage  = false;
+      bool resident = true;
+      bool pinned   = false;
+      uint64_t lastUseFrame = 0;
+      VkDeviceSize size = 0;
+
+      VkBuffer buffer = VK_NULL_HANDLE;
+      VkBufferUsageFlags bufUsage = 0;
+      VkMemoryAllocateFlags allocFlags = 0;
+
+      VkImage image = VK_NULL_HANDLE;
+      VkImageCreateInfo imgInfo{};
+      VkImageLayout imgLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+      VkBuffer hostCopy = VK_NULL_HANDLE; // host visible buffer holding resource data while evicted
+      void*    hostPtr  = nullptr;
+    };
+
+    bool Evict(Resource &a_res);
+    bool Restore(Resource &a_res);
+
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    std::shared_ptr<IResourceManager> m_pResMgr;
+    std::shared_ptr<ICopyEngine>      m_pCopy;
+
+    VkDeviceSize m_minHeadroom    = 0;
+    uint32_t     m_framesInFlight = 2;
+    uint64_t     m_frame          = 0;
+    bool         m_budgetExt      = false;
+    VkDeviceSize m_deviceLocalHeapSize = 0;
+
+    uint32_t m_nextId = 0;
+    std::unordered_map<uint32_t, Resource> m_resources;
+    ResidencyStats m_stats;
+  };
+}
+
+#endif //VK_UTILS_RESIDENCY_H
@@ -3,6 +3,7 @@
 #include "vk_utils.h"
 #include "vk_buffers.h"
 #include "vk_images.h"
+#include "vk_sparse_texture.h"
 #include <unordered_set>
 
 namespace vk_utils
@@ -22,11 +23,13 @@ namespace vk_utils
     for(auto& [buf, _] : m_bufAllocs)
     {
       auto id = m_bufAllocs[buf];
+      NotifyDestroyed(handleToU64(buf));
       vkDestroyBuffer(m_device, buf, nullptr);
 
       allocIds.insert(id);
     }
     m_bufAllocs.clear();
+    m_bufAddresses.clear();
 
     for(auto& [img, _] : m_imgAllocs)
     {
@@ -60,6 +63,8 @@ namespace vk_utils
     vkBindBufferMemory(m_device, buf, m_pAlloc->GetMemoryBlock(allocId).memory, m_pAlloc->GetMemoryBlock(allocId).offset);
 
     m_bufAllocs[buf] = allocId;
+    if(auto addr = vk_utils::getBufferDeviceAddress(m_device, buf, a_usage))
+      m_bufAddresses[buf] = addr;
     if(m_allocRefCount.count(allocId))
       m_allocRefCount[allocId] += 1;
     else
@@ -113,6 +118,8 @@ namespace vk_utils
     for (size_t i = 0; i < buffers.size(); i++)
     {
       m_bufAllocs[buffers[i]] = allocId;
+      if(auto addr = vk_utils::getBufferDeviceAddress(m_device, buffers[i], a_usages[i]))
+        m_bufAddresses[buffers[i]] = addr;
     }
 
     if(m_allocRefCount.count(allocId))
@@ -148,6 +155,56 @@ namespace vk_utils
     }
   }
 
+  VkDeviceAddress ResourceManager::GetDeviceAddress(VkBuffer a_buf) const
+  {
+    auto it = m_bufAddresses.find(a_buf);
+    return it != m_bufAddresses.end() ? it->second : 0;
+  }
+
+  void IResourceManager::WriteDeviceAddressTable(const std::vector<VkBuffer> &a_buffers, VkBuffer a_dst, VkDeviceSize a_dstOffset)
+  {
+    auto pCopy = GetCopyEngine();
+    if(pCopy == nullptr || a_buffers.empty())
+    {
+      VK_UTILS_LOG_WARNING("[IResourceManager::WriteDeviceAddressTable] no copy engine or empty buffer list");
+      return;
+    }
+
+    std::vector<uint64_t> table(a_buffers.size());
+    for(size_t i = 0; i < a_buffers.size(); ++i)
+    {
+      table[i] = GetDeviceAddress(a_buffers[i]);
+      if(table[i] == 0 && a_buffers[i] != VK_NULL_HANDLE)
+        VK_UTILS_LOG_WARNING("[IResourceManager::WriteDeviceAddressTable] buffer has no device address");
+    }
+
+    pCopy->UpdateBuffer(a_dst, a_dstOffset, table.data(), table.size() * sizeof(uint64_t));
+  }
+
+  uint32_t IResourceManager::AddDestroyCallback(DestroyCallback a_callback)
+  {
+    m_destroyCallbacks.emplace_back(m_nextCallbackId, std::move(a_callback));
+    return m_nextCallbackId++;
+  }
+
+  void IResourceManager::RemoveDestroyCallback(uint32_t a_callbackId)
+  {
+    for(auto it = m_destroyCallbacks.begin(); it != m_destroyCallbacks.end(); ++it)
+    {
+      if(it->first == a_callbackId)
+      {
+        m_destroyCallbacks.erase(it);
+        return;
+      }
+    }
+  }
+
+  void IResourceManager::NotifyDestroyed(uint64_t a_handle) const
+  {
+    for(const auto& [id, callback] : m_destroyCallbacks)
+      callback(a_handle);
+  }
+
   VkImage ResourceManager::CreateImage(const VkImageCreateInfo& a_createInfo)
   {
     VkImage image;
@@ -293,6 +350,13 @@ namespace vk_utils
     return res;
   }
 
+  std::shared_ptr<SparseTexture> ResourceManager::CreateSparseTexture(const VkImageCreateInfo& a_createInfo, VkQueue a_sparseQueue,
+                                                                      uint32_t a_sparseQueueFamily, uint32_t a_maxResidentTiles)
+  {
+    return std::make_shared<SparseTexture>(m_device, m_physicalDevice, a_sparseQueue, a_sparseQueueFamily, m_pAlloc, m_pCopy,
+                                           a_createInfo, a_maxResidentTiles);
+  }
+
   VkSampler ResourceManager::CreateSampler(const VkSamplerCreateInfo& a_samplerCreateInfo)
   {
     return m_samplerPool.acquireSampler(a_samplerCreateInfo);
@@ -309,6 +373,7 @@ namespace vk_utils
     }
 
     auto id = m_bufAllocs[a_buffer];
+    NotifyDestroyed(handleToU64(a_buffer));
     vkDestroyBuffer(m_device, a_buffer, nullptr);
 
     m_allocRefCount[id] -= 1;
@@ -323,6 +388,7 @@ namespace vk_utils
     }
 
     m_bufAllocs.erase(a_buffer);
+    m_bufAddresses.erase(a_buffer);
     a_buffer = VK_NULL_HANDLE;
   }
 
@@ -353,6 +419,7 @@ namespace vk_utils
 
     if(a_texture.descriptor.imageView != VK_NULL_HANDLE)
     {
+      NotifyDestroyed(handleToU64(a_texture.descriptor.imageView));
       vkDestroyImageView(m_device, a_texture.descriptor.imageView, nullptr);
       a_texture.descriptor.imageView = VK_NULL_HANDLE;
     }
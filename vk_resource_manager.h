@@ -2,10 +2,13 @@
 #define VK_UTILS_RESOURCE_MANAGER_H
 
 #include "vk_alloc.h"
+#include <functional>
 #include <unordered_set>
 
 namespace vk_utils
 {
+  struct SparseTexture;
+
   struct VulkanTexture
   {
     uint32_t resource_id = UINT32_MAX;
@@ -36,6 +39,14 @@ namespace vk_utils
     virtual void* MapBufferToHostMemory(VkBuffer a_buf, VkDeviceSize a_offset, VkDeviceSize a_size) = 0;
     virtual void UnmapBuffer(VkBuffer a_buf) = 0;
 
+    // device address is captured at creation for buffers with SHADER_DEVICE_ADDRESS usage, 0 for other buffers
+    //
+    virtual VkDeviceAddress GetDeviceAddress(VkBuffer a_buf) const { (void)a_buf; return 0; }
+
+    // writes packed table of device addresses (one uint64_t per buffer, in given order) to a_dst via copy engine
+    //
+    virtual void WriteDeviceAddressTable(const std::vector<VkBuffer> &a_buffers, VkBuffer a_dst, VkDeviceSize a_dstOffset = 0);
+
     virtual VkImage CreateImage(const VkImageCreateInfo& a_createInfo) = 0;
 
     virtual VkImage CreateImage(uint32_t a_width, uint32_t a_height, VkFormat a_format, VkImageUsageFlags a_usage, uint32_t a_mipLvls) = 0;
@@ -64,8 +75,36 @@ namespace vk_utils
     virtual void DestroyTexture(VulkanTexture &a_texture) = 0;
     virtual void DestroySampler(VkSampler &a_sampler) = 0;
 
+    // partially resident texture, a_sparseQueue belongs to a_sparseQueueFamily which must support VK_QUEUE_SPARSE_BINDING_BIT;
+    // if queue is VK_NULL_HANDLE, its family lacks sparse binding or device lacks sparse residency,
+    // software page table fallback is used.
+    // Returns nullptr if the resource manager doesn't support it
+    virtual std::shared_ptr<SparseTexture> CreateSparseTexture(const VkImageCreateInfo& a_createInfo, VkQueue a_sparseQueue,
+                                                               uint32_t a_sparseQueueFamily, uint32_t a_maxResidentTiles)
+    {
+      (void)a_createInfo;
+      (void)a_sparseQueue;
+      (void)a_sparseQueueFamily;
+      (void)a_maxResidentTiles;
+      return nullptr;
+    }
+
+    // callbacks are called with raw value of VkBuffer/VkImageView handle (see handleToU64) right before
+    // resource manager destroys it, so that caches keyed by handles (e.g. DescriptorMaker sets) can drop stale entries
+    //
+    using DestroyCallback = std::function<void(uint64_t a_handle)>;
+    uint32_t AddDestroyCallback(DestroyCallback a_callback);
+    void RemoveDestroyCallback(uint32_t a_callbackId);
+
     // create accel struct ?
     // map, unmap
+
+  protected:
+    void NotifyDestroyed(uint64_t a_handle) const;
+
+  private:
+    std::vector<std::pair<uint32_t, DestroyCallback>> m_destroyCallbacks;
+    uint32_t m_nextCallbackId = 0;
   };
 
   struct ResourceManager : IResourceManager
@@ -99,6 +138,8 @@ namespace vk_utils
     void* MapBufferToHostMemory(VkBuffer a_buf, VkDeviceSize a_offset, VkDeviceSize a_size) override;
     void UnmapBuffer(VkBuffer a_buf) override;
 
+    VkDeviceAddress GetDeviceAddress(VkBuffer a_buf) const override;
+
     VkImage CreateImage(const VkImageCreateInfo& a_createInfo) override;
     VkImage CreateImage(uint32_t a_width, uint32_t a_height, VkFormat a_format, VkImageUsageFlags a_usage, uint32_t a_mipLvls) override;
     VkImage CreateImage(const void* a_data, uint32_t a_width, uint32_t a_height, VkFormat a_format, VkImageUsageFlags a_usage,
@@ -123,6 +164,9 @@ namespace vk_utils
     void DestroyTexture(VulkanTexture &a_texture) override;
     void DestroySampler(VkSampler &a_sampler) override;
 
+    std::shared_ptr<SparseTexture> CreateSparseTexture(const VkImageCreateInfo& a_createInfo, VkQueue a_sparseQueue,
+                                                       uint32_t a_sparseQueueFamily, uint32_t a_maxResidentTiles) override;
+
     // create accel struct ?
     // map, unmap
 
@@ -136,6 +180,7 @@ namespace vk_utils
 
     std::unordered_map<VkBuffer, uint32_t> m_bufAllocs;
     std::unordered_map<VkImage,  uint32_t> m_imgAllocs;
+    std::unordered_map<VkBuffer, VkDeviceAddress> m_bufAddresses;
 
     std::unordered_map<uint32_t, uint32_t> m_allocRefCount;
     std::unordered_set<uint32_t> m_allocsMapped;
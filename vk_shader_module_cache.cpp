@@ -0,0 +1,295 @@
+#include "vk_shader_module_cache.h"
+#include "vk_utils.h"
+#include "vk_embedded_shaders.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__ANDROID__)
+// assets are not plain files, readSPVFile goes through AAssetManager
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vk_utils
+{
+  // read-only view of a whole file
+  //
+  class MappedFile
+  {
+  public:
+    explicit MappedFile(const std::string &a_path)
+    {
+#if defined(__ANDROID__)
+      m_fallback = vk_utils::readSPVFile(a_path.c_str());
+      m_data     = reinterpret_cast<const uint8_t*>(m_fallback.data());
+      m_size     = m_fallback.size() * sizeof(uint32_t);
+#elif defined(_WIN32)
+      m_file = CreateFileA(a_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if(m_file == INVALID_HANDLE_VALUE)
+        return;
+      LARGE_INTEGER size = {};
+      if(!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+        return;
+      m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if(m_mapping == nullptr)
+        return;
+      m_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+      m_size = m_data != nullptr ? size_t(size.QuadPart) : 0;
+#else
+      m_fd = open(a_path.c_str(), O_RDONLY);
+      if(m_fd < 0)
+        return;
+      struct stat st = {};
+      if(fstat(m_fd, &st) != 0 || st.st_size == 0)
+        return;
+      void* ptr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+      if(ptr == MAP_FAILED)
+        return;
+      m_data = reinterpret_cast<const uint8_t*>(ptr);
+      m_size = size_t(st.st_size);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#if defined(_WIN32) && !defined(__ANDROID__)
+      if(m_data != nullptr)
+        UnmapViewOfFile(m_data);
+      if(m_mapping != nullptr)
+        CloseHandle(m_mapping);
+      if(m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+#elif !defined(__ANDROID__)
+      if(m_data != nullptr)
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+      if(m_fd >= 0)
+        close(m_fd);
+#endif
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    const uint8_t* Data() const { return m_data; }
+    size_t         Size() const { return m_size; }
+
+  private:
+    const uint8_t* m_data = nullptr;
+    size_t         m_size = 0;
+#if defined(__ANDROID__)
+    std::vector<uint32_t> m_fallback;
+#elif defined(_WIN32)
+    HANDLE m_file    = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+  };
+
+  ShaderModuleCache::ShaderModuleCache(VkDevice a_device, bool a_skipModuleCreation) : m_device(a_device),
+                                                                                       m_skipModules(a_skipModuleCreation)
+  {
+#if !defined(VK_KHR_maintenance5)
+    if(m_skipModules)
+    {
+      VK_UTILS_LOG_WARNING("[ShaderModuleCache::ShaderModuleCache] VK_KHR_maintenance5 is not available, creating shader modules");
+      m_skipModules = false;
+    }
+#endif
+  }
+
+  ShaderModuleCache::~ShaderModuleCache()
+  {
+    for(auto &[hash, entry] : m_entries)
+    {
+      if(entry->refCount != 0)
+        VK_UTILS_LOG_WARNING("[ShaderModuleCache::~ShaderModuleCache] destroying shader module which is still in use");
+      if(entry->module != VK_NULL_HANDLE)
+        vkDestroyShaderModule(m_device, entry->module, nullptr);
+    }
+  }
+
+  bool ShaderModuleCache::Acquire(const std::string &a_path, VkShaderStageFlagBits a_stage, VkPipelineShaderStageCreateInfo &a_stageInfo,
+                                  const std::vector<uint32_t> **a_ppCode)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto found = m_entryByPath.find(a_path);
+      if(found != m_entryByPath.end())
+      {
+        m_hits++;
+        FillStage(found->second, a_stage, a_stageInfo, a_ppCode);
+        return true;
+      }
+    }
+
+    if(const EmbeddedShader* embedded = findEmbeddedShader(a_path))
+    {
+      return AcquireBytes(reinterpret_cast<const uint8_t*>(embedded->code), embedded->wordCount * sizeof(uint32_t), a_stage,
+                          a_stageInfo, a_ppCode, &a_path);
+    }
+
+    const std::string path = resolveShaderPath(a_path);
+    MappedFile file(path);
+    if(file.Data() == nullptr)
+    {
+      VK_UTILS_LOG_ERROR("[ShaderModuleCache::Acquire] can't open file " + path);
+      return false;
+    }
+    return AcquireBytes(file.Data(), file.Size(), a_stage, a_stageInfo, a_ppCode, &a_path);
+  }
+
+  bool ShaderModuleCache::Acquire(const std::vector<uint32_t> &a_code, VkShaderStageFlagBits a_stage,
+                                  VkPipelineShaderStageCreateInfo &a_stageInfo, const std::vector<uint32_t> **a_ppCode)
+  {
+    return AcquireBytes(reinterpret_cast<const uint8_t*>(a_code.data()), a_code.size() * sizeof(uint32_t), a_stage, a_stageInfo, a_ppCode);
+  }
+
+  bool ShaderModuleCache::AcquireBytes(const uint8_t* a_data, size_t a_size, VkShaderStageFlagBits a_stage,
+                                       VkPipelineShaderStageCreateInfo &a_stageInfo, const std::vector<uint32_t> **a_ppCode,
+                                       const std::string* a_path)
+  {
+    if(a_size == 0)
+      return false;
+
+    const uint64_t hash = hashFNV1a(a_data, a_size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Entry* entry = nullptr;
+    auto range = m_entries.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+      if(it->second->byteSize == a_size && memcmp(it->second->code.data(), a_data, a_size) == 0)
+      {
+        entry = it->second.get();
+        break;
+      }
+    }
+
+    if(entry != nullptr)
+      m_hits++;
+    else
+    {
+      auto newEntry = std::make_unique<Entry>();
+      newEntry->hash     = hash;
+      newEntry->byteSize = a_size;
+      newEntry->code.resize(getPaddedSize(a_size, sizeof(uint32_t)) / sizeof(uint32_t), 0);
+      memcpy(newEntry->code.data(), a_data, a_size);
+
+      newEntry->createInfo          = {};
+      newEntry->createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+      newEntry->createInfo.codeSize = newEntry->code.size() * sizeof(uint32_t);
+      newEntry->createInfo.pCode    = newEntry->code.data();
+
+      if(!m_skipModules && vkCreateShaderModule(m_device, &newEntry->createInfo, nullptr, &newEntry->module) != VK_SUCCESS)
+      {
+        VK_UTILS_LOG_ERROR("[ShaderModuleCache::Acquire] vkCreateShaderModule failed");
+        return false;
+      }
+
+      entry = newEntry.get();
+      m_entries.emplace(hash, std::move(newEntry));
+    }
+
+    if(a_path != nullptr)
+      m_entryByPath[*a_path] = entry;
+    FillStage(entry, a_stage, a_stageInfo, a_ppCode);
+    return true;
+  }
+
+  void ShaderModuleCache::FillStage(Entry* a_entry, VkShaderStageFlagBits a_stage, VkPipelineShaderStageCreateInfo &a_stageInfo,
+                                    const std::vector<uint32_t> **a_ppCode)
+  {
+    a_entry->refCount++;
+
+    a_stageInfo        = {};
+    a_stageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    a_stageInfo.stage  = a_stage;
+    a_stageInfo.module = a_entry->module;
+    a_stageInfo.pName  = "main";
+    if(a_entry->module == VK_NULL_HANDLE)
+      a_stageInfo.pNext = &a_entry->createInfo;
+
+    m_entryById[EntryId(a_stageInfo)] = a_entry;
+    if(a_ppCode != nullptr)
+      (*a_ppCode) = &a_entry->code;
+  }
+
+  uint64_t ShaderModuleCache::EntryId(const VkPipelineShaderStageCreateInfo &a_stageInfo) const
+  {
+    if(a_stageInfo.module != VK_NULL_HANDLE)
+      return handleToU64(a_stageInfo.module);
+    return uint64_t(reinterpret_cast<uintptr_t>(a_stageInfo.pNext));
+  }
+
+  void ShaderModuleCache::Release(const VkPipelineShaderStageCreateInfo &a_stageInfo)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto found = m_entryById.find(EntryId(a_stageInfo));
+    if(found == m_entryById.end())
+    {
+      VK_UTILS_LOG_WARNING("[ShaderModuleCache::Release] stage was not acquired from this cache");
+      return;
+    }
+
+    Entry* entry = found->second;
+    if(entry->refCount == 0)
+    {
+      VK_UTILS_LOG_WARNING("[ShaderModuleCache::Release] stage was released more times than acquired");
+      return;
+    }
+    entry->refCount--; // module is kept for next pipelines until Trim()
+  }
+
+  size_t ShaderModuleCache::Trim()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_entryByPath.clear();
+
+    size_t destroyed = 0;
+    for(auto it = m_entries.begin(); it != m_entries.end();)
+    {
+      Entry* entry = it->second.get();
+      if(entry->refCount != 0)
+      {
+        ++it;
+        continue;
+      }
+
+      if(entry->module != VK_NULL_HANDLE)
+      {
+        m_entryById.erase(handleToU64(entry->module));
+        vkDestroyShaderModule(m_device, entry->module, nullptr);
+      }
+      else
+        m_entryById.erase(uint64_t(reinterpret_cast<uintptr_t>(&entry->createInfo)));
+
+      it = m_entries.erase(it);
+      destroyed++;
+    }
+    return destroyed;
+  }
+
+  size_t ShaderModuleCache::ModuleCount() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+
+  uint32_t ShaderModuleCache::GetHitCount() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+  }
+}
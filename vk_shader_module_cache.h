@@ -0,0 +1,81 @@
+#ifndef VK_UTILS_SHADER_MODULE_CACHE_H
+#define VK_UTILS_SHADER_MODULE_CACHE_H
+
+#include "vk_include.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vk_utils
+{
+  // Shader modules shared between pipelines and deduplicated by SPIR-V content hash.
+  // Files are memory mapped (read through AAssetManager on Android), embedded shaders (see vk_embedded_shaders.h) are
+  // used in place; a module is created only for the first user of the code, so pipelines sharing e.g. a vertex shader
+  // parse it once. Released modules stay in the cache for next pipelines until Trim() or destruction; a path which was
+  // acquired before is not read and hashed again until Trim().
+  //
+  // If a_skipModuleCreation is true (VK_KHR_maintenance5 must be enabled on the device) no VkShaderModule is created
+  // at all: stage info gets VkShaderModuleCreateInfo chained into pNext and module stays VK_NULL_HANDLE.
+  //
+  // Set shaderModuleCache of Graphics/Compute/RT pipeline makers or call IQuad::SetShaderModuleCache to use it.
+  // Thread safe.
+  //
+  class ShaderModuleCache
+  {
+  public:
+    explicit ShaderModuleCache(VkDevice a_device, bool a_skipModuleCreation = false);
+    ~ShaderModuleCache();
+
+    ShaderModuleCache(ShaderModuleCache const&) = delete;
+    ShaderModuleCache& operator=(ShaderModuleCache const&) = delete;
+
+    // fills sType, stage, module (or pNext) and pName = "main" of a_stageInfo; if a_ppCode is not null it receives
+    // SPIR-V words which stay valid until Trim() after the stage is released. Returns false if file can't be read.
+    bool Acquire(const std::string &a_path, VkShaderStageFlagBits a_stage, VkPipelineShaderStageCreateInfo &a_stageInfo,
+                 const std::vector<uint32_t> **a_ppCode = nullptr);
+    bool Acquire(const std::vector<uint32_t> &a_code, VkShaderStageFlagBits a_stage, VkPipelineShaderStageCreateInfo &a_stageInfo,
+                 const std::vector<uint32_t> **a_ppCode = nullptr);
+
+    // a_stageInfo must be the one filled by Acquire
+    void Release(const VkPipelineShaderStageCreateInfo &a_stageInfo);
+    // destroys modules which are not acquired by anyone and forgets file paths (e.g. after shaders on disk are rebuilt);
+    // returns number of destroyed modules
+    size_t Trim();
+
+    bool     SkipsModuleCreation() const { return m_skipModules; }
+    size_t   ModuleCount() const;
+    uint32_t GetHitCount() const;
+
+  private:
+    struct Entry
+    {
+      uint64_t                 hash     = 0;
+      size_t                   byteSize = 0;
+      std::vector<uint32_t>    code;
+      VkShaderModule           module   = VK_NULL_HANDLE;
+      VkShaderModuleCreateInfo createInfo {};
+      uint32_t                 refCount = 0;
+    };
+
+    bool     AcquireBytes(const uint8_t* a_data, size_t a_size, VkShaderStageFlagBits a_stage,
+                          VkPipelineShaderStageCreateInfo &a_stageInfo, const std::vector<uint32_t> **a_ppCode,
+                          const std::string* a_path = nullptr);
+    void     FillStage(Entry* a_entry, VkShaderStageFlagBits a_stage, VkPipelineShaderStageCreateInfo &a_stageInfo,
+                       const std::vector<uint32_t> **a_ppCode);
+    uint64_t EntryId(const VkPipelineShaderStageCreateInfo &a_stageInfo) const;
+
+    VkDevice m_device      = VK_NULL_HANDLE;
+    bool     m_skipModules = false;
+    uint32_t m_hits        = 0;
+
+    mutable std::mutex m_mutex;
+    std::unordered_multimap<uint64_t, std::unique_ptr<Entry>> m_entries; // by content hash
+    std::unordered_map<uint64_t, Entry*> m_entryById;                    // by module handle or createInfo address
+    std::unordered_map<std::string, Entry*> m_entryByPath;               // by path passed to Acquire
+  };
+}
+
+#endif// VK_UTILS_SHADER_MODULE_CACHE_H
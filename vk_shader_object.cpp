@@ -0,0 +1,501 @@
+#include "vk_shader_object.h"
+#include "vk_utils.h"
+#include "vk_ext_funcs.h"
+
+#if defined(VK_EXT_shader_object)
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace vk_utils
+{
+  static const uint32_t SHADER_BINARY_MAGIC = 0x4F53564B; // "KVSO"
+
+  // vkCreateShadersEXT requires binary code to be 16 byte aligned
+  //
+  struct alignas(16) BinaryChunk
+  {
+    uint8_t bytes[16];
+  };
+
+  static const VkShaderStageFlagBits GRAPHICS_STAGES[] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+                                                           VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, VK_SHADER_STAGE_GEOMETRY_BIT,
+                                                           VK_SHADER_STAGE_FRAGMENT_BIT };
+
+  // position of a stage in the order stages are executed
+  //
+  static uint32_t stageOrder(VkShaderStageFlagBits a_stage)
+  {
+    switch(a_stage)
+    {
+#if defined(VK_EXT_mesh_shader)
+      case VK_SHADER_STAGE_TASK_BIT_EXT:                return 0;
+      case VK_SHADER_STAGE_MESH_BIT_EXT:                return 1;
+#endif
+      case VK_SHADER_STAGE_VERTEX_BIT:                  return 2;
+      case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:    return 3;
+      case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: return 4;
+      case VK_SHADER_STAGE_GEOMETRY_BIT:                return 5;
+      case VK_SHADER_STAGE_FRAGMENT_BIT:                return 6;
+      default:                                          return 7;
+    }
+  }
+
+  void ShaderObjects::Bind(VkCommandBuffer a_cmdBuff) const
+  {
+    if(stages.size() == 1 && stages[0] == VK_SHADER_STAGE_COMPUTE_BIT)
+    {
+      vkCmdBindShadersEXT(a_cmdBuff, 1, stages.data(), shaders.data());
+      return;
+    }
+
+    std::vector<VkShaderStageFlagBits> bindStages(std::begin(GRAPHICS_STAGES), std::end(GRAPHICS_STAGES));
+    std::vector<VkShaderEXT>           bindShaders(bindStages.size(), VK_NULL_HANDLE);
+    for(size_t i = 0; i < stages.size(); ++i)
+    {
+      auto found = std::find(bindStages.begin(), bindStages.end(), stages[i]);
+      if(found != bindStages.end())
+        bindShaders[found - bindStages.begin()] = shaders[i];
+      else // task and mesh
+      {
+        bindStages.push_back(stages[i]);
+        bindShaders.push_back(shaders[i]);
+      }
+    }
+
+    vkCmdBindShadersEXT(a_cmdBuff, uint32_t(bindStages.size()), bindStages.data(), bindShaders.data());
+  }
+
+  void ShaderObjects::Destroy(VkDevice a_device)
+  {
+    for(auto shader : shaders)
+    {
+      if(shader != VK_NULL_HANDLE)
+        vkDestroyShaderEXT(a_device, shader, nullptr);
+    }
+    shaders.clear();
+    stages.clear();
+    fromBinary = false;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+
+  bool ShaderObjectMaker::IsSupported(VkPhysicalDevice a_physicalDevice)
+  {
+    VkPhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures = {};
+    shaderObjectFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &shaderObjectFeatures;
+    vkGetPhysicalDeviceFeatures2(a_physicalDevice, &features2);
+
+    return shaderObjectFeatures.shaderObject == VK_TRUE;
+  }
+
+  ShaderObjectMaker::ShaderObjectMaker(VkDevice a_device, VkPhysicalDevice a_physicalDevice, const std::string &a_binaryDirectory) :
+                                       m_device(a_device), m_binaryDirectory(a_binaryDirectory)
+  {
+    VkPhysicalDeviceShaderObjectPropertiesEXT shaderObjectProps = {};
+    shaderObjectProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 props2 = {};
+    props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props2.pNext = &shaderObjectProps;
+    vkGetPhysicalDeviceProperties2(a_physicalDevice, &props2);
+
+    std::stringstream tag;
+    tag << std::hex << std::setfill('0');
+    for(uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+      tag << std::setw(2) << uint32_t(shaderObjectProps.shaderBinaryUUID[i]);
+    tag << "_" << std::setw(8) << shaderObjectProps.shaderBinaryVersion;
+    m_deviceTag = tag.str();
+  }
+
+  void ShaderObjectMaker::LoadShaders(const std::unordered_map<VkShaderStageFlagBits, std::string> &a_shaderPaths,
+                                      const VkSpecializationInfo *a_specInfo, const char* a_mainName)
+  {
+    m_stages.clear();
+    reflection = {};
+    m_mainName = a_mainName;
+
+    for(const auto &[stage, path] : a_shaderPaths)
+    {
+      Stage loaded;
+      loaded.stage    = stage;
+      loaded.code     = vk_utils::readSPVFile(path.c_str());
+      if(loaded.code.empty())
+        RUN_TIME_ERROR(("[ShaderObjectMaker::LoadShaders]: can't load shader " + path).c_str());
+      loaded.codeHash = hashFNV1a(loaded.code.data(), loaded.code.size() * sizeof(uint32_t));
+      vk_utils::reflectSPIRV(loaded.code, stage, reflection);
+      m_stages.push_back(std::move(loaded));
+    }
+    std::sort(m_stages.begin(), m_stages.end(), [](const Stage &a, const Stage &b) { return stageOrder(a.stage) < stageOrder(b.stage); });
+
+    m_specEntries.clear();
+    m_specData.clear();
+    m_specInfo = {};
+    if(a_specInfo != nullptr)
+    {
+      m_specEntries.assign(a_specInfo->pMapEntries, a_specInfo->pMapEntries + a_specInfo->mapEntryCount);
+      const uint8_t* specData = reinterpret_cast<const uint8_t*>(a_specInfo->pData);
+      m_specData.assign(specData, specData + a_specInfo->dataSize);
+      m_specInfo.mapEntryCount = uint32_t(m_specEntries.size());
+      m_specInfo.pMapEntries   = m_specEntries.data();
+      m_specInfo.dataSize      = m_specData.size();
+      m_specInfo.pData         = m_specData.data();
+    }
+  }
+
+  VkPipelineLayout ShaderObjectMaker::MakeLayout(PipelineLayoutCache &a_cache)
+  {
+    VkPipelineLayout layout = a_cache.GetPipelineLayout(reflection, &m_setLayouts);
+    m_setBindings.clear();
+    m_pushConstants.clear();
+    if(reflection.pushConstantSize > 0)
+      m_pushConstants.push_back({reflection.pushConstantStages, 0, reflection.pushConstantSize});
+    return layout;
+  }
+
+  void ShaderObjectMaker::SetLayout(const std::vector<VkDescriptorSetLayout> &a_setLayouts,
+                                    const std::vector<VkPushConstantRange> &a_pushConstants,
+                                    const std::vector<std::vector<VkDescriptorSetLayoutBinding>> &a_setBindings)
+  {
+    if(a_setBindings.size() != a_setLayouts.size())
+      VK_UTILS_LOG_WARNING("[ShaderObjectMaker::SetLayout] a_setBindings should have bindings of every set layout");
+
+    m_setLayouts    = a_setLayouts;
+    m_pushConstants = a_pushConstants;
+    m_setBindings   = a_setBindings;
+  }
+
+  std::vector<VkShaderCreateInfoEXT> ShaderObjectMaker::CreateInfos(bool a_linked) const
+  {
+    const bool link = a_linked && m_stages.size() > 1;
+#if defined(VK_EXT_mesh_shader)
+    const bool hasTask = std::any_of(m_stages.begin(), m_stages.end(), [](const Stage &s) { return s.stage == VK_SHADER_STAGE_TASK_BIT_EXT; });
+#endif
+
+    std::vector<VkShaderCreateInfoEXT> infos(m_stages.size());
+    for(size_t i = 0; i < m_stages.size(); ++i)
+    {
+      const auto &stage = m_stages[i];
+
+      // pre-rasterization stages may be followed by the loaded later stages and by any fragment shader
+      //
+      VkShaderStageFlags nextStage = 0;
+      if(stage.stage != VK_SHADER_STAGE_FRAGMENT_BIT && stage.stage != VK_SHADER_STAGE_COMPUTE_BIT)
+      {
+        nextStage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        for(size_t j = i + 1; j < m_stages.size(); ++j)
+          nextStage |= m_stages[j].stage;
+      }
+
+      auto &info = infos[i];
+      info = {};
+      info.sType                  = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
+      info.flags                  = link ? VK_SHADER_CREATE_LINK_STAGE_BIT_EXT : 0;
+      info.stage                  = stage.stage;
+      info.nextStage              = nextStage;
+      info.codeType               = VK_SHADER_CODE_TYPE_SPIRV_EXT;
+      info.codeSize               = stage.code.size() * sizeof(uint32_t);
+      info.pCode                  = stage.code.data();
+      info.pName                  = m_mainName.c_str();
+      info.setLayoutCount         = uint32_t(m_setLayouts.size());
+      info.pSetLayouts            = m_setLayouts.data();
+      info.pushConstantRangeCount = uint32_t(m_pushConstants.size());
+      info.pPushConstantRanges    = m_pushConstants.data();
+      info.pSpecializationInfo    = m_specEntries.empty() ? nullptr : &m_specInfo;
+
+#if defined(VK_EXT_mesh_shader)
+      if(stage.stage == VK_SHADER_STAGE_MESH_BIT_EXT && !hasTask)
+        info.flags |= VK_SHADER_CREATE_NO_TASK_SHADER_BIT_EXT;
+#endif
+    }
+    return infos;
+  }
+
+  ShaderObjects ShaderObjectMaker::MakeShaders(bool a_linked)
+  {
+    ShaderObjects result;
+    if(m_stages.empty())
+    {
+      VK_UTILS_LOG_ERROR("[ShaderObjectMaker::MakeShaders] no shaders loaded");
+      return result;
+    }
+
+    if(!m_binaryDirectory.empty() && LoadBinaries(a_linked, result))
+    {
+      m_binaryHits++;
+      return result;
+    }
+
+    auto infos = CreateInfos(a_linked);
+    for(const auto &stage : m_stages)
+      result.stages.push_back(stage.stage);
+    result.shaders.resize(infos.size(), VK_NULL_HANDLE);
+
+    VkResult res = vkCreateShadersEXT(m_device, uint32_t(infos.size()), infos.data(), nullptr, result.shaders.data());
+    if(res != VK_SUCCESS)
+    {
+      VK_UTILS_LOG_ERROR("[ShaderObjectMaker::MakeShaders] vkCreateShadersEXT failed: " + vk_utils::errorString(res));
+      result.Destroy(m_device);
+      return result;
+    }
+
+    if(!m_binaryDirectory.empty())
+    {
+      m_binaryMisses++;
+      SaveBinaries(a_linked, result);
+    }
+    return result;
+  }
+
+  uint64_t ShaderObjectMaker::BinaryKey(bool a_linked) const
+  {
+    uint64_t hash = hashFNV1a(&a_linked, sizeof(a_linked));
+    hash = hashFNV1a(m_mainName.data(), m_mainName.size(), hash);
+    for(const auto &stage : m_stages)
+    {
+      hash = hashFNV1a(&stage.stage, sizeof(stage.stage), hash);
+      hash = hashFNV1a(&stage.codeHash, sizeof(stage.codeHash), hash);
+    }
+    for(const auto &entry : m_specEntries)
+    {
+      const uint64_t values[3] = { entry.constantID, entry.offset, entry.size };
+      hash = hashFNV1a(values, sizeof(values), hash);
+    }
+    hash = hashFNV1a(m_specData.data(), m_specData.size(), hash);
+
+    // layouts are part of create info, handles differ between runs so their content is used:
+    // bindings given to SetLayout, or reflection the layouts of MakeLayout are derived from
+    //
+    for(size_t set = 0; set < m_setBindings.size(); ++set)
+    {
+      for(const auto &b : m_setBindings[set])
+      {
+        const uint64_t values[6] = { set, b.binding, uint64_t(b.descriptorType), b.descriptorCount, b.stageFlags,
+                                     uint64_t(b.pImmutableSamplers != nullptr) };
+        hash = hashFNV1a(values, sizeof(values), hash);
+      }
+    }
+    if(m_setBindings.empty())
+    {
+      for(const auto &b : reflection.bindings)
+      {
+        const uint64_t values[5] = { b.set, b.binding, uint64_t(b.type), b.count, b.stages };
+        hash = hashFNV1a(values, sizeof(values), hash);
+      }
+    }
+    for(const auto &range : m_pushConstants)
+    {
+      const uint64_t values[3] = { range.stageFlags, range.offset, range.size };
+      hash = hashFNV1a(values, sizeof(values), hash);
+    }
+    const uint64_t setCount = m_setLayouts.size();
+    return hashFNV1a(&setCount, sizeof(setCount), hash);
+  }
+
+  std::string ShaderObjectMaker::BinaryPath(bool a_linked) const
+  {
+    std::stringstream name;
+    name << "shader_objects_" << m_deviceTag << "_" << std::hex << std::setfill('0') << std::setw(16) << BinaryKey(a_linked) << ".bin";
+    return (std::filesystem::path(m_binaryDirectory) / name.str()).string();
+  }
+
+  bool ShaderObjectMaker::LoadBinaries(bool a_linked, ShaderObjects &a_out)
+  {
+    std::ifstream file(BinaryPath(a_linked), std::ios::binary);
+    if(!file.is_open())
+      return false;
+
+    uint32_t magic = 0, count = 0;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if(!file || magic != SHADER_BINARY_MAGIC || count != m_stages.size())
+      return false;
+
+    auto infos = CreateInfos(a_linked);
+    std::vector<std::vector<BinaryChunk>> blobs(count);
+    for(uint32_t i = 0; i < count; ++i)
+    {
+      uint32_t stage = 0;
+      uint64_t size  = 0;
+      file.read(reinterpret_cast<char*>(&stage), sizeof(stage));
+      file.read(reinterpret_cast<char*>(&size), sizeof(size));
+      if(!file || stage != uint32_t(infos[i].stage) || size == 0 || size > (uint64_t(1) << 30))
+        return false;
+
+      blobs[i].resize(size_t((size + sizeof(BinaryChunk) - 1) / sizeof(BinaryChunk)));
+      file.read(reinterpret_cast<char*>(blobs[i].data()), std::streamsize(size));
+      if(!file)
+        return false;
+
+      infos[i].codeType = VK_SHADER_CODE_TYPE_BINARY_EXT;
+      infos[i].codeSize = size_t(size);
+      infos[i].pCode    = blobs[i].data();
+    }
+
+    for(const auto &stage : m_stages)
+      a_out.stages.push_back(stage.stage);
+    a_out.shaders.resize(infos.size(), VK_NULL_HANDLE);
+
+    // VK_INCOMPATIBLE_SHADER_BINARY_EXT (e.g. after driver update) falls back to SPIR-V
+    //
+    VkResult res = vkCreateShadersEXT(m_device, uint32_t(infos.size()), infos.data(), nullptr, a_out.shaders.data());
+    if(res != VK_SUCCESS)
+    {
+      a_out.Destroy(m_device);
+      return false;
+    }
+
+    a_out.fromBinary = true;
+    return true;
+  }
+
+  void ShaderObjectMaker::SaveBinaries(bool a_linked, const ShaderObjects &a_shaders) const
+  {
+    std::vector<std::vector<uint8_t>> blobs(a_shaders.shaders.size());
+    for(size_t i = 0; i < a_shaders.shaders.size(); ++i)
+    {
+      size_t size = 0;
+      if(vkGetShaderBinaryDataEXT(m_device, a_shaders.shaders[i], &size, nullptr) != VK_SUCCESS || size == 0)
+        return;
+      blobs[i].resize(size);
+      if(vkGetShaderBinaryDataEXT(m_device, a_shaders.shaders[i], &size, blobs[i].data()) != VK_SUCCESS)
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_binaryDirectory, ec);
+
+    const std::string path    = BinaryPath(a_linked);
+    const std::string tmpPath = path + ".tmp";
+    {
+      std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+      const uint32_t count = uint32_t(blobs.size());
+      file.write(reinterpret_cast<const char*>(&SHADER_BINARY_MAGIC), sizeof(SHADER_BINARY_MAGIC));
+      file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+      for(size_t i = 0; i < blobs.size(); ++i)
+      {
+        const uint32_t stage = uint32_t(a_shaders.stages[i]);
+        const uint64_t size  = blobs[i].size();
+        file.write(reinterpret_cast<const char*>(&stage), sizeof(stage));
+        file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        file.write(reinterpret_cast<const char*>(blobs[i].data()), std::streamsize(size));
+      }
+      if(!file.good())
+      {
+        VK_UTILS_LOG_WARNING("[ShaderObjectMaker::SaveBinaries] failed to write " + tmpPath);
+        return;
+      }
+    }
+
+    std::filesystem::rename(tmpPath, path, ec);
+    if(ec)
+    {
+      VK_UTILS_LOG_WARNING("[ShaderObjectMaker::SaveBinaries] failed to replace " + path + ": " + ec.message());
+      std::filesystem::remove(tmpPath, ec);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+
+  void setShaderObjectDefaultState(VkCommandBuffer a_cmdBuff, uint32_t a_width, uint32_t a_height, uint32_t a_colorAttachmentCount)
+  {
+    VkViewport viewport = {};
+    viewport.width    = float(a_width);
+    viewport.height   = float(a_height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor = {};
+    scissor.extent   = { a_width, a_height };
+
+    vkCmdSetViewportWithCountEXT(a_cmdBuff, 1, &viewport);
+    vkCmdSetScissorWithCountEXT(a_cmdBuff, 1, &scissor);
+
+    vkCmdSetPrimitiveTopologyEXT(a_cmdBuff, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    vkCmdSetPrimitiveRestartEnableEXT(a_cmdBuff, VK_FALSE);
+    vkCmdSetRasterizerDiscardEnableEXT(a_cmdBuff, VK_FALSE);
+
+    const VkSampleMask sampleMask = 0xFFFFFFFF;
+    vkCmdSetPolygonModeEXT(a_cmdBuff, VK_POLYGON_MODE_FILL);
+    vkCmdSetRasterizationSamplesEXT(a_cmdBuff, VK_SAMPLE_COUNT_1_BIT);
+    vkCmdSetSampleMaskEXT(a_cmdBuff, VK_SAMPLE_COUNT_1_BIT, &sampleMask);
+    vkCmdSetAlphaToCoverageEnableEXT(a_cmdBuff, VK_FALSE);
+    vkCmdSetAlphaToOneEnableEXT(a_cmdBuff, VK_FALSE);
+    vkCmdSetCullModeEXT(a_cmdBuff, VK_CULL_MODE_NONE);
+    vkCmdSetFrontFaceEXT(a_cmdBuff, VK_FRONT_FACE_CLOCKWISE);
+    vkCmdSetLineWidth(a_cmdBuff, 1.0f);
+    vkCmdSetDepthClampEnableEXT(a_cmdBuff, VK_FALSE);
+    vkCmdSetDepthBiasEnableEXT(a_cmdBuff, VK_FALSE);
+
+    vkCmdSetDepthTestEnableEXT(a_cmdBuff, VK_TRUE);
+    vkCmdSetDepthWriteEnableEXT(a_cmdBuff, VK_TRUE);
+    vkCmdSetDepthCompareOpEXT(a_cmdBuff, VK_COMPARE_OP_LESS_OR_EQUAL);
+    vkCmdSetDepthBoundsTestEnableEXT(a_cmdBuff, VK_FALSE);
+    vkCmdSetStencilTestEnableEXT(a_cmdBuff, VK_FALSE);
+
+    vkCmdSetLogicOpEnableEXT(a_cmdBuff, VK_FALSE);
+    if(a_colorAttachmentCount > 0)
+    {
+      VkColorBlendEquationEXT equation = {};
+      equation.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+      equation.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+      equation.colorBlendOp        = VK_BLEND_OP_ADD;
+      equation.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+      equation.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+      equation.alphaBlendOp        = VK_BLEND_OP_ADD;
+
+      std::vector<VkBool32>                blendEnables(a_colorAttachmentCount, VK_FALSE);
+      std::vector<VkColorBlendEquationEXT> equations(a_colorAttachmentCount, equation);
+      std::vector<VkColorComponentFlags>   writeMasks(a_colorAttachmentCount, VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                                                              VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT);
+      vkCmdSetColorBlendEnableEXT(a_cmdBuff, 0, a_colorAttachmentCount, blendEnables.data());
+      vkCmdSetColorBlendEquationEXT(a_cmdBuff, 0, a_colorAttachmentCount, equations.data());
+      vkCmdSetColorWriteMaskEXT(a_cmdBuff, 0, a_colorAttachmentCount, writeMasks.data());
+    }
+
+    vkCmdSetVertexInputEXT(a_cmdBuff, 0, nullptr, 0, nullptr);
+  }
+
+  void setShaderObjectVertexInput(VkCommandBuffer a_cmdBuff, const VkPipelineVertexInputStateCreateInfo &a_vertexLayout)
+  {
+    std::vector<VkVertexInputBindingDescription2EXT> bindings(a_vertexLayout.vertexBindingDescriptionCount);
+    for(uint32_t i = 0; i < a_vertexLayout.vertexBindingDescriptionCount; ++i)
+    {
+      const auto &src = a_vertexLayout.pVertexBindingDescriptions[i];
+      bindings[i] = {};
+      bindings[i].sType     = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT;
+      bindings[i].binding   = src.binding;
+      bindings[i].stride    = src.stride;
+      bindings[i].inputRate = src.inputRate;
+      bindings[i].divisor   = 1;
+    }
+
+    std::vector<VkVertexInputAttributeDescription2EXT> attributes(a_vertexLayout.vertexAttributeDescriptionCount);
+    for(uint32_t i = 0; i < a_vertexLayout.vertexAttributeDescriptionCount; ++i)
+    {
+      const auto &src = a_vertexLayout.pVertexAttributeDescriptions[i];
+      attributes[i] = {};
+      attributes[i].sType    = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT;
+      attributes[i].location = src.location;
+      attributes[i].binding  = src.binding;
+      attributes[i].format   = src.format;
+      attributes[i].offset   = src.offset;
+    }
+
+    vkCmdSetVertexInputEXT(a_cmdBuff, uint32_t(bindings.size()), bindings.data(), uint32_t(attributes.size()), attributes.data());
+  }
+}
+
+#endif
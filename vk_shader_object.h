@@ -0,0 +1,108 @@
+#ifndef VK_UTILS_SHADER_OBJECT_H
+#define VK_UTILS_SHADER_OBJECT_H
+
+#include "vk_include.h"
+#include "vk_shader_reflection.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// requires Vulkan headers with VK_EXT_shader_object, the extension and shaderObject feature must be enabled on the device
+//
+#if defined(VK_EXT_shader_object)
+
+namespace vk_utils
+{
+  // shaders made by ShaderObjectMaker::MakeShaders, owned by the caller
+  //
+  struct ShaderObjects
+  {
+    std::vector<VkShaderStageFlagBits> stages;
+    std::vector<VkShaderEXT>           shaders;
+    bool                               fromBinary = false; // created from cached binaries
+
+    bool IsValid() const { return !shaders.empty(); }
+
+    // binds all shaders; for graphics shaders the vertex, tessellation, geometry and fragment stages which
+    // are not in this set are unbound, so nothing from a previous bind stays active
+    void Bind(VkCommandBuffer a_cmdBuff) const;
+    void Destroy(VkDevice a_device);
+  };
+
+  // Alternative to GraphicsPipelineMaker / ComputePipelineMaker based on VK_EXT_shader_object: takes the same SPIR-V inputs
+  // and creates VkShaderEXT objects instead of pipelines, all fixed function state is set on command buffer
+  // (setShaderObjectDefaultState, setShaderObjectVertexInput, DynamicStateSetter). Cheap to create and combine,
+  // intended for many short-lived shader combinations.
+  //
+  // Linked shaders are compiled together and must be bound together, unlinked ones can be mixed with any other
+  // unlinked shaders with compatible interfaces. If a_binaryDirectory is not empty, shader binaries are stored there
+  // (vkGetShaderBinaryDataEXT) and used on next runs on devices with the same shaderBinaryUUID and version.
+  //
+  class ShaderObjectMaker
+  {
+  public:
+    static bool IsSupported(VkPhysicalDevice a_physicalDevice);
+
+    ShaderObjectMaker(VkDevice a_device, VkPhysicalDevice a_physicalDevice, const std::string &a_binaryDirectory = "");
+
+    ShaderReflection reflection {}; // merged interface of all stages, filled by LoadShaders
+
+    void             LoadShaders(const std::unordered_map<VkShaderStageFlagBits, std::string> &a_shaderPaths,
+                                 const VkSpecializationInfo *a_specInfo = nullptr, const char* a_mainName = "main");
+    // set layouts and push constants derived from reflection, shared through a_cache; returned pipeline layout
+    // is for vkCmdBindDescriptorSets and vkCmdPushConstants
+    VkPipelineLayout MakeLayout(PipelineLayoutCache &a_cache);
+    // a_setBindings are the bindings each of a_setLayouts was created with; handles differ between runs,
+    // so cached binaries are identified by them
+    void             SetLayout(const std::vector<VkDescriptorSetLayout> &a_setLayouts,
+                               const std::vector<VkPushConstantRange> &a_pushConstants,
+                               const std::vector<std::vector<VkDescriptorSetLayoutBinding>> &a_setBindings);
+
+    // empty result on failure
+    ShaderObjects    MakeShaders(bool a_linked = true);
+
+    uint32_t BinaryHits()   const { return m_binaryHits; }
+    uint32_t BinaryMisses() const { return m_binaryMisses; }
+
+  private:
+    struct Stage
+    {
+      VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+      std::vector<uint32_t> code;
+      uint64_t              codeHash = 0;
+    };
+
+    std::vector<VkShaderCreateInfoEXT> CreateInfos(bool a_linked) const;
+    uint64_t    BinaryKey(bool a_linked) const;
+    std::string BinaryPath(bool a_linked) const;
+    bool        LoadBinaries(bool a_linked, ShaderObjects &a_out);
+    void        SaveBinaries(bool a_linked, const ShaderObjects &a_shaders) const;
+
+    VkDevice    m_device = VK_NULL_HANDLE;
+    std::string m_binaryDirectory;
+    std::string m_deviceTag; // shaderBinaryUUID and shaderBinaryVersion
+
+    std::vector<Stage>                    m_stages;
+    std::string                           m_mainName;
+    std::vector<VkSpecializationMapEntry> m_specEntries;
+    std::vector<uint8_t>                  m_specData;
+    VkSpecializationInfo                  m_specInfo {};
+    std::vector<VkDescriptorSetLayout>    m_setLayouts;
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> m_setBindings; // of SetLayout, empty after MakeLayout
+    std::vector<VkPushConstantRange>      m_pushConstants;
+
+    uint32_t m_binaryHits   = 0;
+    uint32_t m_binaryMisses = 0;
+  };
+
+  // every state shader objects read from command buffer, values match GraphicsPipelineMaker::SetDefaultState
+  // (triangle list, no culling, depth test LESS_OR_EQUAL, no blending) and an empty vertex input
+  void setShaderObjectDefaultState(VkCommandBuffer a_cmdBuff, uint32_t a_width, uint32_t a_height, uint32_t a_colorAttachmentCount = 1);
+  // vertex layout in the same form as for GraphicsPipelineMaker::MakePipeline
+  void setShaderObjectVertexInput(VkCommandBuffer a_cmdBuff, const VkPipelineVertexInputStateCreateInfo &a_vertexLayout);
+}
+
+#endif
+
+#endif// VK_UTILS_SHADER_OBJECT_H
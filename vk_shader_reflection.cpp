@@ -0,0 +1,434 @@
+#include "vk_shader_reflection.h"
+#include "vk_descriptor_helpers.h"
+#include "vk_utils.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace vk_utils
+{
+  // SPIR-V constants used by reflection, see SPIR-V specification, section 3
+  namespace spv
+  {
+    constexpr uint32_t MAGIC = 0x07230203;
+
+    constexpr uint32_t OpTypeInt     = 21;
+    constexpr uint32_t OpTypeFloat   = 22;
+    constexpr uint32_t OpTypeVector  = 23;
+    constexpr uint32_t OpTypeMatrix  = 24;
+    constexpr uint32_t OpTypeImage   = 25;
+    constexpr uint32_t OpTypeSampler = 26;
+    constexpr uint32_t OpTypeSampledImage = 27;
+    constexpr uint32_t OpTypeArray   = 28;
+    constexpr uint32_t OpTypeRuntimeArray = 29;
+    constexpr uint32_t OpTypeStruct  = 30;
+    constexpr uint32_t OpTypePointer = 32;
+    constexpr uint32_t OpConstant    = 43;
+    constexpr uint32_t OpVariable    = 59;
+    constexpr uint32_t OpDecorate    = 71;
+    constexpr uint32_t OpMemberDecorate = 72;
+    constexpr uint32_t OpTypeAccelerationStructureKHR = 5341;
+
+    constexpr uint32_t DecorationBufferBlock  = 3;
+    constexpr uint32_t DecorationArrayStride  = 6;
+    constexpr uint32_t DecorationMatrixStride = 7;
+    constexpr uint32_t DecorationBinding      = 33;
+    constexpr uint32_t DecorationDescriptorSet = 34;
+    constexpr uint32_t DecorationOffset       = 35;
+
+    constexpr uint32_t StorageClassUniformConstant = 0;
+    constexpr uint32_t StorageClassUniform         = 2;
+    constexpr uint32_t StorageClassPushConstant    = 9;
+    constexpr uint32_t StorageClassStorageBuffer   = 12;
+
+    constexpr uint32_t DimBuffer      = 5;
+    constexpr uint32_t DimSubpassData = 6;
+  }
+
+  namespace
+  {
+    struct SpvId
+    {
+      uint32_t opcode = 0;
+      std::vector<uint32_t> operands; // words after result id (for types and constants)
+      uint32_t set     = UINT32_MAX;
+      uint32_t binding = UINT32_MAX;
+      uint32_t arrayStride = 0;
+      bool bufferBlock = false;
+      std::vector<uint32_t> memberOffsets;
+      std::vector<uint32_t> memberMatrixStrides;
+    };
+
+    uint32_t typeSize(const std::vector<SpvId> &ids, uint32_t a_type, uint32_t a_matrixStride = 0)
+    {
+      const SpvId& t = ids[a_type];
+      switch (t.opcode)
+      {
+      case spv::OpTypeInt:
+      case spv::OpTypeFloat:
+        return t.operands[0] / 8;
+      case spv::OpTypeVector:
+        return typeSize(ids, t.operands[0]) * t.operands[1];
+      case spv::OpTypeMatrix:
+        return (a_matrixStride != 0 ? a_matrixStride : typeSize(ids, t.operands[0])) * t.operands[1];
+      case spv::OpTypeArray:
+      {
+        const uint32_t length = ids[t.operands[1]].operands.size() > 2 ? ids[t.operands[1]].operands[2] : 0; // OpConstant value
+        const uint32_t stride = t.arrayStride != 0 ? t.arrayStride : typeSize(ids, t.operands[0]);
+        return stride * length;
+      }
+      case spv::OpTypeStruct:
+      {
+        uint32_t size = 0;
+        for (size_t m = 0; m < t.operands.size(); ++m)
+        {
+          const uint32_t offset = m < t.memberOffsets.size() ? t.memberOffsets[m] : 0;
+          const uint32_t stride = m < t.memberMatrixStrides.size() ? t.memberMatrixStrides[m] : 0;
+          size = std::max(size, offset + typeSize(ids, t.operands[m], stride));
+        }
+        return size;
+      }
+      default:
+        return 0;
+      }
+    }
+  }
+
+  bool reflectSPIRV(const std::vector<uint32_t> &a_code, VkShaderStageFlags a_stage, ShaderReflection &a_out)
+  {
+    if(a_code.size() < 5 || a_code[0] != spv::MAGIC)
+    {
+      VK_UTILS_LOG_ERROR("[reflectSPIRV] invalid SPIR-V module");
+      return false;
+    }
+
+    const uint32_t idBound = a_code[3];
+    std::vector<SpvId> ids(idBound);
+    std::vector<uint32_t> variables;
+
+    for (size_t pos = 5; pos < a_code.size();)
+    {
+      const uint32_t wordCount = a_code[pos] >> 16;
+      const uint32_t opcode    = a_code[pos] & 0xFFFF;
+      if(wordCount == 0 || pos + wordCount > a_code.size())
+      {
+        VK_UTILS_LOG_ERROR("[reflectSPIRV] truncated SPIR-V module");
+        return false;
+      }
+      const uint32_t* ops = a_code.data() + pos + 1;
+
+      switch (opcode)
+      {
+      case spv::OpDecorate:
+        if(ops[0] < idBound && wordCount > 3)
+        {
+          if(ops[1] == spv::DecorationDescriptorSet) ids[ops[0]].set = ops[2];
+          if(ops[1] == spv::DecorationBinding)       ids[ops[0]].binding = ops[2];
+          if(ops[1] == spv::DecorationArrayStride)   ids[ops[0]].arrayStride = ops[2];
+        }
+        if(ops[0] < idBound && wordCount > 2 && ops[1] == spv::DecorationBufferBlock)
+          ids[ops[0]].bufferBlock = true;
+        break;
+
+      case spv::OpMemberDecorate:
+        if(ops[0] < idBound && wordCount > 4 && (ops[2] == spv::DecorationOffset || ops[2] == spv::DecorationMatrixStride))
+        {
+          auto& values = (ops[2] == spv::DecorationOffset) ? ids[ops[0]].memberOffsets : ids[ops[0]].memberMatrixStrides;
+          if(values.size() <= ops[1])
+            values.resize(ops[1] + 1, 0);
+          values[ops[1]] = ops[3];
+        }
+        break;
+
+      case spv::OpTypeInt:
+      case spv::OpTypeFloat:
+      case spv::OpTypeVector:
+      case spv::OpTypeMatrix:
+      case spv::OpTypeImage:
+      case spv::OpTypeSampler:
+      case spv::OpTypeSampledImage:
+      case spv::OpTypeArray:
+      case spv::OpTypeRuntimeArray:
+      case spv::OpTypeStruct:
+      case spv::OpTypePointer:
+      case spv::OpTypeAccelerationStructureKHR:
+        if(ops[0] < idBound)
+        {
+          ids[ops[0]].opcode = opcode;
+          ids[ops[0]].operands.assign(ops + 1, ops + wordCount - 1);
+        }
+        break;
+
+      case spv::OpConstant: // result type, id, value
+        if(ops[1] < idBound)
+        {
+          ids[ops[1]].opcode = opcode;
+          ids[ops[1]].operands.assign(ops, ops + wordCount - 1);
+        }
+        break;
+
+      case spv::OpVariable: // result type, id, storage class
+        if(ops[1] < idBound)
+        {
+          ids[ops[1]].opcode = opcode;
+          ids[ops[1]].operands.assign(ops, ops + wordCount - 1);
+          variables.push_back(ops[1]);
+        }
+        break;
+
+      default:
+        break;
+      }
+
+      pos += wordCount;
+    }
+
+    ShaderReflection result;
+    for (uint32_t varId : variables)
+    {
+      const SpvId& var = ids[varId];
+      const uint32_t storageClass = var.operands[2];
+      const SpvId& ptr = ids[var.operands[0]];
+      if(ptr.opcode != spv::OpTypePointer)
+        continue;
+      uint32_t typeId = ptr.operands[1];
+
+      if(storageClass == spv::StorageClassPushConstant)
+      {
+        result.pushConstantSize   = std::max(result.pushConstantSize, typeSize(ids, typeId));
+        result.pushConstantStages = a_stage;
+        continue;
+      }
+
+      if(var.binding == UINT32_MAX ||
+         (storageClass != spv::StorageClassUniformConstant && storageClass != spv::StorageClassUniform &&
+          storageClass != spv::StorageClassStorageBuffer))
+        continue;
+
+      ShaderReflection::Binding b;
+      b.set     = (var.set == UINT32_MAX) ? 0 : var.set;
+      b.binding = var.binding;
+      b.stages  = a_stage;
+
+      // unwrap arrays
+      while(ids[typeId].opcode == spv::OpTypeArray || ids[typeId].opcode == spv::OpTypeRuntimeArray)
+      {
+        const SpvId& arr = ids[typeId];
+        if(arr.opcode == spv::OpTypeRuntimeArray)
+          b.count = 0;
+        else if(b.count != 0)
+          b.count *= ids[arr.operands[1]].operands.size() > 2 ? ids[arr.operands[1]].operands[2] : 1;
+        typeId = arr.operands[0];
+      }
+
+      const SpvId& type = ids[typeId];
+      switch (type.opcode)
+      {
+      case spv::OpTypeStruct:
+        if(storageClass == spv::StorageClassStorageBuffer || type.bufferBlock)
+          b.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        else
+          b.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        break;
+      case spv::OpTypeSampler:
+        b.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        break;
+      case spv::OpTypeSampledImage:
+        b.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        break;
+      case spv::OpTypeImage: // sampled type, dim, depth, arrayed, ms, sampled, format
+      {
+        const uint32_t dim     = type.operands[1];
+        const uint32_t sampled = type.operands[5];
+        if(dim == spv::DimBuffer)
+          b.type = (sampled == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        else if(dim == spv::DimSubpassData)
+          b.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        else
+          b.type = (sampled == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        break;
+      }
+      case spv::OpTypeAccelerationStructureKHR:
+        b.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        break;
+      default:
+        continue;
+      }
+
+      result.bindings.push_back(b);
+    }
+
+    std::sort(result.bindings.begin(), result.bindings.end(), [](const auto& a, const auto& b)
+              { return std::tie(a.set, a.binding) < std::tie(b.set, b.binding); });
+
+    a_out.Merge(result);
+    return true;
+  }
+
+  void ShaderReflection::Merge(const ShaderReflection &a_other)
+  {
+    for (const auto& b : a_other.bindings)
+    {
+      auto it = std::lower_bound(bindings.begin(), bindings.end(), b, [](const auto& x, const auto& y)
+                                 { return std::tie(x.set, x.binding) < std::tie(y.set, y.binding); });
+      if(it != bindings.end() && it->set == b.set && it->binding == b.binding)
+      {
+        if(it->type != b.type || it->count != b.count)
+          VK_UTILS_LOG_WARNING("[ShaderReflection::Merge] binding " + std::to_string(b.binding) + " of set " +
+                               std::to_string(b.set) + " is declared differently in different stages");
+        it->stages |= b.stages;
+      }
+      else
+        bindings.insert(it, b);
+    }
+
+    pushConstantSize    = std::max(pushConstantSize, a_other.pushConstantSize);
+    pushConstantStages |= a_other.pushConstantStages;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////////////
+
+  size_t PipelineLayoutCache::KeyHash::operator()(const std::vector<uint64_t> &a_key) const
+  {
+    size_t currHash = a_key.size();
+    for (uint64_t word : a_key)
+      hash_combine(currHash, word);
+    return currHash;
+  }
+
+  PipelineLayoutCache::PipelineLayoutCache(VkDevice a_device, uint32_t a_runtimeArraySize, VkDescriptorBindingFlags a_runtimeArrayFlags) :
+    m_device(a_device), m_runtimeArraySize(a_runtimeArraySize), m_runtimeArrayFlags(a_runtimeArrayFlags)
+  {
+  }
+
+  PipelineLayoutCache::~PipelineLayoutCache()
+  {
+    for (auto& [key, layout] : m_pipelineLayouts)
+      vkDestroyPipelineLayout(m_device, layout, nullptr);
+    for (auto& [key, layout] : m_setLayouts)
+      vkDestroyDescriptorSetLayout(m_device, layout, nullptr);
+  }
+
+  VkDescriptorSetLayout PipelineLayoutCache::GetSetLayout(std::vector<VkDescriptorSetLayoutBinding> a_bindings,
+                                                          VkDescriptorSetLayoutCreateFlags a_flags,
+                                                          std::vector<VkDescriptorBindingFlags> a_bindingFlags)
+  {
+    a_bindingFlags.resize(a_bindings.size(), 0);
+    std::vector<size_t> order(a_bindings.size());
+    for (size_t i = 0; i < order.size(); ++i)
+      order[i] = i;
+    std::sort(order.begin(), order.end(), [&a_bindings](size_t a, size_t b) { return a_bindings[a].binding < a_bindings[b].binding; });
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings(a_bindings.size());
+    std::vector<VkDescriptorBindingFlags>     bindingFlags(a_bindings.size());
+    bool hasBindingFlags = false;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+      bindings[i]     = a_bindings[order[i]];
+      bindingFlags[i] = a_bindingFlags[order[i]];
+      hasBindingFlags = hasBindingFlags || (bindingFlags[i] != 0);
+    }
+
+    std::vector<uint64_t> key;
+    key.reserve(1 + bindings.size() * 3);
+    key.push_back(a_flags);
+    for (size_t i = 0; i < bindings.size(); ++i)
+    {
+      const auto& b = bindings[i];
+      key.push_back((uint64_t(b.binding) << 32) | uint32_t(b.descriptorType));
+      key.push_back((uint64_t(b.descriptorCount) << 32) | b.stageFlags);
+      key.push_back(bindingFlags[i]);
+    }
+
+    auto found = m_setLayouts.find(key);
+    if(found != m_setLayouts.end())
+      return found->second;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+    bindingFlagsInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount  = (uint32_t)bindingFlags.size();
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo createInfo = {};
+    createInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    createInfo.pNext        = hasBindingFlags ? &bindingFlagsInfo : nullptr;
+    createInfo.flags        = a_flags;
+    createInfo.bindingCount = (uint32_t)bindings.size();
+    createInfo.pBindings    = bindings.data();
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_device, &createInfo, nullptr, &layout));
+    m_setLayouts[std::move(key)] = layout;
+    return layout;
+  }
+
+  VkPipelineLayout PipelineLayoutCache::GetPipelineLayout(const std::vector<VkDescriptorSetLayout> &a_setLayouts,
+                                                          const std::vector<VkPushConstantRange> &a_pushConstants)
+  {
+    std::vector<uint64_t> key;
+    key.reserve(1 + a_setLayouts.size() + a_pushConstants.size() * 2);
+    key.push_back(a_setLayouts.size());
+    for (auto layout : a_setLayouts)
+      key.push_back(handleToU64(layout));
+    for (const auto& range : a_pushConstants)
+    {
+      key.push_back(range.stageFlags);
+      key.push_back((uint64_t(range.offset) << 32) | range.size);
+    }
+
+    auto found = m_pipelineLayouts.find(key);
+    if(found != m_pipelineLayouts.end())
+      return found->second;
+
+    VkPipelineLayoutCreateInfo createInfo = {};
+    createInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    createInfo.setLayoutCount         = (uint32_t)a_setLayouts.size();
+    createInfo.pSetLayouts            = a_setLayouts.empty() ? nullptr : a_setLayouts.data();
+    createInfo.pushConstantRangeCount = (uint32_t)a_pushConstants.size();
+    createInfo.pPushConstantRanges    = a_pushConstants.empty() ? nullptr : a_pushConstants.data();
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(m_device, &createInfo, nullptr, &layout));
+    m_pipelineLayouts[std::move(key)] = layout;
+    return layout;
+  }
+
+  VkPipelineLayout PipelineLayoutCache::GetPipelineLayout(const ShaderReflection &a_reflection,
+                                                          std::vector<VkDescriptorSetLayout> *a_pSetLayouts)
+  {
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> setBindings(a_reflection.SetCount());
+    std::vector<std::vector<VkDescriptorBindingFlags>>     setBindingFlags(a_reflection.SetCount());
+    for (const auto& b : a_reflection.bindings)
+    {
+      VkDescriptorSetLayoutBinding lb = {};
+      lb.binding         = b.binding;
+      lb.descriptorType  = b.type;
+      lb.descriptorCount = (b.count == 0) ? m_runtimeArraySize : b.count;
+      lb.stageFlags      = b.stages;
+      setBindings[b.set].push_back(lb);
+      setBindingFlags[b.set].push_back((b.count == 0) ? m_runtimeArrayFlags : 0);
+    }
+
+    // bindings are sorted, only the last one of a set may have variable descriptor count
+    for (auto& flags : setBindingFlags)
+    {
+      for (size_t i = 0; i + 1 < flags.size(); ++i)
+        flags[i] &= ~VkDescriptorBindingFlags(VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT);
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(setBindings.size());
+    for (size_t i = 0; i < setBindings.size(); ++i)
+      setLayouts[i] = GetSetLayout(setBindings[i], 0, setBindingFlags[i]);
+
+    std::vector<VkPushConstantRange> pushConstants;
+    if(a_reflection.pushConstantSize > 0)
+      pushConstants.push_back({a_reflection.pushConstantStages, 0, a_reflection.pushConstantSize});
+
+    if(a_pSetLayouts != nullptr)
+      *a_pSetLayouts = setLayouts;
+
+    return GetPipelineLayout(setLayouts, pushConstants);
+  }
+}
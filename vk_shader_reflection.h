@@ -0,0 +1,84 @@
+#ifndef VK_UTILS_SHADER_REFLECTION_H
+#define VK_UTILS_SHADER_REFLECTION_H
+
+#include "vk_include.h"
+
+#include <vector>
+#include <unordered_map>
+
+namespace vk_utils
+{
+  // Resource interface of one or several shader stages, extracted from SPIR-V
+  //
+  struct ShaderReflection
+  {
+    struct Binding
+    {
+      uint32_t set     = 0;
+      uint32_t binding = 0;
+      VkDescriptorType   type   = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+      uint32_t           count  = 1; // 0 for runtime arrays
+      VkShaderStageFlags stages = 0;
+    };
+
+    std::vector<Binding> bindings;   // sorted by (set, binding)
+    uint32_t           pushConstantSize   = 0;
+    VkShaderStageFlags pushConstantStages = 0;
+
+    // adds bindings and push constants of other stage(s), stage flags of equal bindings are merged
+    void Merge(const ShaderReflection &a_other);
+    uint32_t SetCount() const { return bindings.empty() ? 0 : bindings.back().set + 1; }
+  };
+
+  // Lightweight SPIR-V parser (no external dependencies), works on words returned by readSPVFile.
+  // Finds descriptor bindings (set, binding, type, array size) and push constant block size of a_stage;
+  // returns false if a_code is not a valid SPIR-V module.
+  //
+  bool reflectSPIRV(const std::vector<uint32_t> &a_code, VkShaderStageFlags a_stage, ShaderReflection &a_out);
+
+  // Deduplicating cache of descriptor set layouts and pipeline layouts, owns all created objects.
+  // Equal layouts requested by different pipelines return the same handle, so sets stay compatible between them
+  // and don't have to be rebound. Don't destroy returned layouts (e.g. with destroyPipelineIfExists) manually.
+  //
+  class PipelineLayoutCache
+  {
+  public:
+    // a_runtimeArraySize is descriptor count for runtime arrays (count == 0 in reflection), they get a_runtimeArrayFlags.
+    // PARTIALLY_BOUND needs descriptorBindingPartiallyBound (globalContextInit enables it if supported), pass 0 without it.
+    // VARIABLE_DESCRIPTOR_COUNT needs descriptorBindingVariableDescriptorCount and sets allocated with
+    // VkDescriptorSetVariableDescriptorCountAllocateInfo by the caller; it is kept only for the highest binding of a set.
+    explicit PipelineLayoutCache(VkDevice a_device, uint32_t a_runtimeArraySize = 1024,
+                                 VkDescriptorBindingFlags a_runtimeArrayFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT);
+    ~PipelineLayoutCache();
+
+    PipelineLayoutCache(PipelineLayoutCache const&) = delete;
+    PipelineLayoutCache& operator=(PipelineLayoutCache const&) = delete;
+
+    // a_bindingFlags is empty or has flags of each binding in a_bindings
+    VkDescriptorSetLayout GetSetLayout(std::vector<VkDescriptorSetLayoutBinding> a_bindings, VkDescriptorSetLayoutCreateFlags a_flags = 0,
+                                       std::vector<VkDescriptorBindingFlags> a_bindingFlags = {});
+
+    VkPipelineLayout GetPipelineLayout(const std::vector<VkDescriptorSetLayout> &a_setLayouts,
+                                       const std::vector<VkPushConstantRange> &a_pushConstants);
+
+    // set layouts for sets 0..SetCount()-1 (empty layout for gaps) are written to a_pSetLayouts if it is not null
+    VkPipelineLayout GetPipelineLayout(const ShaderReflection &a_reflection, std::vector<VkDescriptorSetLayout> *a_pSetLayouts = nullptr);
+
+    size_t SetLayoutCount() const { return m_setLayouts.size(); }
+    size_t PipelineLayoutCount() const { return m_pipelineLayouts.size(); }
+
+  private:
+    struct KeyHash
+    {
+      size_t operator()(const std::vector<uint64_t> &a_key) const;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_runtimeArraySize = 1024;
+    VkDescriptorBindingFlags m_runtimeArrayFlags = 0;
+    std::unordered_map<std::vector<uint64_t>, VkDescriptorSetLayout, KeyHash> m_setLayouts;
+    std::unordered_map<std::vector<uint64_t>, VkPipelineLayout, KeyHash> m_pipelineLayouts;
+  };
+}
+
+#endif// VK_UTILS_SHADER_REFLECTION_H
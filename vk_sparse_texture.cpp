@@ -0,0 +1,439 @@
+#include "vk_sparse_texture.h"
+#include "vk_utils.h"
+#include "vk_buffers.h"
+#include "vk_images.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <string>
+#include <unordered_set>
+
+namespace vk_utils
+{
+  static uint32_t divUp(uint32_t a, uint32_t b) { return (a + b - 1) / b; }
+
+  bool SparseTexture::IsSparseSupported(VkPhysicalDevice a_physicalDevice, const VkImageCreateInfo& a_createInfo, uint32_t a_queueFamily)
+  {
+    if(a_createInfo.imageType != VK_IMAGE_TYPE_2D || a_createInfo.arrayLayers != 1)
+      return false;
+
+    VkPhysicalDeviceFeatures features = {};
+    vkGetPhysicalDeviceFeatures(a_physicalDevice, &features);
+    if(!features.sparseBinding || !features.sparseResidencyImage2D)
+      return false;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(a_physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(a_physicalDevice, &familyCount, families.data());
+    if(a_queueFamily >= familyCount || !(families[a_queueFamily].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT))
+    {
+      VK_UTILS_LOG_ERROR("[SparseTexture::IsSparseSupported] queue family " + std::to_string(a_queueFamily) +
+                         " doesn't support VK_QUEUE_SPARSE_BINDING_BIT");
+      return false;
+    }
+
+    uint32_t propCount = 0;
+    vkGetPhysicalDeviceSparseImageFormatProperties(a_physicalDevice, a_createInfo.format, a_createInfo.imageType,
+                                                   a_createInfo.samples, a_createInfo.usage, a_createInfo.tiling,
+                                                   &propCount, nullptr);
+    return propCount > 0;
+  }
+
+  SparseTexture::SparseTexture(VkDevice a_device, VkPhysicalDevice a_physicalDevice, VkQueue a_sparseQueue, uint32_t a_sparseQueueFamily,
+                               std::shared_ptr<IMemoryAlloc> a_pAlloc, std::shared_ptr<ICopyEngine> a_pCopy,
+                               const VkImageCreateInfo& a_createInfo, uint32_t a_maxResidentTiles) :
+    m_device(a_device), m_physicalDevice(a_physicalDevice), m_sparseQueue(a_sparseQueue), m_pAlloc(a_pAlloc), m_pCopy(a_pCopy),
+    m_createInfo(a_createInfo), m_maxTiles(a_maxResidentTiles)
+  {
+    assert(m_maxTiles > 0);
+    assert(m_createInfo.mipLevels <= 16);
+
+    m_sparse = m_sparseQueue != VK_NULL_HANDLE && IsSparseSupported(m_physicalDevice, m_createInfo, a_sparseQueueFamily);
+    m_mipTailFirstLod = m_createInfo.mipLevels;
+
+    MemAllocInfo allocInfo = {};
+    allocInfo.memUsage = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    VkSparseImageMemoryRequirements sparseReq = {};
+    if(m_sparse)
+    {
+      VkImageCreateInfo imgInfo = m_createInfo;
+      imgInfo.flags |= VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+      VK_CHECK_RESULT(vkCreateImage(m_device, &imgInfo, nullptr, &m_image));
+
+      VkSemaphoreCreateInfo semaphoreInfo = {};
+      semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      VK_CHECK_RESULT(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_bindSemaphore));
+
+      VkMemoryRequirements memReq = {};
+      vkGetImageMemoryRequirements(m_device, m_image, &memReq);
+
+      uint32_t reqCount = 0;
+      vkGetImageSparseMemoryRequirements(m_device, m_image, &reqCount, nullptr);
+      std::vector<VkSparseImageMemoryRequirements> sparseReqs(reqCount);
+      vkGetImageSparseMemoryRequirements(m_device, m_image, &reqCount, sparseReqs.data());
+      for(const auto& req : sparseReqs)
+      {
+        if(req.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT)
+          sparseReq = req;
+      }
+
+      m_tileSize        = memReq.alignment;
+      m_tileExtent      = sparseReq.formatProperties.imageGranularity;
+      m_mipTailFirstLod = std::min(sparseReq.imageMipTailFirstLod, m_createInfo.mipLevels);
+
+      // tiles go first, mip tail is placed at the end of the pool
+      allocInfo.memReq = memReq;
+      allocInfo.memReq.size = VkDeviceSize(m_maxTiles) * m_tileSize + getPaddedSize(sparseReq.imageMipTailSize, m_tileSize);
+      m_poolAllocId = m_pAlloc->Allocate(allocInfo);
+    }
+    else
+    {
+      // software fallback: tiles of ~64KB stored in a fully resident atlas
+      const uint32_t bpp = std::max<uint32_t>(bppFromVkFormat(m_createInfo.format), 1u);
+      m_tileExtent = {256, 256, 1};
+      while(m_tileExtent.width * m_tileExtent.height * bpp > 65536)
+      {
+        if(m_tileExtent.width > m_tileExtent.height)
+          m_tileExtent.width /= 2;
+        else
+          m_tileExtent.height /= 2;
+      }
+      m_tileSize    = VkDeviceSize(m_tileExtent.width) * m_tileExtent.height * bpp;
+      m_atlasTilesX = static_cast<uint32_t>(std::ceil(std::sqrt(double(m_maxTiles))));
+
+      VkImageCreateInfo atlasInfo = m_createInfo;
+      atlasInfo.extent      = {m_atlasTilesX * m_tileExtent.width, divUp(m_maxTiles, m_atlasTilesX) * m_tileExtent.height, 1};
+      atlasInfo.mipLevels   = 1;
+      atlasInfo.arrayLayers = 1;
+      atlasInfo.usage      |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+      VK_CHECK_RESULT(vkCreateImage(m_device, &atlasInfo, nullptr, &m_image));
+
+      vkGetImageMemoryRequirements(m_device, m_image, &allocInfo.memReq);
+      m_imageAllocId = m_pAlloc->Allocate(allocInfo);
+      auto block = m_pAlloc->GetMemoryBlock(m_imageAllocId);
+      VK_CHECK_RESULT(vkBindImageMemory(m_device, m_image, block.memory, block.offset));
+    }
+
+    uint32_t totalTiles = 0;
+    for(uint32_t mip = 0; mip < m_createInfo.mipLevels; ++mip)
+    {
+      const bool inTail = mip >= m_mipTailFirstLod;
+      m_mipTilesX.push_back(inTail ? 0 : divUp(std::max(m_createInfo.extent.width  >> mip, 1u), m_tileExtent.width));
+      m_mipTilesY.push_back(inTail ? 0 : divUp(std::max(m_createInfo.extent.height >> mip, 1u), m_tileExtent.height));
+      m_mipPageOffset.push_back(totalTiles);
+      totalTiles += m_mipTilesX.back() * m_mipTilesY.back();
+    }
+    m_pageTable.resize(totalTiles, INVALID_SLOT);
+
+    m_slotOwner.resize(m_maxTiles, INVALID_SLOT);
+    m_slotLastUse.resize(m_maxTiles, 0);
+    m_freeSlots.reserve(m_maxTiles);
+    for(uint32_t i = m_maxTiles; i > 0; --i)
+      m_freeSlots.push_back(i - 1);
+
+    VkMemoryRequirements ptReq = {};
+    m_pageTableBuf = createBuffer(m_device, std::max<VkDeviceSize>(totalTiles, 1) * sizeof(uint32_t),
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &ptReq);
+    MemAllocInfo ptAllocInfo = {};
+    ptAllocInfo.memUsage = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    ptAllocInfo.memReq   = ptReq;
+    m_pageTableAllocId   = m_pAlloc->Allocate(ptAllocInfo);
+    auto ptBlock = m_pAlloc->GetMemoryBlock(m_pageTableAllocId);
+    VK_CHECK_RESULT(vkBindBufferMemory(m_device, m_pageTableBuf, ptBlock.memory, ptBlock.offset));
+
+    if(totalTiles > 0)
+    {
+      std::vector<uint32_t> zeros(totalTiles, 0);
+      m_pCopy->UpdateBuffer(m_pageTableBuf, 0, zeros.data(), zeros.size() * sizeof(uint32_t));
+    }
+
+    if(m_sparse && m_mipTailFirstLod < m_createInfo.mipLevels)
+    {
+      auto block = m_pAlloc->GetMemoryBlock(m_poolAllocId);
+
+      VkSparseMemoryBind tailBind = {};
+      tailBind.resourceOffset = sparseReq.imageMipTailOffset;
+      tailBind.size           = sparseReq.imageMipTailSize;
+      tailBind.memory         = block.memory;
+      tailBind.memoryOffset   = block.offset + VkDeviceSize(m_maxTiles) * m_tileSize;
+      SubmitBinds({}, &tailBind, {}, true);
+    }
+  }
+
+  void SparseTexture::Cleanup()
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+
+    if(m_sparseQueue != VK_NULL_HANDLE)
+      vkQueueWaitIdle(m_sparseQueue);
+
+    vkDestroyImage(m_device, m_image, nullptr);
+    vkDestroyBuffer(m_device, m_pageTableBuf, nullptr);
+    vkDestroySemaphore(m_device, m_bindSemaphore, nullptr);
+    m_image         = VK_NULL_HANDLE;
+    m_pageTableBuf  = VK_NULL_HANDLE;
+    m_bindSemaphore = VK_NULL_HANDLE;
+
+    for(auto id : {m_poolAllocId, m_imageAllocId, m_pageTableAllocId})
+    {
+      if(id != UINT32_MAX)
+        m_pAlloc->Free(id);
+    }
+    m_poolAllocId = m_imageAllocId = m_pageTableAllocId = UINT32_MAX;
+
+    m_device = VK_NULL_HANDLE;
+  }
+
+  uint32_t SparseTexture::TileIndex(uint32_t a_tile) const
+  {
+    uint32_t mip, x, y;
+    unpackTileId(a_tile, mip, x, y);
+    if(mip >= m_mipTilesX.size() || x >= m_mipTilesX[mip] || y >= m_mipTilesY[mip])
+      return INVALID_SLOT;
+
+    return m_mipPageOffset[mip] + y * m_mipTilesX[mip] + x;
+  }
+
+  uint32_t SparseTexture::TileId(uint32_t a_tileIdx) const
+  {
+    uint32_t mip = static_cast<uint32_t>(m_mipPageOffset.size()) - 1;
+    while(m_mipPageOffset[mip] > a_tileIdx || m_mipTilesX[mip] == 0)
+      mip--;
+
+    const uint32_t local = a_tileIdx - m_mipPageOffset[mip];
+    return packTileId(mip, local % m_mipTilesX[mip], local / m_mipTilesX[mip]);
+  }
+
+  bool SparseTexture::IsResident(uint32_t a_tile) const
+  {
+    uint32_t idx = TileIndex(a_tile);
+    return idx != INVALID_SLOT && m_pageTable[idx] != INVALID_SLOT;
+  }
+
+  void SparseTexture::GetTileRegion(uint32_t a_tile, uint32_t &a_mip, VkOffset3D &a_offset, VkExtent3D &a_extent) const
+  {
+    uint32_t x, y;
+    unpackTileId(a_tile, a_mip, x, y);
+    a_offset = {0, 0, 0};
+    a_extent = {0, 0, 0};
+
+    const uint32_t idx = TileIndex(a_tile);
+    if(idx == INVALID_SLOT)
+      return;
+
+    const uint32_t mipWidth  = std::max(m_createInfo.extent.width  >> a_mip, 1u);
+    const uint32_t mipHeight = std::max(m_createInfo.extent.height >> a_mip, 1u);
+    a_extent.width  = std::min(m_tileExtent.width,  mipWidth  - x * m_tileExtent.width);
+    a_extent.height = std::min(m_tileExtent.height, mipHeight - y * m_tileExtent.height);
+    a_extent.depth  = 1;
+
+    if(m_sparse)
+    {
+      a_offset = {int32_t(x * m_tileExtent.width), int32_t(y * m_tileExtent.height), 0};
+    }
+    else
+    {
+      const uint32_t slot = m_pageTable[idx];
+      if(slot == INVALID_SLOT)
+      {
+        a_extent = {0, 0, 0};
+        return;
+      }
+      a_offset = {int32_t((slot % m_atlasTilesX) * m_tileExtent.width), int32_t((slot / m_atlasTilesX) * m_tileExtent.height), 0};
+      a_mip    = 0;
+    }
+  }
+
+  void SparseTexture::RequestTiles(const std::vector<uint32_t> &a_tiles)
+  {
+    for(auto tile : a_tiles)
+    {
+      if(TileIndex(tile) == INVALID_SLOT)
+        continue;
+      m_pendingCommit.push_back(tile);
+    }
+  }
+
+  void SparseTexture::ReleaseTiles(const std::vector<uint32_t> &a_tiles)
+  {
+    for(auto tile : a_tiles)
+    {
+      if(TileIndex(tile) == INVALID_SLOT)
+        continue;
+      m_pendingDecommit.push_back(tile);
+    }
+  }
+
+  void SparseTexture::ProcessFeedback(const uint32_t* a_tiles, size_t a_count)
+  {
+    std::unordered_set<uint32_t> unique;
+    std::vector<uint32_t> requested;
+    for(size_t i = 0; i < a_count; ++i)
+    {
+      if(unique.insert(a_tiles[i]).second)
+        requested.push_back(a_tiles[i]);
+    }
+    RequestTiles(requested);
+  }
+
+  VkSparseImageMemoryBind SparseTexture::MakeBind(uint32_t a_tileIdx, VkDeviceMemory a_mem, VkDeviceSize a_memOffset) const
+  {
+    uint32_t mip;
+    VkSparseImageMemoryBind bind = {};
+    GetTileRegion(TileId(a_tileIdx), mip, bind.offset, bind.extent);
+    bind.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    bind.subresource.mipLevel   = mip;
+    bind.subresource.arrayLayer = 0;
+    bind.memory       = a_mem;
+    bind.memoryOffset = a_memOffset;
+
+    return bind;
+  }
+
+  void SparseTexture::Decommit(uint32_t a_tileIdx, std::vector<VkSparseImageMemoryBind> &a_binds)
+  {
+    const uint32_t slot = m_pageTable[a_tileIdx];
+    if(slot == INVALID_SLOT)
+      return;
+
+    if(m_sparse)
+      a_binds.push_back(MakeBind(a_tileIdx, VK_NULL_HANDLE, 0));
+
+    m_pageTable[a_tileIdx] = INVALID_SLOT;
+    m_slotOwner[slot]      = INVALID_SLOT;
+    m_freeSlots.push_back(slot);
+  }
+
+  uint32_t SparseTexture::AcquireSlot(std::vector<VkSparseImageMemoryBind> &a_binds)
+  {
+    if(m_freeSlots.empty())
+    {
+      // evict least recently requested tile
+      auto lru = std::min_element(m_slotLastUse.begin(), m_slotLastUse.end());
+      Decommit(m_slotOwner[std::distance(m_slotLastUse.begin(), lru)], a_binds);
+    }
+
+    uint32_t slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    return slot;
+  }
+
+  void SparseTexture::SubmitBinds(const std::vector<VkSparseImageMemoryBind> &a_binds, const VkSparseMemoryBind* a_pOpaqueBind,
+                                  const std::vector<VkSemaphore> &a_signalSemaphores, bool a_wait)
+  {
+    VkSparseImageMemoryBindInfo imageBindInfo = {};
+    imageBindInfo.image     = m_image;
+    imageBindInfo.bindCount = static_cast<uint32_t>(a_binds.size());
+    imageBindInfo.pBinds    = a_binds.data();
+
+    VkSparseImageOpaqueMemoryBindInfo opaqueBindInfo = {};
+    opaqueBindInfo.image     = m_image;
+    opaqueBindInfo.bindCount = 1;
+    opaqueBindInfo.pBinds    = a_pOpaqueBind;
+
+    VkBindSparseInfo bindInfo = {};
+    bindInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+    if(!a_binds.empty())
+    {
+      bindInfo.imageBindCount = 1;
+      bindInfo.pImageBinds    = &imageBindInfo;
+    }
+    if(a_pOpaqueBind != nullptr)
+    {
+      bindInfo.imageOpaqueBindCount = 1;
+      bindInfo.pImageOpaqueBinds    = &opaqueBindInfo;
+    }
+    if(!a_signalSemaphores.empty())
+    {
+      bindInfo.signalSemaphoreCount = static_cast<uint32_t>(a_signalSemaphores.size());
+      bindInfo.pSignalSemaphores    = a_signalSemaphores.data();
+    }
+
+    VkFence fence = VK_NULL_HANDLE;
+    if(a_wait)
+    {
+      VkFenceCreateInfo fenceCreateInfo = {};
+      fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+      VK_CHECK_RESULT(vkCreateFence(m_device, &fenceCreateInfo, nullptr, &fence));
+    }
+
+    VK_CHECK_RESULT(vkQueueBindSparse(m_sparseQueue, 1, &bindInfo, fence));
+
+    if(a_wait)
+    {
+      VK_CHECK_RESULT(vkWaitForFences(m_device, 1, &fence, VK_TRUE, DEFAULT_TIMEOUT));
+      vkDestroyFence(m_device, fence, nullptr);
+    }
+  }
+
+  void SparseTexture::Flush(VkSemaphore a_signalSemaphore)
+  {
+    if(m_pendingCommit.empty() && m_pendingDecommit.empty())
+      return;
+
+    std::vector<VkSparseImageMemoryBind> binds;
+    for(auto tile : m_pendingDecommit)
+      Decommit(TileIndex(tile), binds);
+
+    const MemoryBlock pool = m_sparse ? m_pAlloc->GetMemoryBlock(m_poolAllocId) : MemoryBlock{};
+
+    std::vector<uint32_t> committed;
+    for(auto tile : m_pendingCommit)
+    {
+      const uint32_t idx = TileIndex(tile);
+      if(m_pageTable[idx] != INVALID_SLOT)
+      {
+        m_slotLastUse[m_pageTable[idx]] = ++m_useCounter;
+        continue;
+      }
+
+      const uint32_t slot = AcquireSlot(binds);
+      m_pageTable[idx]    = slot;
+      m_slotOwner[slot]   = idx;
+      m_slotLastUse[slot] = ++m_useCounter;
+      committed.push_back(tile);
+
+      if(m_sparse)
+        binds.push_back(MakeBind(idx, pool.memory, pool.offset + VkDeviceSize(slot) * m_tileSize));
+    }
+
+    // tile evicted and requested again in the same batch ends up committed, drop stale entries
+    committed.erase(std::remove_if(committed.begin(), committed.end(), [this](uint32_t t) { return !IsResident(t); }),
+                    committed.end());
+
+    m_pendingCommit.clear();
+    m_pendingDecommit.clear();
+
+    // copy engine waits for m_bindSemaphore in the page table upload and returns after it is finished,
+    // so binds are complete before tiles are uploaded in m_onCommitted; engines which can't wait for a semaphore
+    // get the bind waited on the host instead
+    //
+    if(m_sparse && !binds.empty())
+    {
+      std::vector<VkSemaphore> signalSemaphores;
+      if(a_signalSemaphore != VK_NULL_HANDLE)
+        signalSemaphores.push_back(a_signalSemaphore);
+
+      const bool gpuWait = m_pCopy->WaitSemaphore(m_bindSemaphore, VK_PIPELINE_STAGE_TRANSFER_BIT);
+      if(gpuWait)
+        signalSemaphores.push_back(m_bindSemaphore);
+      SubmitBinds(binds, nullptr, signalSemaphores, !gpuWait);
+    }
+
+    std::vector<uint32_t> gpuTable(m_pageTable.size());
+    for(size_t i = 0; i < m_pageTable.size(); ++i)
+      gpuTable[i] = (m_pageTable[i] == INVALID_SLOT) ? 0 : m_pageTable[i] + 1;
+    if(!gpuTable.empty())
+      m_pCopy->UpdateBuffer(m_pageTableBuf, 0, gpuTable.data(), gpuTable.size() * sizeof(uint32_t));
+
+    if(m_onCommitted)
+    {
+      for(auto tile : committed)
+        m_onCommitted(tile);
+    }
+  }
+}
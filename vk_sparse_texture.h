@@ -0,0 +1,136 @@
+#ifndef VK_UTILS_SPARSE_TEXTURE_H
+#define VK_UTILS_SPARSE_TEXTURE_H
+
+#include "vk_include.h"
+#include "vk_alloc.h"
+#include "vk_copy.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace vk_utils
+{
+  // tile id packed into 32 bits: mip (4 bits) | y (14 bits) | x (14 bits),
+  // same packing is expected in GPU feedback buffers
+  //
+  static inline uint32_t packTileId(uint32_t a_mip, uint32_t a_x, uint32_t a_y) { return (a_mip << 28u) | (a_y << 14u) | a_x; }
+  static inline void unpackTileId(uint32_t a_tile, uint32_t &a_mip, uint32_t &a_x, uint32_t &a_y)
+  {
+    a_mip = a_tile >> 28u;
+    a_y   = (a_tile >> 14u) & 0x3FFFu;
+    a_x   = a_tile & 0x3FFFu;
+  }
+
+  // Partially resident 2D texture with page granular residency.
+  //
+  // Sparse mode (device supports sparseResidencyImage2D for the format): image is created with SPARSE_RESIDENCY flag,
+  // tiles are bound to slots of a fixed memory pool with vkQueueBindSparse, mip tail is always resident.
+  //
+  // Fallback mode: physical pages live in a fully resident atlas image (GetImage() returns atlas),
+  // shaders translate virtual tile to atlas slot using page table buffer (GetPageTableBuffer(), one uint per tile
+  // of every mip, 0 - not resident, slot + 1 otherwise; GetMipPageOffsets() gives per-mip start in this table).
+  //
+  // Commits/decommits are queued by RequestTiles/ReleaseTiles and applied in a single batch by Flush.
+  // When pool is full, least recently requested tiles are decommitted to make room.
+  //
+  struct SparseTexture
+  {
+    SparseTexture(VkDevice a_device, VkPhysicalDevice a_physicalDevice, VkQueue a_sparseQueue, uint32_t a_sparseQueueFamily,
+                  std::shared_ptr<IMemoryAlloc> a_pAlloc, std::shared_ptr<ICopyEngine> a_pCopy,
+                  const VkImageCreateInfo& a_createInfo, uint32_t a_maxResidentTiles);
+
+    SparseTexture(SparseTexture const&) = delete;
+    SparseTexture& operator=(SparseTexture const&) = delete;
+
+    ~SparseTexture() { Cleanup(); }
+
+    void Cleanup();
+
+    // a_queueFamily is the family of the queue vkQueueBindSparse is issued on, it must have VK_QUEUE_SPARSE_BINDING_BIT
+    //
+    static bool IsSparseSupported(VkPhysicalDevice a_physicalDevice, const VkImageCreateInfo& a_createInfo, uint32_t a_queueFamily);
+
+    bool IsSparse() const { return m_sparse; }
+    VkImage GetImage() const { return m_image; }
+    VkBuffer GetPageTableBuffer() const { return m_pageTableBuf; }
+    const std::vector<uint32_t>& GetMipPageOffsets() const { return m_mipPageOffset; }
+
+    VkExtent3D GetTileExtent() const { return m_tileExtent; }
+    uint32_t GetNumTilesX(uint32_t a_mip) const { return m_mipTilesX[a_mip]; }
+    uint32_t GetNumTilesY(uint32_t a_mip) const { return m_mipTilesY[a_mip]; }
+
+    // texel region of tile inside its mip level (sparse mode) or inside atlas (fallback mode),
+    // this is where streaming system uploads tile data to after commit
+    //
+    void GetTileRegion(uint32_t a_tile, uint32_t &a_mip, VkOffset3D &a_offset, VkExtent3D &a_extent) const;
+
+    void RequestTiles(const std::vector<uint32_t> &a_tiles);
+    void ReleaseTiles(const std::vector<uint32_t> &a_tiles);
+
+    // feedback hook: raw tile ids written by shaders (e.g. read back from a feedback buffer),
+    // duplicates and invalid ids are skipped
+    //
+    void ProcessFeedback(const uint32_t* a_tiles, size_t a_count);
+
+    // called for each tile which became resident during Flush, streaming system should upload tile data here;
+    // binds of the batch are complete on GPU by then
+    //
+    void SetOnTileCommitted(std::function<void(uint32_t)> a_callback) { m_onCommitted = std::move(a_callback); }
+
+    // submit all pending commits and decommits,
+    // a_signalSemaphore (optional) is signaled by vkQueueBindSparse in sparse mode
+    //
+    void Flush(VkSemaphore a_signalSemaphore = VK_NULL_HANDLE);
+
+    bool IsResident(uint32_t a_tile) const;
+    uint32_t NumResidentTiles() const { return m_maxTiles - static_cast<uint32_t>(m_freeSlots.size()); }
+
+  private:
+    static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+    uint32_t TileIndex(uint32_t a_tile) const;
+    uint32_t TileId(uint32_t a_tileIdx) const;
+    VkSparseImageMemoryBind MakeBind(uint32_t a_tileIdx, VkDeviceMemory a_mem, VkDeviceSize a_memOffset) const;
+    void Decommit(uint32_t a_tileIdx, std::vector<VkSparseImageMemoryBind> &a_binds);
+    uint32_t AcquireSlot(std::vector<VkSparseImageMemoryBind> &a_binds);
+    void SubmitBinds(const std::vector<VkSparseImageMemoryBind> &a_binds, const VkSparseMemoryBind* a_pOpaqueBind,
+                     const std::vector<VkSemaphore> &a_signalSemaphores, bool a_wait);
+
+    VkDevice         m_device         = VK_NULL_HANDLE;
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkQueue          m_sparseQueue    = VK_NULL_HANDLE;
+    std::shared_ptr<IMemoryAlloc> m_pAlloc;
+    std::shared_ptr<ICopyEngine>  m_pCopy;
+
+    bool m_sparse = false;
+    VkImageCreateInfo m_createInfo{};
+    VkImage  m_image   = VK_NULL_HANDLE;
+    VkSemaphore m_bindSemaphore = VK_NULL_HANDLE; // orders page table upload after vkQueueBindSparse
+    uint32_t m_poolAllocId = UINT32_MAX;
+    VkDeviceSize m_tileSize = 0;
+    VkExtent3D m_tileExtent{};
+    uint32_t m_mipTailFirstLod = 0;
+
+    uint32_t m_maxTiles = 0;
+    uint32_t m_atlasTilesX = 0;
+
+    std::vector<uint32_t> m_mipTilesX;
+    std::vector<uint32_t> m_mipTilesY;
+    std::vector<uint32_t> m_mipPageOffset;
+    std::vector<uint32_t> m_pageTable;     // tile index -> slot
+    std::vector<uint32_t> m_slotOwner;     // slot -> tile index
+    std::vector<uint64_t> m_slotLastUse;
+    std::vector<uint32_t> m_freeSlots;
+    uint64_t m_useCounter = 0;
+
+    uint32_t m_imageAllocId = UINT32_MAX;  // fallback atlas memory
+    VkBuffer m_pageTableBuf = VK_NULL_HANDLE;
+    uint32_t m_pageTableAllocId = UINT32_MAX;
+
+    std::vector<uint32_t> m_pendingCommit;
+    std::vector<uint32_t> m_pendingDecommit;
+    std::function<void(uint32_t)> m_onCommitted;
+  };
+}
+
+#endif //VK_UTILS_SPARSE_TEXTURE_H
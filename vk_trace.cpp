@@ -0,0 +1,196 @@
+#include "vk_trace.h"
+#include "vk_utils.h"
+#include "vk_ext_funcs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace vk_utils
+{
+  TraceRecorder::TraceRecorder(size_t a_reserveEvents) : m_startNs(NowNs())
+  {
+    m_cpuEvents.reserve(a_reserveEvents);
+  }
+
+  uint64_t TraceRecorder::NowNs()
+  {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  void TraceRecorder::AddCpuEvent(const char* a_name, const char* a_category, uint64_t a_beginNs, uint64_t a_endNs)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto thread = m_threads.emplace(std::this_thread::get_id(), uint32_t(m_threads.size())).first;
+    m_cpuEvents.push_back({ a_name, a_category, a_beginNs, a_endNs, thread->second });
+  }
+
+  void TraceRecorder::AddGpuEvent(const void* a_track, const std::string &a_name, uint64_t a_beginTicks, uint64_t a_endTicks,
+                                  double a_nsPerTick)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_anchored)
+    {
+      // the zone has finished by now, this is the best guess without calibrated timestamps
+      m_anchorTicks = a_endTicks;
+      m_anchorNs    = NowNs();
+      m_anchored    = true;
+    }
+
+    auto track = m_tracks.emplace(a_track, uint32_t(m_tracks.size())).first;
+    m_gpuEvents.push_back({ a_name, GpuToCpuNs(a_beginTicks, a_nsPerTick), GpuToCpuNs(a_endTicks, a_nsPerTick), track->second });
+  }
+
+  uint64_t TraceRecorder::GpuToCpuNs(uint64_t a_ticks, double a_nsPerTick) const
+  {
+    const int64_t ticks = int64_t(a_ticks - m_anchorTicks);
+    return uint64_t(int64_t(m_anchorNs) + int64_t(double(ticks) * a_nsPerTick));
+  }
+
+  bool TraceRecorder::Calibrate(VkDevice a_device, VkPhysicalDevice a_physicalDevice)
+  {
+#if defined(VK_EXT_calibrated_timestamps)
+    if(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT == nullptr || vkGetCalibratedTimestampsEXT == nullptr)
+      return false;
+
+    uint32_t domainCount = 0;
+    if(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(a_physicalDevice, &domainCount, nullptr) != VK_SUCCESS || domainCount == 0)
+      return false;
+    std::vector<VkTimeDomainEXT> domains(domainCount);
+    vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(a_physicalDevice, &domainCount, domains.data());
+
+    auto hasDomain = [&domains](VkTimeDomainEXT a_domain) { return std::find(domains.begin(), domains.end(), a_domain) != domains.end(); };
+    if(!hasDomain(VK_TIME_DOMAIN_DEVICE_EXT))
+      return false;
+
+    VkCalibratedTimestampInfoEXT infos[2] = {};
+    infos[0].sType      = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    infos[1].sType      = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+    uint64_t timestamps[2] = {};
+    uint64_t maxDeviation  = 0;
+    uint64_t gpuTicks      = 0;
+    uint64_t cpuNs         = 0;
+
+    // steady_clock is CLOCK_MONOTONIC in libstdc++ and libc++ on Linux, so this pair needs no conversion;
+    // elsewhere only the device clock is read, bracketed by two reads of steady_clock
+    //
+#if defined(__linux__)
+    const bool monotonic = hasDomain(VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT);
+#else
+    const bool monotonic = false;
+#endif
+    if(monotonic)
+    {
+      if(vkGetCalibratedTimestampsEXT(a_device, 2, infos, timestamps, &maxDeviation) != VK_SUCCESS)
+        return false;
+      gpuTicks = timestamps[0];
+      cpuNs    = timestamps[1];
+    }
+    else
+    {
+      const uint64_t before = NowNs();
+      if(vkGetCalibratedTimestampsEXT(a_device, 1, infos, timestamps, &maxDeviation) != VK_SUCCESS)
+        return false;
+      const uint64_t after = NowNs();
+      gpuTicks = timestamps[0];
+      cpuNs    = before + (after - before) / 2;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_anchorTicks = gpuTicks;
+    m_anchorNs    = cpuNs;
+    m_anchored    = true;
+    m_calibrated  = true;
+    return true;
+#else
+    (void)a_device;
+    (void)a_physicalDevice;
+    return false;
+#endif
+  }
+
+  bool TraceRecorder::IsCalibrated() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_calibrated;
+  }
+
+  size_t TraceRecorder::EventCount() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cpuEvents.size() + m_gpuEvents.size();
+  }
+
+  void TraceRecorder::Clear()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cpuEvents.clear();
+    m_gpuEvents.clear();
+  }
+
+  static std::string jsonEscape(const char* a_str)
+  {
+    std::string res;
+    for(const char* c = a_str; *c != '\0'; ++c)
+    {
+      if(*c == '"' || *c == '\\')
+        res += '\\';
+      if(uint8_t(*c) >= 0x20)
+        res += *c;
+    }
+    return res;
+  }
+
+  bool TraceRecorder::WriteChromeJson(const std::string &a_path) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // "X" (complete) events with microsecond timestamps relative to the recorder creation;
+    // CPU threads go to process 1, GPU tracks to process 2
+    //
+    std::ofstream file(a_path, std::ios::trunc);
+    char buf[128];
+    auto writeTimes = [&](uint64_t a_beginNs, uint64_t a_endNs) {
+      const double ts  = (double(int64_t(a_beginNs - m_startNs))) * 1e-3;
+      const double dur = (double(int64_t(a_endNs - a_beginNs))) * 1e-3;
+      snprintf(buf, sizeof(buf), "\"ts\":%.3f,\"dur\":%.3f", ts, std::max(dur, 0.0));
+      file << buf;
+    };
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+    for(const auto &track : m_tracks)
+    {
+      file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":" << track.second
+           << ",\"args\":{\"name\":\"GPU track " << track.second << "\"}}";
+    }
+
+    for(const auto &event : m_cpuEvents)
+    {
+      file << ",\n{\"name\":\"" << jsonEscape(event.name) << "\",\"cat\":\"" << jsonEscape(event.category)
+           << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",";
+      writeTimes(event.beginNs, event.endNs);
+      file << "}";
+    }
+
+    for(const auto &event : m_gpuEvents)
+    {
+      file << ",\n{\"name\":\"" << jsonEscape(event.name.c_str()) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":2,\"tid\":" << event.track << ",";
+      writeTimes(event.beginNs, event.endNs);
+      file << "}";
+    }
+    file << "\n]}\n";
+
+    if(!file.good())
+    {
+      VK_UTILS_LOG_WARNING("[TraceRecorder::WriteChromeJson] failed to write " + a_path);
+      return false;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,137 @@
+#ifndef VK_UTILS_TRACE_H
+#define VK_UTILS_TRACE_H
+
+#include "vk_include.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vk_utils
+{
+  // Collects CPU scopes (VK_UTILS_TRACE_SCOPE) and GPU zones (GpuProfiler) on one timeline and writes them in Chrome trace
+  // event JSON format, which chrome://tracing and ui.perfetto.dev open. Library code records submits and waits of
+  // executeCommandBufferNow, allocator calls, mapping and pipeline creation.
+  //
+  // Install with setTraceRecorder; without a recorder every scope costs one atomic load and pointer check, defining
+  // VK_UTILS_DISABLE_TRACE removes scopes completely. GPU timestamps are mapped to CPU time with VK_EXT_calibrated_timestamps
+  // (see Calibrate), otherwise the GPU timeline is anchored at the time its first zone is resolved, so it is shifted by up
+  // to a few frames.
+  //
+  // Thread safe.
+  //
+  class TraceRecorder
+  {
+  public:
+    explicit TraceRecorder(size_t a_reserveEvents = 65536);
+
+    TraceRecorder(TraceRecorder const&) = delete;
+    TraceRecorder& operator=(TraceRecorder const&) = delete;
+
+    static uint64_t NowNs(); // steady_clock, the CPU time base of all events
+
+    // a_name and a_category must outlive the recorder (string literals)
+    void AddCpuEvent(const char* a_name, const char* a_category, uint64_t a_beginNs, uint64_t a_endNs);
+    // a_track identifies the timeline (e.g. one GpuProfiler per queue), ticks are raw timestamp query values
+    void AddGpuEvent(const void* a_track, const std::string &a_name, uint64_t a_beginTicks, uint64_t a_endTicks, double a_nsPerTick);
+
+    // VK_EXT_calibrated_timestamps must be enabled on a_device and loaded with loadExtensionFunctions(device, instance);
+    // globalContextInit does both if the device supports it, unless extensions are given with a_pKnownFeatures.
+    // Repeat from time to time, clocks drift apart slowly.
+    // Returns false if the extension or a suitable time domain is not available.
+    bool Calibrate(VkDevice a_device, VkPhysicalDevice a_physicalDevice);
+    bool IsCalibrated() const;
+
+    bool   WriteChromeJson(const std::string &a_path) const;
+    size_t EventCount() const;
+    void   Clear();
+
+  private:
+    struct CpuEvent
+    {
+      const char* name;
+      const char* category;
+      uint64_t    beginNs;
+      uint64_t    endNs;
+      uint32_t    thread;
+    };
+
+    struct GpuEvent
+    {
+      std::string name;
+      uint64_t    beginNs;
+      uint64_t    endNs;
+      uint32_t    track;
+    };
+
+    uint64_t GpuToCpuNs(uint64_t a_ticks, double a_nsPerTick) const;
+
+    mutable std::mutex                           m_mutex;
+    uint64_t                                     m_startNs = 0;
+    std::vector<CpuEvent>                        m_cpuEvents;
+    std::vector<GpuEvent>                        m_gpuEvents;
+    std::unordered_map<std::thread::id, uint32_t> m_threads;
+    std::unordered_map<const void*, uint32_t>    m_tracks;
+
+    bool     m_calibrated    = false; // by Calibrate, not by the first GPU event
+    bool     m_anchored      = false;
+    uint64_t m_anchorTicks   = 0;
+    uint64_t m_anchorNs      = 0;
+  };
+
+  // inline, so that a disabled scope doesn't make a call; constant initialized, so there is no guard either
+  //
+  inline std::atomic<TraceRecorder*>& traceRecorderSlot()
+  {
+    static std::atomic<TraceRecorder*> recorder { nullptr };
+    return recorder;
+  }
+
+  // nullptr disables tracing; the recorder must outlive all threads which may record
+  inline void           setTraceRecorder(TraceRecorder* a_recorder) { traceRecorderSlot().store(a_recorder, std::memory_order_release); }
+  inline TraceRecorder* getTraceRecorder() { return traceRecorderSlot().load(std::memory_order_acquire); }
+
+  class TraceScope
+  {
+  public:
+    TraceScope(const char* a_name, const char* a_category) : m_recorder(getTraceRecorder())
+    {
+      if(m_recorder != nullptr)
+      {
+        m_name     = a_name;
+        m_category = a_category;
+        m_beginNs  = TraceRecorder::NowNs();
+      }
+    }
+
+    ~TraceScope()
+    {
+      if(m_recorder != nullptr)
+        m_recorder->AddCpuEvent(m_name, m_category, m_beginNs, TraceRecorder::NowNs());
+    }
+
+    TraceScope(TraceScope const&) = delete;
+    TraceScope& operator=(TraceScope const&) = delete;
+
+  private:
+    TraceRecorder* m_recorder = nullptr;
+    const char*    m_name     = nullptr;
+    const char*    m_category = nullptr;
+    uint64_t       m_beginNs  = 0;
+  };
+}
+
+#define VK_UTILS_TRACE_CONCAT_IMPL(a, b) a##b
+#define VK_UTILS_TRACE_CONCAT(a, b) VK_UTILS_TRACE_CONCAT_IMPL(a, b)
+
+#if defined(VK_UTILS_DISABLE_TRACE)
+  #define VK_UTILS_TRACE_SCOPE(name, category)
+#else
+  #define VK_UTILS_TRACE_SCOPE(name, category) vk_utils::TraceScope VK_UTILS_TRACE_CONCAT(vkUtilsTraceScope, __LINE__)(name, category)
+#endif
+
+#endif// VK_UTILS_TRACE_H
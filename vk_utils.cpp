@@ -1,4 +1,7 @@
 #include "vk_utils.h"
+#include "vk_embedded_shaders.h"
+#include "vk_ext_funcs.h"
+#include "vk_trace.h"
 
 #include <cstring>
 #include <set>
@@ -577,9 +580,14 @@ namespace vk_utils {
     fenceCreateInfo.flags = 0;
     VK_CHECK_RESULT(vkCreateFence(a_device, &fenceCreateInfo, NULL, &fence));
 
-    VK_CHECK_RESULT(vkQueueSubmit(a_queue, 1, &submitInfo, fence));
-
-    VK_CHECK_RESULT(vkWaitForFences(a_device, 1, &fence, VK_TRUE, DEFAULT_TIMEOUT));
+    {
+      VK_UTILS_TRACE_SCOPE("vkQueueSubmit", "submit");
+      VK_CHECK_RESULT(vkQueueSubmit(a_queue, 1, &submitInfo, fence));
+    }
+    {
+      VK_UTILS_TRACE_SCOPE("executeCommandBufferNow wait", "wait");
+      VK_CHECK_RESULT(vkWaitForFences(a_device, 1, &fence, VK_TRUE, DEFAULT_TIMEOUT));
+    }
 
     vkDestroyFence(a_device, fence, NULL);
   }
@@ -597,13 +605,29 @@ namespace vk_utils {
     fenceCreateInfo.flags = 0;
     VK_CHECK_RESULT(vkCreateFence(a_device, &fenceCreateInfo, NULL, &fence));
 
-    VK_CHECK_RESULT(vkQueueSubmit(a_queue, 1, &submitInfo, fence));
-
-    VK_CHECK_RESULT(vkWaitForFences(a_device, 1, &fence, VK_TRUE, DEFAULT_TIMEOUT));
+    {
+      VK_UTILS_TRACE_SCOPE("vkQueueSubmit", "submit");
+      VK_CHECK_RESULT(vkQueueSubmit(a_queue, 1, &submitInfo, fence));
+    }
+    {
+      VK_UTILS_TRACE_SCOPE("executeCommandBufferNow wait", "wait");
+      VK_CHECK_RESULT(vkWaitForFences(a_device, 1, &fence, VK_TRUE, DEFAULT_TIMEOUT));
+    }
 
     vkDestroyFence(a_device, fence, NULL);
   }
 
+  uint64_t hashFNV1a(const void* a_data, size_t a_size, uint64_t a_hash)
+  {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(a_data);
+    for(size_t i = 0; i < a_size; ++i)
+    {
+      a_hash ^= bytes[i];
+      a_hash *= 1099511628211ull;
+    }
+    return a_hash;
+  }
+
 #if defined(__ANDROID__)
 
   void setAssetManager(AAssetManager* assetManager) {
@@ -617,7 +641,11 @@ namespace vk_utils {
 
   std::vector<uint32_t> readSPVFile(const char* filename)
   {
-    AAsset* file = AAssetManager_open(g_AssetManager, filename, AASSET_MODE_BUFFER);
+    if(const EmbeddedShader* embedded = findEmbeddedShader(filename))
+      return std::vector<uint32_t>(embedded->code, embedded->code + embedded->wordCount);
+
+    const std::string path = resolveShaderPath(filename);
+    AAsset* file = AAssetManager_open(g_AssetManager, path.c_str(), AASSET_MODE_BUFFER);
     size_t fileLength = AAsset_getLength(file);
 
     auto fileSizePadded = uint64_t(ceil(fileLength / 4.0)) * 4;
@@ -636,10 +664,14 @@ namespace vk_utils {
 #else
   std::vector<uint32_t> readSPVFile(const char *filename)
   {
-    FILE *fp = fopen(filename, "rb");
+    if(const EmbeddedShader* embedded = findEmbeddedShader(filename))
+      return std::vector<uint32_t>(embedded->code, embedded->code + embedded->wordCount);
+
+    const std::string path = resolveShaderPath(filename);
+    FILE *fp = fopen(path.c_str(), "rb");
     if (fp == nullptr)
     {
-      std::string errorMsg = std::string("[vk_utils::readSPVFile]: can't open file ") + std::string(filename);
+      std::string errorMsg = std::string("[vk_utils::readSPVFile]: can't open file ") + path;
       RUN_TIME_ERROR(errorMsg.c_str());
     }
 
@@ -940,4 +972,44 @@ namespace vk_utils {
     vkCmdSetScissor(a_cmdBuff, 0, 1, &scissor);
   }
 
+#if defined(VK_KHR_dynamic_rendering)
+  VkRenderingAttachmentInfoKHR renderingAttachment(VkImageView a_view, VkImageLayout a_layout, VkAttachmentLoadOp a_loadOp,
+                                                   VkAttachmentStoreOp a_storeOp, VkClearValue a_clearValue)
+  {
+    VkRenderingAttachmentInfoKHR attachment = {};
+    attachment.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    attachment.imageView   = a_view;
+    attachment.imageLayout = a_layout;
+    attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+    attachment.loadOp      = a_loadOp;
+    attachment.storeOp     = a_storeOp;
+    attachment.clearValue  = a_clearValue;
+    return attachment;
+  }
+
+  void beginRendering(VkCommandBuffer a_cmdBuff, VkRect2D a_renderArea,
+                      const VkRenderingAttachmentInfoKHR* a_pColorAttachments, uint32_t a_colorAttachmentCount,
+                      const VkRenderingAttachmentInfoKHR* a_pDepthAttachment,
+                      const VkRenderingAttachmentInfoKHR* a_pStencilAttachment,
+                      uint32_t a_layerCount, uint32_t a_viewMask)
+  {
+    VkRenderingInfoKHR renderingInfo = {};
+    renderingInfo.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea           = a_renderArea;
+    renderingInfo.layerCount           = a_layerCount;
+    renderingInfo.viewMask             = a_viewMask;
+    renderingInfo.colorAttachmentCount = a_colorAttachmentCount;
+    renderingInfo.pColorAttachments    = a_pColorAttachments;
+    renderingInfo.pDepthAttachment     = a_pDepthAttachment;
+    renderingInfo.pStencilAttachment   = a_pStencilAttachment;
+
+    vkCmdBeginRenderingKHR(a_cmdBuff, &renderingInfo);
+  }
+
+  void endRendering(VkCommandBuffer a_cmdBuff)
+  {
+    vkCmdEndRenderingKHR(a_cmdBuff);
+  }
+#endif
+
 }
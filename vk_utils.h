@@ -46,6 +46,13 @@ namespace vk_utils
   std::vector<std::string> subgroupOperationToString(VkSubgroupFeatureFlags flags);
 
   size_t getPaddedSize(size_t a_size, size_t a_alignment);
+
+  // 64-bit FNV-1a over bytes; pass previous result as a_hash to continue hashing with the next block
+  uint64_t hashFNV1a(const void* a_data, size_t a_size, uint64_t a_hash = 14695981039346656037ull);
+
+  // raw value of a Vulkan handle (pointer on 64-bit platforms, uint64_t for non-dispatchable handles on 32-bit)
+  template<typename T>
+  inline uint64_t handleToU64(T a_handle) { return (uint64_t)a_handle; }
   uint32_t getSBTAlignedSize(uint32_t value, uint32_t alignment);
 
   std::vector<uint32_t> readSPVFile(const char* filename);
@@ -76,6 +83,7 @@ namespace vk_utils
     VkImageLayout      initialLayout;
     VkImageLayout      finalLayout;
     VkBool32           drawFromBuffer = VK_FALSE;
+    VkBool32           dynamicRendering = VK_FALSE; // no render pass/framebuffer; target view stays in COLOR_ATTACHMENT_OPTIMAL
   };
 
   VkRenderPass createDefaultRenderPass(VkDevice a_device, VkFormat a_imageFormat, VkFormat a_depthFormat,
@@ -83,6 +91,25 @@ namespace vk_utils
   VkRenderPass createRenderPass(VkDevice a_device, RenderTargetInfo2D a_rtInfo);
   // ****************
 
+  // *** dynamic rendering ***
+  // VK_KHR_dynamic_rendering (or dynamicRendering feature of Vulkan 1.3) must be enabled on the device.
+  // No render pass and framebuffer objects are needed, but layout transitions are done by the caller:
+  // attachments must be in a_layout before rendering starts and stay in it after rendering ends.
+  //
+#if defined(VK_KHR_dynamic_rendering)
+  VkRenderingAttachmentInfoKHR renderingAttachment(VkImageView a_view, VkImageLayout a_layout, VkAttachmentLoadOp a_loadOp,
+                                                   VkAttachmentStoreOp a_storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                                                   VkClearValue a_clearValue = {});
+
+  void beginRendering(VkCommandBuffer a_cmdBuff, VkRect2D a_renderArea,
+                      const VkRenderingAttachmentInfoKHR* a_pColorAttachments, uint32_t a_colorAttachmentCount,
+                      const VkRenderingAttachmentInfoKHR* a_pDepthAttachment = nullptr,
+                      const VkRenderingAttachmentInfoKHR* a_pStencilAttachment = nullptr,
+                      uint32_t a_layerCount = 1, uint32_t a_viewMask = 0);
+  void endRendering(VkCommandBuffer a_cmdBuff);
+#endif
+  // ****************
+
   // *** errors and debugging ***
   //
   enum class LogLevel {